@@ -536,5 +536,6 @@ GCONCAT( blit_funcs_, GDST_TYPE )[GBLENDER_SOURCE_MAX] =
 #undef GDST_STOREC
 #undef GDST_PIX
 #undef GDST_CHANNELS
+#undef GDST_FORE
 
 /* EOF */
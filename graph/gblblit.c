@@ -19,7 +19,252 @@
 
 #include "grobjs.h"
 #include "gblblit.h"
+#include "grsimd.h"
 #include <stdlib.h>
+#include <string.h>
+
+
+#define  GSIMD_BLOCK_sse2  16
+#define  GSIMD_BLOCK_avx2  32
+#define  GSIMD_BLOCK_neon  16
+
+
+/* Each instruction set provides two classifiers for a block of
+ * GSIMD_BLOCK_xxx pixels.  Both store the shade indices of the block into
+ * `shade', exactly as computed by GBLENDER_SHADE_INDEX.
+ *
+ *   gsimd_gray_xxx  returns the mask of pixels with a non-zero shade;
+ *                   `*full' receives the mask of fully covered ones
+ *
+ *   gsimd_lcd_xxx   returns 0 if the block is blank, 1 if all subpixels
+ *                   are fully covered, and 2 otherwise
+ */
+
+#ifdef GBLENDER_HAVE_SSE2
+
+static GSIMD_ATTR_sse2 __m128i
+gsimd_shade_sse2( __m128i  v )
+{
+  const __m128i  zero = _mm_setzero_si128();
+  const __m128i  mul  = _mm_set1_epi16( GBLENDER_SHADE_COUNT - 1 );
+  const __m128i  rnd  = _mm_set1_epi16( 128 );
+
+  __m128i  lo = _mm_unpacklo_epi8( v, zero );
+  __m128i  hi = _mm_unpackhi_epi8( v, zero );
+
+
+  lo = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( lo, mul ), rnd ), 8 );
+  hi = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( hi, mul ), rnd ), 8 );
+
+  return _mm_packus_epi16( lo, hi );
+}
+
+
+static GSIMD_ATTR_sse2 unsigned int
+gsimd_gray_sse2( const unsigned char*  src,
+                 unsigned char*        shade,
+                 unsigned int*         full )
+{
+  __m128i  s = gsimd_shade_sse2( _mm_loadu_si128( (const __m128i*)src ) );
+
+
+  _mm_storeu_si128( (__m128i*)shade, s );
+
+  *full = (unsigned int)_mm_movemask_epi8(
+            _mm_cmpeq_epi8( s, _mm_set1_epi8( GBLENDER_SHADE_COUNT - 1 ) ) );
+
+  return (unsigned int)_mm_movemask_epi8(
+           _mm_cmpeq_epi8( s, _mm_setzero_si128() ) ) ^ 0xFFFFU;
+}
+
+
+static GSIMD_ATTR_sse2 int
+gsimd_lcd_sse2( const unsigned char*  src,
+                unsigned char*        shade )
+{
+  const __m128i  top = _mm_set1_epi8( GBLENDER_SHADE_COUNT - 1 );
+
+  __m128i  s0 = gsimd_shade_sse2( _mm_loadu_si128( (const __m128i*)src ) );
+  __m128i  s1 = gsimd_shade_sse2( _mm_loadu_si128( (const __m128i*)src + 1 ) );
+  __m128i  s2 = gsimd_shade_sse2( _mm_loadu_si128( (const __m128i*)src + 2 ) );
+
+
+  _mm_storeu_si128( (__m128i*)shade,     s0 );
+  _mm_storeu_si128( (__m128i*)shade + 1, s1 );
+  _mm_storeu_si128( (__m128i*)shade + 2, s2 );
+
+  if ( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_or_si128( _mm_or_si128( s0, s1 ),
+                                                        s2 ),
+                                          _mm_setzero_si128() ) ) == 0xFFFF )
+    return 0;
+
+  if ( _mm_movemask_epi8( _mm_and_si128( _mm_and_si128(
+                                           _mm_cmpeq_epi8( s0, top ),
+                                           _mm_cmpeq_epi8( s1, top ) ),
+                                         _mm_cmpeq_epi8( s2, top ) ) ) == 0xFFFF )
+    return 1;
+
+  return 2;
+}
+
+#endif /* GBLENDER_HAVE_SSE2 */
+
+
+#ifdef GBLENDER_HAVE_AVX2
+
+static GSIMD_ATTR_avx2 __m256i
+gsimd_shade_avx2( __m256i  v )
+{
+  const __m256i  zero = _mm256_setzero_si256();
+  const __m256i  mul  = _mm256_set1_epi16( GBLENDER_SHADE_COUNT - 1 );
+  const __m256i  rnd  = _mm256_set1_epi16( 128 );
+
+  /* unpacking and packing both work within 128-bit lanes, */
+  /* so the byte order is preserved                        */
+  __m256i  lo = _mm256_unpacklo_epi8( v, zero );
+  __m256i  hi = _mm256_unpackhi_epi8( v, zero );
+
+
+  lo = _mm256_srli_epi16(
+         _mm256_add_epi16( _mm256_mullo_epi16( lo, mul ), rnd ), 8 );
+  hi = _mm256_srli_epi16(
+         _mm256_add_epi16( _mm256_mullo_epi16( hi, mul ), rnd ), 8 );
+
+  return _mm256_packus_epi16( lo, hi );
+}
+
+
+static GSIMD_ATTR_avx2 unsigned int
+gsimd_gray_avx2( const unsigned char*  src,
+                 unsigned char*        shade,
+                 unsigned int*         full )
+{
+  __m256i  s = gsimd_shade_avx2(
+                 _mm256_loadu_si256( (const __m256i*)src ) );
+
+
+  _mm256_storeu_si256( (__m256i*)shade, s );
+
+  *full = (unsigned int)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8( s,
+                               _mm256_set1_epi8( GBLENDER_SHADE_COUNT - 1 ) ) );
+
+  return ~(unsigned int)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8( s, _mm256_setzero_si256() ) );
+}
+
+
+static GSIMD_ATTR_avx2 int
+gsimd_lcd_avx2( const unsigned char*  src,
+                unsigned char*        shade )
+{
+  const __m256i  top = _mm256_set1_epi8( GBLENDER_SHADE_COUNT - 1 );
+
+  __m256i  s0 = gsimd_shade_avx2(
+                  _mm256_loadu_si256( (const __m256i*)src ) );
+  __m256i  s1 = gsimd_shade_avx2(
+                  _mm256_loadu_si256( (const __m256i*)src + 1 ) );
+  __m256i  s2 = gsimd_shade_avx2(
+                  _mm256_loadu_si256( (const __m256i*)src + 2 ) );
+
+
+  _mm256_storeu_si256( (__m256i*)shade,     s0 );
+  _mm256_storeu_si256( (__m256i*)shade + 1, s1 );
+  _mm256_storeu_si256( (__m256i*)shade + 2, s2 );
+
+  if ( _mm256_testz_si256( _mm256_or_si256( _mm256_or_si256( s0, s1 ), s2 ),
+                           _mm256_set1_epi8( -1 ) ) )
+    return 0;
+
+  if ( _mm256_movemask_epi8(
+         _mm256_and_si256( _mm256_and_si256( _mm256_cmpeq_epi8( s0, top ),
+                                             _mm256_cmpeq_epi8( s1, top ) ),
+                           _mm256_cmpeq_epi8( s2, top ) ) ) == -1 )
+    return 1;
+
+  return 2;
+}
+
+#endif /* GBLENDER_HAVE_AVX2 */
+
+
+#ifdef GBLENDER_HAVE_NEON
+
+static uint8x16_t
+gsimd_shade_neon( uint8x16_t  v )
+{
+  const uint16x8_t  rnd = vdupq_n_u16( 128 );
+  const uint8x8_t   mul = vdup_n_u8( GBLENDER_SHADE_COUNT - 1 );
+
+
+  return vcombine_u8(
+           vshrn_n_u16( vmlal_u8( rnd, vget_low_u8( v ), mul ), 8 ),
+           vshrn_n_u16( vmlal_u8( rnd, vget_high_u8( v ), mul ), 8 ) );
+}
+
+
+  /* there is no `movemask'; weigh the lanes and add them up */
+static unsigned int
+gsimd_mask_neon( uint8x16_t  m )
+{
+  static const unsigned char  weights[16] =
+  {
+    1, 2, 4, 8, 16, 32, 64, 128,
+    1, 2, 4, 8, 16, 32, 64, 128
+  };
+
+  uint8x16_t  w = vandq_u8( m, vld1q_u8( weights ) );
+
+
+  return (unsigned int)vaddv_u8( vget_low_u8( w ) )         |
+         (unsigned int)vaddv_u8( vget_high_u8( w ) ) << 8;
+}
+
+
+static unsigned int
+gsimd_gray_neon( const unsigned char*  src,
+                 unsigned char*        shade,
+                 unsigned int*         full )
+{
+  uint8x16_t  s = gsimd_shade_neon( vld1q_u8( src ) );
+
+
+  vst1q_u8( shade, s );
+
+  *full = gsimd_mask_neon(
+            vceqq_u8( s, vdupq_n_u8( GBLENDER_SHADE_COUNT - 1 ) ) );
+
+  return gsimd_mask_neon( vtstq_u8( s, s ) );
+}
+
+
+static int
+gsimd_lcd_neon( const unsigned char*  src,
+                unsigned char*        shade )
+{
+  const uint8x16_t  top = vdupq_n_u8( GBLENDER_SHADE_COUNT - 1 );
+
+  uint8x16_t  s0 = gsimd_shade_neon( vld1q_u8( src ) );
+  uint8x16_t  s1 = gsimd_shade_neon( vld1q_u8( src + 16 ) );
+  uint8x16_t  s2 = gsimd_shade_neon( vld1q_u8( src + 32 ) );
+
+
+  vst1q_u8( shade,      s0 );
+  vst1q_u8( shade + 16, s1 );
+  vst1q_u8( shade + 32, s2 );
+
+  if ( vmaxvq_u8( vorrq_u8( vorrq_u8( s0, s1 ), s2 ) ) == 0 )
+    return 0;
+
+  if ( vminvq_u8( vandq_u8( vandq_u8( vceqq_u8( s0, top ),
+                                      vceqq_u8( s1, top ) ),
+                            vceqq_u8( s2, top ) ) ) == 0xFF )
+    return 1;
+
+  return 2;
+}
+
+#endif /* GBLENDER_HAVE_NEON */
 
 /* generic macros
  */
@@ -100,6 +345,56 @@
 
 /* */
 
+/* channel blending of the direct backends (see `gbllinear.h')
+ */
+
+/* blend in floating point and round to the nearest voltage */
+static unsigned int
+gblender_mix_linear( GBlender      blender,
+                     unsigned int  back,
+                     unsigned int  fore,
+                     unsigned int  a )
+{
+  const float*  mid = blender->linear_mid;
+  float         x   = blender->linear[back];
+  unsigned int  v   = 0;
+  unsigned int  step;
+
+
+  x += ( blender->linear[fore] - x ) * (float)a * ( 1.0f / 255 );
+
+  /* count the thresholds below `x' */
+  for ( step = 128; step; step >>= 1 )
+    if ( x >= mid[v + step - 1] )
+      v += step;
+
+  return v;
+}
+
+
+/* blend in 16-bit fixed point and use a truncated inverse table */
+static unsigned int
+gblender_mix_lut16( GBlender      blender,
+                    unsigned int  back,
+                    unsigned int  fore,
+                    unsigned int  a )
+{
+  unsigned int  x;
+
+
+  if ( a == 0 )
+    return back;
+  if ( a == 255 )
+    return fore;
+
+  x = ( blender->linear16[back] * ( 255 - a ) +
+        blender->linear16[fore] * a           + 127 ) / 255;
+
+  return blender->linear16_inv[x >> ( 16 - GBLENDER_LUT16_INV_BITS )];
+}
+
+/* */
+
 /* Rgb32 blitting routines
  */
 
@@ -108,6 +403,9 @@
 #define  GDST_CHANNELS(p,d)       GBlenderBGR  p = { *(unsigned int*)(d)       & 255, \
                                                      *(unsigned int*)(d) >>  8 & 255, \
                                                      *(unsigned int*)(d) >> 16 & 255 }
+#define  GDST_FORE(p,c)           GBlenderBGR  p = { (c).value       & 255, \
+                                                     (c).value >>  8 & 255, \
+                                                     (c).value >> 16 & 255 }
 #define  GDST_PIX(p,d)            unsigned int  p = *(GBlenderPixel*)(d) & 0xFFFFFF
 #define  GDST_COPY(d)             *(GBlenderPixel*)(d) = color.value
 #define  GDST_STOREP(d,cells,a)   *(GBlenderPixel*)(d) = (cells)[(a)]
@@ -119,6 +417,8 @@
   }
 #define  GDST_STOREC(d,r,g,b)     *(GBlenderPixel*)(d) = GRGB_PACK(r,g,b)
 
+#include "gblsimd.h"
+#include "gbllinear.h"
 #include "gblany.h"
 
 /* Rgb24 blitting routines
@@ -129,6 +429,9 @@
 #define  GDST_CHANNELS(p,d)        GBlenderBGR  p = { ((unsigned char*)(d))[2], \
                                                       ((unsigned char*)(d))[1], \
                                                       ((unsigned char*)(d))[0] }
+#define  GDST_FORE(p,c)            GBlenderBGR  p = { (c).chroma[2], \
+                                                      (c).chroma[1], \
+                                                      (c).chroma[0] }
 #define  GDST_PIX(p,d)             unsigned int  p = GRGB_PACK(((unsigned char*)(d))[0],((unsigned char*)(d))[1],((unsigned char*)(d))[2])
 #define  GDST_COPY(d)              GDST_STORE3(d,color.chroma[0],color.chroma[1],color.chroma[2])
 #define  GDST_STOREC(d,r,g,b)      GDST_STORE3(d,r,g,b)
@@ -150,6 +453,8 @@
       GDST_STORE3(d,_pix >> 16,_pix >> 8,_pix); \
     } while ( 0 )
 
+#include "gblsimd.h"
+#include "gbllinear.h"
 #include "gblany.h"
 
 /* Rgb565 blitting routines
@@ -160,6 +465,9 @@
 #define  GDST_CHANNELS(p,d)      GBlenderBGR  p  = { GRGB565_TO_BLUE (*(unsigned short*)(d)), \
                                                      GRGB565_TO_GREEN(*(unsigned short*)(d)), \
                                                      GRGB565_TO_RED  (*(unsigned short*)(d)) }
+#define  GDST_FORE(p,c)          GBlenderBGR  p  = { GRGB565_TO_BLUE ((unsigned short)(c).value), \
+                                                     GRGB565_TO_GREEN((unsigned short)(c).value), \
+                                                     GRGB565_TO_RED  ((unsigned short)(c).value) }
 #define  GDST_PIX(p,d)           unsigned int  p = GRGB565_TO_RGB24(*(unsigned short*)(d))
 #define  GDST_COPY(d)            *(unsigned short*)(d) = (unsigned short)color.value
 
@@ -180,6 +488,7 @@
 
 #define  GDST_STOREC(d,r,g,b)   *(unsigned short*)(d) = GRGB_TO_RGB565(r,g,b)
 
+#include "gbllinear.h"
 #include "gblany.h"
 
 /* Rgb555 blitting routines
@@ -189,6 +498,9 @@
 #define  GDST_CHANNELS(p,d)      GBlenderBGR  p  = { GRGB555_TO_BLUE (*(unsigned short*)(d)), \
                                                      GRGB555_TO_GREEN(*(unsigned short*)(d)), \
                                                      GRGB555_TO_RED  (*(unsigned short*)(d)) }
+#define  GDST_FORE(p,c)          GBlenderBGR  p  = { GRGB555_TO_BLUE ((unsigned short)(c).value), \
+                                                     GRGB555_TO_GREEN((unsigned short)(c).value), \
+                                                     GRGB555_TO_RED  ((unsigned short)(c).value) }
 #define  GDST_PIX(p,d)           unsigned int  p = GRGB555_TO_RGB24(*(unsigned short*)(d))
 #define  GDST_COPY(d)            *(unsigned short*)(d) = (unsigned short)color.value
 
@@ -209,6 +521,7 @@
 
 #define  GDST_STOREC(d,r,g,b)   *(unsigned short*)(d) = GRGB_TO_RGB555(r,g,b)
 
+#include "gbllinear.h"
 #include "gblany.h"
 
 /* Gray8 blitting routines, only 8-bit gray is supported
@@ -218,6 +531,9 @@
 #define  GDST_CHANNELS(p,d)      GBlenderBGR  p = { *(unsigned char*)(d), \
                                                     *(unsigned char*)(d), \
                                                     *(unsigned char*)(d) }
+#define  GDST_FORE(p,c)          GBlenderBGR  p = { (unsigned char)(c).value, \
+                                                    (unsigned char)(c).value, \
+                                                    (unsigned char)(c).value }
 #define  GDST_PIX(p,d)           unsigned int  p = GGRAY8_TO_RGB24(*(unsigned char*)(d))
 #define  GDST_COPY(d)            *(d) = (unsigned char)color.value
 
@@ -238,10 +554,232 @@
 
 #define  GDST_STOREC(d,r,g,b)   *(d) = GRGB_TO_GRAY8(r,g,b)
 
+#include "gbllinear.h"
 #include "gblany.h"
 
 /* */
 
+/* the blending backends, indexed by GBlenderBackend
+ */
+typedef struct  GBlenderBackendRec_
+{
+  const char*              name;
+  const GBlenderBlitFunc*  blit_funcs[GBLENDER_TARGET_MAX];
+  grSpanFunc               span_funcs[GBLENDER_TARGET_MAX];
+
+} GBlenderBackendRec;
+
+
+static const GBlenderBackendRec  gblender_backends[GBLENDER_BACKEND_MAX] =
+{
+  {
+    "cached",
+    { blit_funcs_gray8,
+      blit_funcs_rgb32,
+      blit_funcs_rgb24,
+      blit_funcs_rgb565,
+      blit_funcs_rgb555 },
+    { _gblender_spans_gray8,
+      _gblender_spans_rgb32,
+      _gblender_spans_rgb24,
+      _gblender_spans_rgb565,
+      _gblender_spans_rgb555 }
+  },
+  {
+    "linear",
+    { blit_funcs_gray8_linear,
+      blit_funcs_rgb32_linear,
+      blit_funcs_rgb24_linear,
+      blit_funcs_rgb565_linear,
+      blit_funcs_rgb555_linear },
+    { _gblender_spans_gray8_linear,
+      _gblender_spans_rgb32_linear,
+      _gblender_spans_rgb24_linear,
+      _gblender_spans_rgb565_linear,
+      _gblender_spans_rgb555_linear }
+  },
+  {
+    "lut16",
+    { blit_funcs_gray8_lut16,
+      blit_funcs_rgb32_lut16,
+      blit_funcs_rgb24_lut16,
+      blit_funcs_rgb565_lut16,
+      blit_funcs_rgb555_lut16 },
+    { _gblender_spans_gray8_lut16,
+      _gblender_spans_rgb32_lut16,
+      _gblender_spans_rgb24_lut16,
+      _gblender_spans_rgb565_lut16,
+      _gblender_spans_rgb555_lut16 }
+  }
+};
+
+
+GBLENDER_APIDEF( const char* )
+gblender_backend_name( GBlenderBackend  backend )
+{
+  if ( backend < 0 || backend >= GBLENDER_BACKEND_MAX )
+    return NULL;
+
+  return gblender_backends[backend].name;
+}
+
+
+GBLENDER_APIDEF( void )
+gblender_set_backend( GBlender         blender,
+                      GBlenderBackend  backend )
+{
+  if ( backend < 0 || backend >= GBLENDER_BACKEND_MAX )
+    backend = GBLENDER_BACKEND_CACHED;
+
+  blender->backend = backend;
+}
+
+
+/* run-time selection of the SIMD variants
+ */
+static GBlenderSimd  gblender_simd = GBLENDER_SIMD_AUTO;
+
+
+static GBlenderSimd
+gblender_simd_detect( void )
+{
+#if defined( GBLENDER_HAVE_AVX2 ) && defined( __GNUC__ )
+
+  __builtin_cpu_init();
+
+  if ( __builtin_cpu_supports( "avx2" ) )
+    return GBLENDER_SIMD_AVX2;
+  if ( __builtin_cpu_supports( "sse2" ) )
+    return GBLENDER_SIMD_SSE2;
+
+#elif defined( GBLENDER_HAVE_AVX2 ) && defined( _MSC_VER )
+
+  int  info[4];
+
+
+  /* AVX2 also needs the OS to save the YMM registers */
+  __cpuid( info, 0 );
+  if ( info[0] >= 7 )
+  {
+    __cpuid( info, 1 );
+    if ( ( info[2] & ( 1 << 27 ) ) && ( info[2] & ( 1 << 28 ) ) &&
+         ( _xgetbv( 0 ) & 6 ) == 6                               )
+    {
+      __cpuidex( info, 7, 0 );
+      if ( info[1] & ( 1 << 5 ) )
+        return GBLENDER_SIMD_AVX2;
+    }
+  }
+  return GBLENDER_SIMD_SSE2;
+
+#elif defined( GBLENDER_HAVE_NEON )
+
+  return GBLENDER_SIMD_NEON;
+
+#endif
+
+  return GBLENDER_SIMD_NONE;
+}
+
+
+GBLENDER_APIDEF( GBlenderSimd )
+gblender_simd_select( GBlenderSimd  level )
+{
+  GBlenderSimd  best = gblender_simd_detect();
+
+
+  if ( level == GBLENDER_SIMD_AUTO )
+    level = best;
+  else if ( level == GBLENDER_SIMD_NEON || best == GBLENDER_SIMD_NEON )
+    level = level == best ? level : GBLENDER_SIMD_NONE;
+  else if ( level > best )    /* NONE < SSE2 < AVX2 */
+    level = best;
+
+  gblender_simd = level;
+
+  return level;
+}
+
+
+GBLENDER_APIDEF( GBlenderSimd )
+gblender_simd_level( void )
+{
+  if ( gblender_simd == GBLENDER_SIMD_AUTO )
+    gblender_simd_select( GBLENDER_SIMD_AUTO );
+
+  return gblender_simd;
+}
+
+
+/* return the SIMD variant of a blitter or span filler, if any */
+static GBlenderBlitFunc
+gblender_simd_blit_func( grPixelMode           mode,
+                         GBlenderSourceFormat  src_format )
+{
+  if ( gblender_simd == GBLENDER_SIMD_AUTO )
+    gblender_simd_select( GBLENDER_SIMD_AUTO );
+
+  if ( src_format > GBLENDER_SOURCE_HBGR )
+    return NULL;
+
+  switch ( gblender_simd )
+  {
+#ifdef GBLENDER_HAVE_SSE2
+  case GBLENDER_SIMD_SSE2:
+    return mode == gr_pixel_mode_rgb32 ? simd_blit_funcs_rgb32_sse2[src_format]
+         : mode == gr_pixel_mode_rgb24 ? simd_blit_funcs_rgb24_sse2[src_format]
+                                       : NULL;
+#endif
+#ifdef GBLENDER_HAVE_AVX2
+  case GBLENDER_SIMD_AVX2:
+    return mode == gr_pixel_mode_rgb32 ? simd_blit_funcs_rgb32_avx2[src_format]
+         : mode == gr_pixel_mode_rgb24 ? simd_blit_funcs_rgb24_avx2[src_format]
+                                       : NULL;
+#endif
+#ifdef GBLENDER_HAVE_NEON
+  case GBLENDER_SIMD_NEON:
+    return mode == gr_pixel_mode_rgb32 ? simd_blit_funcs_rgb32_neon[src_format]
+         : mode == gr_pixel_mode_rgb24 ? simd_blit_funcs_rgb24_neon[src_format]
+                                       : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+
+static grSpanFunc
+gblender_simd_span_func( grPixelMode  mode )
+{
+  if ( gblender_simd == GBLENDER_SIMD_AUTO )
+    gblender_simd_select( GBLENDER_SIMD_AUTO );
+
+  switch ( gblender_simd )
+  {
+#ifdef GBLENDER_HAVE_SSE2
+  case GBLENDER_SIMD_SSE2:
+    return mode == gr_pixel_mode_rgb32 ? _gblender_spans_rgb32_sse2
+         : mode == gr_pixel_mode_rgb24 ? _gblender_spans_rgb24_sse2
+                                       : (grSpanFunc)NULL;
+#endif
+#ifdef GBLENDER_HAVE_AVX2
+  case GBLENDER_SIMD_AVX2:
+    return mode == gr_pixel_mode_rgb32 ? _gblender_spans_rgb32_avx2
+         : mode == gr_pixel_mode_rgb24 ? _gblender_spans_rgb24_avx2
+                                       : (grSpanFunc)NULL;
+#endif
+#ifdef GBLENDER_HAVE_NEON
+  case GBLENDER_SIMD_NEON:
+    return mode == gr_pixel_mode_rgb32 ? _gblender_spans_rgb32_neon
+         : mode == gr_pixel_mode_rgb24 ? _gblender_spans_rgb24_neon
+                                       : (grSpanFunc)NULL;
+#endif
+  default:
+    return (grSpanFunc)NULL;
+  }
+}
+
+
 /* works best to convert from 4 or 16 grays to 256 grays,
  * needs aligned buffers and clean padding
  */
@@ -276,6 +814,7 @@ gblender_blit_init( GBlenderBlit           blit,
   GBlender   blender = surface->gblender;
 
   GBlenderSourceFormat  src_format;
+  GBlenderTargetFormat  dst_format;
   int                   src_x = 0;
   int                   src_y = 0;
   int                   delta;
@@ -340,25 +879,43 @@ gblender_blit_init( GBlenderBlit           blit,
   switch ( target->mode )
   {
   case gr_pixel_mode_gray:
-    blit->blit_func = blit_funcs_gray8[src_format];
+    dst_format = GBLENDER_TARGET_GRAY8;
     break;
   case gr_pixel_mode_rgb32:
-    blit->blit_func = blit_funcs_rgb32[src_format];
+    dst_format = GBLENDER_TARGET_RGB32;
     break;
   case gr_pixel_mode_rgb24:
-    blit->blit_func = blit_funcs_rgb24[src_format];
+    dst_format = GBLENDER_TARGET_RGB24;
     break;
   case gr_pixel_mode_rgb565:
-    blit->blit_func = blit_funcs_rgb565[src_format];
+    dst_format = GBLENDER_TARGET_RGB565;
     break;
   case gr_pixel_mode_rgb555:
-    blit->blit_func = blit_funcs_rgb555[src_format];
+    dst_format = GBLENDER_TARGET_RGB555;
     break;
   default:
     grError = gr_err_bad_target_depth;
     return -2;
   }
 
+  blit->blit_func =
+    gblender_backends[blender->backend].blit_funcs[dst_format][src_format];
+
+  /* not handled by the backend */
+  if ( !blit->blit_func )
+    blit->blit_func = gblender_backends[GBLENDER_BACKEND_CACHED]
+                        .blit_funcs[dst_format][src_format];
+
+  if ( blender->backend == GBLENDER_BACKEND_CACHED )
+  {
+    GBlenderBlitFunc  simd_func = gblender_simd_blit_func( target->mode,
+                                                           src_format );
+
+
+    if ( simd_func )
+      blit->blit_func = simd_func;
+  }
+
   if ( src_pitch < 0 )
     src_buffer -= src_pitch * ( src_height - 1 );
   if ( dst_pitch < 0 )
@@ -423,6 +980,8 @@ grSetTargetPenBrush( grSurface*  surface,
   grBitmap*  target = &surface->bitmap;
   GBlender   blender = surface->gblender;
 
+  GBlenderTargetFormat  dst_format;
+
 
   surface->origin = target->buffer;
   if ( target->pitch < 0 )
@@ -434,27 +993,44 @@ grSetTargetPenBrush( grSurface*  surface,
   {
   case gr_pixel_mode_gray:
     surface->origin    += x;
-    surface->gray_spans = _gblender_spans_gray8;
+    dst_format          = GBLENDER_TARGET_GRAY8;
     break;
   case gr_pixel_mode_rgb555:
     surface->origin    += x * 2;
-    surface->gray_spans = _gblender_spans_rgb555;
+    dst_format          = GBLENDER_TARGET_RGB555;
     break;
   case gr_pixel_mode_rgb565:
     surface->origin    += x * 2;
-    surface->gray_spans = _gblender_spans_rgb565;
+    dst_format          = GBLENDER_TARGET_RGB565;
     break;
   case gr_pixel_mode_rgb24:
     surface->origin    += x * 3;
-    surface->gray_spans = _gblender_spans_rgb24;
+    dst_format          = GBLENDER_TARGET_RGB24;
     break;
   case gr_pixel_mode_rgb32:
     surface->origin    += x * 4;
-    surface->gray_spans = _gblender_spans_rgb32;
+    dst_format          = GBLENDER_TARGET_RGB32;
     break;
   default:
     surface->origin     = NULL;
+    dst_format          = GBLENDER_TARGET_MAX;
+  }
+
+  if ( dst_format == GBLENDER_TARGET_MAX )
     surface->gray_spans = (grSpanFunc)NULL;
+  else
+  {
+    surface->gray_spans =
+      gblender_backends[blender->backend].span_funcs[dst_format];
+
+    if ( blender->backend == GBLENDER_BACKEND_CACHED )
+    {
+      grSpanFunc  simd_spans = gblender_simd_span_func( target->mode );
+
+
+      if ( simd_spans )
+        surface->gray_spans = simd_spans;
+    }
   }
 
   surface->color = color;
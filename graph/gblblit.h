@@ -60,4 +60,61 @@ typedef struct GBlenderBlitRec_
 
 #define  gblender_blit_run(b,color)  (b)->blit_func( (b), (color) )
 
+
+/*
+ * blending backends; the cached one quantizes the coverage to
+ * GBLENDER_SHADE_COUNT levels, the others use all 256 levels and blend
+ * directly in linear light
+ *
+ */
+
+typedef enum
+{
+  GBLENDER_BACKEND_CACHED = 0,  /* gamma-corrected gradient cache   */
+  GBLENDER_BACKEND_LINEAR,      /* floating point, exactly rounded  */
+  GBLENDER_BACKEND_LUT16,       /* 16-bit fixed point lookup tables */
+
+  GBLENDER_BACKEND_MAX
+
+} GBlenderBackend;
+
+
+ /* select the backend for subsequent blits and pen brushes */
+  GBLENDER_API( void )
+  gblender_set_backend( GBlender         blender,
+                        GBlenderBackend  backend );
+
+ /* return the name of a backend, or NULL if out of range */
+  GBLENDER_API( const char* )
+  gblender_backend_name( GBlenderBackend  backend );
+
+
+/*
+ * SIMD variants of the GRAY8, HRGB, and HBGR blitters and of the span
+ * filler for the RGB32 and RGB24 targets; their output is identical to
+ * the portable code
+ *
+ */
+
+typedef enum
+{
+  GBLENDER_SIMD_AUTO = -1,  /* best one supported by the CPU */
+  GBLENDER_SIMD_NONE = 0,   /* portable code only            */
+  GBLENDER_SIMD_SSE2,
+  GBLENDER_SIMD_AVX2,
+  GBLENDER_SIMD_NEON
+
+} GBlenderSimd;
+
+
+ /* select the instruction set for subsequent blits; an unsupported  */
+ /* choice falls back to a lesser one.  Returns the selected variant */
+  GBLENDER_API( GBlenderSimd )
+  gblender_simd_select( GBlenderSimd  level );
+
+ /* return the variant in use, also by the pixel format converters */
+ /* (`grconvert.h') and the swizzle filters (`grswizzle.h')        */
+  GBLENDER_API( GBlenderSimd )
+  gblender_simd_level( void );
+
 #endif /* GBLBLIT_H_ */
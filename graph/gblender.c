@@ -19,11 +19,11 @@
 
 #include "gblender.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #if 0  /* using slow power functions */
 
-#include <math.h>
-
 static void
 gblender_set_gamma_table( double           gamma_value,
                           unsigned short*  gamma_ramp,
@@ -133,6 +133,69 @@ gblender_set_gamma_table( double           gamma_value,
 
 #endif
 
+/* exact transfer functions for the direct blending backends;
+ * these are only evaluated when the gamma changes
+ */
+static double
+gblender_to_linear( double  gamma_value,
+                    double  x )
+{
+  if ( gamma_value > 0 )
+    return pow( x, gamma_value );
+
+  /* sRGB */
+  if ( x <= 0.04045 )
+    return x / 12.92;
+  else
+    return pow( ( x + 0.055 ) / 1.055, 2.4 );
+}
+
+
+static double
+gblender_from_linear( double  gamma_value,
+                      double  x )
+{
+  if ( gamma_value > 0 )
+    return pow( x, 1. / gamma_value );
+
+  /* sRGB */
+  if ( x <= 0.0031308 )
+    return x * 12.92;
+  else
+    return 1.055 * pow( x, 1. / 2.4 ) - 0.055;
+}
+
+
+static void
+gblender_set_linear_tables( GBlender  blender,
+                            double    gamma_value )
+{
+  const int  imax = ( 1 << GBLENDER_LUT16_INV_BITS ) - 1;
+  int        ii;
+
+
+  for ( ii = 0; ii < 256; ii++ )
+  {
+    double  x = gblender_to_linear( gamma_value, ii / 255. );
+
+
+    blender->linear[ii]   = (float)x;
+    blender->linear16[ii] = (unsigned short)( 65535. * x + 0.5 );
+  }
+
+  /* a linear value `x' encodes to the voltage `v' */
+  /* if linear_mid[v-1] <= x < linear_mid[v]      */
+  for ( ii = 0; ii < 255; ii++ )
+    blender->linear_mid[ii] =
+      (float)gblender_to_linear( gamma_value, ( ii + 0.5 ) / 255. );
+
+  /* sample the center of each interval */
+  for ( ii = 0; ii <= imax; ii++ )
+    blender->linear16_inv[ii] = (unsigned char)( 255. *
+      gblender_from_linear( gamma_value, ( ii + 0.5 ) / ( imax + 1 ) ) + 0.5 );
+}
+
+
 /* clear the cache
  */
 GBLENDER_APIDEF( void )
@@ -186,9 +249,12 @@ gblender_init( GBlender   blender,
   gblender_set_gamma_table( gamma_value,
                             blender->gamma_ramp,
                             blender->gamma_ramp_inv );
+  gblender_set_linear_tables( blender, gamma_value );
 
   gblender_clear( blender );
 
+  blender->shared = NULL;
+
 #ifdef GBLENDER_STATS
   blender->stat_hits    = 0;
   blender->stat_lookups = 0;
@@ -267,6 +333,184 @@ gblender_reset_key( GBlender     blender,
   }
 }
 
+/* shared key tables
+ *
+ * Keys are filled once and never modified until the next call to
+ * `gblender_shared_clear', so their cells can be used without locking
+ * once published.  A thread that finds a slot taken by another couple
+ * computes the grades into its blender's scratch cells instead.
+ *
+ * The channel grades are small enough to be stored completely; they are
+ * computed per foreground value when first needed.
+ */
+
+#if defined( __GNUC__ )
+
+#define  GBLENDER_LOAD_ACQUIRE(p)     __atomic_load_n( (p), __ATOMIC_ACQUIRE )
+#define  GBLENDER_STORE_RELEASE(p,v)  __atomic_store_n( (p), (v),          \
+                                                        __ATOMIC_RELEASE )
+#define  GBLENDER_CAS(p,o,n)                                            \
+  __atomic_compare_exchange_n( (p), &(o), (n), 0,                       \
+                               __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+
+#elif defined( _MSC_VER )
+
+#include <intrin.h>
+
+  /* volatile accesses have acquire and release semantics with MSVC */
+#define  GBLENDER_LOAD_ACQUIRE(p)     ( *(volatile void**)(p) )
+#define  GBLENDER_STORE_RELEASE(p,v)  ( *(volatile void**)(p) = (v) )
+#define  GBLENDER_CAS(p,o,n)                                               \
+  ( _InterlockedCompareExchangePointer( (void* volatile*)(p), (n), (o) ) \
+      == (o) )
+
+#else  /* no atomics: sharing is safe within a single thread only */
+
+#define  GBLENDER_LOAD_ACQUIRE(p)     ( *(p) )
+#define  GBLENDER_STORE_RELEASE(p,v)  ( *(p) = (v) )
+#define  GBLENDER_CAS(p,o,n)          ( *(p) == (o) ? ( *(p) = (n), 1 ) : 0 )
+
+#endif
+
+
+typedef struct  GBlenderSharedRec_
+{
+  GBlenderRec    base;                      /* gamma tables, keys, cells */
+  void*          ready[GBLENDER_KEY_COUNT];             /* see below */
+
+  /* all grades for each foreground channel value, by background */
+  void*          channel_ready[256];
+  unsigned char  channel_cells[256][256 * GBLENDER_SHADE_COUNT];
+
+} GBlenderSharedRec;
+
+  /* slot states; pointers so that MSVC can swap them too */
+#define  GBLENDER_KEY_EMPTY  NULL
+#define  GBLENDER_KEY_BUSY   ( (void*)&gblender_key_busy )
+#define  GBLENDER_KEY_READY  ( (void*)&gblender_key_ready )
+
+static const int  gblender_key_busy  = 1;
+static const int  gblender_key_ready = 2;
+
+
+GBLENDER_APIDEF( GBlenderShared )
+gblender_shared_new( double  gamma )
+{
+  /* untouched channel cells are not even mapped by most systems */
+  GBlenderShared  shared = (GBlenderShared)calloc( 1, sizeof ( *shared ) );
+
+
+  if ( shared )
+    gblender_init( &shared->base, gamma );
+
+  return shared;
+}
+
+
+GBLENDER_APIDEF( void )
+gblender_shared_clear( GBlenderShared  shared )
+{
+  int  nn;
+
+
+  for ( nn = 0; nn < GBLENDER_KEY_COUNT; nn++ )
+    shared->ready[nn] = GBLENDER_KEY_EMPTY;
+
+  for ( nn = 0; nn < 256; nn++ )
+    shared->channel_ready[nn] = GBLENDER_KEY_EMPTY;
+}
+
+
+GBLENDER_APIDEF( void )
+gblender_shared_done( GBlenderShared  shared )
+{
+  free( shared );
+}
+
+
+GBLENDER_APIDEF( void )
+gblender_attach( GBlender        blender,
+                 GBlenderShared  shared )
+{
+  if ( shared )
+  {
+    const GBlenderRec*  base = &shared->base;
+
+
+    /* the private tables must match the shared ones */
+    memcpy( blender->gamma_ramp, base->gamma_ramp,
+            sizeof ( base->gamma_ramp ) );
+    memcpy( blender->gamma_ramp_inv, base->gamma_ramp_inv,
+            sizeof ( base->gamma_ramp_inv ) );
+    memcpy( blender->linear, base->linear,
+            sizeof ( base->linear ) );
+    memcpy( blender->linear_mid, base->linear_mid,
+            sizeof ( base->linear_mid ) );
+    memcpy( blender->linear16, base->linear16,
+            sizeof ( base->linear16 ) );
+    memcpy( blender->linear16_inv, base->linear16_inv,
+            sizeof ( base->linear16_inv ) );
+  }
+
+  gblender_clear( blender );
+
+  blender->shared = shared;
+}
+
+
+static GBlenderCell*
+gblender_lookup_shared( GBlender       blender,
+                        GBlenderPixel  background,
+                        GBlenderPixel  foreground )
+{
+  GBlenderShared  shared = blender->shared;
+  unsigned int    idx;
+  GBlenderKey     key;
+  void*           state;
+
+
+  idx = ( background ^ foreground ^ 0x55555555 ) % (GBLENDER_KEY_COUNT-1);
+  key = shared->base.keys + idx;
+
+  state = GBLENDER_LOAD_ACQUIRE( &shared->ready[idx] );
+
+  if ( state == GBLENDER_KEY_READY       &&
+       key->background == background     &&
+       key->foreground == foreground     )
+    return key->cells;
+
+  if ( state == GBLENDER_KEY_EMPTY                                       &&
+       GBLENDER_CAS( &shared->ready[idx], state, GBLENDER_KEY_BUSY ) )
+  {
+    key->background = background;
+    key->foreground = foreground;
+    key->cells      = shared->base.cells[idx];
+
+    gblender_reset_key( &shared->base, key );
+
+    GBLENDER_STORE_RELEASE( &shared->ready[idx], GBLENDER_KEY_READY );
+
+    return key->cells;
+  }
+
+  /* the slot is taken: use private cells */
+  {
+    GBlenderKeyRec  scratch_key;
+
+
+    scratch_key.background = background;
+    scratch_key.foreground = foreground;
+    scratch_key.cells      = blender->scratch;
+
+    gblender_reset_key( blender, &scratch_key );
+  }
+
+  return blender->scratch;
+}
+
+
+/* */
+
  /* lookup the grades of a given (background,foreground) couple
   */
 GBLENDER_APIDEF( GBlenderCell* )
@@ -282,6 +526,9 @@ gblender_lookup( GBlender       blender,
   blender->stat_lookups++;
 #endif
 
+  if ( blender->shared )
+    return gblender_lookup_shared( blender, background, foreground );
+
   idx = ( background ^ foreground ^ 0x55555555 ) % (GBLENDER_KEY_COUNT-1);
 
   key = blender->keys + idx;
@@ -313,15 +560,15 @@ Exit:
 }
 
 
+/* compute the grade levels of a channel (background,foreground) couple
+ */
 static void
-gblender_reset_channel_key( GBlender         blender,
-                            GBlenderChanKey  key )
+gblender_set_channel_grades( GBlender        blender,
+                             unsigned int    back,
+                             unsigned int    fore,
+                             unsigned char*  gr )
 {
-  unsigned int    back = key->backfore & 255;
-  unsigned int    fore = (key->backfore >> 8) & 255;
-  unsigned char*  gr   = (unsigned char*)blender->cells +
-                                         key->index * GBLENDER_SHADE_COUNT;
-  unsigned int    nn;
+  unsigned int  nn;
 
   const unsigned char*   gamma_ramp_inv = blender->gamma_ramp_inv;
   const unsigned short*  gamma_ramp     = blender->gamma_ramp;
@@ -346,6 +593,56 @@ gblender_reset_channel_key( GBlender         blender,
 }
 
 
+static void
+gblender_reset_channel_key( GBlender         blender,
+                            GBlenderChanKey  key )
+{
+  gblender_set_channel_grades( blender,
+                               key->backfore & 255,
+                               ( key->backfore >> 8 ) & 255,
+                               (unsigned char*)blender->cells +
+                                 key->index * GBLENDER_SHADE_COUNT );
+}
+
+
+static unsigned char*
+gblender_lookup_channel_shared( GBlender      blender,
+                                unsigned int  background,
+                                unsigned int  foreground )
+{
+  GBlenderShared  shared = blender->shared;
+  unsigned char*  cells  = shared->channel_cells[foreground];
+  void*           state;
+
+
+  state = GBLENDER_LOAD_ACQUIRE( &shared->channel_ready[foreground] );
+
+  if ( state != GBLENDER_KEY_READY )
+  {
+    if ( state == GBLENDER_KEY_EMPTY                                   &&
+         GBLENDER_CAS( &shared->channel_ready[foreground],
+                       state, GBLENDER_KEY_BUSY )                      )
+    {
+      unsigned int  back;
+
+
+      for ( back = 0; back < 256; back++ )
+        gblender_set_channel_grades( &shared->base, back, foreground,
+                                     cells + back * GBLENDER_SHADE_COUNT );
+
+      GBLENDER_STORE_RELEASE( &shared->channel_ready[foreground],
+                              GBLENDER_KEY_READY );
+    }
+    else  /* another thread is filling the table; this is quick */
+      while ( GBLENDER_LOAD_ACQUIRE( &shared->channel_ready[foreground] ) !=
+                GBLENDER_KEY_READY )
+        ;
+  }
+
+  return cells + background * GBLENDER_SHADE_COUNT;
+}
+
+
 GBLENDER_APIDEF( unsigned char* )
 gblender_lookup_channel( GBlender      blender,
                          unsigned int  background,
@@ -360,6 +657,9 @@ gblender_lookup_channel( GBlender      blender,
   blender->stat_lookups++;
 #endif
 
+  if ( blender->shared )
+    return gblender_lookup_channel_shared( blender, background, foreground );
+
   idx = ( background ^ foreground * 59 ) % ( GBLENDER_KEY_COUNT * 3 - 1 );
 
   key = (GBlenderChanKey)blender->keys + idx;
@@ -23,6 +23,7 @@
 #define  GBLENDER_SHADE_INDEX(n)  (((n) * (GBLENDER_SHADE_COUNT-1) + 128) >> 8)
 #define  GBLENDER_KEY_COUNT       256  /* must be a power of 2 */
 #define  GBLENDER_GAMMA_SHIFT     2
+#define  GBLENDER_LUT16_INV_BITS  12  /* size of the 16-bit inverse table */
 
 #define  xGBLENDER_STORE_BYTES  /* define this to store (R,G,B) values on 3
                                 * bytes, instead of a single 32-bit integer.
@@ -68,6 +69,10 @@
   } GBlenderChanKeyRec, *GBlenderChanKey;
 
 
+  /* a read-mostly key table that several blenders can share */
+  typedef struct GBlenderSharedRec_*  GBlenderShared;
+
+
   /* sizeof GBlenderKeyRec is at least 3x sizeof GBlenderChanKeyRec */
   /* Therefore, we can safely use 3x as many channel keys           */
   typedef struct GBlenderRec_
@@ -104,6 +109,21 @@
     unsigned short        gamma_ramp[256];                              /* voltage to linear */
     unsigned char         gamma_ramp_inv[256 << GBLENDER_GAMMA_SHIFT];  /* linear to voltage */
 
+   /* the exact tables for the direct blending backends (see `gblblit.h')
+    */
+    int                   backend;
+    float                 linear[256];      /* voltage to linear, [0,1]   */
+    float                 linear_mid[255];  /* rounding thresholds        */
+    unsigned short        linear16[256];    /* voltage to linear, 16-bit  */
+    unsigned char         linear16_inv[1 << GBLENDER_LUT16_INV_BITS];
+
+   /* when attached to a shared table, the keys and cells above are not
+    * used; the small caches stay private, and `scratch' receives the
+    * grades of keys that could not be stored in the shared table
+    */
+    GBlenderShared        shared;
+    GBlenderCell          scratch[ GBLENDER_SHADE_COUNT ];
+
 #ifdef GBLENDER_STATS
     long                  stat_hits;    /* number of direct hits             */
     long                  stat_lookups; /* number of table lookups           */
@@ -128,6 +148,30 @@
   gblender_clear_channels( GBlender  blender );
 
 
+ /* Create a key table to be shared by blenders in several threads.
+  * Its keys are computed once and never modified afterwards, so that
+  * lookups need no locking.  Each thread should use its own blender
+  * attached to the table, which provides the small private caches.
+  */
+  GBLENDER_API( GBlenderShared )
+  gblender_shared_new( double  gamma );
+
+  GBLENDER_API( void )
+  gblender_shared_done( GBlenderShared  shared );
+
+ /* forget all keys; no attached blender may be in use meanwhile, */
+ /* and all of them must be attached again afterwards             */
+  GBLENDER_API( void )
+  gblender_shared_clear( GBlenderShared  shared );
+
+ /* attach a blender to a shared table, or detach it if `shared' is */
+ /* NULL; the blender takes the gamma of the table, and a later     */
+ /* `gblender_init' detaches it                                     */
+  GBLENDER_API( void )
+  gblender_attach( GBlender        blender,
+                   GBlenderShared  shared );
+
+
  /* lookup a cell range for a given (background,foreground) pair
   */
   GBLENDER_API( GBlenderCell* )
@@ -0,0 +1,243 @@
+/* Blitters and span filler of the direct blending backends, instantiated
+ * by `gblblit.c' for every target.
+ *
+ * Included without `GLIN' defined, this file includes itself once per
+ * backend.  Unlike the cached blender, these backends use the full 8-bit
+ * coverage and blend each channel in linear light without any cache;
+ * `gblender_mix_<backend>' does the work for one channel.  `GDST_FORE'
+ * takes the channels of the foreground color from its value instead of
+ * reading the `grColor' union through a pixel pointer.
+ */
+
+#ifndef GLIN
+
+#  define  GLIN  linear
+#  include "gbllinear.h"
+
+#  define  GLIN  lut16
+#  include "gbllinear.h"
+
+#else /* GLIN */
+
+#undef  GSCONCAT
+#undef  GSCONCATX
+#undef  GSCONCAT3
+#undef  GSCONCAT3X
+#define GSCONCAT(x,y)       GSCONCATX(x,y)
+#define GSCONCATX(x,y)      x ## y
+#define GSCONCAT3(x,y,z)    GSCONCAT3X(x,y,z)
+#define GSCONCAT3X(x,y,z)   x ## y ## _ ## z
+
+#define GLIN_MIX            GSCONCAT( gblender_mix_, GLIN )
+
+
+static void
+GSCONCAT3( _gblender_spans_, GDST_TYPE, GLIN )( int            y,
+                                                int            count,
+                                                const grSpan*  spans,
+                                                grSurface*     surface )
+{
+  grColor         color   = surface->color;
+  GBlender        blender = surface->gblender;
+
+  GDST_FORE( fore, color );
+
+  unsigned char*  dst_origin = surface->origin - y * surface->bitmap.pitch;
+
+
+  for ( ; count--; spans++ )
+  {
+    unsigned char*  dst = dst_origin + spans->x * GDST_INCR;
+    unsigned short  w   = spans->len;
+    unsigned int    a   = spans->coverage;
+
+    if ( a == 255 )
+      for ( ; w-- ; dst += GDST_INCR )
+      {
+        GDST_COPY(dst);
+      }
+    else if ( a )
+      for ( ; w-- ; dst += GDST_INCR )
+      {
+        GDST_CHANNELS( back, dst );
+
+        GDST_STOREC( dst, GLIN_MIX( blender, back.r, fore.r, a ),
+                          GLIN_MIX( blender, back.g, fore.g, a ),
+                          GLIN_MIX( blender, back.b, fore.b, a ) );
+      }
+  }
+}
+
+
+static void
+GSCONCAT3( _gblender_blit_gray8_, GDST_TYPE, GLIN )( GBlenderBlit  blit,
+                                                     grColor       color )
+{
+  GBlender  blender = blit->blender;
+
+  GDST_FORE( fore, color );
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line + blit->src_x;
+  unsigned char*        dst_line = blit->dst_line + blit->dst_x*GDST_INCR;
+
+  do
+  {
+    const unsigned char*  src = src_line;
+    unsigned char*        dst = dst_line;
+    int                   w   = blit->width;
+
+    do
+    {
+      unsigned int  a = src[0];
+
+      if ( a == 0 )
+      {
+        /* nothing */
+      }
+      else if ( a == 255 )
+      {
+        GDST_COPY(dst);
+      }
+      else
+      {
+        GDST_CHANNELS( back, dst );
+
+        GDST_STOREC( dst, GLIN_MIX( blender, back.r, fore.r, a ),
+                          GLIN_MIX( blender, back.g, fore.g, a ),
+                          GLIN_MIX( blender, back.b, fore.b, a ) );
+      }
+
+      src += 1;
+      dst += GDST_INCR;
+    }
+    while (--w > 0);
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+}
+
+
+  /* `r', `g', and `b' are the offsets of the subpixels, */
+  /* `step' is the distance between two pixels           */
+static void
+GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GLIN )( GBlenderBlit  blit,
+                                                   grColor       color,
+                                                   int           r,
+                                                   int           g,
+                                                   int           b,
+                                                   int           step )
+{
+  GBlender  blender = blit->blender;
+
+  GDST_FORE( fore, color );
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line + blit->src_x*step;
+  unsigned char*        dst_line = blit->dst_line + blit->dst_x*GDST_INCR;
+
+  do
+  {
+    const unsigned char*  src = src_line;
+    unsigned char*        dst = dst_line;
+    int                   w   = blit->width;
+
+    do
+    {
+      unsigned int  ar = src[r];
+      unsigned int  ag = src[g];
+      unsigned int  ab = src[b];
+      unsigned int  aa = (ar << 16) | (ag << 8) | ab;
+
+      if ( aa == 0 )
+      {
+        /* nothing */
+      }
+      else if ( aa == 0xFFFFFFU )
+      {
+        GDST_COPY(dst);
+      }
+      else
+      {
+        GDST_CHANNELS( back, dst );
+
+        GDST_STOREC( dst, GLIN_MIX( blender, back.r, fore.r, ar ),
+                          GLIN_MIX( blender, back.g, fore.g, ag ),
+                          GLIN_MIX( blender, back.b, fore.b, ab ) );
+      }
+
+      src += step;
+      dst += GDST_INCR;
+    }
+    while (--w > 0);
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+}
+
+
+static void
+GSCONCAT3( _gblender_blit_hrgb_, GDST_TYPE, GLIN )( GBlenderBlit  blit,
+                                                    grColor       color )
+{
+  GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GLIN )( blit, color,
+                                                     0, 1, 2, 3 );
+}
+
+
+static void
+GSCONCAT3( _gblender_blit_hbgr_, GDST_TYPE, GLIN )( GBlenderBlit  blit,
+                                                    grColor       color )
+{
+  GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GLIN )( blit, color,
+                                                     2, 1, 0, 3 );
+}
+
+
+static void
+GSCONCAT3( _gblender_blit_vrgb_, GDST_TYPE, GLIN )( GBlenderBlit  blit,
+                                                    grColor       color )
+{
+  int  p = blit->src_pitch / 3;
+
+
+  GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GLIN )( blit, color,
+                                                     0, p, 2 * p, 1 );
+}
+
+
+static void
+GSCONCAT3( _gblender_blit_vbgr_, GDST_TYPE, GLIN )( GBlenderBlit  blit,
+                                                    grColor       color )
+{
+  int  p = blit->src_pitch / 3;
+
+
+  GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GLIN )( blit, color,
+                                                     2 * p, p, 0, 1 );
+}
+
+
+  /* BGRA and MONO sources do not blend with coverage; */
+  /* the NULL entries fall back to the cached blender  */
+static const GBlenderBlitFunc
+GSCONCAT3( blit_funcs_, GDST_TYPE, GLIN )[GBLENDER_SOURCE_MAX] =
+{
+  GSCONCAT3( _gblender_blit_gray8_, GDST_TYPE, GLIN ),
+  GSCONCAT3( _gblender_blit_hrgb_, GDST_TYPE, GLIN ),
+  GSCONCAT3( _gblender_blit_hbgr_, GDST_TYPE, GLIN ),
+  GSCONCAT3( _gblender_blit_vrgb_, GDST_TYPE, GLIN ),
+  GSCONCAT3( _gblender_blit_vbgr_, GDST_TYPE, GLIN ),
+  NULL,
+  NULL
+};
+
+
+#undef GLIN_MIX
+#undef GLIN
+
+#endif /* GLIN */
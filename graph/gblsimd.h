@@ -0,0 +1,352 @@
+/* Vectorized variants of the GRAY8, HRGB, and HBGR blitters and of the
+ * span filler, instantiated by `gblblit.c' for the RGB32 and RGB24
+ * targets.
+ *
+ * Included without `GSIMD' defined, this file includes itself once per
+ * instruction set compiled in.  The vector units only classify blocks of
+ * `GSIMD_N' source pixels and compute their shade indices; pixels with
+ * partial coverage still go through the blender cache one by one, in the
+ * same order as in `gblany.h'.  The cache therefore sees the very same
+ * sequence of lookups, and the output is identical to the scalar code.
+ */
+
+#ifndef GSIMD
+
+#  ifdef GBLENDER_HAVE_SSE2
+#    define  GSIMD  sse2
+#    include "gblsimd.h"
+#  endif
+
+#  ifdef GBLENDER_HAVE_AVX2
+#    define  GSIMD  avx2
+#    include "gblsimd.h"
+#  endif
+
+#  ifdef GBLENDER_HAVE_NEON
+#    define  GSIMD  neon
+#    include "gblsimd.h"
+#  endif
+
+#else /* GSIMD */
+
+#undef  GSCONCAT
+#undef  GSCONCATX
+#undef  GSCONCAT3
+#undef  GSCONCAT3X
+#define GSCONCAT(x,y)       GSCONCATX(x,y)
+#define GSCONCATX(x,y)      x ## y
+#define GSCONCAT3(x,y,z)    GSCONCAT3X(x,y,z)
+#define GSCONCAT3X(x,y,z)   x ## y ## _ ## z
+
+#define GSIMD_N         GSCONCAT( GSIMD_BLOCK_, GSIMD )
+#define GSIMD_ATTR      GSCONCAT( GSIMD_ATTR_, GSIMD )
+#define GSIMD_ALL       ( 0xFFFFFFFFU >> ( 32 - GSIMD_N ) )
+#define GSIMD_GRAY      GSCONCAT( gsimd_gray_, GSIMD )
+#define GSIMD_LCD       GSCONCAT( gsimd_lcd_, GSIMD )
+
+#ifdef GBLENDER_STORE_BYTES
+#define GSIMD_STORE(d,cells,a)  GDST_STOREB(d,cells,a)
+#else
+#define GSIMD_STORE(d,cells,a)  GDST_STOREP(d,cells,a)
+#endif
+
+  /* no final `;'!  `GSIMD_N' copies of the foreground color */
+#define GSIMD_PATTERN_VARS                     \
+  GBlenderPixel   _spat[GSIMD_N];              \
+  unsigned char*  _pat = (unsigned char*)_spat
+
+#define GSIMD_PATTERN_FILL                     \
+  do                                           \
+  {                                            \
+    unsigned char*  _d = _pat;                 \
+    int             _n;                        \
+                                               \
+                                               \
+    for ( _n = 0; _n < GSIMD_N; _n++ )         \
+    {                                          \
+      GDST_COPY(_d);                           \
+      _d += GDST_INCR;                         \
+    }                                          \
+  } while ( 0 )
+
+#define GSIMD_BLEND_GRAY(d,a)                  \
+  do                                           \
+  {                                            \
+    if ( (a) == GBLENDER_SHADE_COUNT-1 )       \
+    {                                          \
+      GDST_COPY(d);                            \
+    }                                          \
+    else if ( a )                              \
+    {                                          \
+      GDST_PIX( back, d );                     \
+                                               \
+      GBLENDER_LOOKUP( blender, back );        \
+                                               \
+      GSIMD_STORE(d,_gcells,a);                \
+    }                                          \
+  } while ( 0 )
+
+#define GSIMD_BLEND_LCD(d,ar,ag,ab)                               \
+  do                                                              \
+  {                                                               \
+    unsigned int  _aa = ( (ar) << 16 ) | ( (ag) << 8 ) | (ab);    \
+                                                                  \
+                                                                  \
+    if ( _aa == (GBLENDER_SHADE_COUNT-1) * 0x010101U )            \
+    {                                                             \
+      GDST_COPY(d);                                               \
+    }                                                             \
+    else if ( _aa )                                               \
+    {                                                             \
+      GDST_CHANNELS( back, d );                                   \
+                                                                  \
+      GBLENDER_LOOKUP_R( blender, back.r );                       \
+                                                                  \
+      GBLENDER_LOOKUP_G( blender, back.g );                       \
+                                                                  \
+      GBLENDER_LOOKUP_B( blender, back.b );                       \
+                                                                  \
+      GDST_STOREC( d, _grcells[ar], _ggcells[ag], _gbcells[ab] ); \
+    }                                                             \
+  } while ( 0 )
+
+
+static GSIMD_ATTR void
+GSCONCAT3( _gblender_spans_, GDST_TYPE, GSIMD )( int            y,
+                                                 int            count,
+                                                 const grSpan*  spans,
+                                                 grSurface*     surface )
+{
+  grColor         color   = surface->color;
+  GBlender        blender = surface->gblender;
+
+  GDST_PIX( fore, &color );
+
+  GBLENDER_VARS( blender, fore );
+
+  unsigned char*  dst_origin = surface->origin - y * surface->bitmap.pitch;
+  int             filled     = 0;
+
+  GSIMD_PATTERN_VARS;
+
+
+  for ( ; count--; spans++ )
+  {
+    unsigned char*  dst = dst_origin + spans->x * GDST_INCR;
+    unsigned short  w   = spans->len;
+    int             a   = GBLENDER_SHADE_INDEX( spans->coverage );
+
+    if ( a == GBLENDER_SHADE_COUNT-1 )
+    {
+      if ( w >= GSIMD_N && !filled )
+      {
+        GSIMD_PATTERN_FILL;
+        filled = 1;
+      }
+
+      for ( ; w >= GSIMD_N; w -= GSIMD_N, dst += GSIMD_N * GDST_INCR )
+        memcpy( dst, _pat, GSIMD_N * GDST_INCR );
+
+      for ( ; w-- ; dst += GDST_INCR )
+      {
+        GDST_COPY(dst);
+      }
+    }
+    else if ( a )
+      for ( ; w-- ; dst += GDST_INCR )
+      {
+        GDST_PIX( back, dst );
+
+        GBLENDER_LOOKUP( blender, back );
+
+        GSIMD_STORE(dst,_gcells,a);
+      }
+  }
+
+  GBLENDER_CLOSE(blender);
+}
+
+
+static GSIMD_ATTR void
+GSCONCAT3( _gblender_blit_gray8_, GDST_TYPE, GSIMD )( GBlenderBlit  blit,
+                                                      grColor       color )
+{
+  GBlender  blender = blit->blender;
+
+  GDST_PIX( fore, &color );
+
+  GBLENDER_VARS( blender, fore );
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line + blit->src_x;
+  unsigned char*        dst_line = blit->dst_line + blit->dst_x*GDST_INCR;
+  unsigned char         shade[GSIMD_N];
+
+  GSIMD_PATTERN_VARS;
+
+
+  GSIMD_PATTERN_FILL;
+
+  do
+  {
+    const unsigned char*  src = src_line;
+    unsigned char*        dst = dst_line;
+    int                   w   = blit->width;
+
+    for ( ; w >= GSIMD_N; w -= GSIMD_N,
+                          src += GSIMD_N,
+                          dst += GSIMD_N * GDST_INCR )
+    {
+      unsigned int  full;
+      unsigned int  mask = GSIMD_GRAY( src, shade, &full );
+
+
+      if ( mask == 0 )
+        continue;
+
+      if ( full == GSIMD_ALL )
+      {
+        memcpy( dst, _pat, GSIMD_N * GDST_INCR );
+        continue;
+      }
+
+      /* visit the covered pixels only, left to right */
+      do
+      {
+        int             i = GSIMD_CTZ( mask );
+        unsigned char*  d = dst + i * GDST_INCR;
+
+
+        GSIMD_BLEND_GRAY( d, shade[i] );
+
+        mask &= mask - 1;
+      }
+      while ( mask );
+    }
+
+    for ( ; w > 0; w--, src++, dst += GDST_INCR )
+    {
+      int  a = GBLENDER_SHADE_INDEX(src[0]);
+
+
+      GSIMD_BLEND_GRAY( dst, a );
+    }
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+
+  GBLENDER_CLOSE(blender);
+}
+
+
+  /* `r' and `b' are the offsets of the red and blue subpixels */
+static GSIMD_ATTR void
+GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GSIMD )( GBlenderBlit  blit,
+                                                    grColor       color,
+                                                    int           r,
+                                                    int           b )
+{
+  GBlender      blender = blit->blender;
+
+  GDST_CHANNELS( fore, &color );
+
+  GBLENDER_CHANNEL_VARS( blender, fore.r, fore.g, fore.b );
+
+  int                   h        = blit->height;
+  const unsigned char*  src_line = blit->src_line + blit->src_x*3;
+  unsigned char*        dst_line = blit->dst_line + blit->dst_x*GDST_INCR;
+  unsigned char         shade[GSIMD_N * 3];
+
+  GSIMD_PATTERN_VARS;
+
+
+  GSIMD_PATTERN_FILL;
+
+  do
+  {
+    const unsigned char*  src = src_line;
+    unsigned char*        dst = dst_line;
+    int                   w   = blit->width;
+
+    for ( ; w >= GSIMD_N; w -= GSIMD_N,
+                          src += GSIMD_N * 3,
+                          dst += GSIMD_N * GDST_INCR )
+    {
+      const unsigned char*  s;
+      unsigned char*        d;
+
+
+      switch ( GSIMD_LCD( src, shade ) )
+      {
+      case 0:   /* blank */
+        continue;
+
+      case 1:   /* fully covered */
+        memcpy( dst, _pat, GSIMD_N * GDST_INCR );
+        continue;
+      }
+
+      for ( s = shade, d = dst; s < shade + GSIMD_N * 3; s += 3, d += GDST_INCR )
+        GSIMD_BLEND_LCD( d, s[r], s[1], s[b] );
+    }
+
+    for ( ; w > 0; w--, src += 3, dst += GDST_INCR )
+    {
+      unsigned int  ar = GBLENDER_SHADE_INDEX(src[r]);
+      unsigned int  ag = GBLENDER_SHADE_INDEX(src[1]);
+      unsigned int  ab = GBLENDER_SHADE_INDEX(src[b]);
+
+
+      GSIMD_BLEND_LCD( dst, ar, ag, ab );
+    }
+
+    src_line += blit->src_pitch;
+    dst_line += blit->dst_pitch;
+  }
+  while (--h > 0);
+
+  GBLENDER_CHANNEL_CLOSE(blender);
+}
+
+
+static GSIMD_ATTR void
+GSCONCAT3( _gblender_blit_hrgb_, GDST_TYPE, GSIMD )( GBlenderBlit  blit,
+                                                     grColor       color )
+{
+  GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GSIMD )( blit, color, 0, 2 );
+}
+
+
+static GSIMD_ATTR void
+GSCONCAT3( _gblender_blit_hbgr_, GDST_TYPE, GSIMD )( GBlenderBlit  blit,
+                                                     grColor       color )
+{
+  GSCONCAT3( _gblender_blit_lcd_, GDST_TYPE, GSIMD )( blit, color, 2, 0 );
+}
+
+
+  /* indexed by GBLENDER_SOURCE_GRAY8 ... GBLENDER_SOURCE_HBGR */
+static const GBlenderBlitFunc
+GSCONCAT3( simd_blit_funcs_, GDST_TYPE, GSIMD )[3] =
+{
+  GSCONCAT3( _gblender_blit_gray8_, GDST_TYPE, GSIMD ),
+  GSCONCAT3( _gblender_blit_hrgb_, GDST_TYPE, GSIMD ),
+  GSCONCAT3( _gblender_blit_hbgr_, GDST_TYPE, GSIMD )
+};
+
+
+#undef GSIMD_N
+#undef GSIMD_ATTR
+#undef GSIMD_ALL
+#undef GSIMD_GRAY
+#undef GSIMD_LCD
+#undef GSIMD_STORE
+#undef GSIMD_PATTERN_VARS
+#undef GSIMD_PATTERN_FILL
+#undef GSIMD_BLEND_GRAY
+#undef GSIMD_BLEND_LCD
+#undef GSIMD
+
+#endif /* GSIMD */
@@ -0,0 +1,138 @@
+/* Row converters for all target formats, instantiated by `grconvert.c'
+ * for the portable code and for every instruction set compiled in.
+ *
+ * Included without `GCONV' defined, this file includes itself once per
+ * variant.  A vector variant converts blocks of `GCONV_N' pixels and hands
+ * the remaining ones to the portable code.
+ */
+
+#ifndef GCONV
+
+#  define  GCONV  c
+#  include "grconvany.h"
+
+#  ifdef GBLENDER_HAVE_SSE2
+#    define  GCONV  sse2
+#    include "grconvany.h"
+#  endif
+
+#  ifdef GBLENDER_HAVE_AVX2
+#    define  GCONV  avx2
+#    include "grconvany.h"
+#  endif
+
+#else /* GCONV */
+
+#undef  GSCONCAT
+#undef  GSCONCATX
+#undef  GSCONCAT3
+#undef  GSCONCAT3X
+#define GSCONCAT(x,y)       GSCONCATX(x,y)
+#define GSCONCATX(x,y)      x ## y
+#define GSCONCAT3(x,y,z)    GSCONCAT3X(x,y,z)
+#define GSCONCAT3X(x,y,z)   x ## y ## _ ## z
+
+#define GCONV_T         GSCONCAT( GCONV_T_, GCONV )
+#define GCONV_N         GSCONCAT( GCONV_N_, GCONV )
+#define GCONV_GUARD     GSCONCAT( GCONV_GUARD_, GCONV )
+#define GCONV_ATTR      GSCONCAT( GSIMD_ATTR_, GCONV )
+#define GCONV_STORE16   GSCONCAT( gconv_store16_, GCONV )
+#define GCONV_STORE32   GSCONCAT( gconv_store32_, GCONV )
+
+#define GV_AND          GSCONCAT( gconv_and_, GCONV )
+#define GV_OR           GSCONCAT( gconv_or_, GCONV )
+#define GV_SHL          GSCONCAT( gconv_shl_, GCONV )
+#define GV_SHR          GSCONCAT( gconv_shr_, GCONV )
+
+  /* the portable variant leaves no pixels, and never recurses */
+#define GCONV_ROWS( src_type, src_incr, guard, fmt, dst_incr, store )      \
+  static GCONV_ATTR void                                                   \
+  GSCONCAT3( gconv_ ## src_type ## _, fmt, GCONV )(                        \
+    const unsigned char*  src,                                             \
+    unsigned char*        dst,                                             \
+    int                   width )                                          \
+  {                                                                        \
+    for ( ; width >= GCONV_N + (guard); width -= GCONV_N,                  \
+                                       src   += GCONV_N * (src_incr),      \
+                                       dst   += GCONV_N * (dst_incr) )     \
+    {                                                                      \
+      GCONV_T  v = GSCONCAT( gconv_ ## src_type ## _, GCONV )( src );      \
+                                                                           \
+                                                                           \
+      store( dst, GCONV_OP_ ## fmt( v ) );                                 \
+    }                                                                      \
+                                                                           \
+    if ( width > 0 )                                                       \
+      gconv_ ## src_type ## _ ## fmt ## _c( src, dst, width );             \
+  }
+
+#define GCONV_RGB24_ROWS( fmt, dst_incr, store )                           \
+          GCONV_ROWS( rgb24, 3, GCONV_GUARD, fmt, dst_incr, store )
+
+  /* for gray, the BGR formats are the same as the RGB ones */
+#define GCONV_GRAY_ROWS( fmt, dst_incr, store )                            \
+          GCONV_ROWS( gray, 1, 0, fmt, dst_incr, store )
+
+
+GCONV_RGB24_ROWS( rgb565,  2, GCONV_STORE16 )
+GCONV_RGB24_ROWS( bgr565,  2, GCONV_STORE16 )
+GCONV_RGB24_ROWS( rgb555,  2, GCONV_STORE16 )
+GCONV_RGB24_ROWS( bgr555,  2, GCONV_STORE16 )
+GCONV_RGB24_ROWS( rgb8880, 4, GCONV_STORE32 )
+GCONV_RGB24_ROWS( rgb0888, 4, GCONV_STORE32 )
+GCONV_RGB24_ROWS( bgr8880, 4, GCONV_STORE32 )
+GCONV_RGB24_ROWS( bgr0888, 4, GCONV_STORE32 )
+
+GCONV_GRAY_ROWS( rgb565,  2, GCONV_STORE16 )
+GCONV_GRAY_ROWS( rgb555,  2, GCONV_STORE16 )
+GCONV_GRAY_ROWS( rgb8880, 4, GCONV_STORE32 )
+GCONV_GRAY_ROWS( rgb0888, 4, GCONV_STORE32 )
+
+
+  /* indexed by source (RGB24, gray) and grConvertFormat */
+static const grConvertFunc
+GSCONCAT( gconv_funcs_, GCONV )[2][gr_convert_max] =
+{
+  {
+    GSCONCAT( gconv_rgb24_rgb565_, GCONV ),
+    GSCONCAT( gconv_rgb24_bgr565_, GCONV ),
+    GSCONCAT( gconv_rgb24_rgb555_, GCONV ),
+    GSCONCAT( gconv_rgb24_bgr555_, GCONV ),
+    GSCONCAT( gconv_rgb24_rgb888_, GCONV ),
+    GSCONCAT( gconv_rgb24_bgr888_, GCONV ),
+    GSCONCAT( gconv_rgb24_rgb8880_, GCONV ),
+    GSCONCAT( gconv_rgb24_rgb0888_, GCONV ),
+    GSCONCAT( gconv_rgb24_bgr8880_, GCONV ),
+    GSCONCAT( gconv_rgb24_bgr0888_, GCONV )
+  },
+  {
+    GSCONCAT( gconv_gray_rgb565_, GCONV ),
+    GSCONCAT( gconv_gray_rgb565_, GCONV ),
+    GSCONCAT( gconv_gray_rgb555_, GCONV ),
+    GSCONCAT( gconv_gray_rgb555_, GCONV ),
+    GSCONCAT( gconv_gray_rgb888_, GCONV ),
+    GSCONCAT( gconv_gray_rgb888_, GCONV ),
+    GSCONCAT( gconv_gray_rgb8880_, GCONV ),
+    GSCONCAT( gconv_gray_rgb0888_, GCONV ),
+    GSCONCAT( gconv_gray_rgb8880_, GCONV ),
+    GSCONCAT( gconv_gray_rgb0888_, GCONV )
+  }
+};
+
+
+#undef GCONV_T
+#undef GCONV_N
+#undef GCONV_GUARD
+#undef GCONV_ATTR
+#undef GCONV_STORE16
+#undef GCONV_STORE32
+#undef GV_AND
+#undef GV_OR
+#undef GV_SHL
+#undef GV_SHR
+#undef GCONV_ROWS
+#undef GCONV_RGB24_ROWS
+#undef GCONV_GRAY_ROWS
+#undef GCONV
+
+#endif /* GCONV */
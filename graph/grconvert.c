@@ -0,0 +1,371 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 1999-2023 by                                              */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*  grconvert.c: Pixel format conversion for display devices.               */
+/*                                                                          */
+/****************************************************************************/
+
+/* Devices whose visual does not match the surface bitmap convert every
+ * updated row into the display format.  A row of RGB24 or 8-bit gray
+ * pixels is first widened to one 32-bit value `R | G << 8 | B << 16' per
+ * pixel (gray being R = G = B); the target format is then packed from
+ * that value with shifts and masks only, so that the portable and the
+ * vectorized code share the very same expressions (see `grconvany.h') and
+ * produce identical output.
+ */
+
+#include "grconvert.h"
+#include "gblblit.h"
+#include "grsimd.h"
+#include <string.h>
+
+
+/* packing of a widened pixel `v' into the target formats; `GV_AND', */
+/* `GV_OR', `GV_SHL', and `GV_SHR' are provided by `grconvany.h'     */
+#define GCONV_OP_rgb565( v )                                   \
+          GV_OR( GV_OR( GV_AND( GV_SHL( v,  8 ), 0xF800 ),     \
+                        GV_AND( GV_SHR( v,  5 ), 0x07E0 ) ),   \
+                 GV_AND( GV_SHR( v, 19 ), 0x001F ) )
+
+#define GCONV_OP_bgr565( v )                                   \
+          GV_OR( GV_OR( GV_AND( GV_SHR( v,  8 ), 0xF800 ),     \
+                        GV_AND( GV_SHR( v,  5 ), 0x07E0 ) ),   \
+                 GV_AND( GV_SHR( v,  3 ), 0x001F ) )
+
+#define GCONV_OP_rgb555( v )                                   \
+          GV_OR( GV_OR( GV_AND( GV_SHL( v,  7 ), 0x7C00 ),     \
+                        GV_AND( GV_SHR( v,  6 ), 0x03E0 ) ),   \
+                 GV_AND( GV_SHR( v, 19 ), 0x001F ) )
+
+#define GCONV_OP_bgr555( v )                                   \
+          GV_OR( GV_OR( GV_AND( GV_SHR( v,  9 ), 0x7C00 ),     \
+                        GV_AND( GV_SHR( v,  6 ), 0x03E0 ) ),   \
+                 GV_AND( GV_SHR( v,  3 ), 0x001F ) )
+
+#define GCONV_OP_rgb0888( v )                                  \
+          GV_OR( GV_OR( GV_SHL( GV_AND( v, 0x0000FF ), 16 ),   \
+                        GV_AND( v, 0x00FF00 ) ),               \
+                 GV_SHR( v, 16 ) )
+
+#define GCONV_OP_rgb8880( v )  GV_SHL( GCONV_OP_rgb0888( v ), 8 )
+#define GCONV_OP_bgr0888( v )  ( v )
+#define GCONV_OP_bgr8880( v )  GV_SHL( v, 8 )
+
+
+/* Each instruction set `xxx' provides
+ *
+ *   GCONV_T_xxx          the type of a vector of widened pixels
+ *   GCONV_N_xxx          the number of pixels in it
+ *   GCONV_GUARD_xxx      the number of RGB24 pixels that must follow a
+ *                        block, because the loads read past its end
+ *   gconv_and_xxx, ...   the lane-wise operations
+ *   gconv_rgb24_xxx      widen RGB24 pixels, the top byte being zero
+ *   gconv_gray_xxx       widen gray pixels
+ *   gconv_store16_xxx    store the low 16 bits of all lanes
+ *   gconv_store32_xxx    store all lanes
+ *
+ * and the 24-bit targets, which are byte copies and not packed.
+ */
+
+#define GCONV_T_c        unsigned int
+#define GCONV_N_c        1
+#define GCONV_GUARD_c    0
+#define GSIMD_ATTR_c     /* */
+
+#define gconv_and_c( a, m )     ( (a) & (m) )
+#define gconv_or_c( a, b )      ( (a) | (b) )
+#define gconv_shl_c( a, n )     ( (a) << (n) )
+#define gconv_shr_c( a, n )     ( (a) >> (n) )
+
+#define gconv_rgb24_c( s )      ( (unsigned int)(s)[0]         | \
+                                  (unsigned int)(s)[1] <<  8   | \
+                                  (unsigned int)(s)[2] << 16   )
+#define gconv_gray_c( s )       ( (s)[0] * 0x010101U )
+
+#define gconv_store16_c( d, v )  ( *(unsigned short*)(d) = (unsigned short)(v) )
+#define gconv_store32_c( d, v )  ( *(unsigned int*)(d) = (v) )
+
+
+static void
+gconv_rgb24_rgb888_c( const unsigned char*  src,
+                      unsigned char*        dst,
+                      int                   width )
+{
+  memcpy( dst, src, (size_t)width * 3 );
+}
+
+
+static void
+gconv_rgb24_bgr888_c( const unsigned char*  src,
+                      unsigned char*        dst,
+                      int                   width )
+{
+  for ( ; width > 0; width--, src += 3, dst += 3 )
+  {
+    dst[0] = src[2];
+    dst[1] = src[1];
+    dst[2] = src[0];
+  }
+}
+
+
+static void
+gconv_gray_rgb888_c( const unsigned char*  src,
+                     unsigned char*        dst,
+                     int                   width )
+{
+  for ( ; width > 0; width--, src++, dst += 3 )
+  {
+    unsigned char  p = src[0];
+
+
+    dst[0] = p;
+    dst[1] = p;
+    dst[2] = p;
+  }
+}
+
+
+#ifdef GBLENDER_HAVE_SSE2
+
+#define GCONV_T_sse2      __m128i
+#define GCONV_N_sse2      4
+#define GCONV_GUARD_sse2  1
+
+#define gconv_and_sse2( a, m )  _mm_and_si128( a, _mm_set1_epi32( m ) )
+#define gconv_or_sse2( a, b )   _mm_or_si128( a, b )
+#define gconv_shl_sse2( a, n )  _mm_slli_epi32( a, n )
+#define gconv_shr_sse2( a, n )  _mm_srli_epi32( a, n )
+
+  /* SSE2 has no byte shuffle; each pixel is loaded as a 32-bit word */
+  /* and the fourth byte, belonging to the next pixel, is masked out  */
+static GSIMD_ATTR_sse2 __m128i
+gconv_rgb24_sse2( const unsigned char*  s )
+{
+  int  p0, p1, p2, p3;
+
+
+  memcpy( &p0, s,     4 );
+  memcpy( &p1, s + 3, 4 );
+  memcpy( &p2, s + 6, 4 );
+  memcpy( &p3, s + 9, 4 );
+
+  return _mm_and_si128( _mm_setr_epi32( p0, p1, p2, p3 ),
+                        _mm_set1_epi32( 0xFFFFFF ) );
+}
+
+
+static GSIMD_ATTR_sse2 __m128i
+gconv_gray_sse2( const unsigned char*  s )
+{
+  const __m128i  zero = _mm_setzero_si128();
+
+  __m128i  v;
+  int      p;
+
+
+  memcpy( &p, s, 4 );
+
+  v = _mm_unpacklo_epi8( _mm_cvtsi32_si128( p ), zero );
+  v = _mm_unpacklo_epi16( v, zero );
+
+  return _mm_or_si128( _mm_or_si128( v, _mm_slli_epi32( v, 8 ) ),
+                       _mm_slli_epi32( v, 16 ) );
+}
+
+
+static GSIMD_ATTR_sse2 void
+gconv_store16_sse2( unsigned char*  d,
+                    __m128i         v )
+{
+  /* sign-extend the low halves so that the saturating pack keeps them */
+  v = _mm_srai_epi32( _mm_slli_epi32( v, 16 ), 16 );
+
+  _mm_storel_epi64( (__m128i*)d, _mm_packs_epi32( v, v ) );
+}
+
+
+static GSIMD_ATTR_sse2 void
+gconv_store32_sse2( unsigned char*  d,
+                    __m128i         v )
+{
+  _mm_storeu_si128( (__m128i*)d, v );
+}
+
+
+#define gconv_rgb24_rgb888_sse2  gconv_rgb24_rgb888_c
+#define gconv_rgb24_bgr888_sse2  gconv_rgb24_bgr888_c
+#define gconv_gray_rgb888_sse2   gconv_gray_rgb888_c
+
+#endif /* GBLENDER_HAVE_SSE2 */
+
+
+#ifdef GBLENDER_HAVE_AVX2
+
+#define GCONV_T_avx2      __m256i
+#define GCONV_N_avx2      8
+#define GCONV_GUARD_avx2  2
+
+#define gconv_and_avx2( a, m )  _mm256_and_si256( a, _mm256_set1_epi32( m ) )
+#define gconv_or_avx2( a, b )   _mm256_or_si256( a, b )
+#define gconv_shl_avx2( a, n )  _mm256_slli_epi32( a, n )
+#define gconv_shr_avx2( a, n )  _mm256_srli_epi32( a, n )
+
+  /* pixels 0-3 and 4-7 are loaded into the two halves, 28 bytes in all */
+static GSIMD_ATTR_avx2 __m256i
+gconv_rgb24_avx2( const unsigned char*  s )
+{
+  const __m256i  shuffle = _mm256_setr_epi8( 0, 1,  2, -1, 3,  4,  5, -1,
+                                             6, 7,  8, -1, 9, 10, 11, -1,
+                                             0, 1,  2, -1, 3,  4,  5, -1,
+                                             6, 7,  8, -1, 9, 10, 11, -1 );
+
+  __m256i  v = _mm256_inserti128_si256(
+                 _mm256_castsi128_si256(
+                   _mm_loadu_si128( (const __m128i*)s ) ),
+                 _mm_loadu_si128( (const __m128i*)( s + 12 ) ), 1 );
+
+
+  return _mm256_shuffle_epi8( v, shuffle );
+}
+
+
+static GSIMD_ATTR_avx2 __m256i
+gconv_gray_avx2( const unsigned char*  s )
+{
+  __m256i  v = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)s ) );
+
+
+  return _mm256_or_si256( _mm256_or_si256( v, _mm256_slli_epi32( v, 8 ) ),
+                          _mm256_slli_epi32( v, 16 ) );
+}
+
+
+static GSIMD_ATTR_avx2 void
+gconv_store16_avx2( unsigned char*  d,
+                    __m256i         v )
+{
+  /* the pack works per half; gather the two results */
+  v = _mm256_permute4x64_epi64( _mm256_packus_epi32( v, v ), 0x08 );
+
+  _mm_storeu_si128( (__m128i*)d, _mm256_castsi256_si128( v ) );
+}
+
+
+static GSIMD_ATTR_avx2 void
+gconv_store32_avx2( unsigned char*  d,
+                    __m256i         v )
+{
+  _mm256_storeu_si256( (__m256i*)d, v );
+}
+
+
+#define gconv_rgb24_rgb888_avx2  gconv_rgb24_rgb888_c
+
+
+  /* five pixels per shuffle; the sixteenth byte stored is garbage */
+  /* that the next block or the portable tail overwrites           */
+static GSIMD_ATTR_avx2 void
+gconv_rgb24_bgr888_avx2( const unsigned char*  src,
+                         unsigned char*        dst,
+                         int                   width )
+{
+  const __m128i  shuffle = _mm_setr_epi8( 2,  1,  0,  5,  4,  3,  8,  7,
+                                          6, 11, 10,  9, 14, 13, 12, 15 );
+
+
+  for ( ; width >= 6; width -= 5, src += 15, dst += 15 )
+    _mm_storeu_si128( (__m128i*)dst,
+                      _mm_shuffle_epi8(
+                        _mm_loadu_si128( (const __m128i*)src ), shuffle ) );
+
+  gconv_rgb24_bgr888_c( src, dst, width );
+}
+
+
+static GSIMD_ATTR_avx2 void
+gconv_gray_rgb888_avx2( const unsigned char*  src,
+                        unsigned char*        dst,
+                        int                   width )
+{
+  const __m128i  shuffle = _mm_setr_epi8( 0, 0, 0, 1, 1, 1, 2, 2,
+                                          2, 3, 3, 3, 4, 4, 4, 5 );
+
+
+  for ( ; width >= 8; width -= 5, src += 5, dst += 15 )
+    _mm_storeu_si128( (__m128i*)dst,
+                      _mm_shuffle_epi8(
+                        _mm_loadl_epi64( (const __m128i*)src ), shuffle ) );
+
+  gconv_gray_rgb888_c( src, dst, width );
+}
+
+#endif /* GBLENDER_HAVE_AVX2 */
+
+
+#include "grconvany.h"
+
+
+extern grConvertFunc
+gr_convert_get_func( grPixelMode      source,
+                     grConvertFormat  target )
+{
+  int  gray;
+
+
+  if ( source == gr_pixel_mode_rgb24 )
+    gray = 0;
+  else if ( source == gr_pixel_mode_gray )
+    gray = 1;
+  else
+    return NULL;
+
+  if ( target < 0 || target >= gr_convert_max )
+    return NULL;
+
+  switch ( gblender_simd_level() )
+  {
+#ifdef GBLENDER_HAVE_SSE2
+  case GBLENDER_SIMD_SSE2:
+    return gconv_funcs_sse2[gray][target];
+#endif
+#ifdef GBLENDER_HAVE_AVX2
+  case GBLENDER_SIMD_AVX2:
+    return gconv_funcs_avx2[gray][target];
+#endif
+  default:
+    return gconv_funcs_c[gray][target];
+  }
+}
+
+
+extern const char*
+gr_convert_format_name( grConvertFormat  format )
+{
+  static const char*  names[gr_convert_max] =
+  {
+    "rgb565",
+    "bgr565",
+    "rgb555",
+    "bgr555",
+    "rgb888",
+    "bgr888",
+    "rgb8880",
+    "rgb0888",
+    "bgr8880",
+    "bgr0888"
+  };
+
+
+  if ( format < 0 || format >= gr_convert_max )
+    return NULL;
+
+  return names[format];
+}
+
+
+/* END */
@@ -0,0 +1,50 @@
+#ifndef GRCONVERT_H_
+#define GRCONVERT_H_
+
+#include "graph.h"
+
+/*
+ * pixel format conversion of RGB24 and 8-bit gray rows into the pixel
+ * layouts of display devices
+ *
+ */
+
+  /* the names give the channels from the most to the least significant */
+  /* bits of a pixel, as in the X11 visual masks; `0' is an unused byte  */
+typedef enum  grConvertFormat_
+{
+  gr_convert_rgb565 = 0,
+  gr_convert_bgr565,
+  gr_convert_rgb555,
+  gr_convert_bgr555,
+  gr_convert_rgb888,
+  gr_convert_bgr888,
+  gr_convert_rgb8880,
+  gr_convert_rgb0888,
+  gr_convert_bgr8880,
+  gr_convert_bgr0888,
+
+  gr_convert_max
+
+} grConvertFormat;
+
+
+  /* convert `width' pixels of a row from `src' to `dst' */
+typedef void
+(*grConvertFunc)( const unsigned char*  src,
+                  unsigned char*        dst,
+                  int                   width );
+
+
+  /* return the converter of `source' rows (`gr_pixel_mode_rgb24' or   */
+  /* `gr_pixel_mode_gray') into `target' pixels, or NULL; the SIMD     */
+  /* variant follows `gblender_simd_select' at the time of the call    */
+  extern grConvertFunc
+  gr_convert_get_func( grPixelMode      source,
+                       grConvertFormat  target );
+
+  /* return the name of a format, or NULL if out of range */
+  extern const char*
+  gr_convert_format_name( grConvertFormat  format );
+
+#endif /* GRCONVERT_H_ */
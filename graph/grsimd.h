@@ -0,0 +1,52 @@
+#ifndef GRSIMD_H_
+#define GRSIMD_H_
+
+/* Instruction sets for the SIMD fast paths of the graph library (see
+ * `gblsimd.h', `grconvany.h', and `grswizzle.c')
+ *
+ * The x86 kernels are compiled with function-level target attributes, so
+ * no special compiler flags are needed; the best one available is picked
+ * at run time with `gblender_simd_select'.  NEON is part of the AArch64
+ * base architecture.
+ */
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#  define  GBLENDER_HAVE_SSE2
+#  define  GBLENDER_HAVE_AVX2
+#  define  GSIMD_ATTR_sse2  __attribute__(( target( "sse2" ) ))
+#  define  GSIMD_ATTR_avx2  __attribute__(( target( "avx2" ) ))
+#  define  GSIMD_CTZ(x)     __builtin_ctz( x )
+#  include <immintrin.h>
+#elif defined( _MSC_VER ) && ( defined( _M_X64 )                          || \
+                               ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+#  define  GBLENDER_HAVE_SSE2
+#  define  GBLENDER_HAVE_AVX2
+#  define  GSIMD_ATTR_sse2  /* */
+#  define  GSIMD_ATTR_avx2  /* */
+#  define  GSIMD_CTZ(x)     gsimd_ctz( x )
+#  include <intrin.h>
+#  include <immintrin.h>
+#elif defined( __aarch64__ ) || defined( _M_ARM64 )
+#  define  GBLENDER_HAVE_NEON
+#  define  GSIMD_ATTR_neon  /* */
+#  ifdef _MSC_VER
+#    define  GSIMD_CTZ(x)   gsimd_ctz( x )
+#    include <intrin.h>
+#  else
+#    define  GSIMD_CTZ(x)   __builtin_ctz( x )
+#  endif
+#  include <arm_neon.h>
+#endif
+
+#ifdef _MSC_VER
+static __inline int
+gsimd_ctz( unsigned int  x )
+{
+  unsigned long  i;
+
+
+  _BitScanForward( &i, x );
+  return (int)i;
+}
+#endif
+
+#endif /* GRSIMD_H_ */
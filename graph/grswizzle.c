@@ -8,6 +8,8 @@
 #include <memory.h>
 
 #include "grswizzle.h"
+#include "gblblit.h"
+#include "grsimd.h"
 
 /* technical note:
  *
@@ -532,6 +534,434 @@ postprocess_line_xrgb32( unsigned char** lines,
 
 
 
+/************************************************************************/
+/************************************************************************/
+/*****                                                              *****/
+/*****               S I M D   F I L T E R I N G                    *****/
+/*****                                                              *****/
+/************************************************************************/
+/************************************************************************/
+
+/* with 8-bit channels, both filters of the RGB24 and XRGB32 formats
+ * treat every byte alike, save for the choice of the channels in each
+ * pixel, which only depends on the phase '(offset+x) % 3' of its column.
+ * the vectorized code below thus works on whole rows of bytes, and takes
+ * that choice from byte masks repeating every three pixels.  the result
+ * is identical to the code above.
+ */
+#if defined( ANTIALIAS ) && defined( GBLENDER_HAVE_SSE2 )
+#define  SWIZZLE_SIMD
+#endif
+
+#ifdef SWIZZLE_SIMD
+
+/* masks for three pixels of up to four bytes plus one AVX2 vector */
+#define  PATTERN_MAX  ( 3 * 4 + 32 )
+
+/* the index of the selected byte of a pixel, for each phase */
+typedef const signed char  chan_t[3];
+
+static chan_t  rgb24_center  = { 0, 1, 2 };
+static chan_t  rgb24_left    = { 2, 0, 1 };
+static chan_t  rgb24_right   = { 1, 2, 0 };
+
+static chan_t  xrgb32_left   = { 2, 1, 0 };
+static chan_t  xrgb32_center = { 1, 0, 2 };
+static chan_t  xrgb32_right  = { 0, 2, 1 };
+
+
+static void
+make_pattern( unsigned char*  pattern,
+              int             pix_bytes,
+              int             offset,
+              chan_t          chan )
+{
+  int  nn;
+
+  for (nn = 0; nn < PATTERN_MAX; nn++)
+    pattern[nn] = (unsigned char)
+      ( nn % pix_bytes == chan[(offset + nn / pix_bytes) % 3] ? 0xFF : 0 );
+}
+
+
+/* the vector loops return the number of bytes done; the remaining ones
+ * are filtered by these functions
+ */
+static void
+swizzle_bytes_tail( unsigned char**       lines,
+                    unsigned char*        write,
+                    int                   nn,
+                    int                   count,
+                    int                   pix_bytes,
+                    const unsigned char*  keep )
+{
+  const unsigned char*  above   = lines[0] + pix_bytes;
+  const unsigned char*  current = lines[1] + pix_bytes;
+  const unsigned char*  below   = lines[2] + pix_bytes;
+  int                   period  = 3 * pix_bytes;
+  int                   phase   = nn % period;
+
+  for ( ; nn < count; nn++)
+  {
+    unsigned int  sum;
+
+    sum  = (unsigned int)current[nn] << 2;
+    sum += current[nn - pix_bytes] +
+           current[nn + pix_bytes] +
+           above  [nn]             +
+           below  [nn]             ;
+
+    write[nn] = (unsigned char)( ( sum >> 3 ) & keep[phase] );
+
+    if (++phase == period)
+      phase = 0;
+  }
+}
+
+
+static void
+postprocess_bytes_tail( unsigned char**       lines,
+                        unsigned char*        write,
+                        int                   nn,
+                        int                   count,
+                        int                   pix_bytes,
+                        const unsigned char*  center,
+                        const unsigned char*  left,
+                        const unsigned char*  right )
+{
+  const unsigned char*  above   = lines[0] + pix_bytes;
+  const unsigned char*  current = lines[1] + pix_bytes;
+  const unsigned char*  below   = lines[2] + pix_bytes;
+  int                   period  = 3 * pix_bytes;
+  int                   phase   = nn % period;
+
+  for ( ; nn < count; nn++)
+  {
+    unsigned int  l = ( current[nn - pix_bytes] + above[nn] ) >> 1;
+    unsigned int  r = ( current[nn + pix_bytes] + below[nn] ) >> 1;
+
+    write[nn] = (unsigned char)( ( current[nn] & center[phase] ) |
+                                 ( l           & left[phase]   ) |
+                                 ( r           & right[phase]  ) );
+
+    if (++phase == period)
+      phase = 0;
+  }
+}
+
+
+static GSIMD_ATTR_sse2 int
+swizzle_bytes_sse2( unsigned char**       lines,
+                    unsigned char*        write,
+                    int                   count,
+                    int                   pix_bytes,
+                    const unsigned char*  keep )
+{
+  const unsigned char*  above   = lines[0] + pix_bytes;
+  const unsigned char*  current = lines[1] + pix_bytes;
+  const unsigned char*  below   = lines[2] + pix_bytes;
+  const __m128i         zero    = _mm_setzero_si128();
+  int                   period  = 3 * pix_bytes;
+  int                   phase   = 0;
+  int                   nn;
+
+  for (nn = 0; nn + 16 <= count; nn += 16)
+  {
+    __m128i  c = _mm_loadu_si128( (const __m128i*)( current + nn ) );
+    __m128i  l = _mm_loadu_si128( (const __m128i*)( current + nn - pix_bytes ) );
+    __m128i  r = _mm_loadu_si128( (const __m128i*)( current + nn + pix_bytes ) );
+    __m128i  a = _mm_loadu_si128( (const __m128i*)( above + nn ) );
+    __m128i  b = _mm_loadu_si128( (const __m128i*)( below + nn ) );
+    __m128i  lo, hi;
+
+    lo = _mm_add_epi16( _mm_add_epi16( _mm_unpacklo_epi8( l, zero ),
+                                       _mm_unpacklo_epi8( r, zero ) ),
+                        _mm_add_epi16( _mm_unpacklo_epi8( a, zero ),
+                                       _mm_unpacklo_epi8( b, zero ) ) );
+    hi = _mm_add_epi16( _mm_add_epi16( _mm_unpackhi_epi8( l, zero ),
+                                       _mm_unpackhi_epi8( r, zero ) ),
+                        _mm_add_epi16( _mm_unpackhi_epi8( a, zero ),
+                                       _mm_unpackhi_epi8( b, zero ) ) );
+
+    lo = _mm_add_epi16( lo, _mm_slli_epi16( _mm_unpacklo_epi8( c, zero ), 2 ) );
+    hi = _mm_add_epi16( hi, _mm_slli_epi16( _mm_unpackhi_epi8( c, zero ), 2 ) );
+
+    c = _mm_packus_epi16( _mm_srli_epi16( lo, 3 ), _mm_srli_epi16( hi, 3 ) );
+    c = _mm_and_si128( c, _mm_loadu_si128( (const __m128i*)( keep + phase ) ) );
+
+    _mm_storeu_si128( (__m128i*)( write + nn ), c );
+
+    phase = ( phase + 16 ) % period;
+  }
+
+  return nn;
+}
+
+
+/* `_mm_avg_epu8' rounds up, the filter rounds down */
+static GSIMD_ATTR_sse2 __m128i
+avg_down_sse2( __m128i  x,
+               __m128i  y )
+{
+  return _mm_sub_epi8( _mm_avg_epu8( x, y ),
+                       _mm_and_si128( _mm_xor_si128( x, y ),
+                                      _mm_set1_epi8( 1 ) ) );
+}
+
+
+static GSIMD_ATTR_sse2 int
+postprocess_bytes_sse2( unsigned char**       lines,
+                        unsigned char*        write,
+                        int                   count,
+                        int                   pix_bytes,
+                        const unsigned char*  center,
+                        const unsigned char*  left,
+                        const unsigned char*  right )
+{
+  const unsigned char*  above   = lines[0] + pix_bytes;
+  const unsigned char*  current = lines[1] + pix_bytes;
+  const unsigned char*  below   = lines[2] + pix_bytes;
+  int                   period  = 3 * pix_bytes;
+  int                   phase   = 0;
+  int                   nn;
+
+  for (nn = 0; nn + 16 <= count; nn += 16)
+  {
+    __m128i  c = _mm_loadu_si128( (const __m128i*)( current + nn ) );
+    __m128i  l = _mm_loadu_si128( (const __m128i*)( current + nn - pix_bytes ) );
+    __m128i  r = _mm_loadu_si128( (const __m128i*)( current + nn + pix_bytes ) );
+    __m128i  a = _mm_loadu_si128( (const __m128i*)( above + nn ) );
+    __m128i  b = _mm_loadu_si128( (const __m128i*)( below + nn ) );
+
+    c = _mm_and_si128( c, _mm_loadu_si128( (const __m128i*)( center + phase ) ) );
+    l = _mm_and_si128( avg_down_sse2( l, a ),
+                       _mm_loadu_si128( (const __m128i*)( left + phase ) ) );
+    r = _mm_and_si128( avg_down_sse2( r, b ),
+                       _mm_loadu_si128( (const __m128i*)( right + phase ) ) );
+
+    _mm_storeu_si128( (__m128i*)( write + nn ),
+                      _mm_or_si128( c, _mm_or_si128( l, r ) ) );
+
+    phase = ( phase + 16 ) % period;
+  }
+
+  return nn;
+}
+
+
+#ifdef GBLENDER_HAVE_AVX2
+
+/* unpacking and packing both work per 128-bit half, so that the bytes */
+/* stay in order                                                        */
+static GSIMD_ATTR_avx2 int
+swizzle_bytes_avx2( unsigned char**       lines,
+                    unsigned char*        write,
+                    int                   count,
+                    int                   pix_bytes,
+                    const unsigned char*  keep )
+{
+  const unsigned char*  above   = lines[0] + pix_bytes;
+  const unsigned char*  current = lines[1] + pix_bytes;
+  const unsigned char*  below   = lines[2] + pix_bytes;
+  const __m256i         zero    = _mm256_setzero_si256();
+  int                   period  = 3 * pix_bytes;
+  int                   phase   = 0;
+  int                   nn;
+
+  for (nn = 0; nn + 32 <= count; nn += 32)
+  {
+    __m256i  c = _mm256_loadu_si256( (const __m256i*)( current + nn ) );
+    __m256i  l = _mm256_loadu_si256( (const __m256i*)( current + nn - pix_bytes ) );
+    __m256i  r = _mm256_loadu_si256( (const __m256i*)( current + nn + pix_bytes ) );
+    __m256i  a = _mm256_loadu_si256( (const __m256i*)( above + nn ) );
+    __m256i  b = _mm256_loadu_si256( (const __m256i*)( below + nn ) );
+    __m256i  lo, hi;
+
+    lo = _mm256_add_epi16( _mm256_add_epi16( _mm256_unpacklo_epi8( l, zero ),
+                                             _mm256_unpacklo_epi8( r, zero ) ),
+                           _mm256_add_epi16( _mm256_unpacklo_epi8( a, zero ),
+                                             _mm256_unpacklo_epi8( b, zero ) ) );
+    hi = _mm256_add_epi16( _mm256_add_epi16( _mm256_unpackhi_epi8( l, zero ),
+                                             _mm256_unpackhi_epi8( r, zero ) ),
+                           _mm256_add_epi16( _mm256_unpackhi_epi8( a, zero ),
+                                             _mm256_unpackhi_epi8( b, zero ) ) );
+
+    lo = _mm256_add_epi16( lo, _mm256_slli_epi16(
+                                 _mm256_unpacklo_epi8( c, zero ), 2 ) );
+    hi = _mm256_add_epi16( hi, _mm256_slli_epi16(
+                                 _mm256_unpackhi_epi8( c, zero ), 2 ) );
+
+    c = _mm256_packus_epi16( _mm256_srli_epi16( lo, 3 ),
+                             _mm256_srli_epi16( hi, 3 ) );
+    c = _mm256_and_si256( c, _mm256_loadu_si256(
+                               (const __m256i*)( keep + phase ) ) );
+
+    _mm256_storeu_si256( (__m256i*)( write + nn ), c );
+
+    phase = ( phase + 32 ) % period;
+  }
+
+  return nn;
+}
+
+
+static GSIMD_ATTR_avx2 __m256i
+avg_down_avx2( __m256i  x,
+               __m256i  y )
+{
+  return _mm256_sub_epi8( _mm256_avg_epu8( x, y ),
+                          _mm256_and_si256( _mm256_xor_si256( x, y ),
+                                            _mm256_set1_epi8( 1 ) ) );
+}
+
+
+static GSIMD_ATTR_avx2 int
+postprocess_bytes_avx2( unsigned char**       lines,
+                        unsigned char*        write,
+                        int                   count,
+                        int                   pix_bytes,
+                        const unsigned char*  center,
+                        const unsigned char*  left,
+                        const unsigned char*  right )
+{
+  const unsigned char*  above   = lines[0] + pix_bytes;
+  const unsigned char*  current = lines[1] + pix_bytes;
+  const unsigned char*  below   = lines[2] + pix_bytes;
+  int                   period  = 3 * pix_bytes;
+  int                   phase   = 0;
+  int                   nn;
+
+  for (nn = 0; nn + 32 <= count; nn += 32)
+  {
+    __m256i  c = _mm256_loadu_si256( (const __m256i*)( current + nn ) );
+    __m256i  l = _mm256_loadu_si256( (const __m256i*)( current + nn - pix_bytes ) );
+    __m256i  r = _mm256_loadu_si256( (const __m256i*)( current + nn + pix_bytes ) );
+    __m256i  a = _mm256_loadu_si256( (const __m256i*)( above + nn ) );
+    __m256i  b = _mm256_loadu_si256( (const __m256i*)( below + nn ) );
+
+    c = _mm256_and_si256( c, _mm256_loadu_si256(
+                               (const __m256i*)( center + phase ) ) );
+    l = _mm256_and_si256( avg_down_avx2( l, a ), _mm256_loadu_si256(
+                                               (const __m256i*)( left + phase ) ) );
+    r = _mm256_and_si256( avg_down_avx2( r, b ), _mm256_loadu_si256(
+                                               (const __m256i*)( right + phase ) ) );
+
+    _mm256_storeu_si256( (__m256i*)( write + nn ),
+                         _mm256_or_si256( c, _mm256_or_si256( l, r ) ) );
+
+    phase = ( phase + 32 ) % period;
+  }
+
+  return nn;
+}
+
+#endif /* GBLENDER_HAVE_AVX2 */
+
+
+static void
+swizzle_line_simd( unsigned char**  lines,
+                   unsigned char*   write,
+                   int              width,
+                   int              offset,
+                   int              pix_bytes,
+                   chan_t           chan )
+{
+  unsigned char  keep[PATTERN_MAX];
+  int            count = width * pix_bytes;
+  int            nn;
+
+  make_pattern( keep, pix_bytes, offset, chan );
+
+#ifdef GBLENDER_HAVE_AVX2
+  if ( gblender_simd_level() == GBLENDER_SIMD_AVX2 )
+    nn = swizzle_bytes_avx2( lines, write, count, pix_bytes, keep );
+  else
+#endif
+    nn = swizzle_bytes_sse2( lines, write, count, pix_bytes, keep );
+
+  swizzle_bytes_tail( lines, write, nn, count, pix_bytes, keep );
+}
+
+
+static void
+postprocess_line_simd( unsigned char**  lines,
+                       unsigned char*   write,
+                       int              width,
+                       int              offset,
+                       int              pix_bytes,
+                       chan_t           center_chan,
+                       chan_t           left_chan,
+                       chan_t           right_chan )
+{
+  unsigned char  center[PATTERN_MAX];
+  unsigned char  left[PATTERN_MAX];
+  unsigned char  right[PATTERN_MAX];
+  int            count = width * pix_bytes;
+  int            nn;
+
+  make_pattern( center, pix_bytes, offset, center_chan );
+  make_pattern( left,   pix_bytes, offset, left_chan );
+  make_pattern( right,  pix_bytes, offset, right_chan );
+
+#ifdef GBLENDER_HAVE_AVX2
+  if ( gblender_simd_level() == GBLENDER_SIMD_AVX2 )
+    nn = postprocess_bytes_avx2( lines, write, count, pix_bytes,
+                                 center, left, right );
+  else
+#endif
+    nn = postprocess_bytes_sse2( lines, write, count, pix_bytes,
+                                 center, left, right );
+
+  postprocess_bytes_tail( lines, write, nn, count, pix_bytes,
+                          center, left, right );
+}
+
+
+static void
+swizzle_line_rgb24_simd( unsigned char**  lines,
+                         unsigned char*   write,
+                         int              width,
+                         int              offset )
+{
+  swizzle_line_simd( lines, write, width, offset, 3, rgb24_center );
+}
+
+
+static void
+postprocess_line_rgb24_simd( unsigned char**  lines,
+                             unsigned char*   write,
+                             int              width,
+                             int              offset )
+{
+  postprocess_line_simd( lines, write, width, offset, 3,
+                         rgb24_center, rgb24_left, rgb24_right );
+}
+
+
+static void
+swizzle_line_xrgb32_simd( unsigned char**  lines,
+                          unsigned char*   write,
+                          int              width,
+                          int              offset )
+{
+  swizzle_line_simd( lines, write, width, offset, 4, xrgb32_left );
+}
+
+
+static void
+postprocess_line_xrgb32_simd( unsigned char**  lines,
+                              unsigned char*   write,
+                              int              width,
+                              int              offset )
+{
+  postprocess_line_simd( lines, write, width, offset, 4,
+                         xrgb32_center, xrgb32_left, xrgb32_right );
+}
+
+#endif /* SWIZZLE_SIMD */
+
+
+
 static void
 gr_swizzle_generic( unsigned char*    read_buff,
                    int                read_pitch,
@@ -610,14 +1040,26 @@ gr_swizzle_rect_rgb24( unsigned char*    read_buff,
                        int               width,
                        int               height )
 {
+  filter_func_t  swizzle_func     = swizzle_line_rgb24;
+  filter_func_t  postprocess_func = postprocess_line_rgb24;
+
+#ifdef SWIZZLE_SIMD
+  if ( gblender_simd_level() == GBLENDER_SIMD_SSE2 ||
+       gblender_simd_level() == GBLENDER_SIMD_AVX2 )
+  {
+    swizzle_func     = swizzle_line_rgb24_simd;
+    postprocess_func = postprocess_line_rgb24_simd;
+  }
+#endif
+
   gr_swizzle_generic( read_buff, read_pitch,
                       write_buff, write_pitch,
                       buff_width,
                       buff_height,
                       x, y, width, height,
                       3,
-                      swizzle_line_rgb24,
-                      postprocess_line_rgb24 );
+                      swizzle_func,
+                      postprocess_func );
 }
 
 
@@ -658,14 +1100,26 @@ gr_swizzle_rect_xrgb32( unsigned char*    read_buff,
                         int               width,
                         int               height )
 {
+  filter_func_t  swizzle_func     = swizzle_line_xrgb32;
+  filter_func_t  postprocess_func = postprocess_line_xrgb32;
+
+#ifdef SWIZZLE_SIMD
+  if ( gblender_simd_level() == GBLENDER_SIMD_SSE2 ||
+       gblender_simd_level() == GBLENDER_SIMD_AVX2 )
+  {
+    swizzle_func     = swizzle_line_xrgb32_simd;
+    postprocess_func = postprocess_line_xrgb32_simd;
+  }
+#endif
+
   gr_swizzle_generic( read_buff, read_pitch,
                       write_buff, write_pitch,
                       buff_width,
                       buff_height,
                       x, y, width, height,
                       4,
-                      swizzle_line_xrgb32,
-                      postprocess_line_xrgb32 );
+                      swizzle_func,
+                      postprocess_func );
 }
 
 
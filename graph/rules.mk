@@ -18,18 +18,24 @@ GRAPH := $(TOP_DIR_2)/graph
 GRAPH_H := $(GRAPH)/gblany.h    \
            $(GRAPH)/gblblit.h   \
            $(GRAPH)/gblender.h  \
+           $(GRAPH)/gbllinear.h \
+           $(GRAPH)/gblsimd.h   \
            $(GRAPH)/graph.h     \
            $(GRAPH)/grconfig.h  \
+           $(GRAPH)/grconvany.h \
+           $(GRAPH)/grconvert.h \
            $(GRAPH)/grdevice.h  \
            $(GRAPH)/grevents.h  \
            $(GRAPH)/grfont.h    \
            $(GRAPH)/grobjs.h    \
+           $(GRAPH)/grsimd.h    \
            $(GRAPH)/grswizzle.h \
            $(GRAPH)/grtypes.h
 
 
 GRAPH_OBJS := $(OBJ_DIR_2)/gblblit.$(O)   \
               $(OBJ_DIR_2)/gblender.$(O)  \
+              $(OBJ_DIR_2)/grconvert.$(O) \
               $(OBJ_DIR_2)/grdevice.$(O)  \
               $(OBJ_DIR_2)/grfill.$(O)    \
               $(OBJ_DIR_2)/grfont.$(O)    \
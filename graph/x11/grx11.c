@@ -30,8 +30,15 @@
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 
+#ifdef HAVE_MITSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif
+
 #include "grtypes.h"
 #include "grobjs.h"
+#include "grconvert.h"
 #include "grx11.h"
 
 #define xxTEST
@@ -145,653 +152,109 @@
       height -= delta;
 
     /* clip rectangle to target bitmap */
-    delta = x + width - target->width;
-    if ( delta > 0 )
-      width -= delta;
-
-    delta = y + height - target->height;
-    if ( delta > 0 )
-      height -= delta;
-
-    if ( width <= 0 || height <= 0 )
-      return 1;
-
-    /* now, setup the blitter */
-    blit->x      = x;
-    blit->y      = y;
-    blit->width  = width;
-    blit->height = height;
-
-    pitch = blit->src_pitch = source->pitch;
-    if ( pitch < 0 )
-      y -= source->rows - 1;
-    blit->src_line  = source->buffer + y * pitch;
-
-    pitch = blit->dst_pitch = target->bytes_per_line;
-    if ( pitch < 0 )
-      y -= target->height - 1;
-    blit->dst_line = (unsigned char*)target->data + y * pitch;
-
-    return 0;
-  }
-
-
-  typedef void  (*grX11ConvertFunc)( grX11Blitter*  blit );
-
-  typedef struct grX11FormatRec_
-  {
-    int             x_depth;
-    int             x_bits_per_pixel;
-    unsigned long   x_red_mask;
-    unsigned long   x_green_mask;
-    unsigned long   x_blue_mask;
-
-    grX11ConvertFunc  rgb_convert;
-    grX11ConvertFunc  gray_convert;
-
-  } grX11Format;
-
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR RGB565                  *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_rgb565( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 2;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned short*  lwrite = (unsigned short*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        unsigned int  r = lread[0];
-        unsigned int  g = lread[1];
-        unsigned int  b = lread[2];
-
-
-        lwrite[0] = (unsigned short)( ( ( r << 8 ) & 0xF800U ) |
-                                      ( ( g << 3 ) & 0x07E0  ) |
-                                      ( ( b >> 3 ) & 0x001F  ) );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static void
-  gr_x11_convert_gray_to_rgb565( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x;
-    unsigned char*  line_write = blit->dst_line + blit->x * 2;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned short*  lwrite = (unsigned short*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread++, lwrite++ )
-      {
-        unsigned int  p = lread[0];
-
-
-        lwrite[0] = (unsigned short)( ( ( p >> 3 ) * 0x0801U ) |
-                                      ( ( p >> 2 ) * 0x0020U ) );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_rgb565 =
-  {
-    16, 16, 0xF800U, 0x07E0, 0x001F,
-    gr_x11_convert_rgb_to_rgb565,
-    gr_x11_convert_gray_to_rgb565
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR  BGR565                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_bgr565( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 2;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned short*  lwrite = (unsigned short*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        unsigned int  r = lread[0];
-        unsigned int  g = lread[1];
-        unsigned int  b = lread[2];
-
-
-        lwrite[0] = (unsigned short)( ( ( b << 8 ) & 0xF800U ) |
-                                      ( ( g << 3 ) & 0x07E0  ) |
-                                      ( ( r >> 3 ) & 0x001F  ) );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_bgr565 =
-  {
-    16, 16, 0x001F, 0x07E0, 0xF800U,
-    gr_x11_convert_rgb_to_bgr565,
-    gr_x11_convert_gray_to_rgb565  /* the same for bgr565! */
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR RGB555                  *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_rgb555( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 2;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned short*  lwrite = (unsigned short*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        unsigned int  r = lread[0];
-        unsigned int  g = lread[1];
-        unsigned int  b = lread[2];
-
-
-        lwrite[0] = (unsigned short)( ( ( r << 7 ) & 0x7C00 ) |
-                                      ( ( g << 2 ) & 0x03E0 ) |
-                                      ( ( b >> 3 ) & 0x001F ) );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static void
-  gr_x11_convert_gray_to_rgb555( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x;
-    unsigned char*  line_write = blit->dst_line + blit->x * 2;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned short*  lwrite = (unsigned short*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread++, lwrite++ )
-        *lwrite = (unsigned short)( ( *lread >> 3 ) * 0x0421U );
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_rgb555 =
-  {
-    15, 16, 0x7C00, 0x03E0, 0x001F,
-    gr_x11_convert_rgb_to_rgb555,
-    gr_x11_convert_gray_to_rgb555
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR  BGR555                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_bgr555( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 2;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned short*  lwrite = (unsigned short*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        unsigned int  r = lread[0];
-        unsigned int  g = lread[1];
-        unsigned int  b = lread[2];
-
-
-        lwrite[0] = (unsigned short)( ( ( b << 7 ) & 0x7C00 ) |
-                                      ( ( g << 2 ) & 0x03E0 ) |
-                                      ( ( r >> 3 ) & 0x001F ) );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format gr_x11_format_bgr555 =
-  {
-    15, 16, 0x001F, 0x03E0, 0x7C00,
-    gr_x11_convert_rgb_to_bgr555,
-    gr_x11_convert_gray_to_rgb555  /* the same for bgr555! */
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR RGB888                  *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_rgb888( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 3;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      memcpy( line_write, line_read, (size_t)blit->width * 3 );
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static void
-  gr_x11_convert_gray_to_rgb888( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x;
-    unsigned char*  line_write = blit->dst_line + blit->x * 3;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned char*   lwrite = line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread++, lwrite += 3 )
-      {
-        unsigned char  p = lread[0];
-
-
-        lwrite[0] = p;
-        lwrite[1] = p;
-        lwrite[2] = p;
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_rgb888 =
-  {
-    24, 24, 0xFF0000L, 0x00FF00U, 0x0000FF,
-    gr_x11_convert_rgb_to_rgb888,
-    gr_x11_convert_gray_to_rgb888
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR  BGR888                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_bgr888( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 3;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      unsigned char*   lwrite = line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite += 3 )
-      {
-        lwrite[0] = lread[2];
-        lwrite[1] = lread[1];
-        lwrite[2] = lread[0];
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_bgr888 =
-  {
-    24, 24, 0x0000FF, 0x00FF00U, 0xFF0000L,
-    gr_x11_convert_rgb_to_bgr888,
-    gr_x11_convert_gray_to_rgb888   /* the same for bgr888 */
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR RGB8880                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_rgb8880( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 4;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*   lread  = line_read;
-      uint32_t*        lwrite = (uint32_t*)line_write;
-      int              x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        uint32_t  r = lread[0];
-        uint32_t  g = lread[1];
-        uint32_t  b = lread[2];
-
-
-        *lwrite = ( r << 24 ) |
-                  ( g << 16 ) |
-                  ( b <<  8 );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static void
-  gr_x11_convert_gray_to_rgb8880( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x;
-    unsigned char*  line_write = blit->dst_line + blit->x*4;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*  lread  = line_read;
-      uint32_t*       lwrite = (uint32_t*)line_write;
-      int             x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread++, lwrite++ )
-        *lwrite = *lread * 0x01010100U;
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_rgb8880 =
-  {
-    24, 32, 0xFF000000UL, 0x00FF0000L, 0x0000FF00U,
-    gr_x11_convert_rgb_to_rgb8880,
-    gr_x11_convert_gray_to_rgb8880
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR RGB0888                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_rgb0888( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 4;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*  lread  = line_read;
-      uint32_t*       lwrite = (uint32_t*)line_write;
-      int             x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        uint32_t  r = lread[0];
-        uint32_t  g = lread[1];
-        uint32_t  b = lread[2];
-
-
-        *lwrite = ( r << 16 ) |
-                  ( g <<  8 ) |
-                  ( b <<  0 );
-      }
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static void
-  gr_x11_convert_gray_to_rgb0888( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x;
-    unsigned char*  line_write = blit->dst_line + blit->x * 4;
-    int             h          = blit->height;
-
-
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*  lread  = line_read;
-      uint32_t*       lwrite = (uint32_t*)line_write;
-      int             x      = blit->width;
-
-
-      for ( ; x > 0; x--, lread++, lwrite++ )
-        *lwrite = *lread * 0x010101U;
-
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
-
-
-  static const grX11Format  gr_x11_format_rgb0888 =
-  {
-    24, 32, 0x00FF0000L, 0x0000FF00U, 0x000000FF,
-    gr_x11_convert_rgb_to_rgb0888,
-    gr_x11_convert_gray_to_rgb0888
-  };
-
-
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR BGR8880                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
-
-  static void
-  gr_x11_convert_rgb_to_bgr8880( grX11Blitter*  blit )
-  {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 4;
-    int             h          = blit->height;
-
+    delta = x + width - target->width;
+    if ( delta > 0 )
+      width -= delta;
 
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*  lread  = line_read;
-      uint32_t*       lwrite = (uint32_t*)line_write;
-      int             x      = blit->width;
+    delta = y + height - target->height;
+    if ( delta > 0 )
+      height -= delta;
 
+    if ( width <= 0 || height <= 0 )
+      return 1;
 
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        uint32_t  r = lread[0];
-        uint32_t  g = lread[1];
-        uint32_t  b = lread[2];
+    /* now, setup the blitter */
+    blit->x      = x;
+    blit->y      = y;
+    blit->width  = width;
+    blit->height = height;
 
+    pitch = blit->src_pitch = source->pitch;
+    if ( pitch < 0 )
+      y -= source->rows - 1;
+    blit->src_line  = source->buffer + y * pitch;
 
-        *lwrite = ( r <<  8 ) |
-                  ( g << 16 ) |
-                  ( b << 24 );
-      }
+    pitch = blit->dst_pitch = target->bytes_per_line;
+    if ( pitch < 0 )
+      y -= target->height - 1;
+    blit->dst_line = (unsigned char*)target->data + y * pitch;
 
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
+    return 0;
   }
 
 
-  static const grX11Format  gr_x11_format_bgr8880 =
+  /* the conversion of RGB24 and gray bitmaps is in `grconvert.c' */
+  typedef struct grX11FormatRec_
   {
-    24, 32, 0x0000FF00U, 0x00FF0000L, 0xFF000000UL,
-    gr_x11_convert_rgb_to_bgr8880,
-    gr_x11_convert_gray_to_rgb8880  /* the same for bgr8880 */
-  };
+    int              x_depth;
+    int              x_bits_per_pixel;
+    unsigned long    x_red_mask;
+    unsigned long    x_green_mask;
+    unsigned long    x_blue_mask;
 
+    grConvertFormat  convert;
 
-  /************************************************************************/
-  /************************************************************************/
-  /*****                                                              *****/
-  /*****                BLITTING ROUTINES FOR BGR0888                 *****/
-  /*****                                                              *****/
-  /************************************************************************/
-  /************************************************************************/
+  } grX11Format;
 
-  static void
-  gr_x11_convert_rgb_to_bgr0888( grX11Blitter*  blit )
+
+  static const grX11Format  gr_x11_format_rgb565 =
   {
-    unsigned char*  line_read  = blit->src_line + blit->x * 3;
-    unsigned char*  line_write = blit->dst_line + blit->x * 4;
-    int             h          = blit->height;
+    16, 16, 0xF800U, 0x07E0, 0x001F,
+    gr_convert_rgb565
+  };
 
+  static const grX11Format  gr_x11_format_bgr565 =
+  {
+    16, 16, 0x001F, 0x07E0, 0xF800U,
+    gr_convert_bgr565
+  };
 
-    for ( ; h > 0; h-- )
-    {
-      unsigned char*  lread  = line_read;
-      uint32_t*       lwrite = (uint32_t*)line_write;
-      int             x      = blit->width;
+  static const grX11Format  gr_x11_format_rgb555 =
+  {
+    15, 16, 0x7C00, 0x03E0, 0x001F,
+    gr_convert_rgb555
+  };
 
+  static const grX11Format  gr_x11_format_bgr555 =
+  {
+    15, 16, 0x001F, 0x03E0, 0x7C00,
+    gr_convert_bgr555
+  };
 
-      for ( ; x > 0; x--, lread += 3, lwrite++ )
-      {
-        uint32_t  r = lread[0];
-        uint32_t  g = lread[1];
-        uint32_t  b = lread[2];
+  static const grX11Format  gr_x11_format_rgb888 =
+  {
+    24, 24, 0xFF0000L, 0x00FF00U, 0x0000FF,
+    gr_convert_rgb888
+  };
 
+  static const grX11Format  gr_x11_format_bgr888 =
+  {
+    24, 24, 0x0000FF, 0x00FF00U, 0xFF0000L,
+    gr_convert_bgr888
+  };
 
-        *lwrite = ( r <<  0 ) |
-                  ( g <<  8 ) |
-                  ( b << 16 );
-      }
+  static const grX11Format  gr_x11_format_rgb8880 =
+  {
+    24, 32, 0xFF000000UL, 0x00FF0000L, 0x0000FF00U,
+    gr_convert_rgb8880
+  };
 
-      line_read  += blit->src_pitch;
-      line_write += blit->dst_pitch;
-    }
-  }
+  static const grX11Format  gr_x11_format_rgb0888 =
+  {
+    24, 32, 0x00FF0000L, 0x0000FF00U, 0x000000FF,
+    gr_convert_rgb0888
+  };
 
+  static const grX11Format  gr_x11_format_bgr8880 =
+  {
+    24, 32, 0x0000FF00U, 0x00FF0000L, 0xFF000000UL,
+    gr_convert_bgr8880
+  };
 
   static const grX11Format  gr_x11_format_bgr0888 =
   {
     24, 32, 0x000000FF, 0x0000FF00U, 0x00FF0000L,
-    gr_x11_convert_rgb_to_bgr0888,
-    gr_x11_convert_gray_to_rgb0888  /* the same for bgr0888 */
+    gr_convert_bgr0888
   };
 
 
@@ -826,6 +289,7 @@
     const grX11Format*  format;
     int                 scanline_pad;
     Visual*             visual;
+    int                 use_shm;
 
   } grX11Device;
 
@@ -865,6 +329,10 @@
     x11dev.busy = XCreateFontCursor( x11dev.display, XC_watch );
     x11dev.scanline_pad = BitmapPad( x11dev.display );
 
+#ifdef HAVE_MITSHM
+    x11dev.use_shm = XShmQueryExtension( x11dev.display );
+#endif
+
     LOG(( "Display: BitmapUnit = %d, BitmapPad = %d, ByteOrder = %s\n",
           BitmapUnit( x11dev.display ), BitmapPad( x11dev.display ),
           ImageByteOrder( x11dev.display ) == LSBFirst ? "LSBFirst"
@@ -954,7 +422,15 @@
     Atom                wm_delete_window;
 
     XImage*             ximage;
-    grX11ConvertFunc    convert;
+    grConvertFunc       convert;
+    int                 bytes_per_pixel;
+
+    /* copy of the bitmap as last sent to the server */
+    unsigned char*      shadow;
+
+#ifdef HAVE_MITSHM
+    XShmSegmentInfo     shminfo;  /* in use if `ximage->obdata' is set */
+#endif
 
     char                key_buffer[10];
     int                 key_cursor;
@@ -963,6 +439,237 @@
   } grX11Surface;
 
 
+#ifdef HAVE_MITSHM
+
+  static int  gr_x11_shm_failed;
+
+
+  static int
+  gr_x11_shm_error_handler( Display*      display,
+                            XErrorEvent*  event )
+  {
+    (void)display;
+    (void)event;
+
+    gr_x11_shm_failed = 1;
+
+    return 0;
+  }
+
+
+  /* attach a shared memory segment of `size' bytes to the surface; */
+  /* this fails for remote displays                                 */
+  static char*
+  gr_x11_shm_attach( grX11Surface*  surface,
+                     size_t         size )
+  {
+    XShmSegmentInfo*  shminfo = &surface->shminfo;
+    XErrorHandler     handler;
+
+
+    shminfo->shmid = shmget( IPC_PRIVATE, size, IPC_CREAT | 0600 );
+    if ( shminfo->shmid < 0 )
+      return NULL;
+
+    shminfo->shmaddr = (char*)shmat( shminfo->shmid, NULL, 0 );
+    if ( shminfo->shmaddr == (char*)-1 )
+    {
+      shmctl( shminfo->shmid, IPC_RMID, NULL );
+      return NULL;
+    }
+
+    shminfo->readOnly = True;
+
+    gr_x11_shm_failed = 0;
+
+    handler = XSetErrorHandler( gr_x11_shm_error_handler );
+    XShmAttach( surface->display, shminfo );
+    XSync( surface->display, False );
+    XSetErrorHandler( handler );
+
+    /* the segment goes away with the last detachment */
+    shmctl( shminfo->shmid, IPC_RMID, NULL );
+
+    if ( gr_x11_shm_failed )
+    {
+      LOG(( "MIT-SHM: attaching failed\n" ));
+
+      shmdt( shminfo->shmaddr );
+      x11dev.use_shm = 0;  /* don't try again */
+
+      return NULL;
+    }
+
+    return shminfo->shmaddr;
+  }
+
+
+  static void
+  gr_x11_shm_detach( grX11Surface*  surface )
+  {
+    XShmDetach( surface->display, &surface->shminfo );
+    XSync( surface->display, False );
+    shmdt( surface->shminfo.shmaddr );
+
+    surface->ximage->obdata = NULL;
+  }
+
+#endif /* HAVE_MITSHM */
+
+
+  /* allocate the image data, in shared memory if possible; */
+  /* without conversion, this is the bitmap buffer, too     */
+  static int
+  gr_x11_surface_alloc( grX11Surface*  surface )
+  {
+    grBitmap*  bitmap = &surface->root.bitmap;
+    XImage*    ximage = surface->ximage;
+    size_t     size   = (size_t)ximage->height *
+                        (size_t)ximage->bytes_per_line;
+    char*      data   = NULL;
+
+
+#ifdef HAVE_MITSHM
+    if ( x11dev.use_shm && size )
+      data = gr_x11_shm_attach( surface, size );
+
+    if ( data )
+    {
+      ximage->obdata = (char*)&surface->shminfo;
+
+      if ( !surface->convert )
+      {
+        free( bitmap->buffer );
+        bitmap->buffer = (unsigned char*)data;
+      }
+    }
+    else
+#endif
+    if ( surface->convert )
+    {
+      data = (char*)malloc( size );
+      if ( !data && size )
+        return 0;
+    }
+    else
+      data = (char*)bitmap->buffer;
+
+    ximage->data = data;
+
+    return 1;
+  }
+
+
+  /* release the image data; a bitmap buffer in shared memory is reset */
+  static void
+  gr_x11_surface_free( grX11Surface*  surface )
+  {
+    XImage*  ximage = surface->ximage;
+
+
+#ifdef HAVE_MITSHM
+    if ( ximage->obdata )
+    {
+      gr_x11_shm_detach( surface );
+
+      if ( !surface->convert )
+        surface->root.bitmap.buffer = NULL;
+    }
+    else
+#endif
+    if ( surface->convert )
+      free( ximage->data );
+
+    ximage->data = NULL;
+  }
+
+
+  /* convert the rectangle of a blitter into the image */
+  static void
+  gr_x11_surface_convert( grX11Surface*  surface,
+                          grX11Blitter*  blit )
+  {
+    int             src_bytes  = surface->bytes_per_pixel;
+    int             dst_bytes  = surface->ximage->bits_per_pixel >> 3;
+    unsigned char*  line_read  = blit->src_line + blit->x * src_bytes;
+    unsigned char*  line_write = blit->dst_line + blit->x * dst_bytes;
+    int             h          = blit->height;
+
+
+    for ( ; h > 0; h-- )
+    {
+      surface->convert( line_read, line_write, blit->width );
+
+      line_read  += blit->src_pitch;
+      line_write += blit->dst_pitch;
+    }
+  }
+
+
+  /* bring both image and shadow up to date with the whole bitmap */
+  static int
+  gr_x11_surface_sync( grX11Surface*  surface )
+  {
+    grBitmap*       bitmap = &surface->root.bitmap;
+    size_t          size   = (size_t)bitmap->rows *
+                             (size_t)( bitmap->pitch < 0 ? -bitmap->pitch
+                                                         : bitmap->pitch );
+    unsigned char*  shadow;
+    grX11Blitter    blit;
+
+
+    shadow = (unsigned char*)realloc( surface->shadow, size );
+    if ( !shadow && size )
+      return 0;
+
+    surface->shadow = shadow;
+
+    if ( size )
+      memcpy( shadow, bitmap->buffer, size );
+
+    if ( surface->convert                                      &&
+         !gr_x11_blitter_reset( &blit, bitmap, surface->ximage,
+                                0, 0, bitmap->width, bitmap->rows ) )
+      gr_x11_surface_convert( surface, &blit );
+
+    return 1;
+  }
+
+
+  static void
+  gr_x11_surface_put( grX11Surface*  surface,
+                      int            x,
+                      int            y,
+                      int            w,
+                      int            h )
+  {
+#ifdef HAVE_MITSHM
+    if ( surface->ximage->obdata )
+      XShmPutImage( surface->display, surface->win, surface->gc,
+                    surface->ximage, x, y, x, y,
+                    (unsigned int)w, (unsigned int)h, False );
+    else
+#endif
+      XPutImage( surface->display, surface->win, surface->gc,
+                 surface->ximage, x, y, x, y,
+                 (unsigned int)w, (unsigned int)h );
+  }
+
+
+  /* the server must be done with a shared image */
+  /* before the application draws again          */
+  static void
+  gr_x11_surface_wait( grX11Surface*  surface )
+  {
+#ifdef HAVE_MITSHM
+    if ( surface->ximage->obdata )
+      XSync( surface->display, False );
+    else
+#endif
+      XFlush( surface->display );
+  }
+
+
   /* close a given window */
   static void
   gr_x11_surface_done( grX11Surface*  surface )
@@ -974,8 +681,7 @@
     {
       if ( surface->ximage )
       {
-        if ( !surface->convert )
-          surface->ximage->data = NULL;
+        gr_x11_surface_free( surface );
         XDestroyImage( surface->ximage );
         surface->ximage = NULL;
       }
@@ -987,10 +693,16 @@
       }
     }
 
+    free( surface->shadow );
+    surface->shadow = NULL;
+
     grDoneBitmap( &surface->root.bitmap );
   }
 
 
+  /* Only bands of rows that differ from the shadow copy are converted */
+  /* and sent to the server.  The demo programs redraw everything for  */
+  /* each frame, while usually only a small part of the bitmap changes. */
   static void
   gr_x11_surface_refresh_rect( grX11Surface*  surface,
                                int            x,
@@ -998,19 +710,58 @@
                                int            w,
                                int            h )
   {
-    grX11Blitter  blit;
+    grBitmap*       bitmap  = &surface->root.bitmap;
+    int             damaged = 0;
+    int             row, start;
+    grX11Blitter    blit, band;
+    unsigned char*  src;
+    unsigned char*  shadow;
+    size_t          len;
+
+
+    if ( gr_x11_blitter_reset( &blit, bitmap, surface->ximage,
+                               x, y, w, h ) )
+      return;
 
+    src = blit.src_line + blit.x * surface->bytes_per_pixel;
+    len = (size_t)blit.width * (size_t)surface->bytes_per_pixel;
 
-    if ( surface->convert                    &&
-         !gr_x11_blitter_reset( &blit, &surface->root.bitmap, surface->ximage,
-                                x, y, w, h ) )
-      surface->convert( &blit );
+    for ( row = 0; row < blit.height; )
+    {
+      /* skip unchanged rows; the shadow has the same layout */
+      for ( ; row < blit.height; row++, src += blit.src_pitch )
+        if ( memcmp( src, surface->shadow + ( src - bitmap->buffer ), len ) )
+          break;
+
+      /* collect changed rows */
+      for ( start = row; row < blit.height; row++, src += blit.src_pitch )
+      {
+        shadow = surface->shadow + ( src - bitmap->buffer );
+
+        if ( !memcmp( src, shadow, len ) )
+          break;
+
+        memcpy( shadow, src, len );
+      }
+
+      if ( row == start )
+        break;
 
-    /* without background defined, this only generates Expose event */
-    XClearArea( surface->display, surface->win,
-                x, y,
-                (unsigned)w, (unsigned)h,
-                True );
+      band          = blit;
+      band.src_line = blit.src_line + start * blit.src_pitch;
+      band.dst_line = blit.dst_line + start * blit.dst_pitch;
+      band.height   = row - start;
+
+      if ( surface->convert )
+        gr_x11_surface_convert( surface, &band );
+
+      gr_x11_surface_put( surface, blit.x, blit.y + start,
+                                   blit.width, band.height );
+      damaged = 1;
+    }
+
+    if ( damaged )
+      gr_x11_surface_wait( surface );
   }
 
 
@@ -1108,16 +859,21 @@
     grBitmap*  bitmap  = &surface->root.bitmap;
     XImage*    ximage  = surface->ximage;
     int        pitch;
-    char*      buffer;
 
 
+    /* a bitmap buffer in shared memory can't be reallocated */
+    gr_x11_surface_free( surface );
+
     /* resize the bitmap */
     if ( grNewBitmap( bitmap->mode,
                       bitmap->grays,
                       width,
                       height,
                       bitmap ) )
+    {
+      gr_x11_surface_alloc( surface );
       return 0;
+    }
 
     /* reallocate surface image */
     pitch  = width * ximage->bits_per_pixel >> 3;
@@ -1131,22 +887,12 @@
         pitch += ( ximage->bitmap_pad - over ) >> 3;
     }
 
-    if ( surface->convert )
-    {
-      buffer = (char*)realloc( ximage->data, (size_t)height * (size_t)pitch );
-      if ( !buffer && height && pitch )
-        return 0;
-
-      ximage->data = buffer;
-    }
-    else
-      ximage->data = (char*)bitmap->buffer;
-
     ximage->bytes_per_line = pitch;
     ximage->width          = width;
     ximage->height         = height;
 
-    return 1;
+    return gr_x11_surface_alloc( surface ) &&
+           gr_x11_surface_sync( surface );
   }
 
 
@@ -1249,16 +995,12 @@
              x_event.xexpose.y + x_event.xexpose.height
                    > exposed.y +         exposed.height )
         {
-          XPutImage( surface->display,
-                     surface->win,
-                     surface->gc,
-                     surface->ximage,
-                     x_event.xexpose.x,
-                     x_event.xexpose.y,
-                     x_event.xexpose.x,
-                     x_event.xexpose.y,
-                     (unsigned int)x_event.xexpose.width,
-                     (unsigned int)x_event.xexpose.height );
+          gr_x11_surface_put( surface,
+                              x_event.xexpose.x,
+                              x_event.xexpose.y,
+                              x_event.xexpose.width,
+                              x_event.xexpose.height );
+          gr_x11_surface_wait( surface );
 
           exposed = x_event.xexpose;
           LOG(( "painted\n" ));
@@ -1341,14 +1083,16 @@
       break;
 
     case gr_pixel_mode_rgb24:
-      surface->convert = x11dev.format->rgb_convert;
+      surface->convert = gr_convert_get_func( gr_pixel_mode_rgb24,
+                                              x11dev.format->convert );
       break;
 
     case gr_pixel_mode_gray:
       /* we only support 256-gray level 8-bit pixmaps */
       if ( bitmap->grays == 256 )
       {
-        surface->convert = x11dev.format->gray_convert;
+        surface->convert = gr_convert_get_func( gr_pixel_mode_gray,
+                                                x11dev.format->convert );
         break;
       }
       /* fall through */
@@ -1382,15 +1126,8 @@
     if ( !surface->ximage )
       return 0;
 
-    /* Allocate or link surface image data */
-    if ( surface->convert )
-    {
-      surface->ximage->data = (char*)malloc( (size_t)bitmap->rows *
-                              (size_t)surface->ximage->bytes_per_line );
-      if ( !surface->ximage->data )
-        return 0;
-    }
-    else
+    /* Set up zero-copy image format */
+    if ( !surface->convert )
     {
       const int x = 1;
 
@@ -1399,9 +1136,34 @@
       surface->ximage->red_mask   = x11dev.format->x_red_mask;
       surface->ximage->green_mask = x11dev.format->x_green_mask;
       surface->ximage->blue_mask  = x11dev.format->x_blue_mask;
-      surface->ximage->data       = (char*)bitmap->buffer;
     }
 
+    /* Allocate or link surface image data */
+    if ( !gr_x11_surface_alloc( surface ) )
+      return 0;
+
+    /* the bitmap buffer might have moved to shared memory */
+    *bitmap = surface->root.bitmap;
+
+    switch ( bitmap->mode )
+    {
+    case gr_pixel_mode_rgb32:
+      surface->bytes_per_pixel = 4;
+      break;
+    case gr_pixel_mode_rgb24:
+      surface->bytes_per_pixel = 3;
+      break;
+    case gr_pixel_mode_rgb565:
+    case gr_pixel_mode_rgb555:
+      surface->bytes_per_pixel = 2;
+      break;
+    default:
+      surface->bytes_per_pixel = 1;
+    }
+
+    if ( !gr_x11_surface_sync( surface ) )
+      return 0;
+
     {
       int                   screen = DefaultScreen( display );
       XTextProperty         xtp  = { (unsigned char*)"FreeType", 31, 8, 8 };
@@ -12,6 +12,11 @@ endif
 X11_CFLAGS ?= $(shell $(PKG_CONFIG) --cflags x11)
 X11_LIBS   ?= $(shell $(PKG_CONFIG) --libs x11)
 
+# The MIT-SHM extension is optional.
+#
+XEXT_CFLAGS ?= $(shell $(PKG_CONFIG) --cflags xext)
+XEXT_LIBS   ?= $(shell $(PKG_CONFIG) --libs xext)
+
 ifneq ($(X11_LIBS),)
   # The GRAPH_LINK variable is expanded each time an executable is linked
   # against the graphics library.
@@ -26,6 +31,12 @@ ifneq ($(X11_LIBS),)
   endif
 
 
+  ifneq ($(XEXT_LIBS),)
+    GRAPH_LINK  += $(XEXT_LIBS)
+    X11_DEFINES := $DHAVE_MITSHM $(XEXT_CFLAGS)
+  endif
+
+
   # Add the X11 driver object file to the graphics library.
   #
   GRAPH_OBJS += $(OBJ_DIR_2)/grx11.$(O)
@@ -41,12 +52,12 @@ ifneq ($(X11_LIBS),)
 	  $(LIBTOOL) --mode=compile $(CC) -static $(CFLAGS) \
                      $(GRAPH_INCLUDES:%=$I%) \
                      $I$(subst /,$(COMPILER_SEP),$(GR_X11)) \
-                     $(X11_CFLAGS:%=$I%) \
+                     $(X11_CFLAGS:%=$I%) $(X11_DEFINES) \
                      $T$(subst /,$(COMPILER_SEP),$@ $<)
   else
 	  $(CC) $(CFLAGS) $(GRAPH_INCLUDES:%=$I%) \
                 $I$(subst /,$(COMPILER_SEP),$(GR_X11)) \
-                $(X11_CFLAGS:%=$I%) \
+                $(X11_CFLAGS:%=$I%) $(X11_DEFINES) \
                 $T$(subst /,$(COMPILER_SEP),$@ $<)
   endif
 endif
@@ -19,6 +19,7 @@
 #include <limits.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -27,19 +28,33 @@
 #include <freetype/ftbbox.h>
 #include <freetype/ftcache.h>
 #include <freetype/ftdriver.h>
+#include <freetype/ftfntfmt.h>
 #include <freetype/ftglyph.h>
 #include <freetype/ftlcdfil.h>
 #include <freetype/ftmodapi.h>
 #include <freetype/ftoutln.h>
 #include <freetype/ftstroke.h>
 #include <freetype/ftsynth.h>
+#include <freetype/ftsystem.h>
+
+#include "common.h"
+#include "thread.h"
 
 #ifdef UNIX
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #else
 #include "mlgetopt.h"
 #endif
 
+#if defined UNIX && defined __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define FTBENCH_PERF
+#endif
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -54,6 +69,10 @@
 
 #endif
 
+#ifdef FTDEMO_THREADS
+  static tlock_t  lock = TLOCK_INITIALIZER;
+#endif
+
 
   typedef struct  btimer_t_ {
     double  t0;
@@ -62,10 +81,56 @@
   } btimer_t;
 
 
+  /* memory manager that tracks the number and size of allocations */
+  typedef struct  bmemory_t_ {
+    struct FT_MemoryRec_  root;
+    size_t                current;   /* live bytes                 */
+    size_t                peak;
+    unsigned long         blocks;    /* live blocks                */
+    unsigned long         allocs;    /* allocations so far         */
+    double                total;     /* bytes allocated so far     */
+
+  } bmemory_t;
+
+
+  /* everything a test needs; each thread gets its own copy */
+  typedef struct  bcontext_t_ {
+    FT_Library        lib;
+    FT_Face           face;
+    FTC_Manager       cache_man;
+    FTC_CMapCache     cmap_cache;
+    FTC_ImageCache    image_cache;
+    FTC_SBitCache     sbit_cache;
+    FTC_ImageTypeRec  font_type;
+
+    /* the face under test */
+    const char*     filename;
+    long            face_index;
+    unsigned char*  memory_file;    /* with option `-p' */
+    size_t          memory_size;
+
+    /* the glyph range and size actually used for this face */
+    int           first_index;
+    int           last_index;
+    int           incr_index;
+    unsigned int  size;
+
+    bmemory_t*     memory;          /* with option `-M'              */
+    size_t         face_bytes;      /* allocated by `FT_New_Face'    */
+    unsigned long  face_blocks;
+
+    FILE*  out;                     /* text report                   */
+    FILE*  output;                  /* records for option `-o'       */
+    int    output_count;            /* tests written for this face   */
+    int    output_fonts;            /* faces written to `output'     */
+
+  } bcontext_t;
+
+
   typedef int
-  (*bcall_t)( btimer_t*  timer,
-              FT_Face    face,
-              void*      user_data );
+  (*bcall_t)( btimer_t*    timer,
+              bcontext_t*  ctx,
+              void*        user_data );
 
 
   typedef struct  btest_t_ {
@@ -73,6 +138,7 @@
     bcall_t      bench;
     int          cache_first;
     void*        user_data;
+    int          lines;        /* text lines processed per call */
 
   } btest_t;
 
@@ -85,8 +151,20 @@
   } bcharset_t;
 
 
+  /* a UTF-8 text corpus, split into non-empty lines */
+  typedef struct  btext_t_
+  {
+    char*         data;
+    int           num_lines;
+    const char**  line_start;
+    const char**  line_end;
+
+  } btext_t;
+
+
   static FT_Error
-  get_face( FT_Face*  face );
+  get_face( bcontext_t*  ctx,
+            FT_Face*     face );
 
 
   /*
@@ -97,13 +175,16 @@
 #define BENCH_TIME  2.0
 #define FACE_SIZE   10
 
+#define REGRESS_THRESHOLD  5.0
+#define NUM_SLOWEST        10
+
 
-  static FT_Library        lib;
-  static FTC_Manager       cache_man;
-  static FTC_CMapCache     cmap_cache;
-  static FTC_ImageCache    image_cache;
-  static FTC_SBitCache     sbit_cache;
-  static FTC_ImageTypeRec  font_type;
+  static bcontext_t  main_ctx;
+
+  static int          num_threads = 1;
+  static bcontext_t*  thread_ctx;
+
+  static int          num_workers = 1;   /* fonts benchmarked in parallel */
 
 
   enum {
@@ -119,6 +200,7 @@
     FT_BENCH_GET_BBOX,
     FT_BENCH_GET_CBOX,
     FT_BENCH_NEW_FACE_AND_LOAD_GLYPH,
+    FT_BENCH_TEXT,
     N_FT_BENCH
   };
 
@@ -138,23 +220,30 @@
     "get glyph cbox      (FT_Glyph_Get_CBox)",
 
     "open face and load glyphs",
+    "process text        (with option `-T')",
     NULL
   };
 
 
-  static int    preload;
-  static char*  filename;
+  static int      preload;
+  static btext_t  text;       /* option `-T' */
 
+  static unsigned int   size      = FACE_SIZE;
+  static unsigned long  max_bytes = CACHE_SIZE * 1024;
+
+  /* the requested range, clipped for each face */
   static int  first_index = 0;
   static int  last_index  = INT_MAX;
-  static int  incr_index  = 1;
 
   static int  cmap_index  = -1;
 
-#define FOREACH( i )  for ( i = first_index ;                          \
-                            ( first_index <= i && i <= last_index ) || \
-                            ( first_index >= i && i >= last_index ) ;  \
-                            i += incr_index )
+  /* iterate over the glyph range of `ctx' */
+#define FOREACH( i )  for ( i = ctx->first_index ;                    \
+                            ( ctx->first_index <= i &&                \
+                              i <= ctx->last_index  ) ||              \
+                            ( ctx->first_index >= i &&                \
+                              i >= ctx->last_index  ) ;               \
+                            i += ctx->incr_index )
 
   static FT_Render_Mode  render_mode = FT_RENDER_MODE_NORMAL;
   static FT_Int32        load_flags  = FT_LOAD_DEFAULT;
@@ -170,6 +259,11 @@
   static char  ps_hinting_engine_names[2][10] = { "freetype",
                                                   "adobe" };
 
+  /* the selected properties, applied to every library we create */
+  static unsigned int  tt_interpreter_version;
+  static unsigned int  ps_hinting_engine;
+  static int           lcd_filter = -1;
+
 
   /*
    * Dummy face requester (the face object is already loaded)
@@ -186,7 +280,8 @@
 
     *aface = (FT_Face)request_data;
 
-    return FT_Err_Ok;
+    /* the cache manager eventually calls `FT_Done_Face' on it */
+    return FT_Reference_Face( *aface );
   }
 
 
@@ -215,7 +310,7 @@
     FILETIME  start, end, kern, user;
 
 
-    GetProcessTimes( GetCurrentProcess(), &start, &end, &kern, &user );
+    GetThreadTimes( GetCurrentThread(), &start, &end, &kern, &user );
 
     return  0.1 * user.dwLowDateTime + 429496729.6 * user.dwHighDateTime;
 
@@ -223,7 +318,7 @@
     ULONG64  cycles;
 
 
-    QueryProcessCycleTime( GetCurrentProcess(), &cycles );
+    QueryThreadCycleTime( GetCurrentThread(), &cycles );
 
     return  1e-3 * cycles; /* at 1GHz */
 
@@ -233,7 +328,10 @@
     struct timespec  tv;
 
 
-#ifdef _POSIX_CPUTIME
+    /* per-thread CPU time is needed for option `-j' */
+#if defined _POSIX_THREAD_CPUTIME && _POSIX_THREAD_CPUTIME >= 0
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &tv );
+#elif defined _POSIX_CPUTIME
     clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &tv );
 #else
     clock_gettime( CLOCK_REALTIME, &tv );
@@ -247,712 +345,3772 @@
 #endif /* _POSIX_TIMERS */
   }
 
-#define TIMER_START( timer )  ( timer )->t0 = get_time()
-#define TIMER_STOP( timer )   ( timer )->total += get_time() - ( timer )->t0
-#define TIMER_GET( timer )    ( timer )->total
-#define TIMER_RESET( timer )  ( timer )->total = 0
-
 
   /*
-   * Bench code
+   * wall-clock timer in microseconds, used for throughput
    */
 
-  static void
-  benchmark( FT_Face   face,
-             btest_t*  test,
-             int       max_iter,
-             double    max_time )
+  static double
+  get_wall_time( void )
   {
-    int       n, done;
-    btimer_t  timer, elapsed;
-
-
-    if ( test->cache_first )
-    {
-      if ( !cache_man )
-      {
-        printf( "  %-25s no cache manager\n", test->title );
-
-        return;
-      }
+#if defined  _WIN32
+    LARGE_INTEGER  ticks, freq;
 
-      TIMER_RESET( &timer );
-      test->bench( &timer, face, test->user_data );
-    }
 
-    printf( "  %-25s ", test->title );
-    fflush( stdout );
+    QueryPerformanceCounter( &ticks );
+    QueryPerformanceFrequency( &freq );
 
-    TIMER_RESET( &timer );
-    TIMER_RESET( &elapsed );
+    return 1E6 * (double)ticks.QuadPart / (double)freq.QuadPart;
 
-    for ( n = 0, done = 0; !max_iter || n < max_iter; n++ )
-    {
-      TIMER_START( &elapsed );
+#elif defined _POSIX_TIMERS && _POSIX_TIMERS > 0
+    struct timespec  tv;
 
-      done += test->bench( &timer, face, test->user_data );
 
-      TIMER_STOP( &elapsed );
+#ifdef _POSIX_MONOTONIC_CLOCK
+    clock_gettime( CLOCK_MONOTONIC, &tv );
+#else
+    clock_gettime( CLOCK_REALTIME, &tv );
+#endif
 
-      if ( TIMER_GET( &elapsed ) > 1E6 * max_time )
-        break;
-    }
+    return 1E6 * (double)tv.tv_sec + 1E-3 * (double)tv.tv_nsec;
 
-    if ( done )
-      printf( "%10.3f us/op %10d done\n",
-              TIMER_GET( &timer ) / (double)done, done );
-    else
-      printf( "no error-free calls\n" );
+#else
+    return 1E6 * (double)time( NULL );
+#endif
   }
 
+#define TIMER_START( timer )  ( timer )->t0 = get_time()
+#define TIMER_STOP( timer )   ( timer )->total += get_time() - ( timer )->t0
+#define TIMER_GET( timer )    ( timer )->total
+#define TIMER_RESET( timer )  ( timer )->total = 0
+
 
   /*
-   * Various tests
+   * Hardware performance counters (option `-E', Linux only)
    */
 
-  static int
-  test_load( btimer_t*  timer,
-             FT_Face    face,
-             void*      user_data )
-  {
-    int  i, done = 0;
+  enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    N_PERF
+  };
 
-    FT_UNUSED( user_data );
+  static const char*  perf_names[N_PERF] =
+  {
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "branch_misses"
+  };
 
+  static int  use_perf;
 
-    TIMER_START( timer );
 
-    FOREACH( i )
-    {
-      if ( !FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        done++;
-    }
+  typedef struct  bperf_t_ {
+    int  fd[N_PERF];   /* -1 if the event is not available */
 
-    TIMER_STOP( timer );
+  } bperf_t;
 
-    return done;
-  }
 
+#ifdef FTBENCH_PERF
 
+  /* open a group of counters for user-space code of the calling thread */
   static int
-  test_load_advances( btimer_t*  timer,
-                      FT_Face    face,
-                      void*      user_data )
+  perf_open( bperf_t*  perf )
   {
-    int        done = 0;
-    FT_Fixed*  advances;
-    FT_ULong   flags = *((FT_ULong*)user_data);
-    FT_Int     start, count;
-
-
-    if ( incr_index > 0 )
-    {
-      start = first_index;
-      count = last_index - first_index + 1;
-    }
-    else
+    static const struct
     {
-      start = last_index;
-      count = first_index - last_index + 1;
-    }
-
-    advances = (FT_Fixed *)calloc( sizeof ( FT_Fixed ), (size_t)count );
+      unsigned int        type;
+      unsigned long long  config;
 
-    TIMER_START( timer );
+    } events[N_PERF] =
+    {
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+      { PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D                  |
+        ( PERF_COUNT_HW_CACHE_OP_READ     << 8 ) |
+        ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+      { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+    };
 
-    FT_Get_Advances( face,
-                     (FT_UInt)start, (FT_UInt)count,
-                     (FT_Int32)flags, advances );
-    done += (int)count;
+    int  i;
 
-    TIMER_STOP( timer );
 
-    free( advances );
+    for ( i = 0; i < N_PERF; i++ )
+    {
+      struct perf_event_attr  attr;
+
+
+      memset( &attr, 0, sizeof ( attr ) );
+      attr.size           = sizeof ( attr );
+      attr.type           = events[i].type;
+      attr.config         = events[i].config;
+      attr.disabled       = i == 0;   /* the leader controls the group */
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      /* events unsupported by the CPU are simply left out */
+      perf->fd[i] = (int)syscall( __NR_perf_event_open, &attr,
+                                  0, -1, i ? perf->fd[0] : -1, 0 );
+      if ( perf->fd[0] < 0 )
+        return 1;
+    }
 
-    return done;
+    return 0;
   }
 
 
-  static int
-  test_render( btimer_t*  timer,
-               FT_Face    face,
-               void*      user_data )
+  static void
+  perf_close( bperf_t*  perf )
   {
-    int  i, done = 0;
-
-    FT_UNUSED( user_data );
+    int  i;
 
 
-    FOREACH( i )
-    {
-      if ( FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        continue;
+    for ( i = N_PERF - 1; i >= 0; i-- )
+      if ( perf->fd[i] >= 0 )
+        close( perf->fd[i] );
+  }
 
-      TIMER_START( timer );
-      if ( !FT_Render_Glyph( face->glyph, render_mode ) )
-        done++;
-      TIMER_STOP( timer );
-    }
 
-    return done;
+  static void
+  perf_start( bperf_t*  perf )
+  {
+    ioctl( perf->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( perf->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
   }
 
 
-  static int
-  test_embolden( btimer_t*  timer,
-                 FT_Face    face,
-                 void*      user_data )
+  /* store the counts in `values', or -1 if not available */
+  static void
+  perf_stop( bperf_t*  perf,
+             double*   values )
   {
-    int  i, done = 0;
+    int  i;
 
-    FT_UNUSED( user_data );
 
+    ioctl( perf->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
 
-    FOREACH( i )
+    for ( i = 0; i < N_PERF; i++ )
     {
-      if ( FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        continue;
+      unsigned long long  data[3];   /* value, time enabled, time running */
 
-      TIMER_START( timer );
-      FT_GlyphSlot_Embolden( face->glyph );
-      done++;
-      TIMER_STOP( timer );
-    }
 
-    return done;
-  }
+      values[i] = -1;
 
+      if ( perf->fd[i] < 0 )
+        continue;
+      if ( read( perf->fd[i], data, sizeof ( data ) ) !=
+             (ssize_t)sizeof ( data ) || !data[2]       )
+        continue;
 
-  static int
-  test_stroke( btimer_t*  timer,
-               FT_Face    face,
-               void*      user_data )
-  {
-    FT_Glyph    glyph;
-    FT_Stroker  stroker;
+      /* scale if the kernel had to multiplex the counters */
+      values[i] = (double)data[0] * (double)data[1] / (double)data[2];
+    }
+  }
 
-    int  i, done = 0;
+#endif /* FTBENCH_PERF */
 
-    FT_UNUSED( user_data );
 
+  /*
+   * Memory accounting (options `-M' and `-S')
+   */
 
-    FT_Stroker_New( lib, &stroker );
-    FT_Stroker_Set( stroker, face->size->metrics.y_ppem,
-                    FT_STROKER_LINECAP_ROUND,
-                    FT_STROKER_LINEJOIN_ROUND,
-                    0 );
+  static int  track_memory;
 
-    FOREACH( i )
-    {
-      if ( FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        continue;
 
-      if ( FT_Get_Glyph( face->glyph, &glyph ) )
-        continue;
+  /* each block is preceded by its size */
+  typedef union  bblock_t_ {
+    size_t  size;
+    double  align_double;
+    void*   align_pointer;
 
-      TIMER_START( timer );
-      FT_Glyph_Stroke( &glyph, stroker, 1 );
-      TIMER_STOP( timer );
+  } bblock_t;
 
-      FT_Done_Glyph( glyph );
-      done++;
-    }
 
-    FT_Stroker_Done( stroker );
+  static void*
+  mem_alloc( FT_Memory  memory,
+             long       size )
+  {
+    bmemory_t*  m = (bmemory_t*)memory->user;
+    bblock_t*   block;
 
-    return done;
-  }
 
+    /* Some cache nodes are not completely initialized after a quick   */
+    /* allocation; clear them to get results independent of the heap. */
+    block = (bblock_t*)calloc( 1, sizeof ( bblock_t ) + (size_t)size );
+    if ( !block )
+      return NULL;
 
-  static int
-  test_get_glyph( btimer_t*  timer,
-                  FT_Face    face,
-                  void*      user_data )
-  {
-    FT_Glyph  glyph;
+    block->size = (size_t)size;
 
-    int  i, done = 0;
+    m->blocks++;
+    m->allocs++;
+    m->total   += (double)size;
+    m->current += (size_t)size;
+    if ( m->current > m->peak )
+      m->peak = m->current;
 
-    FT_UNUSED( user_data );
+    return block + 1;
+  }
 
 
-    FOREACH( i )
-    {
-      if ( FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        continue;
+  static void
+  mem_free( FT_Memory  memory,
+            void*      p )
+  {
+    bmemory_t*  m     = (bmemory_t*)memory->user;
+    bblock_t*   block = (bblock_t*)p - 1;
 
-      TIMER_START( timer );
-      if ( !FT_Get_Glyph( face->glyph, &glyph ) )
-      {
-        FT_Done_Glyph( glyph );
-        done++;
-      }
-      TIMER_STOP( timer );
-    }
 
-    return done;
+    m->blocks--;
+    m->current -= block->size;
+    free( block );
   }
 
 
-  static int
-  test_get_cbox( btimer_t*  timer,
-                 FT_Face    face,
-                 void*      user_data )
+  static void*
+  mem_realloc( FT_Memory  memory,
+               long       cur_size,
+               long       new_size,
+               void*      p )
   {
-    FT_Glyph  glyph;
-    FT_BBox   bbox;
+    bmemory_t*  m = (bmemory_t*)memory->user;
+    bblock_t*   block;
+    size_t      old_size;
 
-    int  i, done = 0;
+    FT_UNUSED( cur_size );
 
-    FT_UNUSED( user_data );
 
+    if ( !p )
+      return mem_alloc( memory, new_size );
 
-    FOREACH( i )
-    {
-      if ( FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        continue;
+    block    = (bblock_t*)p - 1;
+    old_size = block->size;
 
-      if ( FT_Get_Glyph( face->glyph, &glyph ) )
-        continue;
+    block = (bblock_t*)realloc( block,
+                                sizeof ( bblock_t ) + (size_t)new_size );
+    if ( !block )
+      return NULL;
 
-      TIMER_START( timer );
-      FT_Glyph_Get_CBox( glyph, FT_GLYPH_BBOX_PIXELS, &bbox );
-      TIMER_STOP( timer );
+    block->size = (size_t)new_size;
 
-      FT_Done_Glyph( glyph );
-      done++;
-    }
+    m->allocs++;
+    m->total   += (double)new_size;
+    m->current += (size_t)new_size - old_size;
+    if ( m->current > m->peak )
+      m->peak = m->current;
 
-    return done;
+    return block + 1;
   }
 
 
-  static int
-  test_get_bbox( btimer_t*  timer,
-                 FT_Face    face,
-                 void*      user_data )
+  /* create a library that allocates through `memory' */
+  static FT_Error
+  new_tracked_library( bmemory_t*   memory,
+                       FT_Library*  alibrary )
   {
-    FT_BBox    bbox;
+    FT_Error  error;
 
-    int  i, done = 0;
 
-    FT_UNUSED( user_data );
+    memset( memory, 0, sizeof ( *memory ) );
+    memory->root.user    = memory;
+    memory->root.alloc   = mem_alloc;
+    memory->root.free    = mem_free;
+    memory->root.realloc = mem_realloc;
 
+    error = FT_New_Library( &memory->root, alibrary );
+    if ( !error )
+      FT_Add_Default_Modules( *alibrary );
 
-    FOREACH( i )
-    {
-      if ( FT_Load_Glyph( face, (FT_UInt)i, load_flags ) )
-        continue;
+    return error;
+  }
 
-      TIMER_START( timer );
-      FT_Outline_Get_BBox( &face->glyph->outline, &bbox );
-      TIMER_STOP( timer );
 
-      done++;
-    }
+  /*
+   * Font and setup information
+   */
 
-    return done;
+  static const char*
+  get_target_name( void )
+  {
+    return render_mode == FT_RENDER_MODE_NORMAL ? "normal" :
+           render_mode == FT_RENDER_MODE_LIGHT  ? "light"  :
+           render_mode == FT_RENDER_MODE_MONO   ? "mono"   :
+           render_mode == FT_RENDER_MODE_LCD    ? "lcd"    :
+           render_mode == FT_RENDER_MODE_LCD_V  ? "lcd-v"  :
+           render_mode == FT_RENDER_MODE_SDF    ? "sdf"    : "";
   }
 
 
-  static int
-  test_get_char_index( btimer_t*  timer,
-                       FT_Face    face,
-                       void*      user_data )
+  static const char*
+  get_hinting_engine( FT_Face  face )
   {
-    bcharset_t*  charset = (bcharset_t*)user_data;
-    int          i, done = 0;
-
-
-    TIMER_START( timer );
-
-    for ( i = 0; i < charset->size; i++ )
-    {
-      if ( FT_Get_Char_Index(face, charset->code[i]) )
-        done++;
-    }
+    const FT_String*  module_name = FT_FACE_DRIVER_NAME( face );
+    const FT_String*  hinting_engine = "";
+    FT_UInt           prop;
 
-    TIMER_STOP( timer );
 
-    return done;
-  }
+    if ( !FT_IS_SCALABLE( face ) )
+      hinting_engine = "bitmap";
 
+    else if ( load_flags & FT_LOAD_NO_SCALE )
+      hinting_engine = "unscaled";
 
-  static int
-  test_cmap_cache( btimer_t*  timer,
-                   FT_Face    face,
-                   void*      user_data )
-  {
-    bcharset_t*  charset = (bcharset_t*)user_data;
-    int          i, done = 0;
+    else if ( load_flags & FT_LOAD_NO_HINTING )
+      hinting_engine = "unhinted";
 
-    FT_UNUSED( face );
+    else if ( render_mode == FT_RENDER_MODE_LIGHT )
+      hinting_engine = "auto";
 
+    else if ( load_flags == FT_LOAD_FORCE_AUTOHINT )
+      hinting_engine = "auto";
 
-    if ( !cmap_cache )
+    else if ( !FT_Property_Get( face->glyph->library, module_name,
+                                     "interpreter-version", &prop ) )
     {
-      if ( FTC_CMapCache_New( cache_man, &cmap_cache ) )
-        return 0;
-    }
+      switch ( prop )
+      {
+      case TT_INTERPRETER_VERSION_35:
+        hinting_engine = "v35";
+        break;
+      case TT_INTERPRETER_VERSION_40:
+        hinting_engine = "v40";
+        break;
+      }
+    }
+
+    else if ( !FT_Property_Get( face->glyph->library, module_name,
+                                     "hinting-engine", &prop ) )
+    {
+      switch ( prop )
+      {
+      case FT_HINTING_FREETYPE:
+        hinting_engine = "FT";
+        break;
+      case FT_HINTING_ADOBE:
+        hinting_engine = "Adobe";
+        break;
+      }
+    }
+
+    return hinting_engine;
+  }
+
+
+  /*
+   * Statistics over the timed batches of a test
+   */
+
+  typedef struct  bresult_t_ {
+    const char*  title;
+    int          done;        /* number of error-free operations      */
+    double       total;       /* accumulated time, in microseconds    */
+
+    int          iterations;  /* number of timed batches              */
+    int          max_samples;
+    double*      samples;     /* time per operation of each batch     */
+
+    double       min;
+    double       median;
+    double       p95;
+    double       p99;
+    double       mean;        /* of the batches, not `total / done'   */
+    double       stddev;
+    double       ci95;        /* half width of 95% confidence interval */
+
+    int          has_perf;
+    double       perf[N_PERF];  /* counts for all timed batches, or -1 */
+
+    int          has_memory;
+    double       mem_allocs;    /* during all timed batches           */
+    double       mem_bytes;
+    size_t       mem_peak;      /* live bytes, maximum and at the end */
+    size_t       mem_live;
+
+  } bresult_t;
+
+
+  static void
+  add_sample( bresult_t*  result,
+              double      us_op )
+  {
+    if ( result->iterations == result->max_samples )
+    {
+      int      new_max = result->max_samples ? 2 * result->max_samples
+                                             : 256;
+      double*  new_samples;
+
+
+      new_samples = (double*)realloc( result->samples,
+                                      (size_t)new_max * sizeof ( double ) );
+      if ( !new_samples )
+        return;
+
+      result->samples     = new_samples;
+      result->max_samples = new_max;
+    }
+
+    result->samples[result->iterations++] = us_op;
+  }
+
+
+  static int
+  compare_doubles( const void*  a,
+                   const void*  b )
+  {
+    double  x = *(const double*)a;
+    double  y = *(const double*)b;
+
+
+    return x < y ? -1 : x > y ? 1 : 0;
+  }
+
+
+  /* linear interpolation between the closest ranks of sorted samples */
+  static double
+  percentile( const double*  sorted,
+              int            n,
+              double         p )
+  {
+    double  rank = p * ( n - 1 );
+    int     lo   = (int)rank;
+
+
+    if ( lo + 1 >= n )
+      return sorted[n - 1];
+
+    return sorted[lo] + ( rank - lo ) * ( sorted[lo + 1] - sorted[lo] );
+  }
+
+
+  static void
+  compute_stats( bresult_t*  result )
+  {
+    double*  s = result->samples;
+    int      n = result->iterations;
+    double   sum, var;
+    int      i;
+
+
+    if ( !n || !s )
+      return;
+
+    qsort( s, (size_t)n, sizeof ( double ), compare_doubles );
+
+    for ( sum = 0, i = 0; i < n; i++ )
+      sum += s[i];
+    result->mean = sum / n;
+
+    for ( var = 0, i = 0; i < n; i++ )
+      var += ( s[i] - result->mean ) * ( s[i] - result->mean );
+    result->stddev = n > 1 ? sqrt( var / ( n - 1 ) ) : 0;
+    result->ci95   = 1.96 * result->stddev / sqrt( (double)n );
+
+    result->min    = s[0];
+    result->median = percentile( s, n, 0.50 );
+    result->p95    = percentile( s, n, 0.95 );
+    result->p99    = percentile( s, n, 0.99 );
+  }
+
+
+  /*
+   * Machine-readable output (option `-o')
+   */
+
+  enum {
+    OUTPUT_CSV,
+    OUTPUT_JSON
+  };
+
+  static FILE*  output;
+  static int    output_format = OUTPUT_CSV;
+  static int    warmup_iter;
+
+
+  static void
+  output_string( FILE*        output,
+                 const char*  str )
+  {
+    const char*  p;
+
+
+    if ( output_format == OUTPUT_JSON )
+    {
+      fputc( '"', output );
+      for ( p = str; *p; p++ )
+      {
+        if ( *p == '"' || *p == '\\' )
+          fprintf( output, "\\%c", *p );
+        else if ( (unsigned char)*p < 0x20 )
+          fprintf( output, "\\u%04x", (unsigned char)*p );
+        else
+          fputc( *p, output );
+      }
+      fputc( '"', output );
+    }
+    else
+    {
+      if ( !strpbrk( str, ",\"\n" ) )
+      {
+        fputs( str, output );
+        return;
+      }
+
+      fputc( '"', output );
+      for ( p = str; *p; p++ )
+      {
+        if ( *p == '"' )
+          fputc( '"', output );
+        fputc( *p, output );
+      }
+      fputc( '"', output );
+    }
+  }
+
+
+  /* counts per operation; empty CSV fields if not available */
+  static void
+  output_counters( FILE*       output,
+                   bresult_t*  result )
+  {
+    double*  v   = result->perf;
+    double   ipc = -1;
+    int      i;
+
+
+    if ( !use_perf )
+      return;
+
+    if ( result->has_perf                                &&
+         v[PERF_CYCLES] > 0 && v[PERF_INSTRUCTIONS] >= 0 )
+      ipc = v[PERF_INSTRUCTIONS] / v[PERF_CYCLES];
+
+    for ( i = 0; i <= N_PERF; i++ )
+    {
+      const char*  name  = i < N_PERF ? perf_names[i] : "ipc";
+      double       value = i < N_PERF ? v[i] / result->done : ipc;
+
+
+      if ( !result->has_perf || value < 0 )
+      {
+        if ( output_format != OUTPUT_JSON )
+          fputc( ',', output );
+      }
+      else if ( output_format == OUTPUT_JSON )
+        fprintf( output, ", \"%s\": %.4f", name, value );
+      else
+        fprintf( output, ",%.4f", value );
+    }
+  }
+
+
+  /* memory statistics; CSV repeats those of the face in each line */
+  static void
+  output_memory( bcontext_t*  ctx,
+                 bresult_t*   result )
+  {
+    FILE*  output = ctx->output;
+
+
+    if ( !track_memory )
+      return;
+
+    if ( output_format == OUTPUT_JSON )
+    {
+      if ( result->has_memory )
+        fprintf( output,
+                 ", \"allocs_op\": %.4f, \"bytes_op\": %.4f,"
+                 " \"peak_bytes\": %lu, \"live_bytes\": %lu",
+                 result->mem_allocs / result->done,
+                 result->mem_bytes / result->done,
+                 (unsigned long)result->mem_peak,
+                 (unsigned long)result->mem_live );
+    }
+    else if ( result->has_memory )
+      fprintf( output, ",%lu,%lu,%.4f,%.4f,%lu,%lu",
+               (unsigned long)ctx->face_bytes,
+               ctx->face_blocks,
+               result->mem_allocs / result->done,
+               result->mem_bytes / result->done,
+               (unsigned long)result->mem_peak,
+               (unsigned long)result->mem_live );
+    else
+      fprintf( output, ",,,,,," );
+  }
+
+
+  static void
+  output_begin( int     max_iter,
+                double  max_time )
+  {
+    if ( output_format == OUTPUT_JSON )
+    {
+      FT_Int  major, minor, patch;
+
+
+      FT_Library_Version( main_ctx.lib, &major, &minor, &patch );
+
+      fprintf( output,
+               "{\n"
+               "  \"freetype\": \"%d.%d.%d\",\n"
+               "  \"warmup\": %d,\n"
+               "  \"max_iterations\": %d,\n"
+               "  \"max_time\": %g,\n"
+               "  \"threads\": %d,\n"
+               "  \"workers\": %d,\n"
+               "  \"fonts\": [\n",
+               major, minor, patch,
+               warmup_iter, max_iter, max_time, num_threads, num_workers );
+    }
+    else
+    {
+      int  i;
+
+
+      fprintf( output,
+               "font,face_index,family,style,driver,hinting_engine,"
+               "target,load_flags,size,first_index,last_index,"
+               "test,warmup,iterations,done,us_op,"
+               "min,median,p95,p99,mean,stddev,ci95" );
+      if ( use_perf )
+      {
+        for ( i = 0; i < N_PERF; i++ )
+          fprintf( output, ",%s", perf_names[i] );
+        fprintf( output, ",ipc" );
+      }
+      if ( track_memory )
+        fprintf( output, ",face_bytes,face_blocks,"
+                         "allocs_op,bytes_op,peak_bytes,live_bytes" );
+      fputc( '\n', output );
+    }
+  }
+
+
+  static void
+  output_end( void )
+  {
+    if ( output_format == OUTPUT_JSON )
+      fprintf( output,
+               "\n"
+               "  ]\n"
+               "}\n" );
+  }
+
+
+  /* CSV repeats the font data in each line, JSON nests the tests */
+  static void
+  output_font_begin( bcontext_t*  ctx )
+  {
+    FILE*    output = ctx->output;
+    FT_Face  face   = ctx->face;
+
+
+    ctx->output_count = 0;
+
+    if ( !output || output_format != OUTPUT_JSON )
+      return;
+
+    fprintf( output, "%s    {\n      \"font\": ",
+             ctx->output_fonts++ ? ",\n" : "" );
+    output_string( output, ctx->filename );
+    fprintf( output, ",\n      \"face_index\": %ld,\n      \"family\": ",
+             face->face_index );
+    output_string( output, face->family_name ? face->family_name : "" );
+    fprintf( output, ",\n      \"style\": " );
+    output_string( output, face->style_name ? face->style_name : "" );
+    fprintf( output, ",\n      \"driver\": " );
+    output_string( output, FT_FACE_DRIVER_NAME( face ) );
+    fprintf( output, ",\n      \"hinting_engine\": " );
+    output_string( output, get_hinting_engine( face ) );
+    fprintf( output,
+             ",\n"
+             "      \"target\": \"%s\",\n"
+             "      \"load_flags\": \"0x%X\",\n"
+             "      \"size\": %u,\n"
+             "      \"first_index\": %d,\n"
+             "      \"last_index\": %d,\n",
+             get_target_name(),
+             load_flags,
+             ctx->size,
+             ctx->first_index,
+             ctx->last_index );
+
+    if ( ctx->memory )
+      fprintf( output,
+               "      \"face_bytes\": %lu,\n"
+               "      \"face_blocks\": %lu,\n",
+               (unsigned long)ctx->face_bytes, ctx->face_blocks );
+
+    fprintf( output, "      \"tests\": [" );
+  }
+
+
+  static void
+  output_font_end( bcontext_t*  ctx )
+  {
+    if ( ctx->output && output_format == OUTPUT_JSON )
+      fprintf( ctx->output, "%s]\n    }",
+               ctx->output_count ? "\n      " : "" );
+  }
+
+
+  static void
+  output_result( bcontext_t*  ctx,
+                 bresult_t*   result )
+  {
+    FILE*    output = ctx->output;
+    FT_Face  face   = ctx->face;
+
+
+    if ( !output )
+      return;
+
+    /* one test per line in both formats, to simplify reading it back */
+    if ( output_format == OUTPUT_JSON )
+    {
+      fprintf( output, "%s\n        { \"test\": ",
+               ctx->output_count ? "," : "" );
+      output_string( output, result->title );
+      fprintf( output,
+               ", \"warmup\": %d, \"iterations\": %d, \"done\": %d,"
+               " \"us_op\": %.4f,"
+               " \"min\": %.4f, \"median\": %.4f,"
+               " \"p95\": %.4f, \"p99\": %.4f,"
+               " \"mean\": %.4f, \"stddev\": %.4f, \"ci95\": %.4f",
+               warmup_iter, result->iterations, result->done,
+               result->total / result->done,
+               result->min, result->median,
+               result->p95, result->p99,
+               result->mean, result->stddev, result->ci95 );
+      output_counters( output, result );
+      output_memory( ctx, result );
+      fprintf( output, " }" );
+    }
+    else
+    {
+      output_string( output, ctx->filename );
+      fprintf( output, ",%ld,", face->face_index );
+      output_string( output, face->family_name ? face->family_name : "" );
+      fputc( ',', output );
+      output_string( output, face->style_name ? face->style_name : "" );
+      fprintf( output, ",%s,%s,%s,0x%X,%u,%d,%d,",
+               FT_FACE_DRIVER_NAME( face ),
+               get_hinting_engine( face ),
+               get_target_name(),
+               load_flags,
+               ctx->size,
+               ctx->first_index,
+               ctx->last_index );
+      output_string( output, result->title );
+      fprintf( output,
+               ",%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f",
+               warmup_iter, result->iterations, result->done,
+               result->total / result->done,
+               result->min, result->median,
+               result->p95, result->p99,
+               result->mean, result->stddev, result->ci95 );
+      output_counters( output, result );
+      output_memory( ctx, result );
+      fputc( '\n', output );
+    }
+
+    ctx->output_count++;
+  }
+
+
+  /*
+   * Comparison with a previous result file (option `-B')
+   */
+
+  typedef struct  bbaseline_t_ {
+    char*         font;        /* as given on the command line */
+    long          face_index;
+    unsigned int  size;
+    FT_Int32      load_flags;
+    char*         test;
+    double        us_op;
+    double        ci95;
+
+  } bbaseline_t;
+
+
+  static bbaseline_t*  baseline;
+  static int           num_baseline;
+  static double        regress_threshold = REGRESS_THRESHOLD;  /* in % */
+
+  static int  num_compared;
+  static int  num_faster;
+  static int  num_regressed;
+
+
+  static void
+  add_baseline( const char*   font,
+                long          face_index,
+                unsigned int  face_size,
+                FT_Int32      flags,
+                const char*   test,
+                double        us_op,
+                double        ci95 )
+  {
+    static int    max_baseline;
+    bbaseline_t*  b;
+
+
+    if ( num_baseline == max_baseline )
+    {
+      int           new_max = max_baseline ? 2 * max_baseline : 64;
+      bbaseline_t*  new_baseline;
+
+
+      new_baseline = (bbaseline_t*)realloc( baseline,
+                                            (size_t)new_max *
+                                              sizeof ( bbaseline_t ) );
+      if ( !new_baseline )
+        return;
+
+      baseline     = new_baseline;
+      max_baseline = new_max;
+    }
+
+    b = &baseline[num_baseline++];
+
+    b->font       = ft_strdup( font );
+    b->face_index = face_index;
+    b->size       = face_size;
+    b->load_flags = flags;
+    b->test       = ft_strdup( test );
+    b->us_op      = us_op;
+    b->ci95       = ci95;
+  }
+
+
+  /* extract the value of `"key": ...' from a line we have written */
+  static const char*
+  json_value( const char*  line,
+              const char*  key )
+  {
+    char         pattern[32];
+    const char*  p;
+
+
+    snprintf( pattern, sizeof ( pattern ), "\"%s\": ", key );
+
+    p = strstr( line, pattern );
+
+    return p ? p + strlen( pattern ) : NULL;
+  }
+
+
+  /* unquote a JSON string or a CSV field into `buf'; return its end */
+  static const char*
+  read_string( const char*  p,
+               char*        buf,
+               size_t       size,
+               int          json )
+  {
+    size_t  n = 0;
+
+
+    if ( *p != '"' )
+    {
+      /* unquoted CSV field */
+      while ( *p && *p != ',' && *p != '\n' && *p != '\r' )
+      {
+        if ( n + 1 < size )
+          buf[n++] = *p;
+        p++;
+      }
+      buf[n] = '\0';
+
+      return p;
+    }
+
+    for ( p++; *p; p++ )
+    {
+      if ( json && *p == '\\' && p[1] )
+        p++;
+      else if ( *p == '"' )
+      {
+        if ( json || p[1] != '"' )
+        {
+          p++;
+          break;
+        }
+        p++;
+      }
+
+      if ( n + 1 < size )
+        buf[n++] = *p;
+    }
+    buf[n] = '\0';
+
+    return p;
+  }
+
+
+  static int
+  load_baseline( const char*  name )
+  {
+    FILE*  file;
+    char   line[4096];
+    char   font[1024];
+    char   field[1024];
+
+    long          face_index = 0;
+    unsigned int  face_size  = 0;
+    FT_Int32      flags      = 0;
+    int           json       = -1;
+
+    /* CSV column indices */
+    int  col_font = -1, col_face = -1, col_size = -1, col_flags = -1;
+    int  col_test = -1, col_us_op = -1, col_ci95 = -1;
+
+
+    file = fopen( name, "r" );
+    if ( !file )
+    {
+      fprintf( stderr, "couldn't open baseline file `%s'\n", name );
+
+      return 1;
+    }
+
+    font[0] = '\0';
+
+    while ( fgets( line, sizeof ( line ), file ) )
+    {
+      const char*  p;
+
+
+      if ( json < 0 )
+      {
+        for ( p = line; *p == ' ' || *p == '\t'; p++ )
+          ;
+        json = ( *p == '{' );
+
+        if ( !json )
+        {
+          int  col;
+
+
+          /* the header line of a CSV file */
+          for ( p = line, col = 0; *p && *p != '\n'; col++ )
+          {
+            p = read_string( p, field, sizeof ( field ), 0 );
+
+            if ( !strcmp( field, "font" ) )
+              col_font = col;
+            else if ( !strcmp( field, "face_index" ) )
+              col_face = col;
+            else if ( !strcmp( field, "size" ) )
+              col_size = col;
+            else if ( !strcmp( field, "load_flags" ) )
+              col_flags = col;
+            else if ( !strcmp( field, "test" ) )
+              col_test = col;
+            else if ( !strcmp( field, "us_op" ) )
+              col_us_op = col;
+            else if ( !strcmp( field, "ci95" ) )
+              col_ci95 = col;
+
+            if ( *p == ',' )
+              p++;
+          }
+
+          if ( col_font < 0 || col_test < 0 || col_us_op < 0 )
+            break;
+
+          continue;
+        }
+      }
+
+      if ( json )
+      {
+        double  us_op, ci95 = 0;
+
+
+        if ( ( p = json_value( line, "font" ) ) != NULL )
+          read_string( p, font, sizeof ( font ), 1 );
+        else if ( ( p = json_value( line, "face_index" ) ) != NULL )
+          face_index = strtol( p, NULL, 10 );
+        else if ( ( p = json_value( line, "size" ) ) != NULL )
+          face_size = (unsigned int)strtoul( p, NULL, 10 );
+        else if ( ( p = json_value( line, "load_flags" ) ) != NULL )
+          flags = (FT_Int32)strtol( p + 1, NULL, 16 );
+        else if ( ( p = json_value( line, "test" ) ) != NULL )
+        {
+          read_string( p, field, sizeof ( field ), 1 );
+
+          p = json_value( line, "us_op" );
+          if ( !p )
+            continue;
+          us_op = strtod( p, NULL );
+
+          p = json_value( line, "ci95" );
+          if ( p )
+            ci95 = strtod( p, NULL );
+
+          add_baseline( font, face_index, face_size, flags,
+                        field, us_op, ci95 );
+        }
+      }
+      else
+      {
+        char    test[1024];
+        double  us_op = 0, ci95 = 0;
+        int     col;
+
+
+        face_index = 0;
+        face_size  = 0;
+        flags      = 0;
+        test[0]    = '\0';
+
+        for ( p = line, col = 0; *p && *p != '\n'; col++ )
+        {
+          p = read_string( p, field, sizeof ( field ), 0 );
+
+          if ( col == col_font )
+            strcpy( font, field );
+          else if ( col == col_face )
+            face_index = strtol( field, NULL, 10 );
+          else if ( col == col_size )
+            face_size = (unsigned int)strtoul( field, NULL, 10 );
+          else if ( col == col_flags )
+            flags = (FT_Int32)strtol( field, NULL, 16 );
+          else if ( col == col_test )
+            strcpy( test, field );
+          else if ( col == col_us_op )
+            us_op = strtod( field, NULL );
+          else if ( col == col_ci95 )
+            ci95 = strtod( field, NULL );
+
+          if ( *p == ',' )
+            p++;
+        }
+
+        if ( test[0] )
+          add_baseline( font, face_index, face_size, flags,
+                        test, us_op, ci95 );
+      }
+    }
+
+    fclose( file );
+
+    if ( !num_baseline )
+    {
+      fprintf( stderr, "no results found in baseline file `%s'\n", name );
+
+      return 1;
+    }
+
+    return 0;
+  }
+
+
+  static void
+  compare_result( bcontext_t*  ctx,
+                  bresult_t*   result )
+  {
+    FT_Face       face = ctx->face;
+    const char*   base = ft_basename( ctx->filename );
+    bbaseline_t*  b    = NULL;
+    bbaseline_t*  same = NULL;   /* only the base name matches */
+    int           ambiguous = 0;
+    double        us_op, delta, noise;
+    int           i;
+
+
+    if ( !baseline )
+      return;
+
+    /* Prefer the same path; otherwise accept a file with the same base */
+    /* name (e.g., from a different directory) if there is only one.    */
+    for ( i = 0; i < num_baseline; i++ )
+    {
+      if ( baseline[i].face_index != face->face_index ||
+           baseline[i].size       != ctx->size        ||
+           baseline[i].load_flags != load_flags       ||
+           strcmp( baseline[i].test, result->title )  )
+        continue;
+
+      if ( !strcmp( baseline[i].font, ctx->filename ) )
+      {
+        b = &baseline[i];
+        break;
+      }
+
+      if ( !strcmp( ft_basename( baseline[i].font ), base ) )
+      {
+        if ( same && strcmp( same->font, baseline[i].font ) )
+          ambiguous = 1;
+        same = &baseline[i];
+      }
+    }
+
+    if ( !b )
+    {
+      if ( ambiguous )
+      {
+        fprintf( ctx->out, "    %-23s ambiguous (several files `%s')\n",
+                 "baseline", base );
+        return;
+      }
+
+      b = same;
+    }
+
+    if ( !b || b->us_op <= 0 )
+    {
+      fprintf( ctx->out, "    %-23s not found\n", "baseline" );
+      return;
+    }
+
+    us_op = result->total / result->done;
+    delta = 100.0 * ( us_op - b->us_op ) / b->us_op;
+
+    /* the difference is significant if it exceeds */
+    /* the combined 95% confidence intervals       */
+    noise = sqrt( b->ci95 * b->ci95 + result->ci95 * result->ci95 );
+
+    fprintf( ctx->out, "    %-23s %10.3f us/op %+9.1f%%",
+             "baseline", b->us_op, delta );
+
+    LOCK( lock );
+
+    num_compared++;
+
+    if ( fabs( us_op - b->us_op ) <= noise )
+      fprintf( ctx->out, "  (not significant)\n" );
+    else if ( delta > regress_threshold )
+    {
+      fprintf( ctx->out, "  REGRESSION\n" );
+      num_regressed++;
+    }
+    else
+    {
+      fprintf( ctx->out, "  (significant)\n" );
+      if ( delta < 0 )
+        num_faster++;
+    }
+
+    UNLOCK( lock );
+  }
+
+
+  /*
+   * Summary over many fonts (corpus mode)
+   */
+
+  typedef struct  brecord_t_ {
+    char*        font;
+    long         face_index;
+    char*        format;       /* font format, plus `variable' if MM */
+    char*        driver;
+    const char*  test;
+    double       us_op;
+
+  } brecord_t;
+
+
+  static int         corpus;         /* set if more than one face is run */
+  static int         num_slowest = NUM_SLOWEST;
+  static brecord_t*  records;
+  static int         num_records;
+  static int         max_records;
+
+
+  static void
+  record_result( bcontext_t*  ctx,
+                 bresult_t*   result )
+  {
+    FT_Face     face = ctx->face;
+    brecord_t*  r;
+    char        format[64];
+
+
+    if ( !corpus )
+      return;
+
+    snprintf( format, sizeof ( format ), "%s%s",
+              FT_Get_Font_Format( face ),
+              FT_HAS_MULTIPLE_MASTERS( face ) ? " (variable)" : "" );
+
+    LOCK( lock );
+
+    if ( num_records == max_records )
+    {
+      int         new_max = max_records ? 2 * max_records : 1024;
+      brecord_t*  new_records;
+
+
+      new_records = (brecord_t*)realloc( records,
+                                         (size_t)new_max *
+                                           sizeof ( brecord_t ) );
+      if ( !new_records )
+        goto Exit;
+
+      records     = new_records;
+      max_records = new_max;
+    }
+
+    r = &records[num_records++];
+
+    r->font       = ft_strdup( ctx->filename );
+    r->face_index = face->face_index;
+    r->format     = ft_strdup( format );
+    r->driver     = ft_strdup( FT_FACE_DRIVER_NAME( face ) );
+    r->test       = result->title;
+    r->us_op      = result->total / result->done;
+
+  Exit:
+    UNLOCK( lock );
+  }
+
+
+  /* sort by test, then format, then decreasing time */
+  static int
+  compare_records( const void*  a,
+                   const void*  b )
+  {
+    const brecord_t*  x = (const brecord_t*)a;
+    const brecord_t*  y = (const brecord_t*)b;
+    int               d;
+
+
+    d = strcmp( x->test, y->test );
+    if ( !d )
+      d = strcmp( x->format, y->format );
+    if ( !d )
+      d = x->us_op < y->us_op ? 1 : x->us_op > y->us_op ? -1 : 0;
+
+    return d;
+  }
+
+
+  static int
+  compare_records_by_time( const void*  a,
+                           const void*  b )
+  {
+    const brecord_t*  x = (const brecord_t*)a;
+    const brecord_t*  y = (const brecord_t*)b;
+
+
+    return x->us_op < y->us_op ? 1 : x->us_op > y->us_op ? -1 : 0;
+  }
+
+
+  static void
+  print_summary( int  num_files,
+                 int  num_faces )
+  {
+    brecord_t*  slowest;
+    int         i, j, k;
+
+
+    if ( !num_records )
+      return;
+
+    slowest = (brecord_t*)malloc( (size_t)num_records *
+                                    sizeof ( brecord_t ) );
+    if ( !slowest )
+      return;
+
+    qsort( records, (size_t)num_records, sizeof ( brecord_t ),
+           compare_records );
+
+    i = printf( "\n"
+                "summary for %d faces in %d files\n",
+                num_faces, num_files ) - 2;
+    while ( i-- )
+      putchar( '-' );
+    putchar( '\n' );
+
+    for ( i = 0; i < num_records; i = j )
+    {
+      int  n = 0;
+
+
+      printf( "\n"
+              "%s\n"
+              "  %-20s %-10s %6s %11s %11s %11s\n",
+              records[i].test,
+              "format", "driver", "faces",
+              "mean us/op", "median", "max" );
+
+      /* one line per format */
+      for ( j = i; j < num_records                       &&
+                   !strcmp( records[j].test, records[i].test ); j = k )
+      {
+        double  sum = 0;
+
+
+        for ( k = j; k < num_records                            &&
+                     !strcmp( records[k].test, records[j].test ) &&
+                     !strcmp( records[k].format, records[j].format ); k++ )
+        {
+          sum           += records[k].us_op;
+          slowest[n++]   = records[k];
+        }
+
+        /* records are sorted by decreasing time within a format */
+        printf( "  %-20s %-10s %6d %11.3f %11.3f %11.3f\n",
+                records[j].format,
+                records[j].driver,
+                k - j,
+                sum / ( k - j ),
+                records[j + ( k - j ) / 2].us_op,
+                records[j].us_op );
+      }
+
+      qsort( slowest, (size_t)n, sizeof ( brecord_t ),
+             compare_records_by_time );
+
+      printf( "  slowest faces:\n" );
+      for ( k = 0; k < n && k < num_slowest; k++ )
+        printf( "    %12.3f us/op  %s (face %ld)\n",
+                slowest[k].us_op, slowest[k].font, slowest[k].face_index );
+    }
+
+    free( slowest );
+  }
+
+
+  /*
+   * Bench code
+   */
+
+  /* run the untimed warm-up iterations of `test' */
+  static void
+  warm_up( bcontext_t*  ctx,
+           btest_t*     test )
+  {
+    btimer_t  timer;
+    int       n;
+
+
+    TIMER_RESET( &timer );
+    for ( n = 0; n < warmup_iter; n++ )
+      test->bench( &timer, ctx, test->user_data );
+  }
+
+
+  /* if `result' is set, collect the time per operation of each batch */
+  static int
+  run_test( bcontext_t*  ctx,
+            btest_t*     test,
+            int          max_iter,
+            double       max_time,
+            btimer_t*    timer,
+            bresult_t*   result )
+  {
+    int       n, done;
+    btimer_t  elapsed;
+
+    bmemory_t*     memory = result ? ctx->memory : NULL;
+    unsigned long  allocs = 0;
+    double         bytes  = 0;
+
+#ifdef FTBENCH_PERF
+    bperf_t  perf;
+    int      has_perf = 0;
+#endif
+
+
+    TIMER_RESET( timer );
+    TIMER_RESET( &elapsed );
+
+    if ( memory )
+    {
+      memory->peak = memory->current;
+      allocs       = memory->allocs;
+      bytes        = memory->total;
+    }
+
+#ifdef FTBENCH_PERF
+    /* unlike the timer, the counters include the loop overhead of tests */
+    if ( result && use_perf && !perf_open( &perf ) )
+    {
+      has_perf = 1;
+      perf_start( &perf );
+    }
+#endif
+
+    for ( n = 0, done = 0; !max_iter || n < max_iter; n++ )
+    {
+      double  t     = TIMER_GET( timer );
+      int     batch;
+
+
+      TIMER_START( &elapsed );
+
+      batch = test->bench( timer, ctx, test->user_data );
+
+      TIMER_STOP( &elapsed );
+
+      if ( result && batch )
+        add_sample( result, ( TIMER_GET( timer ) - t ) / batch );
+      done += batch;
+
+      if ( TIMER_GET( &elapsed ) > 1E6 * max_time )
+        break;
+    }
+
+#ifdef FTBENCH_PERF
+    if ( has_perf )
+    {
+      perf_stop( &perf, result->perf );
+      perf_close( &perf );
+      result->has_perf = 1;
+    }
+#endif
+
+    if ( memory )
+    {
+      result->has_memory = 1;
+      result->mem_allocs = (double)( memory->allocs - allocs );
+      result->mem_bytes  = memory->total - bytes;
+      result->mem_peak   = memory->peak;
+      result->mem_live   = memory->current;
+    }
+
+    return done;
+  }
+
+
+#ifdef FTDEMO_THREADS
+
+  typedef struct  bthread_t_ {
+    bcontext_t*  ctx;
+    btest_t*     test;
+    int          max_iter;
+    double       max_time;
+
+    btimer_t     timer;
+    int          done;
+
+    thandle_t    handle;
+
+  } bthread_t;
+
+
+  static tthread_ret_t TTHREAD_CALL
+  thread_main( void*  arg )
+  {
+    bthread_t*  thread = (bthread_t*)arg;
+
+
+    thread->done = run_test( thread->ctx,
+                             thread->test,
+                             thread->max_iter,
+                             thread->max_time,
+                             &thread->timer,
+                             NULL );
+
+    return 0;
+  }
+
+
+  /*
+   * Run `test' simultaneously on `num_threads' threads, each with its own
+   * library, face, and cache manager, and compare the throughput with
+   * `single_rate' (ops/s of the single-threaded run).
+   */
+
+  static void
+  benchmark_threads( bcontext_t*  ctx,
+                     btest_t*     test,
+                     int          max_iter,
+                     double       max_time,
+                     double       single_rate )
+  {
+    bthread_t*  threads;
+    btimer_t    timer;
+    double      t0, wall, rate, us_op;
+    int         i, done, started;
+    char        title[32];
+
+
+    threads = (bthread_t*)calloc( (size_t)num_threads, sizeof ( bthread_t ) );
+    if ( !threads )
+      return;
+
+    for ( i = 0; i < num_threads; i++ )
+    {
+      threads[i].ctx      = &thread_ctx[i];
+      threads[i].test     = test;
+      threads[i].max_iter = max_iter;
+      threads[i].max_time = max_time;
+
+      /* fill the caches outside of the measurement */
+      if ( test->cache_first )
+      {
+        TIMER_RESET( &timer );
+        test->bench( &timer, threads[i].ctx, test->user_data );
+      }
+
+      /* warm up before the wall clock starts, too */
+      warm_up( threads[i].ctx, test );
+    }
+
+    t0 = get_wall_time();
+
+    for ( started = 0; started < num_threads; started++ )
+      if ( start_thread( &threads[started].handle,
+                         thread_main,
+                         &threads[started] ) )
+        break;
+
+    for ( i = 0; i < started; i++ )
+      join_thread( threads[i].handle );
+
+    wall = get_wall_time() - t0;
+
+    if ( started < num_threads )
+    {
+      fprintf( ctx->out,
+               "    couldn't start more than %d threads\n", started );
+      goto Exit;
+    }
+
+    done  = 0;
+    us_op = 0;
+    for ( i = 0; i < num_threads; i++ )
+    {
+      done += threads[i].done;
+      if ( threads[i].done )
+        us_op += TIMER_GET( &threads[i].timer ) / (double)threads[i].done;
+    }
+
+    if ( !done || wall <= 0 )
+    {
+      fprintf( ctx->out, "    %-23s no error-free calls\n", "threads" );
+      goto Exit;
+    }
+
+    rate = 1E6 * (double)done / wall;
+
+    snprintf( title, sizeof ( title ), "%d threads", num_threads );
+
+    fprintf( ctx->out, "    %-23s %10.3f us/op %10d done\n",
+             title, us_op / num_threads, done );
+    fprintf( ctx->out, "      %.0f ops/s aggregate, %.2fx speedup,"
+             " %.1f%% scaling efficiency\n",
+             rate,
+             rate / single_rate,
+             100.0 * rate / ( single_rate * num_threads ) );
+
+    fprintf( ctx->out, "      per-thread us/op:" );
+    for ( i = 0; i < num_threads; i++ )
+    {
+      if ( i && !( i % 8 ) )
+        fprintf( ctx->out, "\n                       " );
+
+      if ( threads[i].done )
+        fprintf( ctx->out, " %8.3f",
+                 TIMER_GET( &threads[i].timer ) / (double)threads[i].done );
+      else
+        fprintf( ctx->out, " %8s", "-" );
+    }
+    fprintf( ctx->out, "\n" );
+
+  Exit:
+    free( threads );
+  }
+
+#endif /* FTDEMO_THREADS */
+
+
+  static void
+  print_counters( bcontext_t*  ctx,
+                  bresult_t*   result )
+  {
+    double*  v = result->perf;
+    double   n = result->done;
+
+
+    fprintf( ctx->out, "    %-23s", "counters" );
+    if ( v[PERF_CYCLES] >= 0 )
+      fprintf( ctx->out, " %10.1f cycles/op", v[PERF_CYCLES] / n );
+    if ( v[PERF_INSTRUCTIONS] >= 0 )
+      fprintf( ctx->out, ", %.1f instr/op", v[PERF_INSTRUCTIONS] / n );
+    if ( v[PERF_CYCLES] > 0 && v[PERF_INSTRUCTIONS] >= 0 )
+      fprintf( ctx->out, ", IPC %.2f",
+               v[PERF_INSTRUCTIONS] / v[PERF_CYCLES] );
+    fputc( '\n', ctx->out );
+
+    fprintf( ctx->out, "    %-23s", "misses per op" );
+    if ( v[PERF_L1D_MISSES] >= 0 )
+      fprintf( ctx->out, " %.2f L1D", v[PERF_L1D_MISSES] / n );
+    if ( v[PERF_LLC_MISSES] >= 0 )
+      fprintf( ctx->out, " %.2f LLC", v[PERF_LLC_MISSES] / n );
+    if ( v[PERF_BRANCH_MISSES] >= 0 )
+      fprintf( ctx->out, " %.2f branch", v[PERF_BRANCH_MISSES] / n );
+    fputc( '\n', ctx->out );
+  }
+
+
+  static void
+  benchmark( bcontext_t*  ctx,
+             btest_t*     test,
+             int          max_iter,
+             double       max_time )
+  {
+    int        done;
+    btimer_t   timer;
+    double     t0, wall;
+    bresult_t  result;
+
+
+    if ( test->cache_first )
+    {
+      if ( !ctx->cache_man )
+      {
+        fprintf( ctx->out, "  %-25s no cache manager\n", test->title );
+
+        return;
+      }
+
+      TIMER_RESET( &timer );
+      test->bench( &timer, ctx, test->user_data );
+    }
+
+    fprintf( ctx->out, "  %-25s ", test->title );
+    fflush( ctx->out );
+
+    memset( &result, 0, sizeof ( result ) );
+
+    /* the wall time is the baseline for `-j'; it must not include this */
+    warm_up( ctx, test );
+
+    t0   = get_wall_time();
+    done = run_test( ctx, test, max_iter, max_time, &timer, &result );
+    wall = get_wall_time() - t0;
+
+    if ( done )
+    {
+      fprintf( ctx->out, "%10.3f us/op %10d done\n",
+               TIMER_GET( &timer ) / (double)done, done );
+
+      result.title = test->title;
+      result.done  = done;
+      result.total = TIMER_GET( &timer );
+      compute_stats( &result );
+
+      if ( test->lines && result.iterations )
+        fprintf( ctx->out, "    %-23s %10.0f glyphs/s %9.0f lines/s\n",
+                 "throughput",
+                 1E6 * (double)done / result.total,
+                 1E6 * (double)test->lines * result.iterations /
+                   result.total );
+
+      if ( result.has_perf )
+        print_counters( ctx, &result );
+
+      if ( result.has_memory )
+        fprintf( ctx->out,
+                 "    %-23s %10.2f allocs/op %9.0f bytes/op\n"
+                 "    %-23s %10lu bytes peak %7lu bytes live\n",
+                 "memory",
+                 result.mem_allocs / done,
+                 result.mem_bytes / done,
+                 "",
+                 (unsigned long)result.mem_peak,
+                 (unsigned long)result.mem_live );
+
+      output_result( ctx, &result );
+      compare_result( ctx, &result );
+      record_result( ctx, &result );
+    }
+    else
+      fprintf( ctx->out, "no error-free calls\n" );
+
+    free( result.samples );
+
+#ifdef FTDEMO_THREADS
+    if ( num_threads > 1 && done && wall > 0 )
+    {
+      fflush( ctx->out );
+      benchmark_threads( ctx, test, max_iter, max_time,
+                         1E6 * (double)done / wall );
+    }
+#else
+    FT_UNUSED( wall );
+#endif
+  }
+
+
+  /*
+   * Various tests
+   */
+
+  static int
+  test_load( btimer_t*    timer,
+             bcontext_t*  ctx,
+             void*        user_data )
+  {
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    TIMER_START( timer );
+
+    FOREACH( i )
+    {
+      if ( !FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        done++;
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  static int
+  test_load_advances( btimer_t*    timer,
+                      bcontext_t*  ctx,
+                      void*        user_data )
+  {
+    int        done = 0;
+    FT_Fixed*  advances;
+    FT_ULong   flags = *((FT_ULong*)user_data);
+    FT_Int     start, count;
+
+
+    if ( ctx->incr_index > 0 )
+    {
+      start = ctx->first_index;
+      count = ctx->last_index - ctx->first_index + 1;
+    }
+    else
+    {
+      start = ctx->last_index;
+      count = ctx->first_index - ctx->last_index + 1;
+    }
+
+    advances = (FT_Fixed *)calloc( sizeof ( FT_Fixed ), (size_t)count );
+
+    TIMER_START( timer );
+
+    FT_Get_Advances( ctx->face,
+                     (FT_UInt)start, (FT_UInt)count,
+                     (FT_Int32)flags, advances );
+    done += (int)count;
+
+    TIMER_STOP( timer );
+
+    free( advances );
+
+    return done;
+  }
+
+
+  static int
+  test_render( btimer_t*    timer,
+               bcontext_t*  ctx,
+               void*        user_data )
+  {
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    FOREACH( i )
+    {
+      if ( FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        continue;
+
+      TIMER_START( timer );
+      if ( !FT_Render_Glyph( ctx->face->glyph, render_mode ) )
+        done++;
+      TIMER_STOP( timer );
+    }
+
+    return done;
+  }
+
+
+  static int
+  test_embolden( btimer_t*    timer,
+                 bcontext_t*  ctx,
+                 void*        user_data )
+  {
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    FOREACH( i )
+    {
+      if ( FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        continue;
+
+      TIMER_START( timer );
+      FT_GlyphSlot_Embolden( ctx->face->glyph );
+      done++;
+      TIMER_STOP( timer );
+    }
+
+    return done;
+  }
+
+
+  static int
+  test_stroke( btimer_t*    timer,
+               bcontext_t*  ctx,
+               void*        user_data )
+  {
+    FT_Glyph    glyph;
+    FT_Stroker  stroker;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    FT_Stroker_New( ctx->lib, &stroker );
+    FT_Stroker_Set( stroker, ctx->face->size->metrics.y_ppem,
+                    FT_STROKER_LINECAP_ROUND,
+                    FT_STROKER_LINEJOIN_ROUND,
+                    0 );
+
+    FOREACH( i )
+    {
+      if ( FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        continue;
+
+      if ( FT_Get_Glyph( ctx->face->glyph, &glyph ) )
+        continue;
+
+      TIMER_START( timer );
+      FT_Glyph_Stroke( &glyph, stroker, 1 );
+      TIMER_STOP( timer );
+
+      FT_Done_Glyph( glyph );
+      done++;
+    }
+
+    FT_Stroker_Done( stroker );
+
+    return done;
+  }
+
+
+  static int
+  test_get_glyph( btimer_t*    timer,
+                  bcontext_t*  ctx,
+                  void*        user_data )
+  {
+    FT_Glyph  glyph;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    FOREACH( i )
+    {
+      if ( FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        continue;
+
+      TIMER_START( timer );
+      if ( !FT_Get_Glyph( ctx->face->glyph, &glyph ) )
+      {
+        FT_Done_Glyph( glyph );
+        done++;
+      }
+      TIMER_STOP( timer );
+    }
+
+    return done;
+  }
+
+
+  static int
+  test_get_cbox( btimer_t*    timer,
+                 bcontext_t*  ctx,
+                 void*        user_data )
+  {
+    FT_Glyph  glyph;
+    FT_BBox   bbox;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    FOREACH( i )
+    {
+      if ( FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        continue;
+
+      if ( FT_Get_Glyph( ctx->face->glyph, &glyph ) )
+        continue;
+
+      TIMER_START( timer );
+      FT_Glyph_Get_CBox( glyph, FT_GLYPH_BBOX_PIXELS, &bbox );
+      TIMER_STOP( timer );
+
+      FT_Done_Glyph( glyph );
+      done++;
+    }
+
+    return done;
+  }
+
+
+  static int
+  test_get_bbox( btimer_t*    timer,
+                 bcontext_t*  ctx,
+                 void*        user_data )
+  {
+    FT_BBox    bbox;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    FOREACH( i )
+    {
+      if ( FT_Load_Glyph( ctx->face, (FT_UInt)i, load_flags ) )
+        continue;
+
+      TIMER_START( timer );
+      FT_Outline_Get_BBox( &ctx->face->glyph->outline, &bbox );
+      TIMER_STOP( timer );
+
+      done++;
+    }
+
+    return done;
+  }
+
+
+  static int
+  test_get_char_index( btimer_t*    timer,
+                       bcontext_t*  ctx,
+                       void*        user_data )
+  {
+    bcharset_t*  charset = (bcharset_t*)user_data;
+    int          i, done = 0;
+
+
+    TIMER_START( timer );
+
+    for ( i = 0; i < charset->size; i++ )
+    {
+      if ( FT_Get_Char_Index( ctx->face, charset->code[i]) )
+        done++;
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  static int
+  test_cmap_cache( btimer_t*    timer,
+                   bcontext_t*  ctx,
+                   void*        user_data )
+  {
+    bcharset_t*  charset = (bcharset_t*)user_data;
+    int          i, done = 0;
+
+
+
+    if ( !ctx->cmap_cache )
+    {
+      if ( FTC_CMapCache_New( ctx->cache_man, &ctx->cmap_cache ) )
+        return 0;
+    }
+
+    TIMER_START( timer );
+
+    for ( i = 0; i < charset->size; i++ )
+    {
+      if ( FTC_CMapCache_Lookup( ctx->cmap_cache,
+                                 ctx->font_type.face_id,
+                                 cmap_index,
+                                 charset->code[i] ) )
+        done++;
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  static int
+  test_image_cache( btimer_t*    timer,
+                    bcontext_t*  ctx,
+                    void*        user_data )
+  {
+    FT_Glyph  glyph;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    if ( !ctx->image_cache )
+    {
+      if ( FTC_ImageCache_New( ctx->cache_man, &ctx->image_cache ) )
+        return 0;
+    }
+
+    TIMER_START( timer );
+
+    FOREACH( i )
+    {
+      if ( !FTC_ImageCache_Lookup( ctx->image_cache,
+                                   &ctx->font_type,
+                                   (FT_UInt)i,
+                                   &glyph,
+                                   NULL ) )
+        done++;
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  static int
+  test_sbit_cache( btimer_t*    timer,
+                   bcontext_t*  ctx,
+                   void*        user_data )
+  {
+    FTC_SBit  glyph;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    if ( !ctx->sbit_cache )
+    {
+      if ( FTC_SBitCache_New( ctx->cache_man, &ctx->sbit_cache ) )
+        return 0;
+    }
+
+    TIMER_START( timer );
+
+    FOREACH( i )
+    {
+      if ( !FTC_SBitCache_Lookup( ctx->sbit_cache,
+                                  &ctx->font_type,
+                                  (FT_UInt)i,
+                                  &glyph,
+                                  NULL ) )
+        done++;
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  static int
+  test_cmap_iter( btimer_t*    timer,
+                  bcontext_t*  ctx,
+                  void*        user_data )
+  {
+    FT_UInt   idx;
+    FT_ULong  charcode;
+    int       done;
+
+    FT_UNUSED( user_data );
+
+
+    TIMER_START( timer );
+
+    charcode = FT_Get_First_Char( ctx->face, &idx );
+    done = ( idx != 0 );
+
+    while ( idx != 0 )
+      charcode = FT_Get_Next_Char( ctx->face, charcode, &idx );
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  static int
+  test_new_face( btimer_t*    timer,
+                 bcontext_t*  ctx,
+                 void*        user_data )
+  {
+    FT_Face  bench_face;
+
+    FT_UNUSED( user_data );
+
+
+    TIMER_START( timer );
+
+    if ( !get_face( ctx, &bench_face ) )
+      FT_Done_Face( bench_face );
+
+    TIMER_STOP( timer );
+
+    return 1;
+  }
+
+
+  static int
+  test_new_face_and_load_glyph( btimer_t*    timer,
+                                bcontext_t*  ctx,
+                                void*        user_data )
+  {
+    FT_Face  bench_face;
+
+    int  i, done = 0;
+
+    FT_UNUSED( user_data );
+
+
+    TIMER_START( timer );
+
+    if ( !get_face( ctx, &bench_face ) )
+    {
+      FOREACH( i )
+      {
+        if ( !FT_Load_Glyph( bench_face, (FT_UInt)i, load_flags ) )
+          done++;
+      }
+
+      FT_Done_Face( bench_face );
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  /* map characters to glyphs, kern, load, and render them like a */
+  /* simple text layout engine would do, line by line             */
+  static int
+  test_text( btimer_t*    timer,
+             bcontext_t*  ctx,
+             void*        user_data )
+  {
+    btext_t*   corpus  = (btext_t*)user_data;
+    FT_Face    face    = ctx->face;
+    FT_Bool    kerning = FT_HAS_KERNING( face );
+    FT_Vector  delta;
+
+    int  i, done = 0;
+
+
+    TIMER_START( timer );
+
+    for ( i = 0; i < corpus->num_lines; i++ )
+    {
+      const char*  p    = corpus->line_start[i];
+      const char*  end  = corpus->line_end[i];
+      FT_UInt      prev = 0;
+      int          ch;
+
+
+      while ( ( ch = utf8_next( &p, end ) ) >= 0 )
+      {
+        FT_UInt  gindex = FT_Get_Char_Index( face, (FT_ULong)ch );
+
+
+        if ( kerning && prev && gindex )
+          FT_Get_Kerning( face, prev, gindex, FT_KERNING_DEFAULT, &delta );
+        prev = gindex;
+
+        if ( FT_Load_Glyph( face, gindex, load_flags ) )
+          continue;
+
+        if ( ctx->size && FT_Render_Glyph( face->glyph, render_mode ) )
+          continue;
+
+        done++;
+      }
+    }
+
+    TIMER_STOP( timer );
+
+    return done;
+  }
+
+
+  /*
+   * main
+   */
+
+  static char*   test_string;
+  static int     max_iter;
+  static double  max_time = BENCH_TIME;
+  static int     compare_cached;
+
+  static int  num_errors;   /* fonts that couldn't be loaded or sized */
+
+
+#define TEST( x ) ( !test_string || strchr( test_string, (x) ) )
+
+
+  static void
+  get_charset( bcontext_t*  ctx,
+               bcharset_t*  charset )
+  {
+    FT_Face   face = ctx->face;
+    FT_ULong  charcode;
+    int       i = 0;
+
+
+    charset->code = (FT_ULong*)calloc( (size_t)face->num_glyphs,
+                                       sizeof ( FT_ULong ) );
+    if ( !charset->code )
+      return;
+
+    if ( face->charmap )
+    {
+      FT_UInt  idx;
+
+
+      charcode = FT_Get_First_Char( face, &idx );
+
+      /* certain fonts contain a broken charmap that will map character */
+      /* codes to out-of-bounds glyph indices.  Take care of that here. */
+      /*                                                                */
+      while ( idx && i < face->num_glyphs )
+      {
+        FT_Int  gindex = (FT_Int)idx;
+
+
+        if ( ( ctx->first_index <= gindex &&
+               gindex <= ctx->last_index  ) ||
+             ( ctx->first_index >= gindex &&
+               gindex >= ctx->last_index  ) )
+          charset->code[i++] = charcode;
+        charcode = FT_Get_Next_Char( face, charcode, &idx );
+      }
+    }
+    else
+    {
+      int  j;
+
+
+      /* no charmap, do an identity mapping */
+      FOREACH( j )
+        charset->code[i++] = (FT_ULong)j;
+    }
+
+    charset->size = i;
+  }
+
+
+  static void
+  header( bcontext_t*  ctx )
+  {
+    FT_Face  face = ctx->face;
+
+
+    fprintf( ctx->out,
+             "\n"
+             "family: %s\n"
+             " style: %s\n"
+             "driver: %s %s\n"
+             "target: %s\n"
+             " flags: 0x%X\n"
+             "  cmap: %d\n"
+             "glyphs: %ld\n",
+             face->family_name,
+             face->style_name,
+             FT_FACE_DRIVER_NAME( face ), get_hinting_engine( face ),
+             get_target_name(),
+             load_flags,
+             FT_Get_Charmap_Index( face->charmap ),
+             face->num_glyphs );
+
+    if ( ctx->memory )
+      fprintf( ctx->out,
+               "memory: %lu bytes in %lu blocks\n",
+               (unsigned long)ctx->face_bytes, ctx->face_blocks );
+  }
+
+
+  /* read a UTF-8 text file and split it into lines (option `-T') */
+  static int
+  load_text( const char*  name )
+  {
+    FILE*  file = fopen( name, "rb" );
+    long   size;
+    char*  p;
+    char*  end;
+    int    n;
+
+
+    if ( !file )
+    {
+      fprintf( stderr, "couldn't open text file `%s'\n", name );
+
+      return 1;
+    }
+
+    fseek( file, 0, SEEK_END );
+    size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    text.data = (char*)malloc( (size_t)size + 1 );
+    if ( !text.data                                           ||
+         fread( text.data, 1, (size_t)size, file ) != (size_t)size )
+    {
+      fprintf( stderr, "couldn't read text file `%s'\n", name );
+      fclose( file );
+
+      return 1;
+    }
+
+    fclose( file );
+
+    text.data[size] = '\n';
+    end             = text.data + size + 1;
+
+    /* count, then record the lines */
+    for ( n = 0, p = text.data; p < end; p++ )
+      if ( *p == '\n' )
+        n++;
+
+    text.line_start = (const char**)malloc( (size_t)n * sizeof ( char* ) );
+    text.line_end   = (const char**)malloc( (size_t)n * sizeof ( char* ) );
+    if ( !text.line_start || !text.line_end )
+      return 1;
+
+    for ( p = text.data; p < end; )
+    {
+      char*  eol = (char*)memchr( p, '\n', (size_t)( end - p ) );
+      char*  q   = eol;
+
+
+      if ( q > p && q[-1] == '\r' )
+        q--;
+
+      /* empty lines don't get rendered */
+      if ( q > p )
+      {
+        text.line_start[text.num_lines] = p;
+        text.line_end[text.num_lines]   = q;
+        text.num_lines++;
+      }
+
+      p = eol + 1;
+    }
+
+    return 0;
+  }
+
+
+  /* read the font file of `ctx' into memory (option `-p') */
+  static FT_Error
+  load_file( bcontext_t*  ctx )
+  {
+    FILE*  file = fopen( ctx->filename, "rb" );
+
+
+    if ( file == NULL )
+    {
+      fprintf( stderr, "couldn't find or open `%s'\n", ctx->filename );
+
+      return 1;
+    }
+
+    fseek( file, 0, SEEK_END );
+    ctx->memory_size = (size_t)ftell( file );
+    fseek( file, 0, SEEK_SET );
+
+    ctx->memory_file = (FT_Byte*)malloc( ctx->memory_size );
+    if ( ctx->memory_file == NULL )
+    {
+      fprintf( stderr,
+               "couldn't allocate memory to pre-load font file\n" );
+      fclose( file );
+
+      return 1;
+    }
+
+    if ( !fread( ctx->memory_file, ctx->memory_size, 1, file ) )
+    {
+      fprintf( stderr, "read error\n" );
+      free( ctx->memory_file );
+      ctx->memory_file = NULL;
+      fclose( file );
+
+      return 1;
+    }
+
+    fclose( file );
+
+    return 0;
+  }
+
+
+  static FT_Error
+  get_face( bcontext_t*  ctx,
+            FT_Face*     face )
+  {
+    FT_Error  error;
+
+
+    if ( preload )
+    {
+      if ( !ctx->memory_file && load_file( ctx ) )
+        return 1;
+
+      error = FT_New_Memory_Face( ctx->lib,
+                                  ctx->memory_file,
+                                  (FT_Long)ctx->memory_size,
+                                  ctx->face_index,
+                                  face );
+    }
+    else
+      error = FT_New_Face( ctx->lib, ctx->filename, ctx->face_index, face );
+
+    if ( error )
+      fprintf( stderr, "couldn't load font resource `%s'\n",
+               ctx->filename );
+
+    return error;
+  }
+
+
+  static void
+  set_properties( FT_Library  library )
+  {
+    FT_Property_Set( library,
+                     "truetype",
+                     "interpreter-version", &tt_interpreter_version );
+    FT_Property_Set( library,
+                     "cff",
+                     "hinting-engine", &ps_hinting_engine );
+    FT_Property_Set( library,
+                     "type1",
+                     "hinting-engine", &ps_hinting_engine );
+    FT_Property_Set( library,
+                     "t1cid",
+                     "hinting-engine", &ps_hinting_engine );
+
+    if ( lcd_filter >= 0 )
+      FT_Library_SetLcdFilter( library, (FT_LcdFilter)lcd_filter );
+  }
+
+
+  static FT_Error
+  set_face_size( bcontext_t*  ctx )
+  {
+    if ( !ctx->size )
+      return FT_Err_Ok;
+
+    if ( FT_IS_SCALABLE( ctx->face ) )
+      return FT_Set_Pixel_Sizes( ctx->face, ctx->size, ctx->size );
+    else
+      return FT_Select_Size( ctx->face, 0 );
+  }
+
+
+  /* set up the cache manager of a context whose face is already sized */
+  static void
+  init_cache( bcontext_t*  ctx )
+  {
+    FTC_Manager_New( ctx->lib,
+                     0,
+                     0,
+                     max_bytes,
+                     face_requester,
+                     ctx->face,
+                     &ctx->cache_man );
+
+    ctx->font_type.face_id = (FTC_FaceID)1;
+    ctx->font_type.width   = ctx->size;
+    ctx->font_type.height  = ctx->size;
+    ctx->font_type.flags   = load_flags;
+  }
+
+
+  /* create the library of a context, with memory accounting if needed */
+  static FT_Error
+  new_library( bcontext_t*  ctx )
+  {
+    FT_Error  error;
+
+
+    if ( track_memory )
+    {
+      ctx->memory = (bmemory_t*)malloc( sizeof ( bmemory_t ) );
+      if ( !ctx->memory )
+        return FT_Err_Out_Of_Memory;
+
+      error = new_tracked_library( ctx->memory, &ctx->lib );
+    }
+    else
+      error = FT_Init_FreeType( &ctx->lib );
+
+    if ( !error )
+      set_properties( ctx->lib );
+
+    return error;
+  }
+
+
+  /* create an independent copy of `parent' for a worker thread */
+  static FT_Error
+  init_context( bcontext_t*  ctx,
+                bcontext_t*  parent )
+  {
+    FT_Error  error;
+
+
+    ctx->filename    = parent->filename;
+    ctx->face_index  = parent->face_index;
+    ctx->memory_file = parent->memory_file;   /* owned by `parent' */
+    ctx->memory_size = parent->memory_size;
+    ctx->first_index = parent->first_index;
+    ctx->last_index  = parent->last_index;
+    ctx->incr_index  = parent->incr_index;
+    ctx->size        = parent->size;
+    ctx->out         = parent->out;
+
+    error = new_library( ctx );
+    if ( error )
+      return error;
+
+    error = get_face( ctx, &ctx->face );
+    if ( error )
+      return error;
+
+    if ( parent->face->charmap )
+      ctx->face->charmap =
+        ctx->face->charmaps[FT_Get_Charmap_Index( parent->face->charmap )];
+
+    error = set_face_size( ctx );
+    if ( error )
+      return error;
+
+    init_cache( ctx );
+
+    return FT_Err_Ok;
+  }
+
+
+  static void
+  done_face( bcontext_t*  ctx )
+  {
+    /* The face requester hands out new references to our face, */
+    /* so we must release it after the cache manager.           */
+    if ( ctx->cache_man )
+    {
+      FTC_Manager_Done( ctx->cache_man );
+      ctx->cache_man = NULL;
+    }
+
+    if ( ctx->face )
+    {
+      FT_Done_Face( ctx->face );
+      ctx->face = NULL;
+    }
+  }
+
+
+  static void
+  done_context( bcontext_t*  ctx )
+  {
+    done_face( ctx );
+
+    if ( ctx->lib )
+    {
+      if ( ctx->memory )
+        FT_Done_Library( ctx->lib );
+      else
+        FT_Done_FreeType( ctx->lib );
+      ctx->lib = NULL;
+    }
+
+    free( ctx->memory );
+    ctx->memory = NULL;
+  }
+
+
+  /* run the selected tests on the face of `ctx' */
+  static int
+  bench_face( bcontext_t*  ctx )
+  {
+    FT_Face  face   = ctx->face;
+    int      status = 0;
+    int      j;
+
+
+    j = fprintf( ctx->out,
+                 "\n"
+                 "ftbench results for font `%s'",
+                 ctx->filename ) - 1;
+    if ( face->num_faces > 1 )
+      j += fprintf( ctx->out, ", face %ld", face->face_index );
+    fputc( '\n', ctx->out );
+    while ( j-- )
+      fputc( '-', ctx->out );
+    fputc( '\n', ctx->out );
+
+    if ( cmap_index >= 0 && cmap_index < face->num_charmaps )
+      face->charmap = face->charmaps[cmap_index];
+
+    header( ctx );
+
+    if ( !face->num_glyphs )
+      return 0;
+
+    ctx->first_index = first_index < face->num_glyphs
+                         ? first_index : (int)face->num_glyphs - 1;
+    ctx->last_index  = last_index < face->num_glyphs
+                         ? last_index : (int)face->num_glyphs - 1;
+    ctx->incr_index  = ctx->last_index > ctx->first_index ? 1 : -1;
+
+    ctx->size = size;
+    if ( size && !FT_IS_SCALABLE( face ) && face->num_fixed_sizes )
+    {
+      ctx->size = (unsigned int)face->available_sizes[0].size >> 6;
+      fprintf( stderr,
+               "using size of first bitmap strike (%upx)\n", ctx->size );
+    }
+
+    if ( set_face_size( ctx ) )
+    {
+      fprintf( stderr, "failed to set pixel size to %u\n", ctx->size );
+
+      return 1;
+    }
+
+    init_cache( ctx );
+
+    if ( num_threads > 1 )
+    {
+      thread_ctx = (bcontext_t*)calloc( (size_t)num_threads,
+                                        sizeof ( bcontext_t ) );
+      if ( !thread_ctx )
+      {
+        fprintf( stderr, "couldn't allocate thread contexts\n" );
+        status = 1;
+        goto Exit;
+      }
+
+      for ( j = 0; j < num_threads; j++ )
+      {
+        if ( init_context( &thread_ctx[j], ctx ) )
+        {
+          fprintf( stderr, "couldn't set up context for thread %d\n", j );
+          status = 1;
+          goto Exit;
+        }
+      }
+    }
+
+    fprintf( ctx->out,
+             "\n"
+             "font preloading into memory: %s\n"
+             "maximum cache size: %lu KiByte\n",
+             preload ? "yes" : face->stream->base ? "mapped" : "no",
+             max_bytes / 1024 );
+
+    fprintf( ctx->out,
+             "\n"
+             "testing glyph indices from %d to %d at %u ppem\n"
+             "number of seconds for each test: %s%g\n",
+             ctx->first_index, ctx->last_index, ctx->size,
+             max_iter ? "at most " : "", max_time );
+    if ( max_iter )
+      fprintf( ctx->out,
+               "number of iterations for each test: at most %d\n",
+               max_iter );
+    if ( warmup_iter )
+      fprintf( ctx->out,
+               "number of warm-up iterations for each test: %d\n",
+               warmup_iter );
+    if ( num_threads > 1 )
+      fprintf( ctx->out,
+               "number of threads for scaling tests: %d\n",
+               num_threads );
+
+    fprintf( ctx->out,
+             "\n"
+             "executing tests:\n" );
+
+    output_font_begin( ctx );
+
+    for ( j = 0; j < N_FT_BENCH; j++ )
+    {
+      btest_t   test;
+      FT_ULong  flags;
+
+
+      if ( !TEST( 'a' + j ) )
+        continue;
+
+      test.title       = NULL;
+      test.bench       = NULL;
+      test.cache_first = 0;
+      test.user_data   = NULL;
+      test.lines       = 0;
+
+      switch ( j )
+      {
+      case FT_BENCH_LOAD_GLYPH:
+        test.title = "Load";
+        test.bench = test_load;
+        benchmark( ctx, &test, max_iter, max_time );
+
+        if ( compare_cached )
+        {
+          test.cache_first = 1;
+
+          test.title = "Load (image cached)";
+          test.bench = test_image_cache;
+          benchmark( ctx, &test, max_iter, max_time );
+
+          test.title = "Load (sbit cached)";
+          test.bench = test_sbit_cache;
+          if ( ctx->size )
+            benchmark( ctx, &test, max_iter, max_time );
+          else
+            fprintf( ctx->out, "  %-25s disabled (size = 0)\n", test.title );
+        }
+        break;
+
+      case FT_BENCH_LOAD_ADVANCES:
+        test.user_data = &flags;
+
+        test.title = "Load_Advances (Normal)";
+        test.bench = test_load_advances;
+        flags      = FT_LOAD_DEFAULT;
+        benchmark( ctx, &test, max_iter, max_time );
+
+        test.title  = "Load_Advances (Fast)";
+        test.bench  = test_load_advances;
+        flags       = FT_LOAD_TARGET_LIGHT;
+        benchmark( ctx, &test, max_iter, max_time );
+
+        test.title  = "Load_Advances (Unscaled)";
+        test.bench  = test_load_advances;
+        flags       = FT_LOAD_NO_SCALE;
+        benchmark( ctx, &test, max_iter, max_time );
+        break;
+
+      case FT_BENCH_RENDER:
+        test.title = "Render";
+        test.bench = test_render;
+        if ( ctx->size )
+          benchmark( ctx, &test, max_iter, max_time );
+        else
+          fprintf( ctx->out, "  %-25s disabled (size = 0)\n", test.title );
+        break;
+
+      case FT_BENCH_GET_GLYPH:
+        test.title = "Get_Glyph";
+        test.bench = test_get_glyph;
+        benchmark( ctx, &test, max_iter, max_time );
+        break;
+
+      case FT_BENCH_GET_CBOX:
+        test.title = "Get_CBox";
+        test.bench = test_get_cbox;
+        benchmark( ctx, &test, max_iter, max_time );
+        break;
+
+      case FT_BENCH_GET_BBOX:
+        test.title = "Get_BBox";
+        test.bench = test_get_bbox;
+        {
+          FT_Matrix  rot30 = { 0xDDB4, -0x8000, 0x8000, 0xDDB4 };
+          int        i;
+
+
+          /* rotate outlines by 30 degrees so that CBox and BBox are different */
+          FT_Set_Transform( face, &rot30, NULL );
+          for ( i = 0; thread_ctx && i < num_threads; i++ )
+            FT_Set_Transform( thread_ctx[i].face, &rot30, NULL );
+
+          benchmark( ctx, &test, max_iter, max_time );
+
+          FT_Set_Transform( face, NULL, NULL );
+          for ( i = 0; thread_ctx && i < num_threads; i++ )
+            FT_Set_Transform( thread_ctx[i].face, NULL, NULL );
+        }
+        break;
+
+      case FT_BENCH_CMAP:
+        {
+          bcharset_t  charset;
+
+
+          get_charset( ctx, &charset );
+          if ( charset.code )
+          {
+            test.user_data = (void*)&charset;
+
+
+            test.title = "Get_Char_Index";
+            test.bench = test_get_char_index;
+
+            benchmark( ctx, &test, max_iter, max_time );
+
+            if ( compare_cached )
+            {
+              test.cache_first = 1;
+
+              test.title = "Get_Char_Index (cached)";
+              test.bench = test_cmap_cache;
+              benchmark( ctx, &test, max_iter, max_time );
+            }
+
+            free( charset.code );
+          }
+        }
+        break;
+
+      case FT_BENCH_CMAP_ITER:
+        test.title = "Iterate CMap";
+        test.bench = test_cmap_iter;
+        benchmark( ctx, &test, max_iter, max_time );
+        break;
+
+      case FT_BENCH_NEW_FACE:
+        test.title = "New_Face";
+        test.bench = test_new_face;
+        benchmark( ctx, &test, max_iter, max_time );
+        break;
+
+      case FT_BENCH_EMBOLDEN:
+        test.title = "Embolden";
+        test.bench = test_embolden;
+        if ( ctx->size )
+          benchmark( ctx, &test, max_iter, max_time );
+        else
+          fprintf( ctx->out, "  %-25s disabled (size = 0)\n", test.title );
+        break;
+
+      case FT_BENCH_STROKE:
+        test.title = "Stroke";
+        test.bench = test_stroke;
+        if ( ctx->size )
+          benchmark( ctx, &test, max_iter, max_time );
+        else
+          fprintf( ctx->out, "  %-25s disabled (size = 0)\n", test.title );
+        break;
+
+      case FT_BENCH_NEW_FACE_AND_LOAD_GLYPH:
+        test.title = "New_Face & load glyph(s)";
+        test.bench = test_new_face_and_load_glyph;
+        benchmark( ctx, &test, max_iter, max_time );
+        break;
+
+      case FT_BENCH_TEXT:
+        test.title     = "Text";
+        test.bench     = test_text;
+        test.user_data = &text;
+        test.lines     = text.num_lines;
+        if ( text.num_lines )
+          benchmark( ctx, &test, max_iter, max_time );
+        else
+          fprintf( ctx->out, "  %-25s disabled (no option `-T')\n",
+                   test.title );
+        break;
+      }
+    }
+
+    output_font_end( ctx );
+
+  Exit:
+    if ( thread_ctx )
+    {
+      for ( j = 0; j < num_threads; j++ )
+        done_context( &thread_ctx[j] );
+
+      free( thread_ctx );
+      thread_ctx = NULL;
+    }
+
+    return status;
+  }
+
+
+  /* test the first face of `name', or all faces in corpus mode; */
+  /* return the number of faces tested                           */
+  static int
+  bench_file( bcontext_t*  ctx,
+              const char*  name )
+  {
+    long  num_faces = 1;
+    long  i;
+    int   done      = 0;
+
+
+    ctx->filename = name;
+
+    for ( i = 0; i < num_faces; i++ )
+    {
+      size_t         bytes  = ctx->memory ? ctx->memory->current : 0;
+      unsigned long  blocks = ctx->memory ? ctx->memory->blocks : 0;
+
+
+      ctx->face_index = i;
+
+      if ( get_face( ctx, &ctx->face ) )
+      {
+        ctx->face = NULL;
+
+        LOCK( lock );
+        num_errors++;
+        UNLOCK( lock );
+
+        break;
+      }
+
+      if ( ctx->memory )
+      {
+        ctx->face_bytes  = ctx->memory->current - bytes;
+        ctx->face_blocks = ctx->memory->blocks - blocks;
+      }
+
+      if ( corpus )
+        num_faces = ctx->face->num_faces;
+
+      if ( bench_face( ctx ) )
+      {
+        LOCK( lock );
+        num_errors++;
+        UNLOCK( lock );
+      }
+      else
+        done++;
+
+      done_face( ctx );
+    }
+
+    free( ctx->memory_file );
+    ctx->memory_file = NULL;
+    ctx->memory_size = 0;
+
+    return done;
+  }
+
+
+  /*
+   * Font file collection
+   */
+
+  static char**  files;
+  static int     num_files;
+  static int     max_files;
+
+
+  static int
+  add_file( const char*  name )
+  {
+    if ( num_files == max_files )
+    {
+      int     new_max = max_files ? 2 * max_files : 64;
+      char**  new_files;
+
+
+      new_files = (char**)realloc( files,
+                                   (size_t)new_max * sizeof ( char* ) );
+      if ( !new_files )
+      {
+        fprintf( stderr, "couldn't allocate memory for file list\n" );
+
+        return 1;
+      }
+
+      files     = new_files;
+      max_files = new_max;
+    }
+
+    files[num_files] = ft_strdup( name );
+    if ( !files[num_files] )
+      return 1;
+
+    num_files++;
+
+    return 0;
+  }
+
+
+  static int
+  compare_names( const void*  a,
+                 const void*  b )
+  {
+    return strcmp( *(char* const*)a, *(char* const*)b );
+  }
+
+
+  static int
+  is_directory( const char*  name )
+  {
+#if defined _WIN32
+    DWORD  attr = GetFileAttributesA( name );
+
+
+    return attr != INVALID_FILE_ATTRIBUTES     &&
+           ( attr & FILE_ATTRIBUTE_DIRECTORY );
+#elif defined UNIX
+    struct stat  st;
+
+
+    return !stat( name, &st ) && S_ISDIR( st.st_mode );
+#else
+    FT_UNUSED( name );
+
+    return 0;
+#endif
+  }
+
+
+  /* collect all files below `dir', skipping hidden entries */
+  static int
+  walk_directory( const char*  dir )
+  {
+    int  error = 0;
+
+#if defined _WIN32
+    WIN32_FIND_DATAA  data;
+    HANDLE            find;
+    char*             path;
+
+
+    path = (char*)malloc( strlen( dir ) + 3 );
+    if ( !path )
+      return 1;
+
+    sprintf( path, "%s\\*", dir );
+    find = FindFirstFileA( path, &data );
+    free( path );
+
+    if ( find == INVALID_HANDLE_VALUE )
+    {
+      fprintf( stderr, "couldn't read directory `%s'\n", dir );
+
+      return 1;
+    }
+
+    do
+    {
+      if ( data.cFileName[0] == '.' )
+        continue;
+
+      path = (char*)malloc( strlen( dir ) + strlen( data.cFileName ) + 2 );
+      if ( !path )
+      {
+        error = 1;
+        break;
+      }
+
+      sprintf( path, "%s\\%s", dir, data.cFileName );
+      if ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+        error = walk_directory( path );
+      else
+        error = add_file( path );
+      free( path );
+
+    } while ( !error && FindNextFileA( find, &data ) );
+
+    FindClose( find );
+
+#elif defined UNIX
+    DIR*            d = opendir( dir );
+    struct dirent*  entry;
+    char*           path;
+
+
+    if ( !d )
+    {
+      fprintf( stderr, "couldn't read directory `%s'\n", dir );
+
+      return 1;
+    }
+
+    while ( !error && ( entry = readdir( d ) ) != NULL )
+    {
+      struct stat  st;
+
+
+      if ( entry->d_name[0] == '.' )
+        continue;
+
+      path = (char*)malloc( strlen( dir ) + strlen( entry->d_name ) + 2 );
+      if ( !path )
+      {
+        error = 1;
+        break;
+      }
+
+      sprintf( path, "%s/%s", dir, entry->d_name );
+
+      /* don't follow symbolic links to directories to avoid cycles */
+      if ( !lstat( path, &st ) && S_ISDIR( st.st_mode ) )
+        error = walk_directory( path );
+      else if ( !is_directory( path ) )
+        error = add_file( path );
+      free( path );
+    }
+
+    closedir( d );
+
+#else
+    fprintf( stderr, "can't read directory `%s' on this platform\n", dir );
+    error = 1;
+#endif
+
+    return error;
+  }
+
+
+  /* add a font file, a directory, or (with a leading `@') a list file */
+  static int
+  add_input( const char*  name )
+  {
+    int  first = num_files;
+    int  error;
+
+
+    if ( name[0] == '@' )
+    {
+      FILE*  list = fopen( name + 1, "r" );
+      char   line[4096];
+
+
+      if ( !list )
+      {
+        fprintf( stderr, "couldn't open list file `%s'\n", name + 1 );
+
+        return 1;
+      }
+
+      corpus = 1;
+      error  = 0;
+
+      /* one name per line; empty lines and `#' comments are ignored */
+      while ( !error && fgets( line, sizeof ( line ), list ) )
+      {
+        size_t  len = strlen( line );
 
-    TIMER_START( timer );
 
-    for ( i = 0; i < charset->size; i++ )
-    {
-      if ( FTC_CMapCache_Lookup( cmap_cache,
-                                 font_type.face_id,
-                                 cmap_index,
-                                 charset->code[i] ) )
-        done++;
+        while ( len && ( line[len - 1] == '\n' || line[len - 1] == '\r' ) )
+          line[--len] = '\0';
+
+        if ( !len || line[0] == '#' )
+          continue;
+
+        if ( is_directory( line ) )
+          error = walk_directory( line );
+        else
+          error = add_file( line );
+      }
+
+      fclose( list );
+
+      return error;
     }
 
-    TIMER_STOP( timer );
+    if ( !is_directory( name ) )
+      return add_file( name );
 
-    return done;
+    corpus = 1;
+    error  = walk_directory( name );
+
+    /* directory order is arbitrary */
+    qsort( files + first, (size_t)( num_files - first ), sizeof ( char* ),
+           compare_names );
+
+    return error;
   }
 
 
-  static int
-  test_image_cache( btimer_t*  timer,
-                    FT_Face    face,
-                    void*      user_data )
-  {
-    FT_Glyph  glyph;
+  /*
+   * Parallel processing of font files (option `-P')
+   */
 
-    int  i, done = 0;
+#ifdef FTDEMO_THREADS
+
+  typedef struct  bworker_t_ {
+    bcontext_t  ctx;
+    int         num_faces;
+
+    thandle_t   handle;
+
+  } bworker_t;
+
+
+  static int  next_file;
+  static int  output_fonts;   /* faces written to `output' so far */
+
+
+  /* append the contents of buffer `from' to `to' and empty the buffer */
+  static void
+  flush_buffer( FILE*  from,
+                FILE*  to )
+  {
+    char  buf[4096];
+    long  left = ftell( from );
 
-    FT_UNUSED( face );
-    FT_UNUSED( user_data );
 
+    rewind( from );
 
-    if ( !image_cache )
+    while ( left > 0 )
     {
-      if ( FTC_ImageCache_New( cache_man, &image_cache ) )
-        return 0;
+      size_t  n = (size_t)left < sizeof ( buf ) ? (size_t)left
+                                                : sizeof ( buf );
+
+
+      n = fread( buf, 1, n, from );
+      if ( !n )
+        break;
+
+      fwrite( buf, 1, n, to );
+      left -= (long)n;
     }
 
-    TIMER_START( timer );
+    rewind( from );
+  }
 
-    FOREACH( i )
+
+  static tthread_ret_t TTHREAD_CALL
+  worker_main( void*  arg )
+  {
+    bworker_t*   worker = (bworker_t*)arg;
+    bcontext_t*  ctx    = &worker->ctx;
+
+
+    while ( 1 )
     {
-      if ( !FTC_ImageCache_Lookup( image_cache,
-                                   &font_type,
-                                   (FT_UInt)i,
-                                   &glyph,
-                                   NULL ) )
-        done++;
-    }
+      int  i;
 
-    TIMER_STOP( timer );
 
-    return done;
+      LOCK( lock );
+      i = next_file++;
+      UNLOCK( lock );
+
+      if ( i >= num_files )
+        break;
+
+      /* buffer the results of each file to keep them together */
+      ctx->output_fonts  = 0;
+      worker->num_faces += bench_file( ctx, files[i] );
+
+      LOCK( lock );
+
+      flush_buffer( ctx->out, stdout );
+      fflush( stdout );
+
+      if ( ctx->output )
+      {
+        if ( output_fonts && ctx->output_fonts )
+          fprintf( output, ",\n" );
+        flush_buffer( ctx->output, output );
+        output_fonts += ctx->output_fonts;
+      }
+
+      UNLOCK( lock );
+    }
+
+    return 0;
   }
 
 
+  /* process all files with `num_workers' threads; */
+  /* return the number of faces tested             */
   static int
-  test_sbit_cache( btimer_t*  timer,
-                   FT_Face    face,
-                   void*      user_data )
+  run_workers( void )
   {
-    FTC_SBit  glyph;
+    bworker_t*  workers;
+    int         i, started = 0;
+    int         num_faces  = 0;
 
-    int  i, done = 0;
 
-    FT_UNUSED( face );
-    FT_UNUSED( user_data );
+    workers = (bworker_t*)calloc( (size_t)num_workers,
+                                  sizeof ( bworker_t ) );
+    if ( !workers )
+    {
+      fprintf( stderr, "couldn't allocate workers\n" );
+      num_errors++;
 
+      return 0;
+    }
 
-    if ( !sbit_cache )
+    for ( i = 0; i < num_workers; i++ )
     {
-      if ( FTC_SBitCache_New( cache_man, &sbit_cache ) )
-        return 0;
+      bcontext_t*  ctx = &workers[i].ctx;
+
+
+      if ( new_library( ctx ) )
+        break;
+
+      ctx->out = tmpfile();
+      if ( !ctx->out )
+        break;
+
+      if ( output )
+      {
+        ctx->output = tmpfile();
+        if ( !ctx->output )
+          break;
+      }
     }
 
-    TIMER_START( timer );
+    if ( i == num_workers )
+      for ( ; started < num_workers; started++ )
+        if ( start_thread( &workers[started].handle,
+                           worker_main,
+                           &workers[started] ) )
+          break;
 
-    FOREACH( i )
+    /* the remaining files are taken by the started workers */
+    for ( i = 0; i < started; i++ )
     {
-      if ( !FTC_SBitCache_Lookup( sbit_cache,
-                                  &font_type,
-                                  (FT_UInt)i,
-                                  &glyph,
-                                  NULL ) )
-        done++;
+      join_thread( workers[i].handle );
+      num_faces += workers[i].num_faces;
     }
 
-    TIMER_STOP( timer );
+    if ( !started )
+    {
+      fprintf( stderr, "couldn't start worker threads\n" );
+      num_errors++;
+    }
 
-    return done;
+    for ( i = 0; i < num_workers; i++ )
+    {
+      done_context( &workers[i].ctx );
+
+      if ( workers[i].ctx.out )
+        fclose( workers[i].ctx.out );
+      if ( workers[i].ctx.output )
+        fclose( workers[i].ctx.output );
+    }
+
+    free( workers );
+
+    return num_faces;
   }
 
+#endif /* FTDEMO_THREADS */
 
-  static int
-  test_cmap_iter( btimer_t*  timer,
-                  FT_Face    face,
-                  void*      user_data )
+
+  /*
+   * Cache sizing sweep (option `-S')
+   */
+
+#define SWEEP_LOOKUPS  50000
+#define SWEEP_VALUES   16
+
+  /* the sizes of the workload, from the most to the least frequent */
+  static const unsigned int  sweep_ppem[] =
   {
-    FT_UInt   idx;
-    FT_ULong  charcode;
-    int       done;
+    16, 12, 14, 10, 20, 24, 32, 48
+  };
 
-    FT_UNUSED( user_data );
+#define N_SWEEP_PPEM  (int)( sizeof ( sweep_ppem ) / sizeof ( *sweep_ppem ) )
 
+  static const int  dflt_sweep_faces[] = { 1, 4, 16 };
+  static const int  dflt_sweep_sizes[] = { 1, 4, 16 };
+  static const int  dflt_sweep_kib[]   = { 256, 1024, 4096 };
 
-    TIMER_START( timer );
 
-    charcode = FT_Get_First_Char( face, &idx );
-    done = ( idx != 0 );
+  typedef struct  bsweep_font_t_ {
+    const char*  filename;
+    FT_Long      num_glyphs;
 
-    while ( idx != 0 )
-      charcode = FT_Get_Next_Char( face, charcode, &idx );
+  } bsweep_font_t;
 
-    TIMER_STOP( timer );
 
-    return done;
+  typedef struct  bsweep_t_ {
+    bsweep_font_t*  fonts;
+    int             num_fonts;
+
+    /* the lookups, identical for all settings */
+    int             num_lookups;
+    int*            font;
+    int*            ppem;
+    FT_UInt*        gindex;
+
+    unsigned long   face_loads;
+
+  } bsweep_t;
+
+
+  static FT_Error
+  sweep_requester( FTC_FaceID  face_id,
+                   FT_Library  library,
+                   FT_Pointer  request_data,
+                   FT_Face*    aface )
+  {
+    bsweep_font_t*  font  = (bsweep_font_t*)face_id;
+    bsweep_t*       sweep = (bsweep_t*)request_data;
+
+
+    sweep->face_loads++;
+
+    return FT_New_Face( library, font->filename, 0, aface );
   }
 
 
-  static int
-  test_new_face( btimer_t*  timer,
-                 FT_Face    face,
-                 void*      user_data )
+  /* xorshift generator with a fixed seed, uniform in [0,1) */
+  static double
+  sweep_random( void )
   {
-    FT_Face  bench_face;
+    static FT_UInt32  state = 0x2545F491UL;
 
-    FT_UNUSED( face );
-    FT_UNUSED( user_data );
 
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    state &= 0xFFFFFFFFUL;
 
-    TIMER_START( timer );
+    return state / 4294967296.0;
+  }
 
-    if ( !get_face( &bench_face ) )
-      FT_Done_Face( bench_face );
 
-    TIMER_STOP( timer );
+  /* cumulative distribution of Zipf's law (exponent 1) over `n' ranks */
+  static double*
+  zipf_new( long  n )
+  {
+    double*  cdf = (double*)malloc( (size_t)n * sizeof ( double ) );
+    double   sum = 0;
+    long     i;
 
-    return 1;
+
+    if ( !cdf )
+      return NULL;
+
+    for ( i = 0; i < n; i++ )
+      cdf[i] = sum += 1.0 / ( i + 1 );
+    for ( i = 0; i < n; i++ )
+      cdf[i] /= sum;
+
+    return cdf;
   }
 
 
-  static int
-  test_new_face_and_load_glyph( btimer_t*  timer,
-                                FT_Face    face,
-                                void*      user_data )
+  static long
+  zipf_rank( const double*  cdf,
+             long           n )
   {
-    FT_Face  bench_face;
+    double  u  = sweep_random();
+    long    lo = 0;
+    long    hi = n - 1;
 
-    int  i, done = 0;
 
-    FT_UNUSED( face );
-    FT_UNUSED( user_data );
+    while ( lo < hi )
+    {
+      long  mid = ( lo + hi ) / 2;
 
 
-    TIMER_START( timer );
+      if ( cdf[mid] < u )
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    return lo;
+  }
 
-    if ( !get_face( &bench_face ) )
+
+  /* parse `n1,n2,...' up to a slash; use `dflt' for an empty list */
+  static const char*
+  parse_sweep_values( const char*  spec,
+                      int*         values,
+                      int*         num_values,
+                      const int*   dflt,
+                      int          num_dflt )
+  {
+    int  n = 0;
+
+
+    while ( *spec && *spec != '/' )
     {
-      FOREACH( i )
-      {
-        if ( !FT_Load_Glyph( bench_face, (FT_UInt)i, load_flags ) )
-          done++;
-      }
+      char*  end;
+      long   value = strtol( spec, &end, 10 );
 
-      FT_Done_Face( bench_face );
+
+      if ( end == spec || value < 0 )
+        return NULL;
+
+      if ( n < SWEEP_VALUES )
+        values[n++] = (int)value;
+
+      spec = end;
+      if ( *spec == ',' )
+        spec++;
     }
 
-    TIMER_STOP( timer );
+    if ( !n )
+      for ( ; n < num_dflt; n++ )
+        values[n] = dflt[n];
 
-    return done;
-  }
+    *num_values = n;
 
+    return *spec == '/' ? spec + 1 : spec;
+  }
 
-  /*
-   * main
-   */
 
-  static void
-  get_charset( FT_Face      face,
-               bcharset_t*  charset )
+  static int
+  sweep_run( bsweep_t*  sweep,
+             int        max_faces,
+             int        max_sizes,
+             int        max_kib )
   {
-    FT_ULong  charcode;
-    int       i = 0;
-
+    bmemory_t         mem;
+    FT_Library        lib;
+    FTC_Manager       manager = NULL;
+    FTC_SBitCache     cache;
+    FTC_ImageTypeRec  type;
+    FTC_SBit          sbit;
+
+    int     hits   = 0;
+    int     misses = 0;
+    int     errors = 0;
+    int     status = 1;
+    double  t_hit  = 0;
+    double  t_miss = 0;
+    int     pass, i;
+
+
+    if ( new_tracked_library( &mem, &lib ) )
+    {
+      fprintf( stderr, "couldn't initialize font library\n" );
+      return 1;
+    }
 
-    charset->code = (FT_ULong*)calloc( (size_t)face->num_glyphs,
-                                       sizeof ( FT_ULong ) );
-    if ( !charset->code )
-      return;
+    set_properties( lib );
 
-    if ( face->charmap )
+    if ( FTC_Manager_New( lib,
+                          (FT_UInt)max_faces,
+                          (FT_UInt)max_sizes,
+                          (FT_ULong)max_kib * 1024,
+                          sweep_requester,
+                          sweep,
+                          &manager )              ||
+         FTC_SBitCache_New( manager, &cache )     )
     {
-      FT_UInt  idx;
+      fprintf( stderr, "couldn't create cache manager\n" );
+      goto Exit;
+    }
 
+    type.flags = load_flags;
 
-      charcode = FT_Get_First_Char( face, &idx );
+    /* the first pass fills the caches */
+    for ( pass = 0; pass < 2; pass++ )
+    {
+      sweep->face_loads = 0;
 
-      /* certain fonts contain a broken charmap that will map character */
-      /* codes to out-of-bounds glyph indices.  Take care of that here. */
-      /*                                                                */
-      while ( idx && i < face->num_glyphs )
+      for ( i = 0; i < sweep->num_lookups; i++ )
       {
-        FT_Int  gindex = (FT_Int)idx;
+        unsigned long  allocs = mem.allocs;
+        double         t;
+        FT_Error       error;
 
 
-        if ( ( first_index <= gindex && gindex <= last_index ) ||
-             ( first_index >= gindex && gindex >= last_index ) )
-          charset->code[i++] = charcode;
-        charcode = FT_Get_Next_Char( face, charcode, &idx );
-      }
-    }
-    else
-    {
-      int  j;
+        type.face_id = (FTC_FaceID)&sweep->fonts[sweep->font[i]];
+        type.width   = sweep_ppem[sweep->ppem[i]];
+        type.height  = sweep_ppem[sweep->ppem[i]];
 
+        t     = get_wall_time();
+        error = FTC_SBitCache_Lookup( cache, &type, sweep->gindex[i],
+                                      &sbit, NULL );
+        t     = get_wall_time() - t;
 
-      /* no charmap, do an identity mapping */
-      FOREACH( j )
-        charset->code[i++] = (FT_ULong)j;
+        if ( !pass )
+          continue;
+
+        /* a hit doesn't allocate anything */
+        if ( error )
+          errors++;
+        else if ( mem.allocs != allocs )
+        {
+          misses++;
+          t_miss += t;
+        }
+        else
+        {
+          hits++;
+          t_hit += t;
+        }
+      }
     }
 
-    charset->size = i;
-  }
+    printf( "%5d %5d %7d %6.1f%% %8.3f %8.3f %8.3f %5lu %8lu %8lu\n",
+            max_faces, max_sizes, max_kib,
+            100.0 * hits / sweep->num_lookups,
+            ( t_hit + t_miss ) / ( hits + misses ? hits + misses : 1 ),
+            hits ? t_hit / hits : 0.0,
+            misses ? t_miss / misses : 0.0,
+            sweep->face_loads,
+            (unsigned long)( mem.peak / 1024 ),
+            (unsigned long)( mem.current / 1024 ) );
 
+    if ( errors )
+      printf( "%19s %d lookups failed\n", "", errors );
 
-  static void
-  header( FT_Face  face )
-  {
-    const FT_String*  target =
-                 render_mode == FT_RENDER_MODE_NORMAL ? "normal" :
-                 render_mode == FT_RENDER_MODE_LIGHT  ? "light"  :
-                 render_mode == FT_RENDER_MODE_MONO   ? "mono"   :
-                 render_mode == FT_RENDER_MODE_LCD    ? "lcd"    :
-                 render_mode == FT_RENDER_MODE_LCD_V  ? "lcd-v"  :
-                 render_mode == FT_RENDER_MODE_SDF    ? "sdf"    : "";
-    const FT_String*  module_name = FT_FACE_DRIVER_NAME( face );
-    const FT_String*  hinting_engine = "";
-    FT_UInt           prop;
+    status = 0;
 
+  Exit:
+    if ( manager )
+      FTC_Manager_Done( manager );
+    FT_Done_Library( lib );
 
-    if ( !FT_IS_SCALABLE( face ) )
-      hinting_engine = "bitmap";
+    return status;
+  }
 
-    else if ( load_flags & FT_LOAD_NO_SCALE )
-      hinting_engine = "unscaled";
 
-    else if ( load_flags & FT_LOAD_NO_HINTING )
-      hinting_engine = "unhinted";
+  /* run a Zipf-distributed workload over all fonts and sizes */
+  /* for all combinations of cache manager limits in `spec'   */
+  static int
+  run_sweep( const char*  spec )
+  {
+    int  faces[SWEEP_VALUES], num_faces;
+    int  sizes[SWEEP_VALUES], num_sizes;
+    int  kib[SWEEP_VALUES], num_kib;
+
+    bsweep_t  sweep;
+    double*   font_cdf  = NULL;
+    double*   ppem_cdf  = NULL;
+    double*   glyph_cdf = NULL;
+    FT_Long   max_glyphs = 0;
+    int       status     = 1;
+    int       i, f, s, b;
+
+
+    spec = parse_sweep_values( spec, faces, &num_faces,
+                               dflt_sweep_faces, 3 );
+    if ( spec )
+      spec = parse_sweep_values( spec, sizes, &num_sizes,
+                                 dflt_sweep_sizes, 3 );
+    if ( spec )
+      spec = parse_sweep_values( spec, kib, &num_kib,
+                                 dflt_sweep_kib, 3 );
+    if ( !spec || *spec )
+    {
+      fprintf( stderr, "invalid argument for option `-S'\n" );
 
-    else if ( render_mode == FT_RENDER_MODE_LIGHT )
-      hinting_engine = "auto";
+      return 1;
+    }
 
-    else if ( load_flags == FT_LOAD_FORCE_AUTOHINT )
-      hinting_engine = "auto";
+    memset( &sweep, 0, sizeof ( sweep ) );
 
-    else if ( !FT_Property_Get( lib, module_name,
-                                     "interpreter-version", &prop ) )
+    sweep.fonts = (bsweep_font_t*)calloc( (size_t)num_files,
+                                          sizeof ( bsweep_font_t ) );
+    if ( !sweep.fonts )
+      return 1;
+
+    for ( i = 0; i < num_files; i++ )
     {
-      switch ( prop )
+      FT_Face  face;
+
+
+      if ( FT_New_Face( main_ctx.lib, files[i], 0, &face ) )
       {
-      case TT_INTERPRETER_VERSION_35:
-        hinting_engine = "v35";
-        break;
-      case TT_INTERPRETER_VERSION_40:
-        hinting_engine = "v40";
-        break;
+        fprintf( stderr, "couldn't load font resource `%s'\n", files[i] );
+        continue;
       }
-    }
 
-    else if ( !FT_Property_Get( lib, module_name,
-                                     "hinting-engine", &prop ) )
-    {
-      switch ( prop )
+      if ( face->num_glyphs > 0 )
       {
-      case FT_HINTING_FREETYPE:
-        hinting_engine = "FT";
-        break;
-      case FT_HINTING_ADOBE:
-        hinting_engine = "Adobe";
-        break;
+        sweep.fonts[sweep.num_fonts].filename   = files[i];
+        sweep.fonts[sweep.num_fonts].num_glyphs = face->num_glyphs;
+        sweep.num_fonts++;
+
+        if ( face->num_glyphs > max_glyphs )
+          max_glyphs = face->num_glyphs;
       }
-    }
 
-    printf( "\n"
-            "family: %s\n"
-            " style: %s\n"
-            "driver: %s %s\n"
-            "target: %s\n"
-            " flags: 0x%X\n"
-            "  cmap: %d\n"
-            "glyphs: %ld\n",
-            face->family_name,
-            face->style_name,
-            module_name, hinting_engine,
-            target,
-            load_flags,
-            FT_Get_Charmap_Index( face->charmap ),
-            face->num_glyphs );
-  }
+      FT_Done_Face( face );
+    }
 
+    if ( !sweep.num_fonts )
+      goto Exit;
 
-  static FT_Error
-  get_face( FT_Face*  face )
-  {
-    static unsigned char*  memory_file = NULL;
-    static size_t          memory_size;
-    int                    face_index = 0;
-    FT_Error               error;
+    sweep.num_lookups = max_iter ? max_iter : SWEEP_LOOKUPS;
+    sweep.font   = (int*)malloc( (size_t)sweep.num_lookups * sizeof ( int ) );
+    sweep.ppem   = (int*)malloc( (size_t)sweep.num_lookups * sizeof ( int ) );
+    sweep.gindex = (FT_UInt*)malloc( (size_t)sweep.num_lookups *
+                                     sizeof ( FT_UInt ) );
 
+    font_cdf  = zipf_new( sweep.num_fonts );
+    ppem_cdf  = zipf_new( N_SWEEP_PPEM );
+    glyph_cdf = zipf_new( max_glyphs );
 
-    if ( preload )
+    if ( !sweep.font || !sweep.ppem || !sweep.gindex ||
+         !font_cdf   || !ppem_cdf   || !glyph_cdf    )
     {
-      if ( !memory_file )
-      {
-        FILE*  file = fopen( filename, "rb" );
-
-
-        if ( file == NULL )
-        {
-          fprintf( stderr, "couldn't find or open `%s'\n", filename );
+      fprintf( stderr, "couldn't allocate lookups\n" );
+      goto Exit;
+    }
 
-          return 1;
-        }
+    /* low glyph indices are the most frequent */
+    for ( i = 0; i < sweep.num_lookups; i++ )
+    {
+      int  n = (int)zipf_rank( font_cdf, sweep.num_fonts );
 
-        fseek( file, 0, SEEK_END );
-        memory_size = (size_t)ftell( file );
-        fseek( file, 0, SEEK_SET );
 
-        memory_file = (FT_Byte*)malloc( memory_size );
-        if ( memory_file == NULL )
-        {
-          fprintf( stderr,
-                   "couldn't allocate memory to pre-load font file\n" );
+      sweep.font[i]   = n;
+      sweep.ppem[i]   = (int)zipf_rank( ppem_cdf, N_SWEEP_PPEM );
+      sweep.gindex[i] = (FT_UInt)( zipf_rank( glyph_cdf, max_glyphs ) %
+                                   sweep.fonts[n].num_glyphs );
+    }
 
-          return 1;
-        }
+    i = printf( "\n"
+                "cache sweep over %d fonts at %d sizes,"
+                " %d lookups per setting\n",
+                sweep.num_fonts, N_SWEEP_PPEM, sweep.num_lookups ) - 2;
+    while ( i-- )
+      putchar( '-' );
+    putchar( '\n' );
 
-        if ( !fread( memory_file, memory_size, 1, file ) )
+    printf( "\n"
+            "fonts, sizes, and glyph indices follow Zipf's law;\n"
+            "latencies are wall time in us, memory is in KiByte\n"
+            "\n"
+            "%5s %5s %7s %7s %8s %8s %8s %5s %8s %8s\n",
+            "faces", "sizes", "max KiB",
+            "hits", "us/op", "hit", "miss", "opens",
+            "peak", "final" );
+
+    for ( f = 0; f < num_faces; f++ )
+      for ( s = 0; s < num_sizes; s++ )
+        for ( b = 0; b < num_kib; b++ )
         {
-          fprintf( stderr, "read error\n" );
-          free( memory_file );
-          memory_file = NULL;
+          if ( sweep_run( &sweep, faces[f], sizes[s], kib[b] ) )
+            goto Exit;
 
-          return 1;
+          fflush( stdout );
         }
-      }
-
-      error = FT_New_Memory_Face( lib,
-                                  memory_file,
-                                  (FT_Long)memory_size,
-                                  face_index,
-                                  face );
-    }
-    else
-      error = FT_New_Face( lib, filename, face_index, face );
 
-    if ( error )
-      fprintf( stderr, "couldn't load font resource\n");
+    status = 0;
 
-    return error;
+  Exit:
+    free( font_cdf );
+    free( ppem_cdf );
+    free( glyph_cdf );
+    free( sweep.font );
+    free( sweep.ppem );
+    free( sweep.gindex );
+    free( sweep.fonts );
+
+    return status;
   }
 
 
@@ -992,12 +4150,25 @@
       "ftbench: run FreeType benchmarks\n"
       "--------------------------------\n"
       "\n"
-      "Usage: ftbench [options] fontname\n"
+      "Usage: ftbench [options] font...\n"
+      "\n"
+      "  Each `font' is a font file, a directory to be searched\n"
+      "  recursively, or `@FILE' to read font file names from FILE,\n"
+      "  one per line.  With more than one font file, all faces of\n"
+      "  each file are tested, and a summary is printed at the end.\n"
       "\n"
+      "  -B FILE   Compare results with those in FILE, written by option\n"
+      "            `-o' for a previous run; exit with status 1 if a test\n"
+      "            is significantly slower (see option `-R').\n"
       "  -C        Compare with cached version (if available).\n"
       "  -c N      Use at most N iterations for each test\n"
       "            (0 means time limited).\n"
+      "  -E        Count CPU cycles, instructions, cache misses, and\n"
+      "            branch mispredictions with hardware performance\n"
+      "            counters (Linux only).\n"
       "  -e E      Set specific charmap index E.\n"
+      "  -F FMT    Use format FMT for option `-o', either `csv' (default)\n"
+      "            or `json'.\n"
       "  -f L      Use hex number L as load flags (see `FT_LOAD_XXX').\n"
       "  -H NAME   Use PS hinting engine NAME.\n"
       "            Available versions are %s; default is `%s'.\n"
@@ -1005,26 +4176,49 @@
       "            Available versions are %s; default is version %u.\n"
       "  -i I-J    Forward or reverse range of glyph indices to use\n"
       "            (default is from 0 to the number of glyphs minus one).\n"
+      "  -j N      Also run each test on N threads simultaneously, each\n"
+      "            with its own library, face, and cache manager, and\n"
+      "            report the scaling relative to a single thread.\n"
       "  -l N      Set LCD filter to N\n"
       "              0: none, 1: default, 2: light, 16: legacy\n"
-      "  -m M      Set maximum cache size to M KiByte (default is %d).\n",
+      "  -M        Count the memory allocated by FreeType, per operation\n"
+      "            and by opening the face.\n"
+      "  -m M      Set maximum cache size to M KiByte (default is %d).\n"
+      "  -n N      List the N slowest faces per test in the summary\n"
+      "            (default is %d).\n",
              hinting_engines,
              ps_hinting_engine_names[dflt_ps_hinting_engine],
              interpreter_versions,
              dflt_tt_interpreter_version,
-             CACHE_SIZE );
+             CACHE_SIZE,
+             NUM_SLOWEST );
     fprintf( stderr,
+      "  -o FILE   Write results with statistics over all timed iterations\n"
+      "            to FILE in the format given by option `-F'.\n"
+      "  -P N      Test N font files in parallel, each in its own thread;\n"
+      "            implies no option `-j'.\n"
       "  -p        Preload font file in memory.\n"
+      "  -R P      With option `-B', treat a slowdown of more than P percent\n"
+      "            as a regression (default is %.0f).\n"
       "  -r N      Set render mode to N\n"
       "              0: normal, 1: light, 2: mono, 3: LCD, 4: LCD vertical\n"
       "            (default is 0).\n"
+      "  -S F/S/M  Instead of the tests, run a Zipf-distributed workload\n"
+      "            through the sbit cache with all combinations of at most\n"
+      "            F faces, S sizes, and M KiByte (comma-separated lists;\n"
+      "            empty lists select defaults); `-c' sets the number of\n"
+      "            lookups (default is %d).\n"
       "  -s S      Use S ppem as face size (default is %dppem).\n"
       "            If set to zero, don't call FT_Set_Pixel_Sizes.\n"
       "            Use value 0 with option `-f 1' or something similar to\n"
       "            load the glyphs unscaled, otherwise errors will show up.\n",
+             REGRESS_THRESHOLD,
+             SWEEP_LOOKUPS,
              FACE_SIZE );
     fprintf( stderr,
+      "  -T FILE   Use the lines of UTF-8 text FILE for test `m'.\n"
       "  -t T      Use at most T seconds per bench (default is %.0f).\n"
+      "  -w N      Run N untimed warm-up iterations before each test.\n"
       "\n"
       "  -b tests  Perform chosen tests (default is all):\n",
              BENCH_TIME );
@@ -1047,23 +4241,19 @@
   }
 
 
-#define TEST( x ) ( !test_string || strchr( test_string, (x) ) )
-
-
   int
   main( int     argc,
         char**  argv )
   {
-    FT_Face   face;
     FT_Error  error;
 
-    unsigned long  max_bytes      = CACHE_SIZE * 1024;
-    char*          test_string    = NULL;
-    unsigned int   size           = FACE_SIZE;
-    int            max_iter       = 0;
-    double         max_time       = BENCH_TIME;
-    int            compare_cached = 0;
-    int            j;
+    char*  output_name   = NULL;
+    char*  baseline_name = NULL;
+    char*  sweep_spec    = NULL;
+    char*  text_name     = NULL;
+    int    status        = 0;
+    int    num_faces     = 0;
+    int    j;
 
     unsigned int  versions[2] = { TT_INTERPRETER_VERSION_35,
                                   TT_INTERPRETER_VERSION_40 };
@@ -1080,7 +4270,7 @@
 #endif
 
 
-    if ( FT_Init_FreeType( &lib ) )
+    if ( FT_Init_FreeType( &main_ctx.lib ) )
     {
       fprintf( stderr, "could not initialize font library\n" );
 
@@ -1089,43 +4279,46 @@
 
 
     /* collect all available versions, then set again the default */
-    FT_Property_Get( lib,
+    FT_Property_Get( main_ctx.lib,
                      "truetype",
                      "interpreter-version", &dflt_tt_interpreter_version );
     for ( j = 0; j < 2; j++ )
     {
-      error = FT_Property_Set( lib,
+      error = FT_Property_Set( main_ctx.lib,
                                "truetype",
                                "interpreter-version", &versions[j] );
       if ( !error )
         tt_interpreter_versions[num_tt_interpreter_versions++] = versions[j];
     }
-    FT_Property_Set( lib,
+    FT_Property_Set( main_ctx.lib,
                      "truetype",
                      "interpreter-version", &dflt_tt_interpreter_version );
 
-    FT_Property_Get( lib,
+    FT_Property_Get( main_ctx.lib,
                      "cff",
                      "hinting-engine", &dflt_ps_hinting_engine );
     for ( j = 0; j < 2; j++ )
     {
-      error = FT_Property_Set( lib,
+      error = FT_Property_Set( main_ctx.lib,
                                "cff",
                                "hinting-engine", &engines[j] );
       if ( !error )
         ps_hinting_engines[num_ps_hinting_engines++] = engines[j];
     }
-    FT_Property_Set( lib,
+    FT_Property_Set( main_ctx.lib,
                      "cff",
                      "hinting-engine", &dflt_ps_hinting_engine );
-    FT_Property_Set( lib,
+    FT_Property_Set( main_ctx.lib,
                      "type1",
                      "hinting-engine", &dflt_ps_hinting_engine );
-    FT_Property_Set( lib,
+    FT_Property_Set( main_ctx.lib,
                      "t1cid",
                      "hinting-engine", &dflt_ps_hinting_engine );
 
 
+    tt_interpreter_version = dflt_tt_interpreter_version;
+    ps_hinting_engine      = dflt_ps_hinting_engine;
+
     version = (int)dflt_tt_interpreter_version;
     engine  = ps_hinting_engine_names[dflt_ps_hinting_engine];
 
@@ -1134,13 +4327,18 @@
       int  opt;
 
 
-      opt = getopt( argc, argv, "b:Cc:e:f:H:I:i:l:m:pr:s:t:v" );
+      opt = getopt( argc, argv,
+                    "B:b:Cc:Ee:F:f:H:I:i:j:l:Mm:n:o:P:pR:r:S:s:T:t:vw:" );
 
       if ( opt == -1 )
         break;
 
       switch ( opt )
       {
+      case 'B':
+        baseline_name = optarg;
+        break;
+
       case 'b':
         test_string = optarg;
         break;
@@ -1159,6 +4357,24 @@
         cmap_index = atoi( optarg );
         break;
 
+      case 'E':
+        use_perf = 1;
+#ifndef FTBENCH_PERF
+        fprintf( stderr,
+                 "warning: no counter support, ignoring option `-E'\n" );
+        use_perf = 0;
+#endif
+        break;
+
+      case 'F':
+        if ( !strcmp( optarg, "json" ) )
+          output_format = OUTPUT_JSON;
+        else if ( !strcmp( optarg, "csv" ) )
+          output_format = OUTPUT_CSV;
+        else
+          usage();
+        break;
+
       case 'f':
         load_flags = strtol( optarg, NULL, 16 );
         break;
@@ -1170,15 +4386,7 @@
         {
           if ( !strcmp( engine, ps_hinting_engine_names[j] ) )
           {
-            FT_Property_Set( lib,
-                             "cff",
-                             "hinting-engine", &j );
-            FT_Property_Set( lib,
-                             "type1",
-                             "hinting-engine", &j );
-            FT_Property_Set( lib,
-                             "t1cid",
-                             "hinting-engine", &j );
+            ps_hinting_engine = (unsigned int)j;
             break;
           }
         }
@@ -1195,9 +4403,7 @@
         {
           if ( version == (int)tt_interpreter_versions[j] )
           {
-            FT_Property_Set( lib,
-                             "truetype",
-                             "interpreter-version", &version );
+            tt_interpreter_version = (unsigned int)version;
             break;
           }
         }
@@ -1219,6 +4425,20 @@
         }
         break;
 
+      case 'j':
+        num_threads = atoi( optarg );
+        if ( num_threads < 1 )
+          num_threads = 1;
+#ifndef FTDEMO_THREADS
+        if ( num_threads > 1 )
+        {
+          fprintf( stderr,
+                   "warning: no thread support, ignoring option `-j'\n" );
+          num_threads = 1;
+        }
+#endif
+        break;
+
       case 'l':
         {
           int  filter = atoi( optarg );
@@ -1231,11 +4451,15 @@
           case FT_LCD_FILTER_LIGHT:
           case FT_LCD_FILTER_LEGACY1:
           case FT_LCD_FILTER_LEGACY:
-            FT_Library_SetLcdFilter( lib, (FT_LcdFilter)filter );
+            lcd_filter = filter;
           }
         }
         break;
 
+      case 'M':
+        track_memory = 1;
+        break;
+
       case 'm':
         {
           int  mb = atoi( optarg );
@@ -1246,10 +4470,40 @@
         }
         break;
 
+      case 'n':
+        num_slowest = atoi( optarg );
+        if ( num_slowest < 0 )
+          num_slowest = 0;
+        break;
+
+      case 'o':
+        output_name = optarg;
+        break;
+
+      case 'P':
+        num_workers = atoi( optarg );
+        if ( num_workers < 1 )
+          num_workers = 1;
+#ifndef FTDEMO_THREADS
+        if ( num_workers > 1 )
+        {
+          fprintf( stderr,
+                   "warning: no thread support, ignoring option `-P'\n" );
+          num_workers = 1;
+        }
+#endif
+        break;
+
       case 'p':
         preload = 1;
         break;
 
+      case 'R':
+        regress_threshold = atof( optarg );
+        if ( regress_threshold < 0 )
+          regress_threshold = -regress_threshold;
+        break;
+
       case 'r':
         {
           int  rm = atoi( optarg );
@@ -1262,6 +4516,10 @@
         }
         break;
 
+      case 'S':
+        sweep_spec = optarg;
+        break;
+
       case 's':
         {
           int  sz = atoi( optarg );
@@ -1275,6 +4533,10 @@
         }
         break;
 
+      case 'T':
+        text_name = optarg;
+        break;
+
       case 't':
         max_time = atof( optarg );
         if ( max_time < 0 )
@@ -1286,7 +4548,7 @@
           FT_Int  major, minor, patch;
 
 
-          FT_Library_Version( lib, &major, &minor, &patch );
+          FT_Library_Version( main_ctx.lib, &major, &minor, &patch );
 
           printf( "ftbench (FreeType) %d.%d", major, minor );
           if ( patch )
@@ -1296,6 +4558,12 @@
         }
         /* break; */
 
+      case 'w':
+        warmup_iter = atoi( optarg );
+        if ( warmup_iter < 0 )
+          warmup_iter = 0;
+        break;
+
       default:
         usage();
         break;
@@ -1305,274 +4573,172 @@
     argc -= optind;
     argv += optind;
 
-    if ( argc != 1 )
+    if ( argc < 1 )
       usage();
 
-    filename = *argv;
+    for ( j = 0; j < argc; j++ )
+      if ( add_input( argv[j] ) )
+      {
+        status = 1;
+        goto Exit;
+      }
 
-    if ( get_face( &face ) )
+    if ( !num_files )
+    {
+      fprintf( stderr, "no font files found\n" );
+      status = 1;
       goto Exit;
+    }
 
-    j = printf( "\n"
-                "ftbench results for font `%s'\n",
-                filename ) - 2;
-    while ( j-- )
-      putchar( '-' );
-    putchar( '\n' );
-
-    if ( cmap_index >= face->num_charmaps )
-      cmap_index = -1;
-    if ( cmap_index >= 0 )
-      face->charmap = face->charmaps[cmap_index];
-
-    /* sync target and mode */
-    load_flags |= FT_LOAD_TARGET_( render_mode );
-    render_mode = (FT_Render_Mode)( ( load_flags & 0xF0000 ) >> 16 );
-
-    header( face );
-
-    if ( !face->num_glyphs )
-      goto Exit;
+    if ( argc > 1 )
+      corpus = 1;
 
-    if ( first_index >= face->num_glyphs )
-      first_index = face->num_glyphs - 1;
-    if ( last_index >= face->num_glyphs )
-      last_index = face->num_glyphs - 1;
-    incr_index = last_index > first_index ? 1 : -1;
+    if ( num_workers > num_files )
+      num_workers = num_files;
+    if ( num_workers > 1 && num_threads > 1 )
+    {
+      fprintf( stderr,
+               "warning: option `-P' given, ignoring option `-j'\n" );
+      num_threads = 1;
+    }
 
-    if ( size )
+#ifdef FTBENCH_PERF
+    if ( use_perf )
     {
-      if ( FT_IS_SCALABLE( face ) )
-      {
-        if ( FT_Set_Pixel_Sizes( face, size, size ) )
-        {
-          fprintf( stderr, "failed to set pixel size to %u\n", size );
+      bperf_t  perf;
 
-          return 1;
-        }
-      }
-      else
+
+      if ( perf_open( &perf ) )
       {
-        size = (unsigned int)face->available_sizes[0].size >> 6;
         fprintf( stderr,
-                 "using size of first bitmap strike (%upx)\n", size );
-        FT_Select_Size( face, 0 );
+                 "warning: couldn't open hardware performance counters\n" );
+        use_perf = 0;
       }
+      else
+        perf_close( &perf );
     }
+#endif
 
-    FTC_Manager_New( lib,
-                     0,
-                     0,
-                     max_bytes,
-                     face_requester,
-                     face,
-                     &cache_man );
-
-    font_type.face_id = (FTC_FaceID)1;
-    font_type.width   = size;
-    font_type.height  = size;
-    font_type.flags   = load_flags;
-
-    printf( "\n"
-            "font preloading into memory: %s\n"
-            "maximum cache size: %lu KiByte\n",
-            preload ? "yes" : face->stream->base ? "mapped" : "no",
-            max_bytes / 1024 );
-
-    printf( "\n"
-            "testing glyph indices from %d to %d at %u ppem\n"
-            "number of seconds for each test: %s%g\n",
-            first_index, last_index, size,
-            max_iter ? "at most " : "", max_time );
-    if ( max_iter )
-      printf( "number of iterations for each test: at most %d\n",
-              max_iter );
-
-    printf( "\n"
-            "executing tests:\n" );
+    /* sync target and mode */
+    load_flags |= FT_LOAD_TARGET_( render_mode );
+    render_mode = (FT_Render_Mode)( ( load_flags & 0xF0000 ) >> 16 );
 
-    for ( j = 0; j < N_FT_BENCH; j++ )
+    if ( sweep_spec )
     {
-      btest_t   test;
-      FT_ULong  flags;
-
+      status = run_sweep( sweep_spec );
+      goto Exit;
+    }
 
-      if ( !TEST( 'a' + j ) )
-        continue;
+    if ( text_name && load_text( text_name ) )
+    {
+      status = 1;
+      goto Exit;
+    }
 
-      test.title       = NULL;
-      test.bench       = NULL;
-      test.cache_first = 0;
-      test.user_data   = NULL;
+    if ( baseline_name && load_baseline( baseline_name ) )
+    {
+      status = 1;
+      goto Exit;
+    }
 
-      switch ( j )
+    if ( output_name )
+    {
+      output = fopen( output_name, "w" );
+      if ( !output )
       {
-      case FT_BENCH_LOAD_GLYPH:
-        test.title = "Load";
-        test.bench = test_load;
-        benchmark( face, &test, max_iter, max_time );
-
-        if ( compare_cached )
-        {
-          test.cache_first = 1;
-
-          test.title = "Load (image cached)";
-          test.bench = test_image_cache;
-          benchmark( face, &test, max_iter, max_time );
-
-          test.title = "Load (sbit cached)";
-          test.bench = test_sbit_cache;
-          if ( size )
-            benchmark( face, &test, max_iter, max_time );
-          else
-            printf( "  %-25s disabled (size = 0)\n", test.title );
-        }
-        break;
-
-      case FT_BENCH_LOAD_ADVANCES:
-        test.user_data = &flags;
-
-        test.title = "Load_Advances (Normal)";
-        test.bench = test_load_advances;
-        flags      = FT_LOAD_DEFAULT;
-        benchmark( face, &test, max_iter, max_time );
-
-        test.title  = "Load_Advances (Fast)";
-        test.bench  = test_load_advances;
-        flags       = FT_LOAD_TARGET_LIGHT;
-        benchmark( face, &test, max_iter, max_time );
-
-        test.title  = "Load_Advances (Unscaled)";
-        test.bench  = test_load_advances;
-        flags       = FT_LOAD_NO_SCALE;
-        benchmark( face, &test, max_iter, max_time );
-        break;
-
-      case FT_BENCH_RENDER:
-        test.title = "Render";
-        test.bench = test_render;
-        if ( size )
-          benchmark( face, &test, max_iter, max_time );
-        else
-          printf( "  %-25s disabled (size = 0)\n", test.title );
-        break;
-
-      case FT_BENCH_GET_GLYPH:
-        test.title = "Get_Glyph";
-        test.bench = test_get_glyph;
-        benchmark( face, &test, max_iter, max_time );
-        break;
-
-      case FT_BENCH_GET_CBOX:
-        test.title = "Get_CBox";
-        test.bench = test_get_cbox;
-        benchmark( face, &test, max_iter, max_time );
-        break;
-
-      case FT_BENCH_GET_BBOX:
-        test.title = "Get_BBox";
-        test.bench = test_get_bbox;
-        {
-          FT_Matrix  rot30 = { 0xDDB4, -0x8000, 0x8000, 0xDDB4 };
-
-
-          /* rotate outlines by 30 degrees so that CBox and BBox are different */
-          FT_Set_Transform( face, &rot30, NULL );
-          benchmark( face, &test, max_iter, max_time );
-          FT_Set_Transform( face, NULL, NULL );
-        }
-        break;
-
-      case FT_BENCH_CMAP:
-        {
-          bcharset_t  charset;
-
+        fprintf( stderr, "couldn't open `%s'\n", output_name );
+        status = 1;
+        goto Exit;
+      }
 
-          get_charset( face, &charset );
-          if ( charset.code )
-          {
-            test.user_data = (void*)&charset;
+      output_begin( max_iter, max_time );
+    }
 
+    if ( track_memory )
+    {
+      /* start over with a library that counts its allocations */
+      FT_Done_FreeType( main_ctx.lib );
+      main_ctx.lib = NULL;
 
-            test.title = "Get_Char_Index";
-            test.bench = test_get_char_index;
+      if ( new_library( &main_ctx ) )
+      {
+        fprintf( stderr, "could not initialize font library\n" );
+        status = 1;
+        goto Exit;
+      }
+    }
+    else
+      set_properties( main_ctx.lib );
 
-            benchmark( face, &test, max_iter, max_time );
+    main_ctx.out    = stdout;
+    main_ctx.output = output;
 
-            if ( compare_cached )
-            {
-              test.cache_first = 1;
+#ifdef FTDEMO_THREADS
+    if ( num_workers > 1 )
+      num_faces = run_workers();
+    else
+#endif
+      for ( j = 0; j < num_files; j++ )
+        num_faces += bench_file( &main_ctx, files[j] );
 
-              test.title = "Get_Char_Index (cached)";
-              test.bench = test_cmap_cache;
-              benchmark( face, &test, max_iter, max_time );
-            }
+    if ( corpus )
+    {
+      print_summary( num_files, num_faces );
 
-            free( charset.code );
-          }
-        }
-        break;
+      if ( num_errors )
+        printf( "\n"
+                "%d fonts or faces couldn't be tested\n",
+                num_errors );
+    }
+    else if ( num_errors )
+      status = 1;
 
-      case FT_BENCH_CMAP_ITER:
-        test.title = "Iterate CMap";
-        test.bench = test_cmap_iter;
-        benchmark( face, &test, max_iter, max_time );
-        break;
+    if ( baseline )
+    {
+      printf( "\n"
+              "compared %d tests with `%s':\n"
+              "  %d significantly faster,"
+              " %d regressed by more than %g%%\n",
+              num_compared, baseline_name,
+              num_faster, num_regressed, regress_threshold );
+
+      if ( num_regressed )
+        status = 1;
+    }
 
-      case FT_BENCH_NEW_FACE:
-        test.title = "New_Face";
-        test.bench = test_new_face;
-        benchmark( face, &test, max_iter, max_time );
-        break;
+  Exit:
+    if ( output )
+    {
+      output_end();
+      fclose( output );
+    }
 
-      case FT_BENCH_EMBOLDEN:
-        test.title = "Embolden";
-        test.bench = test_embolden;
-        if ( size )
-          benchmark( face, &test, max_iter, max_time );
-        else
-          printf( "  %-25s disabled (size = 0)\n", test.title );
-        break;
+    done_context( &main_ctx );
 
-      case FT_BENCH_STROKE:
-        test.title = "Stroke";
-        test.bench = test_stroke;
-        if ( size )
-          benchmark( face, &test, max_iter, max_time );
-        else
-          printf( "  %-25s disabled (size = 0)\n", test.title );
-        break;
+    for ( j = 0; j < num_files; j++ )
+      free( files[j] );
+    free( files );
 
-      case FT_BENCH_NEW_FACE_AND_LOAD_GLYPH:
-        test.title = "New_Face & load glyph(s)";
-        test.bench = test_new_face_and_load_glyph;
-        benchmark( face, &test, max_iter, max_time );
-        break;
-      }
+    for ( j = 0; j < num_records; j++ )
+    {
+      free( records[j].font );
+      free( records[j].format );
+      free( records[j].driver );
     }
+    free( records );
 
-  Exit:
-    /* The following is a bit subtle: When we call FTC_Manager_Done, this
-     * normally destroys all FT_Face objects that the cache might have
-     * created by calling the face requester.
-     *
-     * However, this little benchmark uses a tricky face requester that
-     * doesn't create a new FT_Face through FT_New_Face but simply passes a
-     * pointer to the one that was previously created.
-     *
-     * If the cache manager has been used before, the call to
-     * FTC_Manager_Done discards our single FT_Face.
-     *
-     * In the case where no cache manager is in place, or if no test was
-     * run, the call to FT_Done_FreeType releases any remaining FT_Face
-     * object anyway.
-     */
-    if ( cache_man )
-      FTC_Manager_Done( cache_man );
+    for ( j = 0; j < num_baseline; j++ )
+    {
+      free( baseline[j].font );
+      free( baseline[j].test );
+    }
+    free( baseline );
 
-    FT_Done_FreeType( lib );
+    free( text.data );
+    free( text.line_start );
+    free( text.line_end );
 
-    return 0;
+    return status;
   }
 
 
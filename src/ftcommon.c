@@ -35,6 +35,13 @@
 #include <string.h>
 #include <stdarg.h>
 
+#ifdef UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 
 #ifdef _WIN32
 #define strcasecmp  _stricmp
@@ -253,6 +260,174 @@
 #define TRUNC( x )  (   (x) >> 6 )
 
 
+  /*************************************************************************/
+  /*                                                                       */
+  /* Preloaded font files get memory-mapped if possible, so that only the  */
+  /* pages FreeType actually reads take up memory, and read otherwise.     */
+  /* This happens when a face of the file is first selected, so that       */
+  /* installing hundreds of fonts costs no more than without preloading.   */
+  /*                                                                       */
+  static int
+  font_file_map( PFontFile    file,
+                 const char*  filepath )
+  {
+#ifdef UNIX
+    struct stat  st;
+    void*        address;
+    int          fd;
+
+
+    fd = open( filepath, O_RDONLY );
+    if ( fd < 0 )
+      return 0;
+
+    if ( fstat( fd, &st ) || st.st_size <= 0 )
+    {
+      close( fd );
+      return 0;
+    }
+
+    address = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                    fd, 0 );
+    close( fd );
+
+    if ( address == MAP_FAILED )
+      return 0;
+
+    /* the hints are just that */
+#ifdef MADV_WILLNEED
+    if ( file->mode == PRELOAD_MAP_WILLNEED )
+      (void)madvise( address, (size_t)st.st_size, MADV_WILLNEED );
+#endif
+#ifdef MADV_RANDOM
+    if ( file->mode == PRELOAD_MAP_RANDOM )
+      (void)madvise( address, (size_t)st.st_size, MADV_RANDOM );
+#endif
+
+    file->address = address;
+    file->size    = (size_t)st.st_size;
+    file->mapped  = 1;
+
+    return 1;
+
+#else /* !UNIX */
+
+    FT_UNUSED( file );
+    FT_UNUSED( filepath );
+
+    return 0;
+
+#endif /* !UNIX */
+  }
+
+
+  static int
+  font_file_read( PFontFile    file,
+                  const char*  filepath )
+  {
+    FILE*  fp = fopen( filepath, "rb" );
+    long   size;
+    void*  address;
+
+
+    if ( !fp )
+      return 0;
+
+    if ( fseek( fp, 0, SEEK_END )         ||
+         ( size = ftell( fp ) ) <= 0      ||
+         fseek( fp, 0, SEEK_SET )         ||
+         !( address = malloc( (size_t)size ) ) )
+    {
+      fclose( fp );
+      return 0;
+    }
+
+    if ( !fread( address, (size_t)size, 1, fp ) )
+    {
+      free( address );
+      fclose( fp );
+      return 0;
+    }
+
+    fclose( fp );
+
+    file->address = address;
+    file->size    = (size_t)size;
+    file->mapped  = 0;
+
+    return 1;
+  }
+
+
+  /* load the file of `font' if not done yet; on failure, the */
+  /* face gets opened from the file path as usual              */
+  static void
+  font_file_load( PFont  font )
+  {
+    PFontFile  file = font->file;
+
+
+    if ( !file || file->address )
+      return;
+
+    if ( file->mode != PRELOAD_READ              &&
+         font_file_map( file, font->filepathname ) )
+      return;
+
+    (void)font_file_read( file, font->filepathname );
+  }
+
+
+  static void
+  font_file_release( PFontFile  file )
+  {
+    if ( !file || --file->ref_count > 0 )
+      return;
+
+#ifdef UNIX
+    if ( file->address && file->mapped )
+      munmap( file->address, file->size );
+    else
+#endif
+      free( file->address );
+
+    free( file );
+  }
+
+
+#ifdef UNIX
+
+  /* count the pages of a mapped file that are in memory */
+  static size_t
+  font_file_resident( PFontFile  file )
+  {
+    size_t          page      = (size_t)sysconf( _SC_PAGESIZE );
+    size_t          num_pages = ( file->size + page - 1 ) / page;
+    size_t          count     = 0;
+    size_t          i;
+    unsigned char*  vec;
+
+
+    vec = (unsigned char*)malloc( num_pages );
+    if ( !vec )
+      return 0;
+
+    /* the vector is `char*' on some systems */
+    if ( !mincore( file->address, file->size, (void*)vec ) )
+      for ( i = 0; i < num_pages; i++ )
+        if ( vec[i] & 1 )
+          count++;
+
+    free( vec );
+
+    count *= page;
+
+    return count < file->size ? count : file->size;
+  }
+
+#endif /* UNIX */
+
+
   /*************************************************************************/
   /*                                                                       */
   /* The face requester is a function provided by the client application   */
@@ -267,23 +442,25 @@
                      FT_Pointer  request_data,
                      FT_Face*    aface )
   {
-    PFont  font = (PFont)face_id;
+    PFont     font = (PFont)face_id;
+    FT_Error  err;
 
     FT_UNUSED( request_data );
 
 
-    if ( font->file_address != NULL )
-      error = FT_New_Memory_Face( lib,
-                                  (const FT_Byte*)font->file_address,
-                                  (FT_Long)font->file_size,
-                                  font->face_index,
-                                  aface );
+    /* don't touch `error'; this gets called from render threads, too */
+    if ( font->file && font->file->address )
+      err = FT_New_Memory_Face( lib,
+                                (const FT_Byte*)font->file->address,
+                                (FT_Long)font->file->size,
+                                font->face_index,
+                                aface );
     else
-      error = FT_New_Face( lib,
-                           font->filepathname,
-                           font->face_index,
-                           aface );
-    if ( !error )
+      err = FT_New_Face( lib,
+                         font->filepathname,
+                         font->face_index,
+                         aface );
+    if ( !err )
     {
       const char*  format = FT_Get_Font_Format( *aface );
 
@@ -338,7 +515,7 @@
         (*aface)->charmap = (*aface)->charmaps[font->cmap_index];
     }
 
-    return error;
+    return err;
   }
 
 
@@ -394,9 +571,7 @@
 
     handle->use_sbits_cache = 1;
 
-    /* string_init */
-    memset( handle->string, 0, sizeof ( TGlyph ) * MAX_GLYPHS );
-    handle->string_length = 0;
+    handle->bitmap_cache.max_bytes = MAX_BITMAP_BYTES;
 
     return handle;
   }
@@ -411,19 +586,8 @@
     if ( !handle )
       return;
 
-    for ( i = 0; i < handle->max_fonts; i++ )
-    {
-      if ( handle->fonts[i] )
-      {
-        if ( handle->fonts[i]->filepathname )
-          free( (void*)handle->fonts[i]->filepathname );
-        free( handle->fonts[i] );
-      }
-    }
-    free( handle->fonts );
-
     /* string_done */
-    for ( i = 0; i < MAX_GLYPHS; i++ )
+    for ( i = 0; i < handle->string_max; i++ )
     {
       PGlyph  glyph = handle->string + i;
 
@@ -431,10 +595,28 @@
       if ( glyph->image )
         FT_Done_Glyph( glyph->image );
     }
+    free( handle->string );
+
+    FTDemo_Bitmap_Cache_Reset( handle );
+    free( handle->bitmap_cache.buckets );
 
     FT_Stroker_Done( handle->stroker );
     FT_Bitmap_Done( handle->library, &handle->bitmap );
     FTC_Manager_Done( handle->cache_manager );
+
+    /* the faces are gone now, and with them the last file accesses */
+    for ( i = 0; i < handle->max_fonts; i++ )
+    {
+      if ( handle->fonts[i] )
+      {
+        if ( handle->fonts[i]->filepathname )
+          free( (void*)handle->fonts[i]->filepathname );
+        font_file_release( handle->fonts[i]->file );
+        free( handle->fonts[i] );
+      }
+    }
+    free( handle->fonts );
+
     FT_Done_FreeType( handle->library );
 
     free( handle );
@@ -547,6 +729,7 @@
   {
     long          i, num_faces;
     FT_Face       face;
+    PFontFile     file = NULL;
 
 
     /* We use a conservative approach here, at the cost of calling     */
@@ -609,54 +792,25 @@
 
         font->palette_index = 0;
 
+        /* the file gets loaded on first use of one of its faces */
+        font->file = NULL;
         if ( handle->preload )
         {
-          FILE*   file = fopen( filepath, "rb" );
-          size_t  file_size;
-
-
-          if ( file == NULL )  /* shouldn't happen */
-          {
-            free( (void*)font->filepathname );
-            free( font );
-            return FT_Err_Invalid_Argument;
-          }
-
-          fseek( file, 0, SEEK_END );
-          file_size = (size_t)ftell( file );
-          fseek( file, 0, SEEK_SET );
-
-          if ( file_size <= 0 )
-          {
-            free( font );
-            fclose( file );
-            return FT_Err_Invalid_Stream_Operation;
-          }
-
-          font->file_address = malloc( file_size );
-          if ( !font->file_address )
+          if ( !file )
           {
-            free( font );
-            fclose( file );
-            return FT_Err_Out_Of_Memory;
+            file = (PFontFile)calloc( 1, sizeof ( TFontFile ) );
+            if ( !file )
+            {
+              free( (void*)font->filepathname );
+              free( font );
+              return FT_Err_Out_Of_Memory;
+            }
+
+            file->mode = handle->preload;
           }
 
-          if ( !fread( font->file_address, file_size, 1, file ) )
-          {
-            free( font->file_address );
-            free( font );
-            fclose( file );
-            return FT_Err_Invalid_Stream_Read;
-          }
-
-          font->file_size = file_size;
-
-          fclose( file );
-        }
-        else
-        {
-          font->file_address = NULL;
-          font->file_size    = 0;
+          file->ref_count++;
+          font->file = file;
         }
 
         FT_Done_Face( face );
@@ -737,6 +891,8 @@
     int      index = font->cmap_index;
 
 
+    font_file_load( font );
+
     handle->current_font   = font;
     handle->scaler.face_id = (FTC_FaceID)font;
 
@@ -866,7 +1022,47 @@
   FTDemo_Set_Preload( FTDemo_Handle*  handle,
                       int             preload )
   {
-    handle->preload = !!preload;
+    if ( preload < PRELOAD_NONE || preload >= N_PRELOAD_MODES )
+      preload = PRELOAD_MAP;
+
+    handle->preload = preload;
+  }
+
+
+  void
+  FTDemo_Preload_Stats( FTDemo_Handle*  handle,
+                        size_t*         total,
+                        size_t*         resident )
+  {
+    PFontFile  last = NULL;
+    int        i;
+
+
+    *total    = 0;
+    *resident = 0;
+
+    /* the faces of a file are installed one after another */
+    for ( i = 0; i < handle->num_fonts; i++ )
+    {
+      PFontFile  file = handle->fonts[i]->file;
+
+
+      if ( !file || file == last || !file->address )
+        continue;
+
+      last    = file;
+      *total += file->size;
+
+#ifdef UNIX
+      if ( file->mapped )
+      {
+        *resident += font_file_resident( file );
+        continue;
+      }
+#endif
+
+      *resident += file->size;
+    }
   }
 
 
@@ -1035,6 +1231,8 @@
     /* lazy to walk over all loaded fonts to check whether they */
     /* are of appropriate type, then unloading them explicitly. */
     FTC_Manager_Reset( handle->cache_manager );
+    FTDemo_Bitmap_Cache_Reset( handle );
+    handle->string_loaded = 0;
 
     return 1;
   }
@@ -1342,15 +1540,31 @@
                           int*            x_advance,
                           int*            y_advance,
                           FT_Glyph*       aglyf )
+  {
+    error = FTDemo_Glyph_To_Bitmap_R( handle, glyf, target, left, top,
+                                      x_advance, y_advance, aglyf );
+
+    return error;
+  }
+
+
+  FT_Error
+  FTDemo_Glyph_To_Bitmap_R( FTDemo_Handle*  handle,
+                            FT_Glyph        glyf,
+                            grBitmap*       target,
+                            int*            left,
+                            int*            top,
+                            int*            x_advance,
+                            int*            y_advance,
+                            FT_Glyph*       aglyf )
   {
     FT_BitmapGlyph  bitmap;
     FT_Bitmap*      source;
+    FT_Error        err = FT_Err_Ok;
 
 
     *aglyf = NULL;
 
-    error = FT_Err_Ok;
-
     if ( glyf->format == FT_GLYPH_FORMAT_OUTLINE ||
          glyf->format == FT_GLYPH_FORMAT_SVG     )
     {
@@ -1383,9 +1597,9 @@
       }
 
       /* render the glyph to a bitmap, don't destroy original */
-      error = FT_Glyph_To_Bitmap( &glyf, render_mode, NULL, 0 );
-      if ( error )
-        return error;
+      err = FT_Glyph_To_Bitmap( &glyf, render_mode, NULL, 0 );
+      if ( err )
+        return err;
 
       *aglyf = glyf;
     }
@@ -1451,6 +1665,441 @@
     *x_advance = ( glyf->advance.x + 0x8000 ) >> 16;
     *y_advance = ( glyf->advance.y + 0x8000 ) >> 16;
 
+    return err;
+  }
+
+
+  void
+  FTDemo_Bitmap_Upgray( grBitmap*  bitmap )
+  {
+    unsigned char*  p;
+    size_t          i, size;
+    unsigned int    scale;
+
+
+    if ( bitmap->mode != gr_pixel_mode_gray ||
+         bitmap->grays <= 1                 ||
+         bitmap->grays == 256               )
+      return;
+
+    p     = bitmap->buffer;
+    size  = (size_t)abs( bitmap->pitch ) * (size_t)bitmap->rows;
+    scale = 255U / (unsigned int)( bitmap->grays - 1 );
+
+    for ( i = 0; i < size; i++ )
+      p[i] = (unsigned char)( p[i] * scale );
+
+    bitmap->grays = 256;
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* The bitmap cache holds final glyph bitmaps, keyed by everything that  */
+  /* goes into them, in a hash table.  A doubly-linked list orders the     */
+  /* nodes by last use; the least recently used ones are dropped whenever  */
+  /* the byte budget would be exceeded.  Each bitmap buffer directly       */
+  /* follows its node in memory.                                           */
+  /*                                                                       */
+  /*************************************************************************/
+
+  typedef struct  BKey_
+  {
+    FTC_FaceID      face_id;
+    FT_UInt         width;
+    FT_UInt         height;
+    FT_Int          pixel;
+    FT_UInt         x_res;
+    FT_UInt         y_res;
+    FT_Int32        load_flags;
+    int             lcd_mode;
+    FT_UInt         gindex;
+    FTDemo_Variant  variant;
+
+  } BKey;
+
+
+  typedef struct  FTDemo_BNodeRec_
+  {
+    FTDemo_BNode   link;      /* next node in the same bucket */
+    FTDemo_BNode   prev;      /* the LRU list                 */
+    FTDemo_BNode   next;
+
+    BKey           key;
+    unsigned long  hash;
+    size_t         size;      /* node and buffer */
+
+    grBitmap       bitmap;
+    int            left;
+    int            top;
+    FT_Vector      advance;
+
+  } FTDemo_BNodeRec;
+
+
+#define BCACHE_MIN_BUCKETS  256
+
+#define BKEY_MIX( h, v )  ( ( (h) ^ (unsigned long)(v) ) * 0x01000193UL )
+
+
+  static void
+  bcache_key( FTDemo_Handle*         handle,
+              const FTDemo_Variant*  variant,
+              FT_UInt                gindex,
+              BKey*                  key )
+  {
+    key->face_id    = handle->scaler.face_id;
+    key->width      = handle->scaler.width;
+    key->height     = handle->scaler.height;
+    key->pixel      = handle->scaler.pixel;
+    key->x_res      = handle->scaler.x_res;
+    key->y_res      = handle->scaler.y_res;
+    key->load_flags = handle->load_flags;
+    key->lcd_mode   = handle->lcd_mode;
+    key->gindex     = gindex;
+
+    if ( variant )
+      key->variant = *variant;
+    else
+      memset( &key->variant, 0, sizeof ( FTDemo_Variant ) );
+  }
+
+
+  static unsigned long
+  bcache_hash( const BKey*  key )
+  {
+    const FTDemo_Variant*  v = &key->variant;
+    unsigned long          h = 0x811C9DC5UL;
+
+
+    h = BKEY_MIX( h, (size_t)key->face_id );
+    h = BKEY_MIX( h, key->width );
+    h = BKEY_MIX( h, key->height );
+    h = BKEY_MIX( h, key->pixel );
+    h = BKEY_MIX( h, key->x_res );
+    h = BKEY_MIX( h, key->y_res );
+    h = BKEY_MIX( h, key->load_flags );
+    h = BKEY_MIX( h, key->lcd_mode );
+    h = BKEY_MIX( h, key->gindex );
+
+    h = BKEY_MIX( h, v->kind );
+    h = BKEY_MIX( h, v->palette_index );
+    h = BKEY_MIX( h, v->matrix.xx );
+    h = BKEY_MIX( h, v->matrix.xy );
+    h = BKEY_MIX( h, v->matrix.yx );
+    h = BKEY_MIX( h, v->matrix.yy );
+    h = BKEY_MIX( h, v->radius );
+    h = BKEY_MIX( h, v->xstr );
+    h = BKEY_MIX( h, v->ystr );
+
+    return h;
+  }
+
+
+  static int
+  bcache_equal( const BKey*  a,
+                const BKey*  b )
+  {
+    const FTDemo_Variant*  va = &a->variant;
+    const FTDemo_Variant*  vb = &b->variant;
+
+
+    return a->face_id          == b->face_id          &&
+           a->width            == b->width            &&
+           a->height           == b->height           &&
+           a->pixel            == b->pixel            &&
+           a->x_res            == b->x_res            &&
+           a->y_res            == b->y_res            &&
+           a->load_flags       == b->load_flags       &&
+           a->lcd_mode         == b->lcd_mode         &&
+           a->gindex           == b->gindex           &&
+           va->kind            == vb->kind            &&
+           va->palette_index   == vb->palette_index   &&
+           va->matrix.xx       == vb->matrix.xx       &&
+           va->matrix.xy       == vb->matrix.xy       &&
+           va->matrix.yx       == vb->matrix.yx       &&
+           va->matrix.yy       == vb->matrix.yy       &&
+           va->radius          == vb->radius          &&
+           va->xstr            == vb->xstr            &&
+           va->ystr            == vb->ystr;
+  }
+
+
+  /* remove `node' from the LRU list */
+  static void
+  bcache_unlink( FTDemo_Bitmap_Cache*  cache,
+                 FTDemo_BNode          node )
+  {
+    if ( node->prev )
+      node->prev->next = node->next;
+    else
+      cache->head = node->next;
+
+    if ( node->next )
+      node->next->prev = node->prev;
+    else
+      cache->tail = node->prev;
+  }
+
+
+  /* put `node' at the front of the LRU list */
+  static void
+  bcache_push( FTDemo_Bitmap_Cache*  cache,
+               FTDemo_BNode          node )
+  {
+    node->prev = NULL;
+    node->next = cache->head;
+
+    if ( cache->head )
+      cache->head->prev = node;
+    else
+      cache->tail = node;
+
+    cache->head = node;
+  }
+
+
+  static void
+  bcache_remove( FTDemo_Bitmap_Cache*  cache,
+                 FTDemo_BNode          node )
+  {
+    FTDemo_BNode*  pnode = cache->buckets +
+                             node->hash % cache->num_buckets;
+
+
+    while ( *pnode != node )
+      pnode = &(*pnode)->link;
+    *pnode = node->link;
+
+    bcache_unlink( cache, node );
+
+    cache->cur_bytes -= node->size;
+    cache->num_nodes--;
+
+    free( node );
+  }
+
+
+  /* drop the least recently used nodes until `size' more bytes fit */
+  static void
+  bcache_shrink( FTDemo_Bitmap_Cache*  cache,
+                 size_t                size )
+  {
+    while ( cache->tail && cache->cur_bytes + size > cache->max_bytes )
+    {
+      bcache_remove( cache, cache->tail );
+      cache->evictions++;
+    }
+  }
+
+
+  /* keep the load factor at most 1; failing to grow is harmless */
+  static void
+  bcache_grow( FTDemo_Bitmap_Cache*  cache )
+  {
+    unsigned int   new_num, i;
+    FTDemo_BNode*  new_buckets;
+
+
+    if ( cache->num_nodes < cache->num_buckets )
+      return;
+
+    new_num     = cache->num_buckets ? 2 * cache->num_buckets
+                                     : BCACHE_MIN_BUCKETS;
+    new_buckets = (FTDemo_BNode*)calloc( new_num, sizeof ( FTDemo_BNode ) );
+    if ( !new_buckets )
+      return;
+
+    for ( i = 0; i < cache->num_buckets; i++ )
+    {
+      FTDemo_BNode  node = cache->buckets[i];
+
+
+      while ( node )
+      {
+        FTDemo_BNode   link  = node->link;
+        FTDemo_BNode*  pnode = new_buckets + node->hash % new_num;
+
+
+        node->link = *pnode;
+        *pnode     = node;
+        node       = link;
+      }
+    }
+
+    free( cache->buckets );
+    cache->buckets     = new_buckets;
+    cache->num_buckets = new_num;
+  }
+
+
+  void
+  FTDemo_Bitmap_Cache_Set_Budget( FTDemo_Handle*  handle,
+                                  size_t          max_bytes )
+  {
+    FTDemo_Bitmap_Cache*  cache = &handle->bitmap_cache;
+
+
+    cache->max_bytes = max_bytes;
+    bcache_shrink( cache, 0 );
+  }
+
+
+  void
+  FTDemo_Bitmap_Cache_Reset( FTDemo_Handle*  handle )
+  {
+    FTDemo_Bitmap_Cache*  cache = &handle->bitmap_cache;
+    FTDemo_BNode          node  = cache->head;
+
+
+    while ( node )
+    {
+      FTDemo_BNode  next = node->next;
+
+
+      free( node );
+      node = next;
+    }
+
+    if ( cache->buckets )
+      memset( cache->buckets, 0,
+              cache->num_buckets * sizeof ( FTDemo_BNode ) );
+
+    cache->head      = NULL;
+    cache->tail      = NULL;
+    cache->num_nodes = 0;
+    cache->cur_bytes = 0;
+  }
+
+
+  FT_Bool
+  FTDemo_Bitmap_Cache_Lookup( FTDemo_Handle*         handle,
+                              const FTDemo_Variant*  variant,
+                              FT_UInt                gindex,
+                              grBitmap*              target,
+                              int*                   left,
+                              int*                   top,
+                              FT_Vector*             advance )
+  {
+    FTDemo_Bitmap_Cache*  cache = &handle->bitmap_cache;
+    FTDemo_BNode          node;
+    BKey                  key;
+    unsigned long         hash;
+
+
+    if ( !cache->max_bytes )
+      return 0;
+
+    bcache_key( handle, variant, gindex, &key );
+    hash = bcache_hash( &key );
+
+    node = cache->num_buckets ? cache->buckets[hash % cache->num_buckets]
+                              : NULL;
+    for ( ; node; node = node->link )
+      if ( node->hash == hash && bcache_equal( &node->key, &key ) )
+        break;
+
+    if ( !node )
+    {
+      cache->misses++;
+      return 0;
+    }
+
+    cache->hits++;
+
+    if ( node != cache->head )
+    {
+      bcache_unlink( cache, node );
+      bcache_push( cache, node );
+    }
+
+    *target  = node->bitmap;
+    *left    = node->left;
+    *top     = node->top;
+    *advance = node->advance;
+
+    return 1;
+  }
+
+
+  FT_Error
+  FTDemo_Bitmap_Cache_Render( FTDemo_Handle*         handle,
+                              const FTDemo_Variant*  variant,
+                              FT_UInt                gindex,
+                              FT_Glyph               glyf,
+                              grBitmap*              target,
+                              int*                   left,
+                              int*                   top,
+                              FT_Vector*             advance,
+                              FT_Glyph*              aglyf )
+  {
+    FTDemo_Bitmap_Cache*  cache = &handle->bitmap_cache;
+    FTDemo_BNode          node;
+    FTDemo_BNode*         pnode;
+    size_t                bytes, size;
+    int                   x_advance, y_advance;
+
+
+    error = FTDemo_Glyph_To_Bitmap( handle, glyf, target, left, top,
+                                    &x_advance, &y_advance, aglyf );
+    if ( error )
+      return error;
+
+    *advance = glyf->advance;
+
+    bytes = (size_t)abs( target->pitch ) * (size_t)target->rows;
+    size  = sizeof ( FTDemo_BNodeRec ) + bytes;
+
+    if ( size > cache->max_bytes )
+      return error;
+
+    node = (FTDemo_BNode)malloc( size );
+    if ( !node )
+      return error;
+
+    bcache_shrink( cache, size );
+
+    bcache_key( handle, variant, gindex, &node->key );
+    node->hash = bcache_hash( &node->key );
+    node->size = size;
+
+    node->bitmap        = *target;
+    node->bitmap.buffer = (unsigned char*)( node + 1 );
+    if ( bytes )
+      memcpy( node->bitmap.buffer, target->buffer, bytes );
+
+    /* the blitter would otherwise rescale the cached pixels in place */
+    /* each time the node is drawn                                    */
+    FTDemo_Bitmap_Upgray( &node->bitmap );
+
+    node->left    = *left;
+    node->top     = *top;
+    node->advance = *advance;
+
+    bcache_grow( cache );
+    if ( !cache->num_buckets )
+    {
+      free( node );
+      return error;
+    }
+
+    pnode      = cache->buckets + node->hash % cache->num_buckets;
+    node->link = *pnode;
+    *pnode     = node;
+
+    bcache_push( cache, node );
+
+    cache->cur_bytes += size;
+    cache->num_nodes++;
+
+    /* hand out the cached copy so that the glyph can go */
+    *target = node->bitmap;
+    if ( *aglyf )
+    {
+      FT_Done_Glyph( *aglyf );
+      *aglyf = NULL;
+    }
+
     return error;
   }
 
@@ -1564,20 +2213,40 @@
 
     /* otherwise, use an image cache to store glyph outlines, and render */
     /* them on demand. we can thus support very large sizes easily..     */
+    /* the bitmap cache spares us the rendering of recently used glyphs  */
     {
-      FT_Glyph  glyf;
+      FTDemo_Variant  variant;
+      FT_Vector       advance;
+      FT_Glyph        glyf;
+
 
+      memset( &variant, 0, sizeof ( FTDemo_Variant ) );
+      variant.palette_index = handle->current_font->palette_index;
 
-      error = FTC_ImageCache_LookupScaler( handle->image_cache,
-                                           &handle->scaler,
-                                           (FT_ULong)handle->load_flags,
-                                           Index,
-                                           &glyf,
-                                           NULL );
+      if ( FTDemo_Bitmap_Cache_Lookup( handle, &variant, (FT_UInt)Index,
+                                       target, left, top, &advance ) )
+        error = FT_Err_Ok;
+      else
+      {
+        error = FTC_ImageCache_LookupScaler( handle->image_cache,
+                                             &handle->scaler,
+                                             (FT_ULong)handle->load_flags,
+                                             Index,
+                                             &glyf,
+                                             NULL );
+
+        if ( !error )
+          error = FTDemo_Bitmap_Cache_Render( handle, &variant,
+                                              (FT_UInt)Index, glyf,
+                                              target, left, top,
+                                              &advance, aglyf );
+      }
 
       if ( !error )
-        error = FTDemo_Glyph_To_Bitmap( handle, glyf, target, left, top,
-                                        x_advance, y_advance, aglyf );
+      {
+        *x_advance = (int)( ( advance.x + 0x8000 ) >> 16 );
+        *y_advance = (int)( ( advance.y + 0x8000 ) >> 16 );
+      }
     }
 
   Exit:
@@ -1693,6 +2362,39 @@
   }
 
 
+  /* make sure that `string[index]' exists; the array grows by doubling */
+  /* so that long strings need few reallocations                         */
+  static int
+  string_reserve( FTDemo_Handle*  handle,
+                  int             index )
+  {
+    PGlyph  string;
+    int     max = handle->string_max;
+
+
+    if ( index < max )
+      return 1;
+
+    if ( !max )
+      max = 64;
+    while ( max <= index )
+      max *= 2;
+
+    string = (PGlyph)realloc( handle->string,
+                              (size_t)max * sizeof ( TGlyph ) );
+    if ( !string )
+      return 0;
+
+    memset( string + handle->string_max, 0,
+            (size_t)( max - handle->string_max ) * sizeof ( TGlyph ) );
+
+    handle->string     = string;
+    handle->string_max = max;
+
+    return 1;
+  }
+
+
   void
   FTDemo_String_Set( FTDemo_Handle*  handle,
                      const char*     string )
@@ -1700,21 +2402,40 @@
     const char*    p = string;
     const char*    end = p + strlen( string );
     int            ch;
-    PGlyph         glyph = handle->string;
 
 
     handle->string_length = 0;
+    handle->string_loaded = 0;
+
+    /* the record after the last glyph is the predecessor of the first */
+    /* one in `FTDemo_String_Load'; on allocation failure, the string  */
+    /* gets truncated                                                  */
+    if ( !string_reserve( handle, 0 ) )
+      return;
 
     while ( ( ch = utf8_next( &p, end ) ) >= 0 )
     {
-      glyph->glyph_index = FTDemo_Get_Index( handle, (FT_UInt32)ch );
-
-      glyph++;
-      handle->string_length++;
-
-      if ( handle->string_length >= MAX_GLYPHS )
+      if ( !string_reserve( handle, handle->string_length + 1 ) )
         break;
+
+      handle->string[handle->string_length++].glyph_index =
+        FTDemo_Get_Index( handle, (FT_UInt32)ch );
     }
+
+    handle->string[handle->string_length].glyph_index = 0;
+  }
+
+
+  static int
+  string_same_scaler( FTC_Scaler  a,
+                      FTC_Scaler  b )
+  {
+    return a->face_id == b->face_id &&
+           a->width   == b->width   &&
+           a->height  == b->height  &&
+           a->pixel   == b->pixel   &&
+           a->x_res   == b->x_res   &&
+           a->y_res   == b->y_res;
   }
 
 
@@ -1736,6 +2457,13 @@
 
     face = size->face;
 
+    /* only the kerning needs an update if the glyphs are still valid */
+    if ( handle->string_loaded                               &&
+         handle->string_load_flags == handle->load_flags     &&
+         string_same_scaler( &handle->string_scaler,
+                             &handle->scaler )               )
+      goto Kerning;
+
     for ( glyph = handle->string, i = 0; i < length; glyph++, i++ )
     {
       /* clear existing image if there is one */
@@ -1745,6 +2473,8 @@
         glyph->image = NULL;
       }
 
+      glyph->advance = 0;
+
       /* load the glyph and get the image */
       if ( !FT_Load_Glyph( face, glyph->glyph_index,
                            handle->load_flags )        &&
@@ -1764,11 +2494,15 @@
         glyph->lsb_delta = face->glyph->lsb_delta;
         glyph->rsb_delta = face->glyph->rsb_delta;
 
-        glyph->hadvance.x = metrics->horiAdvance;
-        glyph->hadvance.y = 0;
+        glyph->advance = metrics->horiAdvance;
       }
     }
 
+    handle->string_loaded     = 1;
+    handle->string_scaler     = handle->scaler;
+    handle->string_load_flags = handle->load_flags;
+
+  Kerning:
     if ( sc->kerning_degree )
     {
       /* this function needs and returns points, not pixels */
@@ -1783,6 +2517,9 @@
           i < length;
           prev = glyph, glyph++, i++ )
     {
+      glyph->hadvance.x = glyph->advance;
+      glyph->hadvance.y = 0;
+
       if ( !glyph->image )
         continue;
 
@@ -2037,6 +2774,61 @@
   }
 
 
+  int
+  FTDemo_SVG_Options( const char*  s )
+  {
+    Rsvg_Port_OptionsRec  options = rsvg_port_options;
+
+
+    while ( *s )
+    {
+      const char*  end = strchr( s, ',' );
+      size_t       len = end ? (size_t)( end - s ) : strlen( s );
+      long         n;
+
+
+      if ( len == 6 && !strncmp( s, "direct", 6 ) )
+        options.direct = 1;
+      else if ( !strncmp( s, "cache=", 6 )      &&
+                sscanf( s + 6, "%ld", &n ) == 1 &&
+                n >= 0                          )
+        options.cache_limit = (size_t)n * 1000;
+      else if ( !strncmp( s, "entries=", 8 )    &&
+                sscanf( s + 8, "%ld", &n ) == 1 &&
+                n > 0                           )
+        options.cache_entries = (int)n;
+      else
+        return 1;
+
+      s += len;
+      if ( *s == ',' )
+        s++;
+    }
+
+    rsvg_port_options = options;
+
+    return 0;
+  }
+
+
+  void
+  FTDemo_SVG_Stats( void )
+  {
+    const Rsvg_Port_StatsRec*  stats = &rsvg_port_stats;
+
+
+    if ( !stats->lookups )
+      return;
+
+    printf( "SVG document cache: %lu lookups, %lu hits (%.1f%%),"
+            " %lu evictions\n",
+            stats->lookups,
+            stats->hits,
+            100.0 * (double)stats->hits / (double)stats->lookups,
+            stats->evictions );
+  }
+
+
   int
   FTDemo_Event_Cff_Hinting_Engine_Change( FT_Library     library,
                                           unsigned int*  current,
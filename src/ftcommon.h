@@ -122,8 +122,8 @@
   /*************************************************************************/
   /*************************************************************************/
 
-#define MAX_GLYPHS 512            /* at most 512 glyphs in the string */
 #define MAX_GLYPH_BYTES  150000   /* 150kB for the glyph image cache */
+#define MAX_BITMAP_BYTES 8000000  /* 8MB for the glyph bitmap cache  */
 
 
   typedef struct  TGlyph_
@@ -134,12 +134,25 @@
     FT_Pos     lsb_delta; /* delta caused by hinting */
     FT_Pos     rsb_delta; /* delta caused by hinting */
     FT_Vector  hadvance;  /* kerned horizontal advance */
+    FT_Pos     advance;   /* horizontal advance before kerning */
 
     FT_Vector  vvector;   /* vert. origin => hori. origin */
     FT_Vector  vadvance;  /* vertical advance */
 
   } TGlyph, *PGlyph;
 
+  /* a font file in memory, shared by all faces installed from it; */
+  /* it gets loaded when one of the faces is first selected         */
+  typedef struct  TFontFile_
+  {
+    void*   address;            /* NULL if not loaded (yet)   */
+    size_t  size;
+    int     mode;               /* PRELOAD_XXX                */
+    int     mapped;             /* memory-mapped or allocated */
+    int     ref_count;          /* number of faces            */
+
+  } TFontFile, *PFontFile;
+
   /* this simple record is used to model a given `installed' face */
   typedef struct  TFont_
   {
@@ -148,11 +161,20 @@
     int          cmap_index;
     int          palette_index;
     int          num_indices;
-    void*        file_address;  /* for preloaded files */
-    size_t       file_size;
+    PFontFile    file;          /* for preloaded files */
 
   } TFont, *PFont;
 
+  /* the values of `preload' in FTDemo_Handle */
+  enum {
+    PRELOAD_NONE = 0,
+    PRELOAD_MAP,                /* memory-map the font files         */
+    PRELOAD_MAP_WILLNEED,       /* ditto, reading ahead the files    */
+    PRELOAD_MAP_RANDOM,         /* ditto, without any read-ahead     */
+    PRELOAD_READ,               /* read the font files into memory   */
+    N_PRELOAD_MODES
+  };
+
   enum {
     LCD_MODE_MONO = 0,
     LCD_MODE_AA,
@@ -194,6 +216,46 @@
 
   } FTDemo_String_Context;
 
+  /* Everything besides the face, the scaler, the load flags, and the  */
+  /* LCD mode that changes the bitmap of a glyph, as far as the bitmap  */
+  /* cache is concerned; `kind' distinguishes the callers' rendering    */
+  /* methods, zero being plain `FTDemo_Index_To_Bitmap'.  Unused fields */
+  /* should be zero.                                                    */
+  typedef struct  FTDemo_Variant_
+  {
+    int        kind;
+    int        palette_index;
+
+    FT_Matrix  matrix;         /* outline transformation */
+    FT_Fixed   radius;         /* stroker radius         */
+    FT_Pos     xstr;           /* emboldening strengths  */
+    FT_Pos     ystr;
+
+  } FTDemo_Variant;
+
+
+  typedef struct FTDemo_BNodeRec_*  FTDemo_BNode;
+
+  /* final glyph bitmaps, most recently used first */
+  typedef struct  FTDemo_Bitmap_Cache_
+  {
+    FTDemo_BNode*  buckets;
+    unsigned int   num_buckets;
+    unsigned int   num_nodes;
+
+    FTDemo_BNode   head;
+    FTDemo_BNode   tail;
+
+    size_t         max_bytes;          /* zero disables the cache */
+    size_t         cur_bytes;
+
+    unsigned long  hits;
+    unsigned long  misses;
+    unsigned long  evictions;
+
+  } FTDemo_Bitmap_Cache;
+
+
   typedef struct
   {
     FT_Library      library;           /* the FreeType library          */
@@ -220,18 +282,26 @@
     int             use_layers;        /* do we use color-layered glyphs? */
     int             autohint;          /* force auto-hinting              */
     int             lcd_mode;          /* mono, aa, light, vrgb, ...      */
-    int             preload;           /* force font file preloading      */
+    int             preload;           /* font file preloading mode       */
 
     /* don't touch the following fields! */
 
-    /* used for string rendering */
-    TGlyph          string[MAX_GLYPHS];
+    /* used for string rendering; the glyph array grows as needed */
+    PGlyph          string;
     int             string_length;
+    int             string_max;
+
+    /* the settings the glyph images of the string were loaded with */
+    int             string_loaded;
+    FTC_ScalerRec   string_scaler;
+    FT_Int32        string_load_flags;
 
     unsigned long   encoding;
     FT_Stroker      stroker;
     FT_Bitmap       bitmap;            /* used as bitmap conversion buffer */
 
+    FTDemo_Bitmap_Cache  bitmap_cache;
+
   } FTDemo_Handle;
 
 
@@ -263,10 +333,19 @@
                        FT_Bool         no_instances );
 
 
+  /* set the preloading mode for fonts installed later on; memory */
+  /* mapping falls back to reading if not available               */
   void
   FTDemo_Set_Preload( FTDemo_Handle*  handle,
                       int             preload );
 
+  /* get the sizes of all preloaded font files, and how much of it */
+  /* is actually in memory                                         */
+  void
+  FTDemo_Preload_Stats( FTDemo_Handle*  handle,
+                        size_t*         total,
+                        size_t*         resident );
+
   void
   FTDemo_Set_Current_Font( FTDemo_Handle*  handle,
                            PFont           font );
@@ -323,8 +402,26 @@
                           int*            y_advance,
                           FT_Glyph*       aglyf );
 
+  /* same as FTDemo_Glyph_To_Bitmap, but the global `error' is left     */
+  /* alone; different threads can thus call it with different handles  */
+  FT_Error
+  FTDemo_Glyph_To_Bitmap_R( FTDemo_Handle*  handle,
+                            FT_Glyph        glyf,
+                            grBitmap*       target,
+                            int*            left,
+                            int*            top,
+                            int*            x_advance,
+                            int*            y_advance,
+                            FT_Glyph*       aglyf );
+
+  /* convert a gray bitmap with 4 or 16 levels to 256 levels in place; */
+  /* the blitter does this otherwise, writing into the glyph buffer     */
+  void
+  FTDemo_Bitmap_Upgray( grBitmap*  bitmap );
+
   /* get a grBitmap from glyph index (don't free target->buffer) */
-  /* if aglyf != NULL, you should FT_Glyph_Done the aglyf */
+  /* if aglyf != NULL, you should FT_Glyph_Done the aglyf         */
+  /* larger glyphs go through the bitmap cache                    */
   FT_Error
   FTDemo_Index_To_Bitmap( FTDemo_Handle*  handle,
                           FT_ULong        Index,
@@ -336,6 +433,41 @@
                           FT_Glyph*       aglyf );
 
 
+  /* set the byte budget of the bitmap cache; zero disables it */
+  void
+  FTDemo_Bitmap_Cache_Set_Budget( FTDemo_Handle*  handle,
+                                  size_t          max_bytes );
+
+  /* drop all cached bitmaps, e.g., after changing the LCD filter */
+  void
+  FTDemo_Bitmap_Cache_Reset( FTDemo_Handle*  handle );
+
+  /* look up a cached bitmap of the current face and size (don't free */
+  /* target->buffer, which stays valid until the next cache change);  */
+  /* `advance' is in 16.16 format, like the advance of an FT_Glyph    */
+  FT_Bool
+  FTDemo_Bitmap_Cache_Lookup( FTDemo_Handle*         handle,
+                              const FTDemo_Variant*  variant,
+                              FT_UInt                gindex,
+                              grBitmap*              target,
+                              int*                   left,
+                              int*                   top,
+                              FT_Vector*             advance );
+
+  /* convert a FT_Glyph of `gindex' to a grBitmap and cache the result */
+  /* if aglyf != NULL, you should FT_Glyph_Done the aglyf               */
+  FT_Error
+  FTDemo_Bitmap_Cache_Render( FTDemo_Handle*         handle,
+                              const FTDemo_Variant*  variant,
+                              FT_UInt                gindex,
+                              FT_Glyph               glyf,
+                              grBitmap*              target,
+                              int*                   left,
+                              int*                   top,
+                              FT_Vector*             advance,
+                              FT_Glyph*              aglyf );
+
+
   /* given glyph index, draw a glyph on the display */
   FT_Error
   FTDemo_Draw_Index( FTDemo_Handle*   handle,
@@ -370,13 +502,14 @@
                     int*             pen_y);
 
 
-  /* set the string to be drawn */
+  /* set the string to be drawn, of any length */
   void
   FTDemo_String_Set( FTDemo_Handle*  handle,
                      const char*     string );
 
 
-  /* load kerned advances with hinting compensation */
+  /* load kerned advances with hinting compensation; the glyph images */
+  /* are only reloaded if the scaler or the load flags have changed   */
   FT_Error
   FTDemo_String_Load( FTDemo_Handle*          handle,
                       FTDemo_String_Context*  sc );
@@ -403,6 +536,17 @@
                              grColor            color );
 
 
+  /* set the options of the OT-SVG renderer from a comma-separated list */
+  /* like `direct,cache=N,entries=N' (N in kB for `cache'); call before */
+  /* loading glyphs and return nonzero for an invalid list              */
+  int
+  FTDemo_SVG_Options( const char*  s );
+
+  /* print the hit rate of the SVG document cache, if it was used; the  */
+  /* counts are only complete after `FTDemo_Done'                       */
+  void
+  FTDemo_SVG_Stats( void );
+
   /* make a FT_Encoding tag from a string */
   unsigned long
   FTDemo_Make_Encoding_Tag( const char*  s );
@@ -1696,6 +1696,11 @@
       "            Specify the design coordinates for each\n"
       "            Multiple Master axis at start-up.  Implies `-n'.\n"
       "  -n        Don't display named instances of variation fonts.\n"
+      "  -S opts   Set OT-SVG rendering options by a comma-separated list:\n"
+      "            `direct' (draw documents straight into the glyph bitmap),\n"
+      "            `cache=size' (cache up to `size' kB of parsed documents;\n"
+      "            zero disables the cache), `entries=N' (cache up to N\n"
+      "            documents).  The cache hit rate is printed at exit.\n"
       "\n"
       "  -v        Show version."
       "\n" );
@@ -1716,7 +1721,7 @@
 
     while ( 1 )
     {
-      option = getopt( *argc, *argv, "a:d:e:f:k:nr:v" );
+      option = getopt( *argc, *argv, "a:d:e:f:k:nr:S:v" );
 
       if ( option == -1 )
         break;
@@ -1774,6 +1779,11 @@
           usage( execname );
         break;
 
+      case 'S':
+        if ( FTDemo_SVG_Options( optarg ) )
+          usage( execname );
+        break;
+
       case 'v':
         {
           FT_String  str[64] = "ftgrid (FreeType) ";
@@ -1878,6 +1888,9 @@
     FTDemo_Display_Done( display );
     FTDemo_Done( handle );
 
+    /* the library adds its counts when it is done */
+    FTDemo_SVG_Stats();
+
     exit( 0 );      /* for safety reasons */
     /* return 0; */ /* never reached */
   }
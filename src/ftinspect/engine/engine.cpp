@@ -6,6 +6,7 @@
 
 #include "engine.hpp"
 
+#include <climits>
 #include <stdexcept>
 #include <stdint.h>
 
@@ -15,62 +16,15 @@
 #include <freetype/ftmodapi.h>
 
 
-/////////////////////////////////////////////////////////////////////////////
-//
-// FaceID
-//
-/////////////////////////////////////////////////////////////////////////////
-
-FaceID::FaceID()
-: fontIndex(-1),
-  faceIndex(-1),
-  namedInstanceIndex(-1)
-{
-  // empty
-}
-
-
-FaceID::FaceID(int fontIndex,
-               long faceIndex,
-               int namedInstanceIndex)
-: fontIndex(fontIndex),
-  faceIndex(faceIndex),
-  namedInstanceIndex(namedInstanceIndex)
-{
-  // empty
-}
-
-
-bool
-FaceID::operator<(const FaceID& other) const
-{
-  bool ret = false;
-
-  if (fontIndex < other.fontIndex)
-    ret = true;
-  else if (fontIndex == other.fontIndex)
-  {
-    if (faceIndex < other.faceIndex)
-      ret = true;
-    else if (faceIndex == other.faceIndex)
-    {
-      if (namedInstanceIndex < other.namedInstanceIndex)
-        ret = true;
-    }
-  }
-
-  return ret;
-}
-
-
 // The face requester is a function provided by the client application to
 // the cache manager to translate an 'abstract' face ID into a real
 // `FT_Face' object.
 //
-// We use a map: `faceID` is the value, and its associated key gives the
-// font, face, and named instance indices.  Getting a key from a value is
-// slow, but this must be done only once, since `faceRequester` is only
-// called if the font is not yet in the cache.
+// `ftcFaceID` is actually an ID from `faceIDMap_`, which gives the font,
+// face, and named instance indices.  The driver settings that are part of
+// the key need no action here: they are the current ones when a new face
+// gets opened (see `Engine::lookupFace`).  The design coordinates, however,
+// are a property of the face and must be set again.
 
 FT_Error
 faceRequester(FTC_FaceID ftcFaceID,
@@ -79,17 +33,9 @@ faceRequester(FTC_FaceID ftcFaceID,
               FT_Face* faceP)
 {
   Engine* engine = static_cast<Engine*>(requestData);
-  // `ftcFaceID` is actually an integer
-  // -> First convert pointer to same-width integer, then discard superfluous
-  //    bits (e.g., on x86_64 where pointers are wider than `int`).
-  int val = static_cast<int>(reinterpret_cast<intptr_t>(ftcFaceID));
-  // Make sure this does not cause information loss.
-  Q_ASSERT_X(sizeof(void*) >= sizeof(int),
-             "faceRequester",
-             "Pointer size must be at least the size of int"
-             " in order to treat FTC_FaceID correctly");
-
-  const FaceID& faceID = engine->faceIDMap_.key(val);
+  auto id = reinterpret_cast<FaceIDMap::IDType>(ftcFaceID);
+
+  FaceID faceID = engine->faceIDMap_.key(id);
 
   // This is the only place where we have to check the validity of the font
   // index; note that the validity of both the face and named instance index
@@ -105,10 +51,23 @@ faceRequester(FTC_FaceID ftcFaceID,
     faceIndex += faceID.namedInstanceIndex << 16;
 
   *faceP = NULL;
-  return FT_New_Face(library,
-                     qPrintable(font),
-                     faceIndex,
-                     faceP);
+  FT_Error error = FT_New_Face(library,
+                               qPrintable(font),
+                               faceIndex,
+                               faceP);
+  if (error)
+    return error;
+
+  auto& coords = engine->mmgxCoords_;
+  if (!coords.empty()
+      && FaceID(faceID.fontIndex,
+                faceID.faceIndex,
+                faceID.namedInstanceIndex) == engine->mmgxFaceID_)
+    FT_Set_Var_Design_Coordinates(*faceP,
+                                  static_cast<unsigned>(coords.size()),
+                                  coords.data());
+
+  return FT_Err_Ok;
 }
 
 
@@ -123,8 +82,6 @@ Engine::Engine()
 {
   ftSize_ = NULL;
   ftFallbackFace_ = NULL;
-  // We reserve value 0 for the 'invalid face ID'.
-  faceCounter_ = 1;
 
   FT_Error error;
 
@@ -134,7 +91,10 @@ Engine::Engine()
     // XXX error handling
   }
 
-  error = FTC_Manager_New(library_, 0, 0, 0,
+  // Every combination of driver settings in use (for example, in the
+  // comparator tab) needs its own faces and sizes, so we allow more than
+  // the defaults.
+  error = FTC_Manager_New(library_, 16, 32, 4 * 1024 * 1024,
                           faceRequester, this, &cacheManager_);
   if (error)
   {
@@ -178,32 +138,98 @@ Engine::withFace(FaceID id,
                  Func func)
 {
   FT_Face face;
+  if (lookupFace(id, &face))
+    func(face);
+}
+
+
+// The key of the driver settings that can change the glyphs of a font
+// type.  The CFF and TrueType drivers have their own hinting settings,
+// while stem darkening also affects the auto-hinter and thus all fonts.
+
+unsigned
+Engine::settingsKey(int fontType)
+{
+  unsigned key = stemDarkening_ ? 1 : 0;
+
+  if (fontType == FontType_CFF)
+    key |= static_cast<unsigned>(cffHintingMode_ + 1) << 1;
+  else if (fontType == FontType_TrueType)
+    key |= static_cast<unsigned>(ttInterpreterVersion_ + 1) << 8;
+
+  return key;
+}
+
+
+static int
+driverFontType(FT_Face face)
+{
+  const char* moduleName = FT_FACE_DRIVER_NAME(face);
+
+  // XXX cover all available modules
+  if (!strcmp(moduleName, "cff"))
+    return Engine::FontType_CFF;
+  else if (!strcmp(moduleName, "truetype"))
+    return Engine::FontType_TrueType;
+  else
+    return Engine::FontType_Other;
+}
+
+
+FTC_FaceID
+Engine::lookupFace(FaceID id,
+                   FT_Face* face)
+{
+  *face = NULL;
+  if (id.fontIndex < 0)
+    return NULL;
+
+  // We know the font type only after opening a face for the first time.
+  auto typeID = FaceID(id.fontIndex, id.faceIndex, 0);
+  auto typeIter = faceTypes_.find(typeID);
+  bool haveType = typeIter != faceTypes_.end();
+
+  id.settings = settingsKey(haveType ? typeIter->second : FontType_Other);
+
   // Search triplet (fontIndex, faceIndex, namedInstanceIndex).
   auto numId = reinterpret_cast<FTC_FaceID>(faceIDMap_.value(id));
   if (numId)
   {
     // Found.
-    if (!FTC_Manager_LookupFace(cacheManager_, numId, &face))
-      func(face);
+    if (FTC_Manager_LookupFace(cacheManager_, numId, face))
+    {
+      *face = NULL;
+      return NULL;
+    }
+    return numId;
   }
-  else if (id.fontIndex >= 0)
-  {
-    if (faceCounter_ >= INT_MAX) // Prevent overflow.
-      return;
 
-    // Not found; try to load triplet
-    // (fontIndex, faceIndex, namedInstanceIndex).
-    numId = reinterpret_cast<FTC_FaceID>(faceCounter_);
-    faceIDMap_.insert(id, faceCounter_++);
+  // Not found; try to load triplet
+  // (fontIndex, faceIndex, namedInstanceIndex).
+  numId = reinterpret_cast<FTC_FaceID>(faceIDMap_.insert(id));
+  if (!numId) // Out of IDs.
+    return NULL;
 
-    if (!FTC_Manager_LookupFace(cacheManager_, numId, &face))
-      func(face);
-    else
-    {
-      faceIDMap_.remove(id);
-      faceCounter_--;
-    }
+  if (FTC_Manager_LookupFace(cacheManager_, numId, face))
+  {
+    faceIDMap_.remove(id);
+    *face = NULL;
+    return NULL;
   }
+
+  if (!haveType)
+  {
+    // The face has been opened with the current settings, so it can
+    // simply be filed under the key of its real font type.
+    int fontType = driverFontType(*face);
+    faceTypes_[typeID] = fontType;
+
+    auto typedID = id;
+    typedID.settings = settingsKey(fontType);
+    faceIDMap_.changeKey(id, typedID);
+  }
+
+  return numId;
 }
 
 
@@ -285,51 +311,21 @@ Engine::loadFont(int fontIndex,
   update();
 
   curFontIndex_ = fontIndex;
-  auto id = FaceID(fontIndex, faceIndex, namedInstanceIndex);
-
-  // Search triplet (fontIndex, faceIndex, namedInstanceIndex).
-  scaler_.face_id = reinterpret_cast<FTC_FaceID>(faceIDMap_.value(id));
-  if (scaler_.face_id)
+  curFaceIndex_ = faceIndex;
+  curNamedInstanceIndex_ = namedInstanceIndex;
+
+  scaler_.face_id = lookupFace(FaceID(fontIndex,
+                                      faceIndex,
+                                      namedInstanceIndex),
+                               &ftFallbackFace_);
+  if (ftFallbackFace_)
   {
-    // Found.
-    if (!FTC_Manager_LookupFace(cacheManager_, scaler_.face_id,
-                               &ftFallbackFace_))
-    {
-      numGlyphs = ftFallbackFace_->num_glyphs;
-      if (FTC_Manager_LookupSize(cacheManager_, &scaler_, &ftSize_))
-        ftSize_ = NULL; // Good font, bad size.
-    }
-    else
-    {
-      ftFallbackFace_ = NULL;
-      ftSize_ = NULL;
-    }
-  }
-  else if (fontIndex >= 0)
-  {
-    if (faceCounter_ >= INT_MAX) // Prevent overflow.
-      return -1;
-
-    // Not found; try to load triplet
-    // (fontIndex, faceIndex, namedInstanceIndex).
-    scaler_.face_id = reinterpret_cast<FTC_FaceID>(faceCounter_);
-    faceIDMap_.insert(id, faceCounter_++);
-
-    if (!FTC_Manager_LookupFace(cacheManager_, scaler_.face_id,
-                                &ftFallbackFace_))
-    {
-      numGlyphs = ftFallbackFace_->num_glyphs;
-      if (FTC_Manager_LookupSize(cacheManager_, &scaler_, &ftSize_))
-        ftSize_ = NULL; // Good font, bad size.
-    }
-    else
-    {
-      faceIDMap_.remove(id);
-      faceCounter_--;
-      ftFallbackFace_ = NULL;
-      ftSize_ = NULL;
-    }
+    numGlyphs = ftFallbackFace_->num_glyphs;
+    if (FTC_Manager_LookupSize(cacheManager_, &scaler_, &ftSize_))
+      ftSize_ = NULL; // Good font, bad size.
   }
+  else
+    ftSize_ = NULL;
 
   imageType_.face_id = scaler_.face_id;
 
@@ -349,15 +345,7 @@ Engine::loadFont(int fontIndex,
     curFamilyName_ = QString(ftFallbackFace_->family_name);
     curStyleName_ = QString(ftFallbackFace_->style_name);
 
-    const char* moduleName = FT_FACE_DRIVER_NAME(ftFallbackFace_);
-
-    // XXX cover all available modules
-    if (!strcmp(moduleName, "cff"))
-      fontType_ = FontType_CFF;
-    else if (!strcmp(moduleName, "truetype"))
-      fontType_ = FontType_TrueType;
-    else
-      fontType_ = FontType_Other;
+    fontType_ = driverFontType(ftFallbackFace_);
 
     curCharMaps_.clear();
     curCharMaps_.reserve(ftFallbackFace_->num_charmaps);
@@ -381,13 +369,16 @@ Engine::reloadFont()
   palette_ = NULL;
   if (!scaler_.face_id)
     return;
+
+  // The driver settings and thus the face ID might have changed.
+  scaler_.face_id = lookupFace(FaceID(curFontIndex_,
+                                      curFaceIndex_,
+                                      curNamedInstanceIndex_),
+                               &ftFallbackFace_);
   imageType_.face_id = scaler_.face_id;
 
-  if (FTC_Manager_LookupFace(cacheManager_,
-                             scaler_.face_id,
-                             &ftFallbackFace_))
+  if (!ftFallbackFace_)
   {
-    ftFallbackFace_ = NULL;
     ftSize_ = NULL;
     return;
   }
@@ -419,26 +410,38 @@ void
 Engine::removeFont(int fontIndex,
                    bool closeFile)
 {
-  // We iterate over all triplets that contain the given font index
-  // and remove them.
-  QMap<FaceID, FTC_IDType>::iterator iter
-    = faceIDMap_.lowerBound(FaceID(fontIndex, 0, 0));
-
-  while (true)
+  // Closing the file moves all following fonts down by one index, so
+  // their triplets would refer to the wrong files; drop them, too.
+  int lastIndex = closeFile ? numberOfOpenedFonts() - 1 : fontIndex;
+  auto affected = [&](int index)
   {
-    if (iter == faceIDMap_.end())
-      break;
+    return index >= fontIndex && index <= lastIndex;
+  };
 
-    FaceID faceID = iter.key();
-    if (faceID.fontIndex != fontIndex)
-      break;
+  // We remove all triplets that contain the affected font indices.
+  for (int i = fontIndex; i <= lastIndex; i++)
+    for (auto id : faceIDMap_.removeFont(i))
+      FTC_Manager_RemoveFaceID(cacheManager_,
+                               reinterpret_cast<FTC_FaceID>(id));
 
-    auto ftcFaceID = reinterpret_cast<FTC_FaceID>(iter.value());
-    FTC_Manager_RemoveFaceID(cacheManager_, ftcFaceID);
+  for (auto iter = faceTypes_.begin(); iter != faceTypes_.end();)
+  {
+    if (affected(iter->first.fontIndex))
+      iter = faceTypes_.erase(iter);
+    else
+      ++iter;
+  }
 
-    iter = faceIDMap_.erase(iter);
+  if (affected(mmgxFaceID_.fontIndex))
+  {
+    mmgxFaceID_ = FaceID();
+    mmgxCoords_.clear();
   }
 
+  // The current face might be gone; `loadFont` must not look at it.
+  if (affected(curFontIndex_))
+    invalidateCurrentFace();
+
   if (closeFile)
     fontFileManager_.remove(fontIndex);
 }
@@ -773,8 +776,11 @@ Engine::setCFFHintingMode(int mode)
                                    "cff",
                                    "hinting-engine",
                                    &mode);
-  if (!error)
-    resetCache();
+  if (!error && mode != cffHintingMode_)
+  {
+    cffHintingMode_ = mode;
+    invalidateCurrentFace();
+  }
 }
 
 
@@ -785,8 +791,11 @@ Engine::setTTInterpreterVersion(int version)
                                    "truetype",
                                    "interpreter-version",
                                    &version);
-  if (!error)
-    resetCache();
+  if (!error && version != ttInterpreterVersion_)
+  {
+    ttInterpreterVersion_ = version;
+    invalidateCurrentFace();
+  }
 }
 
 
@@ -810,7 +819,11 @@ Engine::setStemDarkening(bool darkening)
                   "t1cid",
                   "no-stem-darkening",
                   &noDarkening);
-  resetCache();
+  if (darkening != stemDarkening_)
+  {
+    stemDarkening_ = darkening;
+    invalidateCurrentFace();
+  }
 }
 
 
@@ -822,9 +835,33 @@ Engine::applyMMGXDesignCoords(FT_Fixed* coords,
     return;
   if (count >= UINT_MAX)
     count = UINT_MAX - 1;
-  FT_Set_Var_Design_Coordinates(ftSize_->face,
-                                static_cast<unsigned>(count),
-                                coords);
+
+  FaceID faceID(curFontIndex_, curFaceIndex_, curNamedInstanceIndex_);
+  std::vector<FT_Fixed> newCoords;
+  if (coords)
+    newCoords.assign(coords, coords + count);
+
+  // Every face of the triplet opened since the last change already has
+  // these coordinates.
+  if (faceID == mmgxFaceID_ && newCoords == mmgxCoords_)
+    return;
+
+  mmgxFaceID_ = faceID;
+  mmgxCoords_ = std::move(newCoords);
+
+  // The faces of the font opened with other driver settings and all glyphs
+  // cached so far have the old coordinates; flush them and open the
+  // current face again, which makes `faceRequester` set the new ones.
+  for (auto id : faceIDMap_.fontIDs(curFontIndex_))
+    FTC_Manager_RemoveFaceID(cacheManager_,
+                             reinterpret_cast<FTC_FaceID>(id));
+  invalidateCurrentFace();
+
+  scaler_.face_id = lookupFace(faceID, &ftFallbackFace_);
+  imageType_.face_id = scaler_.face_id;
+  if (ftFallbackFace_
+      && FTC_Manager_LookupSize(cacheManager_, &scaler_, &ftSize_))
+    ftSize_ = NULL; // Good font, bad size.
 }
 
 
@@ -883,8 +920,20 @@ Engine::update()
 void
 Engine::resetCache()
 {
-  // Reset the cache.
-  FTC_Manager_Reset(cacheManager_);
+  // Flush all faces of the current font (together with their sizes and
+  // glyphs), whatever driver settings they have been opened with; other
+  // fonts stay in the cache.
+  for (auto id : faceIDMap_.fontIDs(curFontIndex_))
+    FTC_Manager_RemoveFaceID(cacheManager_,
+                             reinterpret_cast<FTC_FaceID>(id));
+  invalidateCurrentFace();
+}
+
+
+void
+Engine::invalidateCurrentFace()
+{
+  // Only `reloadFont` gets the face matching the current settings.
   ftFallbackFace_ = NULL;
   ftSize_ = NULL;
   palette_ = NULL;
@@ -1010,6 +1059,17 @@ Engine::queryEngine()
                     "interpreter-version",
                     &engineDefaults_.ttInterpreterVersionDefault);
   }
+
+  // Start with the settings that `settingsKey` sees.
+  cffHintingMode_ = engineDefaults_.cffHintingEngineDefault;
+  ttInterpreterVersion_ = engineDefaults_.ttInterpreterVersionDefault;
+
+  FT_Bool noDarkening;
+  error = FT_Property_Get(library_,
+                          "cff",
+                          "no-stem-darkening",
+                          &noDarkening);
+  stemDarkening_ = !error && !noDarkening;
 }
 
 
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "charmap.hpp"
+#include "faceidmap.hpp"
 #include "fontinfo.hpp"
 #include "fontfilemanager.hpp"
 #include "mmgx.hpp"
@@ -14,11 +15,11 @@
 #include "rendering.hpp"
 
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <QString>
-#include <QMap>
 
 #include <ft2build.h>
 #include <freetype/freetype.h>
@@ -28,26 +29,6 @@
 #include <freetype/ftoutln.h>
 
 
-// This structure maps the (font, face, instance) index triplet to abstract
-// IDs (generated by a running number stored in MainGUI's `faceCounter`
-// member).
-//
-// Qt's `QMap` class needs an implementation of the `<` operator.
-
-struct FaceID
-{
-  int fontIndex;
-  long faceIndex;
-  int namedInstanceIndex;
-
-  FaceID();
-  FaceID(int fontIndex,
-         long faceIndex,
-         int namedInstanceIndex);
-  bool operator<(const FaceID& other) const;
-};
-
-
 // FreeType-specific data.
 
 class Engine
@@ -98,7 +79,7 @@ public:
                   bool closeFile = true);
 
   void update();
-  void resetCache();
+  void resetCache(); // Only for the current font.
   void loadDefaults();
 
   //////// Getters
@@ -202,7 +183,7 @@ public:
   void setPaletteIndex(int index) { paletteIndex_ = index; }
   void setLCDSubPixelPositioning(bool sp) { lcdSubPixelPositioning_ = sp; }
 
-  // (settings without backing fields)
+  // (settings of the FreeType library and its drivers)
   // Note: These 3 functions now take the actual mode/version from FreeType
   // instead of values from the enum in MainGUI!
   void setLcdFilter(FT_LcdFilter filter);
@@ -221,14 +202,17 @@ public:
                                 FT_Face*);
 
 private:
-  using FTC_IDType = uintptr_t;
-  FTC_IDType faceCounter_; // A running number to initialize `faceIDMap`.
-  QMap<FaceID, FTC_IDType> faceIDMap_;
+  FaceIDMap faceIDMap_;
+  // The font type of each (font, face) pair opened so far, with the named
+  // instance index set to zero.
+  std::unordered_map<FaceID, int, FaceIDHash> faceTypes_;
 
   FontFileManager fontFileManager_;
 
   // font info
   int curFontIndex_ = -1;
+  long curFaceIndex_ = -1;
+  int curNamedInstanceIndex_ = -1;
   int fontType_ = FontType_Other;
   QString curFamilyName_;
   QString curStyleName_;
@@ -280,6 +264,17 @@ private:
   bool lcdSubPixelPositioning_ = false;
   int renderMode_ = 0;
 
+  // driver properties, as far as they are part of `FaceID::settings`
+  int cffHintingMode_ = -1;
+  int ttInterpreterVersion_ = -1;
+  bool stemDarkening_ = false;
+
+  // The design coordinates last set with `applyMMGXDesignCoords` and the
+  // triplet they belong to; `faceRequester` applies them to every face of
+  // this triplet it opens, whatever its settings key.
+  FaceID mmgxFaceID_;
+  std::vector<FT_Fixed> mmgxCoords_;
+
   unsigned long loadFlags_ = FT_LOAD_DEFAULT;
 
   std::unique_ptr<RenderingEngine> renderingEngine_;
@@ -287,6 +282,12 @@ private:
   void queryEngine();
   void loadPaletteInfos();
 
+  unsigned settingsKey(int fontType);
+  // Return NULL if the face can't be opened.
+  FTC_FaceID lookupFace(FaceID id,
+                        FT_Face* face);
+  void invalidateCurrentFace();
+
   // It is safe to put the implementation into the corresponding cpp file.
   template <class Func>
   void withFace(FaceID id,
@@ -0,0 +1,199 @@
+// faceidmap.cpp
+
+// Copyright (C) 2016-2023 by
+// Werner Lemberg.
+
+
+#include "faceidmap.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// FaceID
+//
+/////////////////////////////////////////////////////////////////////////////
+
+FaceID::FaceID()
+: fontIndex(-1),
+  faceIndex(-1),
+  namedInstanceIndex(-1),
+  settings(0)
+{
+  // empty
+}
+
+
+FaceID::FaceID(int fontIndex,
+               long faceIndex,
+               int namedInstanceIndex,
+               unsigned settings)
+: fontIndex(fontIndex),
+  faceIndex(faceIndex),
+  namedInstanceIndex(namedInstanceIndex),
+  settings(settings)
+{
+  // empty
+}
+
+
+bool
+FaceID::operator==(const FaceID& other) const
+{
+  return fontIndex == other.fontIndex
+         && faceIndex == other.faceIndex
+         && namedInstanceIndex == other.namedInstanceIndex
+         && settings == other.settings;
+}
+
+
+size_t
+FaceIDHash::operator()(const FaceID& faceID) const
+{
+  // Face indices are small, and named instances even smaller.
+  size_t h = std::hash<int>()(faceID.fontIndex);
+  h = h * 31 + std::hash<long>()(faceID.faceIndex);
+  h = h * 31 + std::hash<int>()(faceID.namedInstanceIndex);
+  h = h * 31 + std::hash<unsigned>()(faceID.settings);
+  return h;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// FaceIDMap
+//
+/////////////////////////////////////////////////////////////////////////////
+
+FaceIDMap::FaceIDMap()
+: counter_(1)
+{
+  // empty
+}
+
+
+FaceIDMap::IDType
+FaceIDMap::value(const FaceID& faceID) const
+{
+  auto iter = ids_.find(faceID);
+  if (iter == ids_.end())
+    return 0;
+  return iter->second;
+}
+
+
+FaceID
+FaceIDMap::key(IDType id) const
+{
+  auto iter = faceIDs_.find(id);
+  if (iter == faceIDs_.end())
+    return {};
+  return iter->second;
+}
+
+
+FaceIDMap::IDType
+FaceIDMap::insert(const FaceID& faceID)
+{
+  auto found = value(faceID);
+  if (found)
+    return found;
+
+  // `faceRequester` gets the ID as a pointer; stay within `int` anyway.
+  if (counter_ >= INT_MAX) // Prevent overflow.
+    return 0;
+
+  auto id = counter_++;
+  ids_.emplace(faceID, id);
+  faceIDs_.emplace(id, faceID);
+  fontIDs_[faceID.fontIndex].push_back(id);
+
+  return id;
+}
+
+
+void
+FaceIDMap::remove(const FaceID& faceID)
+{
+  auto iter = ids_.find(faceID);
+  if (iter == ids_.end())
+    return;
+
+  auto id = iter->second;
+  ids_.erase(iter);
+  faceIDs_.erase(id);
+
+  auto fontIter = fontIDs_.find(faceID.fontIndex);
+  if (fontIter != fontIDs_.end())
+  {
+    auto& fontIDs = fontIter->second;
+    fontIDs.erase(std::find(fontIDs.begin(), fontIDs.end(), id));
+    if (fontIDs.empty())
+      fontIDs_.erase(fontIter);
+  }
+
+  // Give back the ID of a face that couldn't be opened.
+  if (id == counter_ - 1)
+    counter_--;
+}
+
+
+void
+FaceIDMap::changeKey(const FaceID& from,
+                     const FaceID& to)
+{
+  // Both keys must belong to the same font for `fontIDs_`.
+  if (from.fontIndex != to.fontIndex || ids_.count(to))
+    return;
+
+  auto iter = ids_.find(from);
+  if (iter == ids_.end())
+    return;
+
+  auto id = iter->second;
+  ids_.erase(iter);
+  ids_.emplace(to, id);
+  faceIDs_[id] = to;
+}
+
+
+std::vector<FaceIDMap::IDType>
+FaceIDMap::fontIDs(int fontIndex) const
+{
+  auto fontIter = fontIDs_.find(fontIndex);
+  if (fontIter == fontIDs_.end())
+    return {};
+  return fontIter->second;
+}
+
+
+std::vector<FaceIDMap::IDType>
+FaceIDMap::removeFont(int fontIndex)
+{
+  std::vector<IDType> removed;
+
+  auto fontIter = fontIDs_.find(fontIndex);
+  if (fontIter == fontIDs_.end())
+    return removed;
+
+  removed.swap(fontIter->second);
+  fontIDs_.erase(fontIter);
+
+  for (auto id : removed)
+  {
+    auto iter = faceIDs_.find(id);
+    if (iter == faceIDs_.end())
+      continue;
+
+    ids_.erase(iter->second);
+    faceIDs_.erase(iter);
+  }
+
+  return removed;
+}
+
+
+// end of faceidmap.cpp
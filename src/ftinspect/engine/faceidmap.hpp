@@ -0,0 +1,81 @@
+// faceidmap.hpp
+
+// Copyright (C) 2016-2023 by
+// Werner Lemberg.
+
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+
+// This structure holds the (font, face, instance) index triplet that
+// `FaceIDMap` maps to abstract IDs.  The same triplet gets a different ID
+// for every combination of driver properties relevant to it (see
+// `Engine::settingsKey`), so that the cache never mixes faces and glyphs
+// loaded with different settings.
+
+struct FaceID
+{
+  int fontIndex;
+  long faceIndex;
+  int namedInstanceIndex;
+  unsigned settings;
+
+  FaceID();
+  FaceID(int fontIndex,
+         long faceIndex,
+         int namedInstanceIndex,
+         unsigned settings = 0);
+  bool operator==(const FaceID& other) const;
+};
+
+
+struct FaceIDHash
+{
+  size_t operator()(const FaceID& faceID) const;
+};
+
+
+// A bidirectional index between triplets and the abstract IDs that we pass
+// as `FTC_FaceID` to the cache manager, hashed in both directions and by
+// font index, so neither the face requester nor the removal of a font has
+// to scan all triplets ever opened.
+//
+// The IDs come from a running number and are not reused, except for the
+// last one if `remove` is called right after `insert` (i.e., if the face
+// can't be opened).
+
+class FaceIDMap
+{
+public:
+  using IDType = uintptr_t;
+
+  FaceIDMap();
+
+  IDType value(const FaceID& faceID) const; // 0 if not found.
+  FaceID key(IDType id) const; // `FaceID()` if not found.
+  IDType insert(const FaceID& faceID); // 0 if out of IDs.
+  void remove(const FaceID& faceID);
+  // Give an ID a new key unless the new key is already taken.
+  void changeKey(const FaceID& from,
+                 const FaceID& to);
+  // Return the IDs of all triplets of a font.
+  std::vector<IDType> fontIDs(int fontIndex) const;
+  // Remove all triplets of a font and return their IDs.
+  std::vector<IDType> removeFont(int fontIndex);
+
+  size_t size() const { return ids_.size(); }
+
+private:
+  IDType counter_; // The next ID; 0 is the 'invalid face ID'.
+  std::unordered_map<FaceID, IDType, FaceIDHash> ids_;
+  std::unordered_map<IDType, FaceID> faceIDs_;
+  std::unordered_map<int, std::vector<IDType>> fontIDs_;
+};
+
+
+// end of faceidmap.hpp
@@ -0,0 +1,195 @@
+// faceidbench.cpp
+
+// Copyright (C) 2023 by
+// Werner Lemberg.
+
+
+// A standalone benchmark of `FaceIDMap` against the ordered map with a
+// linear reverse lookup that ftinspect used before (i.e., a `QMap` and
+// `QMap::key`); `std::map` stands in for the latter so that no Qt is
+// needed.  Usage:
+//
+//   faceidbench [entries...]
+//
+// The default is 10000, 50000, and 100000 entries.  Every font gets 10
+// faces with 10 named instances each.  Times are per lookup; the removal
+// time is for removing all fonts one by one.
+
+#include "engine/faceidmap.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+
+
+namespace
+{
+
+struct FaceIDLess
+{
+  bool
+  operator()(const FaceID& a,
+             const FaceID& b) const
+  {
+    if (a.fontIndex != b.fontIndex)
+      return a.fontIndex < b.fontIndex;
+    if (a.faceIndex != b.faceIndex)
+      return a.faceIndex < b.faceIndex;
+    if (a.namedInstanceIndex != b.namedInstanceIndex)
+      return a.namedInstanceIndex < b.namedInstanceIndex;
+    return a.settings < b.settings;
+  }
+};
+
+using OrderedMap = std::map<FaceID, FaceIDMap::IDType, FaceIDLess>;
+
+constexpr int FacesPerFont = 10;
+constexpr int InstancesPerFace = 10;
+constexpr int TripletsPerFont = FacesPerFont * InstancesPerFace;
+
+
+FaceID
+triplet(int n)
+{
+  return FaceID(n / TripletsPerFont,
+                n % TripletsPerFont / InstancesPerFace,
+                n % InstancesPerFace);
+}
+
+
+// Microseconds since `start`.
+double
+elapsed(std::chrono::steady_clock::time_point start)
+{
+  auto d = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::micro>(d).count();
+}
+
+
+// Exactly what `QMap::key` does.
+FaceID
+linearKey(const OrderedMap& map,
+          FaceIDMap::IDType id)
+{
+  for (auto& entry : map)
+    if (entry.second == id)
+      return entry.first;
+  return {};
+}
+
+
+void
+fill(int entries,
+     FaceIDMap& hashed,
+     OrderedMap& ordered)
+{
+  for (int n = 0; n < entries; n++)
+  {
+    auto faceID = triplet(n);
+    ordered.emplace(faceID, hashed.insert(faceID));
+  }
+}
+
+
+void
+run(int entries)
+{
+  FaceIDMap hashed;
+  OrderedMap ordered;
+  fill(entries, hashed, ordered);
+
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> pick(0, entries - 1);
+
+  // The linear scan is so slow that it gets far fewer iterations.
+  const int slowLookups = 1000;
+  const int fastLookups = 1000000;
+
+  // Keep the results alive.
+  long sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < slowLookups; i++)
+    sink += linearKey(ordered, pick(rng) + 1).faceIndex;
+  double reverseOld = elapsed(start) / slowLookups;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < fastLookups; i++)
+    sink += hashed.key(pick(rng) + 1).faceIndex;
+  double reverseNew = elapsed(start) / fastLookups;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < fastLookups; i++)
+    sink += ordered.find(triplet(pick(rng)))->second;
+  double forwardOld = elapsed(start) / fastLookups;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < fastLookups; i++)
+    sink += hashed.value(triplet(pick(rng)));
+  double forwardNew = elapsed(start) / fastLookups;
+
+  int fonts = (entries + TripletsPerFont - 1) / TripletsPerFont;
+
+  // Like `Engine::removeFont` did before.
+  start = std::chrono::steady_clock::now();
+  for (int font = 0; font < fonts; font++)
+  {
+    auto iter = ordered.lower_bound(FaceID(font, 0, 0));
+    while (iter != ordered.end() && iter->first.fontIndex == font)
+    {
+      sink += iter->second;
+      iter = ordered.erase(iter);
+    }
+  }
+  double removeOld = elapsed(start) / 1000;
+
+  start = std::chrono::steady_clock::now();
+  for (int font = 0; font < fonts; font++)
+    sink += hashed.removeFont(font).size();
+  double removeNew = elapsed(start) / 1000;
+
+  if (!ordered.empty() || hashed.size())
+    std::printf("(removal incomplete)\n");
+
+  std::printf("%7d   %8.3f us -> %5.3f us   %5.3f us -> %5.3f us"
+              "   %6.2f ms -> %6.2f ms\n",
+              entries,
+              reverseOld, reverseNew,
+              forwardOld, forwardNew,
+              removeOld, removeNew);
+
+  if (sink == 42)
+    std::printf("\n");
+}
+
+} // namespace
+
+
+int
+main(int argc,
+     char** argv)
+{
+  std::printf("entries    reverse lookup           forward lookup"
+              "         removal\n");
+
+  if (argc < 2)
+  {
+    run(10000);
+    run(50000);
+    run(100000);
+  }
+  else
+    for (int i = 1; i < argc; i++)
+    {
+      int entries = std::atoi(argv[i]);
+      if (entries > 0)
+        run(entries);
+    }
+
+  return 0;
+}
+
+
+// end of faceidbench.cpp
@@ -237,7 +237,7 @@ void
 MainGUI::reloadCurrentTabFont()
 {
   if (tabWidget_->currentWidget() != comparatorTab_)
-    settingPanel_->applyDelayedSettings(); // This resets the cache.
+    settingPanel_->applyDelayedSettings(); // This changes face IDs.
   applySettings();
   auto index = tabWidget_->currentIndex();
   if (index >= 0 && static_cast<size_t>(index) < tabs_.size())
@@ -403,10 +403,10 @@ SettingPanel::applySettings()
 void
 SettingPanel::applyDelayedSettings()
 {
-  // This must not be combined with `applySettings` since those engine
-  // manipulations reset the whole cache!  Therefore, it must only be called
-  // when the selection of the combobox actually changes (a.k.a.
-  // `QComboBox::activate`).
+  // This is not combined with `applySettings` since those engine
+  // manipulations change the face IDs, which needs a reload of the font.
+  // Faces and glyphs of other settings stay in the cache, so switching back
+  // is cheap.
 
   int index = hintingModeComboBox_->currentIndex();
 
@@ -205,7 +205,7 @@ TripletSelector::closeCurrentFont()
   auto idx = fontComboBox_->currentIndex();
   if (idx < 0)
     return;
-  engine_->fontFileManager().remove(idx);
+  engine_->removeFont(idx);
 
   // Show next font after deletion, i.e., retain index if possible.
   int num = engine_->numberOfOpenedFonts();
@@ -13,6 +13,10 @@
 /*                                                                          */
 /****************************************************************************/
 
+#ifndef  _GNU_SOURCE
+#define  _GNU_SOURCE /* we use `getopt', `vsnprintf', and threads */
+#endif
+
 #include <ft2build.h>
 #include <freetype/freetype.h>
 #include <freetype/ftbitmap.h>
@@ -20,17 +24,29 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
 #include <limits.h>
 
 #include "common.h"
 #include "md5.h"
+#include "thread.h"
 
 #ifdef UNIX
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #else
 #include "mlgetopt.h"
 #endif
 
+#ifdef FTDEMO_THREADS
+  static tlock_t  lock = TLOCK_INITIALIZER;
+  static tcond_t  wake = TCOND_INITIALIZER;   /* new chunks are available */
+  static tcond_t  done = TCOND_INITIALIZER;   /* a chunk has been tested  */
+#endif
+
 
   static FT_Error        error;
   static FT_Library      library;
@@ -39,8 +55,92 @@
   static FT_Int32        load_flags  = FT_LOAD_DEFAULT;
 
   static int           ptsize;
+  static int           quiet;
+  static int           num_threads = 1;
+
+
+
+  /* Text is written to stdout if `out' is NULL; otherwise it is  */
+  /* collected in memory, to be written later in the serial order. */
+  typedef struct  Text_
+  {
+    char*   buffer;
+    size_t  length;
+    size_t  size;
+
+  } Text;
+
+
+  /* make room for at least `size' bytes in total */
+  static void
+  Grow( Text*   out,
+        size_t  size )
+  {
+    if ( size <= out->size )
+      return;
+
+    if ( size < 2 * out->size )
+      size = 2 * out->size;
+
+    out->buffer = (char*)realloc( out->buffer, size );
+    if ( !out->buffer )
+      Panic( "could not allocate output buffer\n" );
+
+    out->size = size;
+  }
+
+
+  static void
+  Append( Text*        out,
+          const void*  data,
+          size_t       length )
+  {
+    Grow( out, out->length + length );
+
+    memcpy( out->buffer + out->length, data, length );
+    out->length += length;
+  }
+
+
+  static void
+  Print( Text*        out,
+         const char*  format,
+         ... )
+  {
+    va_list  ap;
+    int      len;
+
+
+    if ( !out )
+    {
+      va_start( ap, format );
+      vprintf( format, ap );
+      va_end( ap );
+      return;
+    }
 
-  static int  Fail;
+    Grow( out, out->length + 256 );
+
+    while ( 1 )
+    {
+      size_t  avail = out->size - out->length;
+
+
+      va_start( ap, format );
+      len = vsnprintf( out->buffer + out->length, avail, format, ap );
+      va_end( ap );
+
+      if ( len >= 0 && (size_t)len < avail )
+      {
+        out->length += (size_t)len;
+        return;
+      }
+
+      /* Windows returns -1 on truncation */
+      Grow( out, len >= 0 ? out->length + (size_t)len + 1
+                          : out->size + 256 );
+    }
+  }
 
 
   /* error messages */
@@ -51,15 +151,17 @@
 
 
   static void
-  Error( const FT_String  *msg )
+  Error( Text*            out,
+         FT_Error         err,
+         const FT_String  *msg )
   {
     const FT_String  *str;
 
 
-    switch( error )
+    switch( err )
     #include <freetype/fterrors.h>
 
-    printf( "%serror = 0x%04x, %s\n", msg, error, str );
+    Print( out, "%serror = 0x%04x, %s\n", msg, err, str );
   }
 
 
@@ -78,15 +180,22 @@
       "  -f L    Use hex number L as load flags (see `FT_LOAD_XXX')\n"
       "  -r N    Set render mode to N\n"
       "  -i I-J  Range of glyph indices to use (default: all)\n"
-      "  -q      Quiet mode without the rendering analysis\n" );
+      "  -j N    Test with N threads; the output does not change\n"
+      "  -q      Quiet mode without the rendering analysis\n"
+      "  -w F    Write the results to baseline file F\n"
+      "  -c F    Compare the results with baseline file F and only\n"
+      "          show changed glyphs\n" );
 
     exit( 1 );
   }
 
 
-  /* Analyze X- and Y-acutance; bitmap should have positive pitch */
+  /* Analyze X- and Y-acutance; bitmap should have positive pitch; */
+  /* a negative value means that the bitmap is void                */
   static void
-  Analyze( FT_Bitmap* bitmap )
+  Analyze( FT_Bitmap*  bitmap,
+           double*     xacut,
+           double*     yacut )
   {
     unsigned int   i, j;
     unsigned char  *b;
@@ -112,10 +221,7 @@
       s1 += (unsigned long)d1;
     }
 
-    if ( s1 )
-      printf( "%.4lf ", (double)s2 / s1 );
-    else
-      printf( "  void " );
+    *xacut = s1 ? (double)s2 / s1 : -1.0;
 
     /* Y-acutance */
     for ( s1 = s2 = 0, j = 0; j < bitmap->width; j++ )
@@ -136,32 +242,926 @@
       s1 += (unsigned long)d1;
     }
 
-    if ( s1 )
-      printf( "%.4lf ", (double)s2 / s1 );
-    else
-      printf( "  void " );
+    *yacut = s1 ? (double)s2 / s1 : -1.0;
   }
 
 
   /* Calculate MD5 checksum; bitmap should have positive pitch */
   static void
-  Checksum( FT_Bitmap* bitmap )
+  Checksum( FT_Bitmap*     bitmap,
+            unsigned char  md5[16] )
   {
-    MD5_CTX        ctx;
-    unsigned char  md5[16];
-    int            i;
+    MD5_CTX  ctx;
+
 
     MD5_Init( &ctx );
     if ( bitmap->buffer )
       MD5_Update( &ctx, bitmap->buffer,
                   (unsigned long)bitmap->rows * (unsigned long)bitmap->pitch );
     MD5_Final( md5, &ctx );
+  }
+
+
+  /* where a glyph has failed */
+#define STAGE_OK       0
+#define STAGE_LOAD     1
+#define STAGE_RENDER   2
+#define STAGE_CONVERT  3
+
+
+  typedef struct  Result_
+  {
+    int            stage;
+    FT_Error       err;
+    unsigned int   width;
+    unsigned int   rows;
+    double         xacut;
+    double         yacut;
+    unsigned char  md5[16];
+
+  } Result;
+
+
+  /* the analysis is only done if `render' is set */
+  static void
+  Test_Glyph( FT_Library    lib,
+              FT_Face       aface,
+              unsigned int  id,
+              int           render,
+              Result*       result )
+  {
+    FT_Bitmap  bitmap;
+
+
+    memset( result, 0, sizeof ( Result ) );
+
+    result->err = FT_Load_Glyph( aface, id, load_flags );
+    if ( result->err )
+    {
+      result->stage = STAGE_LOAD;
+      return;
+    }
+
+    if ( !render )
+      return;
+
+    result->err = FT_Render_Glyph( aface->glyph, render_mode );
+    if ( result->err && result->err != FT_Err_Cannot_Render_Glyph )
+    {
+      result->stage = STAGE_RENDER;
+      return;
+    }
+
+    FT_Bitmap_Init( &bitmap );
+
+    /* convert to an 8-bit bitmap with a positive pitch */
+    result->err = FT_Bitmap_Convert( lib, &aface->glyph->bitmap, &bitmap, 1 );
+    if ( result->err )
+    {
+      result->stage = STAGE_CONVERT;
+      return;
+    }
+
+    result->width = bitmap.width;
+    result->rows  = bitmap.rows;
+
+    Analyze( &bitmap, &result->xacut, &result->yacut );
+    Checksum( &bitmap, result->md5 );
+
+    FT_Bitmap_Done( lib, &bitmap );
+  }
+
+
+  static void
+  Print_Result( Text*          out,
+                const char*    label,
+                const Result*  result )
+  {
+    static const char*  stages[] =
+    {
+      "", "loading ", "rendering ", "converting "
+    };
+
+    int  i;
+
+
+    Print( out, "%5s ", label );
+
+    if ( result->stage != STAGE_OK )
+    {
+      Error( out, result->err, stages[result->stage] );
+      return;
+    }
+
+    Print( out, "%3ux%-4u ", result->width, result->rows );
+
+    if ( result->xacut >= 0 )
+      Print( out, "%.4lf ", result->xacut );
+    else
+      Print( out, "  void " );
+
+    if ( result->yacut >= 0 )
+      Print( out, "%.4lf ", result->yacut );
+    else
+      Print( out, "  void " );
 
     for ( i = 0; i < 16; i++ )
-       printf( "%02X", md5[i] );
+       Print( out, "%02X", result->md5[i] );
+
+    Print( out, "\n" );
+  }
+
+
+  /*************************************************************************/
+  /*                                                                       */
+  /* Golden hash database.  Option `-w' stores the results of all tested   */
+  /* glyphs in a file; option `-c' compares them with such a baseline and  */
+  /* reports the changed glyphs only.  After a 16-byte header (magic,      */
+  /* version, and record size), the file holds fixed-size records with    */
+  /* big-endian numbers, sorted by key, so that the baseline can be mapped */
+  /* into memory and searched in place.  The first 28 bytes are the key.   */
+  /*                                                                       */
+  /*   offset  size  contents                                              */
+  /*                                                                       */
+  /*      0      8   first half of the MD5 checksum of the font file       */
+  /*      8      4   face index                                            */
+  /*     12      4   ppem                                                  */
+  /*     16      4   load flags                                            */
+  /*     20      4   render mode                                           */
+  /*     24      4   glyph index                                           */
+  /*     28      4   stage of failure << 16 | error code                   */
+  /*     32      4   bitmap width                                          */
+  /*     36      4   bitmap rows                                           */
+  /*     40      4   X-acutance * 10000, or 0xFFFFFFFF if void             */
+  /*     44      4   Y-acutance * 10000, or 0xFFFFFFFF if void             */
+  /*     48     16   MD5 checksum of the bitmap                            */
+  /*                                                                       */
+  /*************************************************************************/
+
+#define DB_MAGIC        "FTLINTDB"
+#define DB_VERSION      1
+#define DB_HEADER_SIZE  16
+#define DB_FONT_SIZE    8
+#define DB_KEY_SIZE     28
+#define DB_RECORD_SIZE  64
+#define DB_VOID         0xFFFFFFFFUL
+
+
+  static struct
+  {
+    const char*           write_name;   /* option `-w'              */
+    const char*           check_name;   /* option `-c'              */
+
+    Text                  records;      /* for `-w', unsorted       */
+
+    const unsigned char*  base;         /* for `-c', sorted records */
+    size_t                num_base;
+    void*                 data;         /* the baseline file        */
+    size_t                size;
+    int                   mapped;
+
+  } db;
+
+
+  /* how the glyphs of a face or of all faces compare */
+  typedef struct  Tally_
+  {
+    int  fail;
+    int  same;        /* glyphs equal to the baseline */
+    int  changed;     /* glyphs different from it     */
+    int  added;       /* glyphs not in it             */
+    int  expected;    /* glyphs in it                 */
+
+  } Tally;
+
+
+  static Tally  face_tally;    /* of the current face    */
+  static Tally  total;         /* of all faces, for `-c' */
+
+
+  static void
+  Add_Tally( Tally*        sum,
+             const Tally*  tally )
+  {
+    sum->fail     += tally->fail;
+    sum->same     += tally->same;
+    sum->changed  += tally->changed;
+    sum->added    += tally->added;
+    sum->expected += tally->expected;
+  }
+
+
+  static void
+  Put32( unsigned char*  p,
+         unsigned long   v )
+  {
+    p[0] = (unsigned char)( v >> 24 );
+    p[1] = (unsigned char)( v >> 16 );
+    p[2] = (unsigned char)( v >> 8 );
+    p[3] = (unsigned char)v;
+  }
+
+
+  static unsigned long
+  Get32( const unsigned char*  p )
+  {
+    return ( (unsigned long)p[0] << 24 ) | ( (unsigned long)p[1] << 16 ) |
+           ( (unsigned long)p[2] << 8  ) |   (unsigned long)p[3];
+  }
+
+
+  static void
+  Make_Key( unsigned char*        rec,
+            const unsigned char*  font_key,
+            int                   face_index,
+            unsigned int          id )
+  {
+    memcpy( rec, font_key, DB_FONT_SIZE );
+    Put32( rec +  8, (unsigned long)face_index );
+    Put32( rec + 12, (unsigned long)ptsize );
+    Put32( rec + 16, (unsigned long)load_flags );
+    Put32( rec + 20, (unsigned long)render_mode );
+    Put32( rec + 24, id );
+  }
+
+
+  static void
+  Make_Record( unsigned char*  rec,
+               const Result*   result )
+  {
+    Put32( rec + 28, ( (unsigned long)result->stage << 16 ) |
+                     ( (unsigned long)result->err & 0xFFFF ) );
+    Put32( rec + 32, result->width );
+    Put32( rec + 36, result->rows );
+    Put32( rec + 40, result->xacut >= 0
+                       ? (unsigned long)( result->xacut * 10000 + 0.5 )
+                       : DB_VOID );
+    Put32( rec + 44, result->yacut >= 0
+                       ? (unsigned long)( result->yacut * 10000 + 0.5 )
+                       : DB_VOID );
+    memcpy( rec + 48, result->md5, 16 );
+  }
+
+
+  static void
+  Read_Record( const unsigned char*  rec,
+               Result*               result )
+  {
+    unsigned long  v;
+
+
+    v             = Get32( rec + 28 );
+    result->stage = (int)( v >> 16 );
+    result->err   = (FT_Error)( v & 0xFFFF );
+    result->width = (unsigned int)Get32( rec + 32 );
+    result->rows  = (unsigned int)Get32( rec + 36 );
+
+    v             = Get32( rec + 40 );
+    result->xacut = v == DB_VOID ? -1.0 : v / 10000.0;
+    v             = Get32( rec + 44 );
+    result->yacut = v == DB_VOID ? -1.0 : v / 10000.0;
+
+    memcpy( result->md5, rec + 48, 16 );
+
+    if ( result->stage > STAGE_CONVERT )
+      result->stage = STAGE_CONVERT;
+  }
+
+
+  /* the fonts are identified by their contents, not their names */
+  static void
+  Font_Key( const char*     fname,
+            unsigned char*  font_key )
+  {
+    FILE*          file;
+    MD5_CTX        ctx;
+    unsigned char  md5[16];
+    unsigned char  buffer[65536];
+    size_t         len;
+
+
+    memset( font_key, 0, DB_FONT_SIZE );
+
+    file = fopen( fname, "rb" );
+    if ( !file )
+      return;
+
+    MD5_Init( &ctx );
+    while ( ( len = fread( buffer, 1, sizeof ( buffer ), file ) ) > 0 )
+      MD5_Update( &ctx, buffer, (unsigned long)len );
+    MD5_Final( md5, &ctx );
+
+    fclose( file );
+
+    memcpy( font_key, md5, DB_FONT_SIZE );
+  }
+
+
+  /* the index of the first baseline record whose key is not smaller */
+  static size_t
+  DB_Lower_Bound( const unsigned char*  key )
+  {
+    size_t  lo = 0;
+    size_t  hi = db.num_base;
+
+
+    while ( lo < hi )
+    {
+      size_t  mid = lo + ( hi - lo ) / 2;
+
+
+      if ( memcmp( db.base + mid * DB_RECORD_SIZE, key, DB_KEY_SIZE ) < 0 )
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    return lo;
+  }
+
+
+  static const unsigned char*
+  DB_Lookup( const unsigned char*  key )
+  {
+    size_t  i = DB_Lower_Bound( key );
+
+
+    if ( i < db.num_base                                           &&
+         !memcmp( db.base + i * DB_RECORD_SIZE, key, DB_KEY_SIZE ) )
+      return db.base + i * DB_RECORD_SIZE;
+
+    return NULL;
+  }
+
+
+  /* the number of baseline records for glyphs `first' to `last' */
+  static int
+  DB_Count( const unsigned char*  font_key,
+            int                   face_index,
+            unsigned int          first,
+            unsigned int          last )
+  {
+    unsigned char  key[DB_KEY_SIZE];
+    size_t         lo, hi;
+
+
+    Make_Key( key, font_key, face_index, first );
+    lo = DB_Lower_Bound( key );
+
+    Make_Key( key, font_key, face_index, last );
+    hi = DB_Lower_Bound( key );
+    if ( hi < db.num_base                                           &&
+         !memcmp( db.base + hi * DB_RECORD_SIZE, key, DB_KEY_SIZE ) )
+      hi++;
+
+    return (int)( hi - lo );
+  }
+
+
+  static void
+  DB_Load( const char*  name )
+  {
+    unsigned char*  data = NULL;
+    size_t          size = 0;
+
+#ifdef UNIX
+    int          fd;
+    struct stat  st;
+
+
+    fd = open( name, O_RDONLY );
+    if ( fd >= 0 && !fstat( fd, &st ) && st.st_size > 0 )
+    {
+      void*  p = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+                       fd, 0 );
+
+
+      if ( p != MAP_FAILED )
+      {
+        data      = (unsigned char*)p;
+        size      = (size_t)st.st_size;
+        db.mapped = 1;
+      }
+    }
+    if ( fd >= 0 )
+      close( fd );
+#endif
+
+    if ( !data )
+    {
+      FILE*  file = fopen( name, "rb" );
+      long   len;
+
+
+      if ( !file )
+      {
+        fprintf( stderr, "could not open baseline `%s'\n", name );
+        exit( 1 );
+      }
+
+      if ( !fseek( file, 0, SEEK_END ) && ( len = ftell( file ) ) > 0 )
+      {
+        size = (size_t)len;
+        data = (unsigned char*)malloc( size );
+
+        rewind( file );
+        if ( data && fread( data, 1, size, file ) != size )
+        {
+          free( data );
+          data = NULL;
+        }
+      }
+
+      fclose( file );
+    }
+
+    if ( !data                                                     ||
+         size < DB_HEADER_SIZE                                     ||
+         memcmp( data, DB_MAGIC, 8 )                               ||
+         Get32( data + 8 ) != DB_VERSION                           ||
+         Get32( data + 12 ) != DB_RECORD_SIZE                      ||
+         ( size - DB_HEADER_SIZE ) % DB_RECORD_SIZE                )
+    {
+      fprintf( stderr, "invalid baseline `%s'\n", name );
+      exit( 1 );
+    }
+
+    db.data     = data;
+    db.size     = size;
+    db.base     = data + DB_HEADER_SIZE;
+    db.num_base = ( size - DB_HEADER_SIZE ) / DB_RECORD_SIZE;
+  }
+
+
+  static void
+  DB_Done( void )
+  {
+    if ( !db.data )
+      return;
+
+#ifdef UNIX
+    if ( db.mapped )
+      munmap( db.data, db.size );
+    else
+#endif
+      free( db.data );
+  }
+
+
+  static int
+  Compare_Records( const void*  a,
+                   const void*  b )
+  {
+    return memcmp( a, b, DB_KEY_SIZE );
+  }
+
+
+  static void
+  DB_Save( const char*  name )
+  {
+    FILE*           file;
+    unsigned char   header[DB_HEADER_SIZE];
+    unsigned char*  recs = (unsigned char*)db.records.buffer;
+    size_t          num  = db.records.length / DB_RECORD_SIZE;
+    size_t          i, n;
+
+
+    if ( num )
+      qsort( recs, num, DB_RECORD_SIZE, Compare_Records );
+
+    /* a font given twice must not appear twice */
+    for ( i = n = 0; i < num; i++ )
+    {
+      if ( n > 0                                                          &&
+           !memcmp( recs + ( n - 1 ) * DB_RECORD_SIZE,
+                    recs + i * DB_RECORD_SIZE, DB_KEY_SIZE )               )
+        continue;
+
+      if ( n != i )
+        memcpy( recs + n * DB_RECORD_SIZE, recs + i * DB_RECORD_SIZE,
+                DB_RECORD_SIZE );
+      n++;
+    }
+
+    memcpy( header, DB_MAGIC, 8 );
+    Put32( header + 8, DB_VERSION );
+    Put32( header + 12, DB_RECORD_SIZE );
+
+    file = fopen( name, "wb" );
+    if ( !file                                                      ||
+         fwrite( header, 1, DB_HEADER_SIZE, file ) != DB_HEADER_SIZE ||
+         ( n && fwrite( recs, DB_RECORD_SIZE, n, file ) != n )       )
+    {
+      fprintf( stderr, "could not write baseline `%s'\n", name );
+      exit( 1 );
+    }
+
+    fclose( file );
+    free( db.records.buffer );
   }
 
 
+  /* Test glyphs `first' to `last'.  In check mode, only glyphs that */
+  /* differ from the baseline are printed.                            */
+  static void
+  Lint_Glyphs( Text*                 out,
+               Text*                 records,
+               Tally*                tally,
+               FT_Library            lib,
+               FT_Face               aface,
+               const unsigned char*  font_key,
+               int                   face_index,
+               unsigned int          first,
+               unsigned int          last )
+  {
+    unsigned int  id;
+    int           render = !quiet || db.write_name || db.check_name;
+
+
+    for ( id = first; id <= last; id++ )
+    {
+      Result                result;
+      unsigned char         rec[DB_RECORD_SIZE];
+      const unsigned char*  base = NULL;
+      char                  label[16];
+
+
+      Test_Glyph( lib, aface, id, render, &result );
+
+      if ( result.stage == STAGE_LOAD || result.stage == STAGE_RENDER )
+        tally->fail++;
+
+      if ( font_key )
+      {
+        Make_Key( rec, font_key, face_index, id );
+        Make_Record( rec, &result );
+
+        if ( records )
+          Append( records, rec, DB_RECORD_SIZE );
+      }
+
+      if ( db.check_name )
+      {
+        base = DB_Lookup( rec );
+        if ( !base )
+          tally->added++;
+        else if ( memcmp( base + DB_KEY_SIZE, rec + DB_KEY_SIZE,
+                          DB_RECORD_SIZE - DB_KEY_SIZE )         )
+          tally->changed++;
+        else
+        {
+          tally->same++;
+          continue;
+        }
+      }
+
+      if ( quiet )
+        continue;
+
+      sprintf( label, "%u", id );
+      Print_Result( out, label, &result );
+
+      if ( db.check_name )
+      {
+        if ( base )
+        {
+          Read_Record( base, &result );
+          Print_Result( out, "was", &result );
+        }
+        else
+          Print( out, "%5s not in the baseline\n", "was" );
+      }
+    }
+  }
+
+
+  static void
+  Summary( Text*         out,
+           const Tally*  tally )
+  {
+    if ( tally->fail == 0 )
+      Print( out, "  OK.\n" );
+    else if ( tally->fail == 1 )
+      Print( out, "  1 fail.\n" );
+    else
+      Print( out, "  %d fails.\n", tally->fail );
+
+    if ( db.check_name )
+    {
+      int  missing = tally->expected - tally->same - tally->changed;
+
+
+      if ( tally->changed || tally->added || missing )
+        Print( out, "  %d changed, %d new, %d missing.\n",
+               tally->changed, tally->added, missing );
+      else
+        Print( out, "  unchanged.\n" );
+    }
+  }
+
+
+#ifdef FTDEMO_THREADS
+
+  /*
+   * With option `-j', the glyphs of each face are split into chunks that
+   * helper threads test in any order, each thread with its own library
+   * and face objects.  The main thread opens the faces as usual but
+   * merely queues its output as a list of parts: text, chunks, and face
+   * summaries.  It writes the parts strictly in sequence as soon as they
+   * are complete, so the output is the same as without `-j'.
+   */
+
+#define CHUNK_GLYPHS  64   /* glyphs per chunk                     */
+#define MAX_PENDING   16   /* queued chunks per thread, at most    */
+
+
+  typedef enum  PartKind_
+  {
+    PART_TEXT,
+    PART_CHUNK,
+    PART_SUMMARY
+
+  } PartKind;
+
+
+  typedef struct  Part_
+  {
+    PartKind      kind;
+    Text          text;
+
+    /* chunks only, but for the expected glyphs of summaries */
+    const char*           fname;
+    const unsigned char*  font_key;
+    int                   face_index;
+    unsigned int          first;
+    unsigned int          last;
+    Text                  records;
+    Tally                 tally;
+    int                   done;
+
+  } Part;
+
+
+  /* `parts' is only reallocated by the main thread, with the lock held */
+  static struct
+  {
+    Part*  parts;
+    int    num_parts;
+    int    max_parts;
+
+    int    next;        /* first part not yet looked at by a thread */
+    int    written;     /* number of parts already written          */
+    int    pending;     /* queued chunks not yet written            */
+    int    finished;    /* all parts are queued                     */
+
+  } queue;
+
+
+  static Part*
+  Queue_Part( PartKind  kind )
+  {
+    Part*  part;
+
+
+    LOCK( lock );
+
+    if ( queue.num_parts == queue.max_parts )
+    {
+      queue.max_parts = queue.max_parts ? 2 * queue.max_parts : 256;
+      queue.parts     = (Part*)realloc( queue.parts,
+                                        (size_t)queue.max_parts *
+                                          sizeof ( Part ) );
+      if ( !queue.parts )
+        Panic( "could not allocate output queue\n" );
+    }
+
+    part = queue.parts + queue.num_parts++;
+    memset( part, 0, sizeof ( Part ) );
+    part->kind = kind;
+
+    if ( kind == PART_CHUNK )
+      queue.pending++;
+
+    UNLOCK( lock );
+
+    return part;
+  }
+
+
+  /* where the main thread's text goes */
+  static Text*
+  Output( void )
+  {
+    Part*  part;
+
+
+    if ( num_threads < 2 )
+      return NULL;
+
+    /* only the main thread touches text parts; no need to lock */
+    if ( queue.num_parts > queue.written )
+    {
+      part = queue.parts + queue.num_parts - 1;
+      if ( part->kind == PART_TEXT )
+        return &part->text;
+    }
+
+    return &Queue_Part( PART_TEXT )->text;
+  }
+
+
+  /* Write queued parts in order until more than `max_pending' chunks */
+  /* are left; this waits for the threads if necessary.               */
+  static void
+  Write_Parts( int  max_pending )
+  {
+    LOCK( lock );
+
+    while ( queue.written < queue.num_parts )
+    {
+      Part*  part = queue.parts + queue.written;
+
+
+      if ( part->kind == PART_CHUNK && !part->done )
+      {
+        if ( queue.pending <= max_pending )
+          break;
+
+        WAIT( done, lock );
+        continue;
+      }
+
+      UNLOCK( lock );
+
+      if ( part->kind == PART_SUMMARY )
+      {
+        face_tally.expected = part->tally.expected;
+
+        Summary( NULL, &face_tally );
+        Add_Tally( &total, &face_tally );
+        memset( &face_tally, 0, sizeof ( Tally ) );
+      }
+      else
+      {
+        if ( part->text.length )
+          fwrite( part->text.buffer, 1, part->text.length, stdout );
+        free( part->text.buffer );
+
+        if ( part->records.length )
+          Append( &db.records, part->records.buffer, part->records.length );
+        free( part->records.buffer );
+
+        Add_Tally( &face_tally, &part->tally );
+      }
+
+      LOCK( lock );
+
+      if ( part->kind == PART_CHUNK )
+        queue.pending--;
+      queue.written++;
+    }
+
+    UNLOCK( lock );
+  }
+
+
+  /* queue the glyphs of the current face, then write what is ready */
+  static void
+  Queue_Glyphs( const char*           fname,
+                const unsigned char*  font_key,
+                int                   face_index,
+                unsigned int          first,
+                unsigned int          last,
+                int                   expected )
+  {
+    while ( first <= last )
+    {
+      Part*  part = Queue_Part( PART_CHUNK );
+
+
+      part->fname      = fname;
+      part->font_key   = font_key;
+      part->face_index = face_index;
+      part->first      = first;
+      part->last       = last - first < CHUNK_GLYPHS ? last
+                                                     : first + CHUNK_GLYPHS - 1;
+
+      if ( part->last == last )
+        break;
+
+      first = part->last + 1;
+    }
+
+    Queue_Part( PART_SUMMARY )->tally.expected = expected;
+
+    LOCK( lock );
+    BROADCAST( wake );
+    UNLOCK( lock );
+
+    Write_Parts( MAX_PENDING * num_threads );
+  }
+
+
+  static tthread_ret_t TTHREAD_CALL
+  Lint_Thread( void*  arg )
+  {
+    FT_Library   lib        = (FT_Library)arg;
+    FT_Face      aface      = NULL;
+    const char*  fname      = NULL;
+    int          face_index = -1;
+
+
+    LOCK( lock );
+
+    while ( 1 )
+    {
+      Part      chunk;
+      Text      text    = { NULL, 0, 0 };
+      Text      records = { NULL, 0, 0 };
+      Tally     tally;
+      int       idx;
+      FT_Error  err;
+
+
+      while ( queue.next < queue.num_parts                &&
+              queue.parts[queue.next].kind != PART_CHUNK )
+        queue.next++;
+
+      if ( queue.next == queue.num_parts )
+      {
+        if ( queue.finished )
+          break;
+
+        WAIT( wake, lock );
+        continue;
+      }
+
+      idx   = queue.next++;
+      chunk = queue.parts[idx];
+
+      UNLOCK( lock );
+
+      memset( &tally, 0, sizeof ( Tally ) );
+
+      /* chunks of the same face usually follow each other */
+      if ( !aface                          ||
+           fname      != chunk.fname       ||
+           face_index != chunk.face_index  )
+      {
+        if ( aface )
+          FT_Done_Face( aface );
+
+        fname      = chunk.fname;
+        face_index = chunk.face_index;
+
+        err = FT_New_Face( lib, fname, face_index, &aface );
+        if ( !err )
+        {
+          err = FT_Set_Char_Size( aface, ptsize << 6, ptsize << 6, 72, 72 );
+          if ( err )
+            FT_Done_Face( aface );
+        }
+
+        if ( err )
+        {
+          aface = NULL;
+
+          /* the main thread succeeded, so this is very unlikely */
+          Error( &text, err, "  opening " );
+          tally.fail = (int)( chunk.last - chunk.first + 1 );
+        }
+      }
+
+      if ( aface )
+        Lint_Glyphs( &text, db.write_name ? &records : NULL, &tally,
+                     lib, aface, chunk.font_key, chunk.face_index,
+                     chunk.first, chunk.last );
+
+      LOCK( lock );
+
+      queue.parts[idx].text    = text;
+      queue.parts[idx].records = records;
+      queue.parts[idx].tally   = tally;
+      queue.parts[idx].done    = 1;
+
+      BROADCAST( done );
+    }
+
+    UNLOCK( lock );
+
+    if ( aface )
+      FT_Done_Face( aface );
+
+    return 0;
+  }
+
+#else /* !FTDEMO_THREADS */
+
+#define Output()  NULL
+
+#endif /* !FTDEMO_THREADS */
+
+
   int
   main( int     argc,
         char**  argv )
@@ -172,7 +1172,14 @@
     int           opt;
     unsigned int  first_index = 0;
     unsigned int  last_index = UINT_MAX;
-    int           quiet = 0;
+
+    unsigned char*  font_keys = NULL;
+
+#ifdef FTDEMO_THREADS
+    thandle_t*    threads   = NULL;
+    FT_Library*   libraries = NULL;
+    int           i;
+#endif
 
 
     execname = ft_basename( argv[0] );
@@ -180,12 +1187,16 @@
     if ( argc < 3 )
       Usage( execname );
 
-    while ( ( opt =  getopt( argc, argv, "f:r:i:q") ) != -1)
+    while ( ( opt =  getopt( argc, argv, "c:f:r:i:j:qw:") ) != -1)
     {
 
       switch ( opt )
       {
 
+      case 'c':
+        db.check_name = optarg;
+        break;
+
       case 'f':
         load_flags = strtol( optarg, NULL, 16 );
         break;
@@ -219,10 +1230,20 @@
         }
         break;
 
+      case 'j':
+        num_threads = atoi( optarg );
+        if ( num_threads < 1 )
+          Usage( execname );
+        break;
+
       case 'q':
         quiet = 1;
         break;
 
+      case 'w':
+        db.write_name = optarg;
+        break;
+
       default:
         Usage( execname );
         break;
@@ -239,35 +1260,96 @@
     error = FT_Init_FreeType( &library );
     if ( error )
     {
-      Error( "" );
+      Error( NULL, error, "" );
       exit( 1 );
     }
 
+#ifdef FTDEMO_THREADS
+    if ( num_threads > 1 )
+    {
+      int  n = 0;
+
+
+      threads   = (thandle_t*)calloc( (size_t)num_threads,
+                                      sizeof ( thandle_t ) );
+      libraries = (FT_Library*)calloc( (size_t)num_threads,
+                                       sizeof ( FT_Library ) );
+      if ( !threads || !libraries )
+        Panic( "could not allocate threads\n" );
+
+      for ( i = 0; i < num_threads; i++ )
+      {
+        error = FT_Init_FreeType( &libraries[n] );
+        if ( error )
+        {
+          Error( NULL, error, "" );
+          exit( 1 );
+        }
+
+        if ( start_thread( &threads[n], Lint_Thread, libraries[n] ) )
+          FT_Done_FreeType( libraries[n] );
+        else
+          n++;
+      }
+
+      /* fall back to the serial mode */
+      num_threads = n > 1 ? n : 1;
+      if ( n == 1 )
+      {
+        LOCK( lock );
+        queue.finished = 1;
+        BROADCAST( wake );
+        UNLOCK( lock );
+
+        join_thread( threads[0] );
+        FT_Done_FreeType( libraries[0] );
+      }
+    }
+#endif
+
+    if ( db.check_name )
+      DB_Load( db.check_name );
+
+    if ( db.write_name || db.check_name )
+    {
+      font_keys = (unsigned char*)malloc( (size_t)argc * DB_FONT_SIZE );
+      if ( !font_keys )
+        Panic( "could not allocate font keys\n" );
+    }
+
     /* Now check all files */
     for ( face_index = 0, file_index = 1; file_index < argc; file_index++ )
     {
-      unsigned int  id, fi, li;
+      unsigned int    fi, li;
+      unsigned char*  font_key = NULL;
+      int             expected = 0;
 
 
       fname = argv[file_index];
 
-      printf( "%s:\n", fname );
+      if ( font_keys )
+      {
+        font_key = font_keys + file_index * DB_FONT_SIZE;
+        Font_Key( fname, font_key );
+      }
+
+      Print( Output(), "%s:\n", fname );
 
     Next_Face:
       error = FT_New_Face( library, fname, face_index, &face );
       if ( error )
       {
-        Error( "  opening " );
+        Error( Output(), error, "  opening " );
         continue;
       }
 
-      printf( quiet ? "  %s %s:" : "  %s %s\n",
-              face->family_name, face->style_name );
+      Print( Output(), quiet ? "  %s %s:" : "  %s %s\n",
+             face->family_name, face->style_name );
 
       error = FT_Set_Char_Size( face, ptsize << 6, ptsize << 6, 72, 72 );
       if ( error )
       {
-        Error( "  sizing " );
+        Error( Output(), error, "  sizing " );
         goto Finalize;
       }
 
@@ -282,80 +1364,85 @@
       if ( !quiet )
       {
         /*        "NNNNN AAAxBBBB X.XXXX Y.YYYY MMDD55MMDD55MMDD55MMDD55MMDD55MM" */
-        printf( "\n GID  imgsize  Xacut  Yacut  MD5 hashsum" );
-        printf( "\n-------------------------------------------------------------\n" );
+        Print( Output(), "\n GID  imgsize  Xacut  Yacut  MD5 hashsum" );
+        Print( Output(), "\n-------------------------------------------------------------\n" );
       }
 
-      Fail = 0;
-      for ( id = fi; id <= li; id++ )
+      /* glyphs beyond the current number of glyphs count as missing */
+      if ( db.check_name )
+        expected = DB_Count( font_key, face_index, fi, last_index );
+
+#ifdef FTDEMO_THREADS
+      if ( num_threads > 1 )
       {
-        FT_Bitmap  bitmap;
+        Queue_Glyphs( fname, font_key, face_index, fi, li, expected );
+        goto Finalize;
+      }
+#endif
 
+      memset( &face_tally, 0, sizeof ( Tally ) );
+      face_tally.expected = expected;
 
-        error = FT_Load_Glyph( face, id, load_flags );
-        if ( error )
-        {
-          if ( !quiet )
-          {
-            printf( "%5u ", id );
-            Error( "loading " );
-          }
-          Fail++;
-          continue;
-        }
+      Lint_Glyphs( NULL, db.write_name ? &db.records : NULL, &face_tally,
+                   library, face, font_key, face_index, fi, li );
 
-        if ( quiet )
-          continue;
+      Summary( NULL, &face_tally );
+      Add_Tally( &total, &face_tally );
 
-        printf( "%5u ", id );
+    Finalize:
 
-        error = FT_Render_Glyph( face->glyph, render_mode );
-        if ( error && error != FT_Err_Cannot_Render_Glyph )
-        {
-          Error( "rendering " );
-          Fail++;
-          continue;
-        }
+      if ( ++face_index == face->num_faces )
+        face_index = 0;
 
-        FT_Bitmap_Init( &bitmap );
+      FT_Done_Face( face );
 
-        /* convert to an 8-bit bitmap with a positive pitch */
-        error = FT_Bitmap_Convert( library, &face->glyph->bitmap, &bitmap, 1 );
-        if ( error )
-        {
-          Error( "converting " );
-          continue;
-        }
-        else
-          printf( "%3ux%-4u ", bitmap.width, bitmap.rows );
+      if ( face_index )
+        goto Next_Face;
+    }
 
-        Analyze( &bitmap );
-        Checksum( &bitmap );
+#ifdef FTDEMO_THREADS
+    if ( num_threads > 1 )
+    {
+      LOCK( lock );
+      queue.finished = 1;
+      BROADCAST( wake );
+      UNLOCK( lock );
 
-        FT_Bitmap_Done( library, &bitmap );
+      Write_Parts( 0 );
 
-        printf( "\n" );
+      for ( i = 0; i < num_threads; i++ )
+      {
+        join_thread( threads[i] );
+        FT_Done_FreeType( libraries[i] );
       }
+    }
 
-      if ( Fail == 0 )
-        printf( "  OK.\n" );
-      else if ( Fail == 1 )
-        printf( "  1 fail.\n" );
-      else
-        printf( "  %d fails.\n", Fail );
+    free( threads );
+    free( libraries );
+    free( queue.parts );
+#endif
 
-    Finalize:
+    FT_Done_FreeType( library );
 
-      if ( ++face_index == face->num_faces )
-        face_index = 0;
+    free( font_keys );
 
-      FT_Done_Face( face );
+    if ( db.write_name )
+      DB_Save( db.write_name );
 
-      if ( face_index )
-        goto Next_Face;
+    if ( db.check_name )
+    {
+      int  missing = total.expected - total.same - total.changed;
+
+
+      printf( "%d changed, %d new, %d missing glyphs in total.\n",
+              total.changed, total.added, missing );
+
+      DB_Done();
+
+      if ( total.changed || total.added || missing )
+        exit( 1 );
     }
 
-    FT_Done_FreeType( library );
     exit( 0 );      /* for safety reasons */
 
     /* return 0; */ /* never reached */
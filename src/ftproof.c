@@ -0,0 +1,631 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 2023 by                                                   */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*                                                                          */
+/*  ftproof.c - render specimen images from a job file                      */
+/*                                                                          */
+/****************************************************************************/
+
+
+#include "ftcommon.h"
+#include "common.h"
+#include "mlgetopt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <freetype/ftlcdfil.h>
+
+#ifdef UNIX
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+
+#define MAX_LINE_LENGTH  4096
+
+
+  /* a job renders one image; all fields but `out' are */
+  /* inherited from the previous line of the job file  */
+  typedef struct  Job_
+  {
+    const char*  font;
+    int          ptsize;      /* 26.6, at 72dpi */
+    int          lcd_mode;
+    int          lcd_filter;
+    double       gamma;
+    const char*  text;
+    const char*  out;         /* NULL for a generated name */
+    int          line;
+
+  } Job;
+
+
+  static struct
+  {
+    const char*  dims;
+    const char*  prefix;
+    const char*  job_file;
+    int          num_workers;
+
+    Job*         jobs;
+    int          num_jobs;
+    int          max_jobs;
+
+  } status = { "640x480x24", "ftproof-", NULL, 1, NULL, 0, 0 };
+
+
+  static FTDemo_Handle*   handle;
+  static FTDemo_Display*  display;
+
+
+  typedef struct  Name_
+  {
+    const char*  name;
+    int          value;
+
+  } Name;
+
+
+  static const Name  lcd_modes[] =
+  {
+    { "mono",           LCD_MODE_MONO },
+    { "aa",             LCD_MODE_AA },
+    { "light",          LCD_MODE_LIGHT },
+    { "light-subpixel", LCD_MODE_LIGHT_SUBPIXEL },
+    { "rgb",            LCD_MODE_RGB },
+    { "bgr",            LCD_MODE_BGR },
+    { "vrgb",           LCD_MODE_VRGB },
+    { "vbgr",           LCD_MODE_VBGR },
+    { NULL,             0 }
+  };
+
+  static const Name  lcd_filters[] =
+  {
+    { "none",    FT_LCD_FILTER_NONE },
+    { "default", FT_LCD_FILTER_DEFAULT },
+    { "light",   FT_LCD_FILTER_LIGHT },
+    { "legacy",  FT_LCD_FILTER_LEGACY1 },
+    { NULL,      0 }
+  };
+
+
+  /*************************************************************************/
+  /*************************************************************************/
+  /*****                                                               *****/
+  /*****                        JOB FILE PARSER                        *****/
+  /*****                                                               *****/
+  /*************************************************************************/
+  /*************************************************************************/
+
+
+  static void
+  Job_Error( int          line,
+             const char*  message,
+             const char*  arg )
+  {
+    fprintf( stderr, "%s:%d: %s `%s'\n",
+                     status.job_file, line, message, arg );
+    exit( 1 );
+  }
+
+
+  static int
+  Lookup_Name( const Name*  names,
+               const char*  name,
+               int          line,
+               const char*  what )
+  {
+    for ( ; names->name; names++ )
+      if ( !strcmp( name, names->name ) )
+        return names->value;
+
+    Job_Error( line, what, name );
+    return 0;
+  }
+
+
+  /* split `line' in place into `key=value' pairs and update `job'; */
+  /* the value of `text' extends to the end of the line             */
+  static void
+  Parse_Line( char*  line,
+              Job*   job )
+  {
+    char*  p = line;
+
+
+    job->out = NULL;
+
+    while ( 1 )
+    {
+      char*  key;
+      char*  value;
+
+
+      while ( *p == ' ' || *p == '\t' )
+        p++;
+      if ( !*p )
+        break;
+
+      key = p;
+      while ( *p && *p != '=' && *p != ' ' && *p != '\t' )
+        p++;
+      if ( *p != '=' )
+      {
+        *p = '\0';
+        Job_Error( job->line, "missing value for", key );
+      }
+      *p++ = '\0';
+
+      value = p;
+
+      if ( !strcmp( key, "text" ) )
+      {
+        job->text = value;
+        break;
+      }
+
+      while ( *p && *p != ' ' && *p != '\t' )
+        p++;
+      if ( *p )
+        *p++ = '\0';
+
+      if ( !strcmp( key, "font" ) )
+        job->font = value;
+      else if ( !strcmp( key, "size" ) )
+      {
+        job->ptsize = (int)( atof( value ) * 64.0 );
+        if ( job->ptsize <= 0 )
+          Job_Error( job->line, "invalid size", value );
+      }
+      else if ( !strcmp( key, "mode" ) )
+        job->lcd_mode = Lookup_Name( lcd_modes, value, job->line,
+                                     "unknown render mode" );
+      else if ( !strcmp( key, "filter" ) )
+        job->lcd_filter = Lookup_Name( lcd_filters, value, job->line,
+                                       "unknown LCD filter" );
+      else if ( !strcmp( key, "gamma" ) )
+      {
+        job->gamma = atof( value );
+        if ( job->gamma < 0.0 || job->gamma > 3.0 )
+          Job_Error( job->line, "invalid gamma", value );
+      }
+      else if ( !strcmp( key, "out" ) )
+        job->out = value;
+      else
+        Job_Error( job->line, "unknown key", key );
+    }
+  }
+
+
+  static void
+  Read_Jobs( const char*  filename )
+  {
+    FILE*  file;
+    char   buffer[MAX_LINE_LENGTH];
+    Job    job = { NULL, 32 * 64, LCD_MODE_AA, FT_LCD_FILTER_DEFAULT,
+                   GAMMA, "The quick brown fox jumps over the lazy dog",
+                   NULL, 0 };
+
+
+    if ( !strcmp( filename, "-" ) )
+      file = stdin;
+    else
+      file = fopen( filename, "r" );
+
+    if ( !file )
+    {
+      fprintf( stderr, "could not open job file `%s'\n", filename );
+      exit( 1 );
+    }
+
+    while ( fgets( buffer, MAX_LINE_LENGTH, file ) )
+    {
+      size_t  len = strlen( buffer );
+      char*   p   = buffer;
+
+
+      job.line++;
+
+      while ( len > 0 && ( buffer[len - 1] == '\n' ||
+                           buffer[len - 1] == '\r' ) )
+        buffer[--len] = '\0';
+
+      while ( *p == ' ' || *p == '\t' )
+        p++;
+      if ( !*p || *p == '#' )
+        continue;
+
+      /* the job keeps pointers into the line */
+      p = ft_strdup( p );
+      if ( !p )
+        PanicZ( "could not allocate job" );
+
+      Parse_Line( p, &job );
+
+      if ( !job.font )
+        Job_Error( job.line, "missing key", "font" );
+
+      if ( status.num_jobs >= status.max_jobs )
+      {
+        status.max_jobs = status.max_jobs ? 2 * status.max_jobs : 256;
+        status.jobs     = (Job*)realloc( status.jobs,
+                                         (size_t)status.max_jobs *
+                                           sizeof ( Job ) );
+        if ( !status.jobs )
+          PanicZ( "could not allocate job" );
+      }
+
+      status.jobs[status.num_jobs++] = job;
+    }
+
+    if ( file != stdin )
+      fclose( file );
+  }
+
+
+  /*************************************************************************/
+  /*************************************************************************/
+  /*****                                                               *****/
+  /*****                          RENDERING                            *****/
+  /*****                                                               *****/
+  /*************************************************************************/
+  /*************************************************************************/
+
+
+  /* install fonts on first use only */
+  static PFont
+  Find_Font( const char*  filepath )
+  {
+    int  i;
+
+
+    for ( i = 0; i < handle->num_fonts; i++ )
+      if ( !strcmp( handle->fonts[i]->filepathname, filepath ) )
+        return handle->fonts[i];
+
+    if ( FTDemo_Install_Font( handle, filepath, 0, 1 ) ||
+         handle->num_fonts == i                        )
+      return NULL;
+
+    return handle->fonts[i];
+  }
+
+
+  /* fill the image with lines of text, like the text mode of `ftstring' */
+  static void
+  Render_Text( void )
+  {
+    FTDemo_String_Context  sc = { KERNING_MODE_NORMAL, KERNING_DEGREE_NONE,
+                                  0, 0, NULL, 0, 0 };
+
+    FT_Size  size;
+    int      y, step_y;
+    int      offset = 0;
+
+
+    sc.extent = ( display->bitmap->width - 8 ) * 64;
+
+    if ( FTDemo_Get_Size( handle, &size ) )
+      return;
+
+    step_y = ( size->metrics.height >> 6 ) + 1;
+    y      = 4 + ( size->metrics.ascender >> 6 );
+
+    for ( ; y < display->bitmap->rows + ( size->metrics.descender >> 6 );
+            y += step_y )
+    {
+      sc.offset = offset;
+
+      offset += FTDemo_String_Draw( handle, display, &sc, 4, y );
+
+      offset %= handle->string_length;
+    }
+  }
+
+
+  /* return 1 on failure */
+  static int
+  Render_Job( const Job*  job,
+              int         idx,
+              FT_String*  ver_str )
+  {
+    FTDemo_String_Context  sc = { KERNING_MODE_NORMAL, KERNING_DEGREE_NONE,
+                                  0, 0, NULL, 0, 0 };
+
+    PFont  font;
+    char   filename[MAX_LINE_LENGTH];
+
+
+    font = Find_Font( job->font );
+    if ( !font )
+    {
+      fprintf( stderr, "%s:%d: could not open font `%s'\n",
+                       status.job_file, job->line, job->font );
+      return 1;
+    }
+
+    FTDemo_Set_Current_Font( handle, font );
+    FTDemo_Set_Current_Charsize( handle, job->ptsize, 72 );
+
+    handle->lcd_mode = job->lcd_mode;
+    FTDemo_Update_Current_Flags( handle );
+
+    FT_Library_SetLcdFilter( handle->library,
+                             (FT_LcdFilter)job->lcd_filter );
+
+    display->gamma = job->gamma;
+    grSetTargetGamma( display->surface, display->gamma );
+
+    FTDemo_String_Set( handle, job->text );
+
+    FTDemo_Display_Clear( display );
+
+    if ( handle->string_length > 0 )
+    {
+      if ( FTDemo_String_Load( handle, &sc ) )
+      {
+        fprintf( stderr, "%s:%d: could not load text at size %g\n",
+                         status.job_file, job->line, job->ptsize / 64.0 );
+        return 1;
+      }
+
+      Render_Text();
+    }
+
+    if ( !job->out )
+      snprintf( filename, sizeof ( filename ), "%s%05d.png",
+                status.prefix, idx );
+
+    return FTDemo_Display_Print( display, job->out ? job->out : filename,
+                                 ver_str ) != 0;
+  }
+
+
+  /* render the jobs whose indices are read from `fd', */
+  /* or all jobs if `fd' is negative                   */
+  static int
+  Work( int  fd )
+  {
+    FT_String  ver_str[64] = "ftproof (FreeType) ";
+    int        failures    = 0;
+    int        idx;
+
+
+    handle = FTDemo_New();
+
+    handle->encoding = FT_ENCODING_UNICODE;
+
+    display = FTDemo_Display_New( "batch", status.dims, NULL );
+    if ( !display )
+      PanicZ( "could not allocate display surface" );
+
+    FTDemo_Version( handle, ver_str );
+
+    if ( fd < 0 )
+    {
+      for ( idx = 0; idx < status.num_jobs; idx++ )
+        failures += Render_Job( &status.jobs[idx], idx, ver_str );
+    }
+#ifdef UNIX
+    else
+    {
+      /* writes of an `int' to a pipe are atomic */
+      while ( read( fd, &idx, sizeof ( idx ) ) == sizeof ( idx ) )
+        failures += Render_Job( &status.jobs[idx], idx, ver_str );
+    }
+#endif
+
+    FTDemo_Display_Done( display );
+    FTDemo_Done( handle );
+
+    return failures;
+  }
+
+
+#ifdef UNIX
+
+  /* The worker pool consists of processes since the common demo code */
+  /* is not reentrant.  Job indices are handed out through a pipe, so  */
+  /* each worker picks up the next job as soon as it is done.          */
+  static int
+  Work_Parallel( void )
+  {
+    int  fds[2];
+    int  i, idx;
+    int  num_workers = 0;
+    int  failures    = 0;
+    int  wstatus;
+
+
+    if ( pipe( fds ) )
+      return Work( -1 );
+
+    fflush( stdout );
+    fflush( stderr );
+
+    for ( i = 0; i < status.num_workers; i++ )
+    {
+      pid_t  pid = fork();
+
+
+      if ( pid == 0 )
+      {
+        close( fds[1] );
+        exit( Work( fds[0] ) ? 1 : 0 );
+      }
+
+      if ( pid > 0 )
+        num_workers++;
+    }
+
+    close( fds[0] );
+
+    if ( !num_workers )
+    {
+      close( fds[1] );
+      return Work( -1 );
+    }
+
+    /* an early exit of all workers must not kill us */
+    signal( SIGPIPE, SIG_IGN );
+
+    for ( idx = 0; idx < status.num_jobs; idx++ )
+      while ( write( fds[1], &idx, sizeof ( idx ) ) != sizeof ( idx ) )
+        if ( errno != EINTR )
+        {
+          fprintf( stderr, "lost the workers at job %d\n", idx );
+          failures++;
+          goto Exit;
+        }
+
+  Exit:
+    close( fds[1] );
+
+    while ( wait( &wstatus ) > 0 )
+      if ( !WIFEXITED( wstatus ) || WEXITSTATUS( wstatus ) )
+        failures++;
+
+    return failures;
+  }
+
+#endif /* UNIX */
+
+
+  /*************************************************************************/
+  /*************************************************************************/
+  /*****                                                               *****/
+  /*****                    REST OF THE APPLICATION                    *****/
+  /*****                                                               *****/
+  /*************************************************************************/
+  /*************************************************************************/
+
+
+  static void
+  usage( const char*  execname )
+  {
+    fprintf( stderr,
+      "\n"
+      "ftproof: batch specimen renderer -- part of the FreeType project\n"
+      "----------------------------------------------------------------\n"
+      "\n" );
+    fprintf( stderr,
+      "Usage: %s [options] jobfile\n"
+      "\n",
+             execname );
+    fprintf( stderr,
+      "  jobfile   The file with one image per line (`-' for stdin).\n"
+      "            Each line holds `key=value' pairs, with keys\n"
+      "            `font', `size' (ppem), `mode' (mono, aa, light,\n"
+      "            light-subpixel, rgb, bgr, vrgb, or vbgr), `filter'\n"
+      "            (none, default, light, or legacy), `gamma', `out'\n"
+      "            (PNG file name), and `text' (rest of the line).\n"
+      "            All values but `out' carry over to the next line.\n"
+      "\n" );
+    fprintf( stderr,
+      "  -d WxH[xD]\n"
+      "            Set the image width, height, and color depth\n"
+      "            (default: 640x480x24).\n"
+      "  -j N      Render with N worker processes (default: 1).\n"
+      "  -o prefix Name images without `out' as `prefixNNNNN.png'\n"
+      "            (default: `ftproof-').\n"
+      "\n"
+      "  -v        Show version.\n"
+      "\n" );
+
+    exit( 1 );
+  }
+
+
+  static void
+  parse_cmdline( int*     argc,
+                 char***  argv )
+  {
+    int          option;
+    const char*  execname = ft_basename( (*argv)[0] );
+
+
+    while ( 1 )
+    {
+      option = getopt( *argc, *argv, "d:j:o:v" );
+
+      if ( option == -1 )
+        break;
+
+      switch ( option )
+      {
+      case 'd':
+        status.dims = optarg;
+        break;
+
+      case 'j':
+        status.num_workers = atoi( optarg );
+        if ( status.num_workers < 1 )
+          usage( execname );
+        break;
+
+      case 'o':
+        status.prefix = optarg;
+        break;
+
+      case 'v':
+        {
+          FT_String  str[64] = "ftproof (FreeType) ";
+
+
+          handle = FTDemo_New();
+          FTDemo_Version( handle, str );
+          printf( "%s\n", str );
+          exit( 0 );
+        }
+        /* break; */
+
+      default:
+        usage( execname );
+        break;
+      }
+    }
+
+    *argc -= optind;
+    *argv += optind;
+
+    if ( *argc != 1 )
+      usage( execname );
+
+    status.job_file = *argv[0];
+  }
+
+
+  int
+  main( int     argc,
+        char**  argv )
+  {
+    int  failures;
+
+
+    parse_cmdline( &argc, &argv );
+
+    Read_Jobs( status.job_file );
+
+#ifdef UNIX
+    if ( status.num_workers > 1 && status.num_jobs > 1 )
+      failures = Work_Parallel();
+    else
+#endif
+      failures = Work( -1 );
+
+    exit( failures ? 1 : 0 );
+
+    /* return 0; */ /* never reached */
+  }
+
+
+/* End */
@@ -13,15 +13,28 @@
 /****************************************************************************/
 
 
+#ifndef  _GNU_SOURCE
+#define  _GNU_SOURCE /* we want to use `clock_gettime' if available */
+#endif
+
 #include <freetype/ftmodapi.h>
 
 #include "ftcommon.h"
 #include "common.h"
+#include "thread.h"
 #include "mlgetopt.h"
+#include "gblblit.h"
+#include "grsimd.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#ifdef FTDEMO_THREADS
+  static tlock_t  lock = TLOCK_INITIALIZER;
+#endif
+
 
   typedef FT_Vector  Vec2;
   typedef FT_BBox    Box;
@@ -51,6 +64,8 @@
     FT_Int   y_offset;
     FT_Bool  nearest_filtering;
     float    generation_time;
+    float    draw_time;
+    int      simd;      /* `GBlenderSimd' variant of `draw' */
     FT_Bool  reconstruct;
     FT_Bool  use_bitmap;
     FT_Bool  overlaps;
@@ -65,6 +80,8 @@
   static FTDemo_Handle*   handle  = NULL;
   static FTDemo_Display*  display = NULL;
 
+  static int  num_threads = 1;   /* option `-j' */
+
   static Status  status =
   {
     /* face              */ NULL,
@@ -76,6 +93,8 @@
     /* y_offset          */ 0,
     /* nearest_filtering */ 0,
     /* generation_time   */ 0.0f,
+    /* draw_time         */ 0.0f,
+    /* simd              */ GBLENDER_SIMD_NONE,
     /* reconstruct       */ 0,
     /* use_bitmap        */ 0,
     /* overlaps          */ 0,
@@ -196,6 +215,7 @@
     grWriteln( "  a, d               : Move glyph Left/right" );
     grLn();
     grWriteln( "  f                  : Toggle between bilinear/nearest filtering" );
+    grWriteln( "  v                  : Toggle between vector/portable drawing code" );
     grLn();
     grWriteln( "  m                  : Toggle overlapping support" );
     grLn();
@@ -219,6 +239,8 @@
   static void
   write_header( void )
   {
+    static const char*  simd_names[] = { "Portable", "SSE2", "AVX2", "NEON" };
+
     static char  header_string[512];
 
 
@@ -239,9 +261,14 @@
                        header_string, display->fore_color );
 
     sprintf( header_string,
-             "SDF Generated in: %.0f ms, From: %s",
+             "SDF Generated in: %.0f ms, From: %s,"
+             " Drawn in: %.1f ms (%s, %d thread%s)",
              (double)status.generation_time,
-             status.use_bitmap ? "Bitmap" : "Outline" );
+             status.use_bitmap ? "Bitmap" : "Outline",
+             (double)status.draw_time,
+             simd_names[status.simd],
+             num_threads,
+             num_threads == 1 ? "" : "s" );
     grWriteCellString( display->bitmap, 0, 2 * HEADER_HEIGHT,
                        header_string, display->fore_color );
 
@@ -361,6 +388,11 @@
     case grKEY( 'r' ):
       status.reconstruct = !status.reconstruct;
       break;
+    case grKEY( 'v' ):
+      status.simd = status.simd == GBLENDER_SIMD_NONE
+                      ? gblender_simd_level()
+                      : GBLENDER_SIMD_NONE;
+      break;
 
     case grKEY( 'i' ):
       status.width += 0.5f;
@@ -450,6 +482,609 @@
     return ( signed_dist / 128.0f ) * (float)status.spread;
   }
 
+
+  /* wall-clock timer in microseconds */
+  static double
+  get_wall_time( void )
+  {
+#if defined  _WIN32
+    LARGE_INTEGER  ticks, freq;
+
+
+    QueryPerformanceCounter( &ticks );
+    QueryPerformanceFrequency( &freq );
+
+    return 1E6 * (double)ticks.QuadPart / (double)freq.QuadPart;
+
+#elif defined _POSIX_TIMERS && _POSIX_TIMERS > 0
+    struct timespec  tv;
+
+
+#ifdef _POSIX_MONOTONIC_CLOCK
+    clock_gettime( CLOCK_MONOTONIC, &tv );
+#else
+    clock_gettime( CLOCK_REALTIME, &tv );
+#endif
+
+    return 1E6 * (double)tv.tv_sec + 1E-3 * (double)tv.tv_nsec;
+
+#else
+    return 1E6 * (double)time( NULL );
+#endif
+  }
+
+
+  /* The display is drawn row by row, split into bands of rows for the */
+  /* threads of option `-j'.  Each display row needs a single line of  */
+  /* distances, interpolated between the two sample rows around it;    */
+  /* the display pixels are then interpolated between the two entries  */
+  /* of this line around them.  The positions and fractions of the     */
+  /* columns are the same for all rows and computed once per frame.    */
+  /*                                                                   */
+  /* The vector variants of both steps give exactly the same result as */
+  /* the portable code.                                                */
+
+  typedef void
+  (*DrawLineFunc)( float*          line,
+                   const FT_Byte*  src0,
+                   const FT_Byte*  src1,
+                   float           fy );
+
+  typedef void
+  (*DrawPixelsFunc)( const float*    line,
+                     unsigned char*  dst );
+
+
+  static struct
+  {
+    const FT_Byte*  buffer;       /* the SDF, `width' x `rows' bytes     */
+    int             width;
+    int             rows;
+    int             scale;
+    FT_Bool         nearest;
+    FT_Bool         reconstruct;
+    float           spread;
+    float           edge0;        /* range of `smoothstep'               */
+    float           edge1;
+
+    int             x_min;        /* first display column                */
+    int             count;        /* number of display columns           */
+    int*            ix;           /* left line entry of each column      */
+    float*          fx;           /*   and the fraction of the right one */
+    int             first_col;    /* sample column of the first entry    */
+    int             num_cols;     /* entries of a line                   */
+
+    int             top;          /* display row of the first sample row */
+    int             first_row;
+    int             num_rows;
+
+    DrawLineFunc    line_func;
+    DrawPixelsFunc  pixels_func;
+
+  } frame;
+
+
+  typedef struct  DrawWorker_
+  {
+    float*     line;              /* `frame.num_cols' entries */
+    int        first;             /* band of rows, relative   */
+    int        last;              /*   to `frame.first_row'   */
+
+#ifdef FTDEMO_THREADS
+    thandle_t  thread;
+#endif
+
+  } DrawWorker;
+
+
+  static DrawWorker*  draw_workers;
+  static int          draw_max_cols;
+
+
+  /* Fill `line' with the distances between the sample rows `src0' and */
+  /* `src1', from entry `k' on; a NULL row or a column outside of the  */
+  /* SDF gives the minimum distance.                                   */
+  static void
+  draw_line_from( float*          line,
+                  const FT_Byte*  src0,
+                  const FT_Byte*  src1,
+                  float           fy,
+                  int             k )
+  {
+    for ( ; k < frame.num_cols; k++ )
+    {
+      int    col = frame.first_col + k;
+      float  d0  = -frame.spread;
+      float  d1  = -frame.spread;
+
+
+      if ( col < frame.width )
+      {
+        if ( src0 )
+          d0 = map_sdf_to_float( src0[col] );
+        if ( src1 )
+          d1 = map_sdf_to_float( src1[col] );
+      }
+
+      line[k] = d0 * ( 1.0f - fy ) + d1 * fy;
+    }
+  }
+
+
+  /* Draw the display columns from `c' on. */
+  static void
+  draw_pixels_from( const float*    line,
+                    unsigned char*  dst,
+                    int             c )
+  {
+    for ( ; c < frame.count; c++ )
+    {
+      float  fx   = frame.fx[c];
+      float  dist = ( 1.0f - fx ) * line[frame.ix[c]] +
+                    fx * line[frame.ix[c] + 1];
+      float  value;
+
+
+      if ( frame.reconstruct )
+      {
+        /* If we are reconstructing then discard all values outside of  */
+        /* the range defined by `status.width` and use `status.edge' to */
+        /* make smooth anti-aliased edges.                              */
+
+        /* This is similar to an OpenGL implementation to draw SDF. */
+        value = 1.0f - smoothstep( frame.edge0, frame.edge1, -dist );
+      }
+      else
+      {
+        /* If not reconstructing then normalize the absolute values */
+        /* between [0, 255] and invert them.                        */
+        dist  = dist < 0 ? -dist : dist;
+        value = 1.0f - dist / frame.spread;
+      }
+
+      value *= 255;
+
+      dst[3 * c + 0] = (unsigned char)value;
+      dst[3 * c + 1] = (unsigned char)value;
+      dst[3 * c + 2] = (unsigned char)value;
+    }
+  }
+
+
+  static void
+  draw_line_c( float*          line,
+               const FT_Byte*  src0,
+               const FT_Byte*  src1,
+               float           fy )
+  {
+    draw_line_from( line, src0, src1, fy, 0 );
+  }
+
+
+  static void
+  draw_pixels_c( const float*    line,
+                 unsigned char*  dst )
+  {
+    draw_pixels_from( line, dst, 0 );
+  }
+
+
+#ifdef GBLENDER_HAVE_SSE2
+
+  /* Each step below is the same IEEE operation as in the portable */
+  /* code, in the same order.                                      */
+
+  static GSIMD_ATTR_sse2 __m128
+  draw_map_sse2( __m128  v )
+  {
+    return _mm_mul_ps( _mm_div_ps( _mm_sub_ps( v, _mm_set1_ps( 128.0f ) ),
+                                   _mm_set1_ps( 128.0f ) ),
+                       _mm_set1_ps( frame.spread ) );
+  }
+
+
+  static GSIMD_ATTR_sse2 void
+  draw_line_sse2( float*          line,
+                  const FT_Byte*  src0,
+                  const FT_Byte*  src1,
+                  float           fy )
+  {
+    __m128   f1    = _mm_set1_ps( fy );
+    __m128   f0    = _mm_set1_ps( 1.0f - fy );
+    __m128   d0    = _mm_set1_ps( -frame.spread );
+    __m128   d1    = d0;
+    __m128i  zeroi = _mm_setzero_si128();
+
+    int  limit = frame.width - frame.first_col;
+    int  k;
+
+
+    if ( limit > frame.num_cols )
+      limit = frame.num_cols;
+
+    for ( k = 0; k + 4 <= limit; k += 4 )
+    {
+      int  col = frame.first_col + k;
+      int  bytes;
+
+
+      if ( src0 )
+      {
+        memcpy( &bytes, src0 + col, 4 );
+        d0 = draw_map_sse2( _mm_cvtepi32_ps(
+               _mm_unpacklo_epi16(
+                 _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zeroi ),
+                 zeroi ) ) );
+      }
+      if ( src1 )
+      {
+        memcpy( &bytes, src1 + col, 4 );
+        d1 = draw_map_sse2( _mm_cvtepi32_ps(
+               _mm_unpacklo_epi16(
+                 _mm_unpacklo_epi8( _mm_cvtsi32_si128( bytes ), zeroi ),
+                 zeroi ) ) );
+      }
+
+      _mm_storeu_ps( line + k, _mm_add_ps( _mm_mul_ps( d0, f0 ),
+                                           _mm_mul_ps( d1, f1 ) ) );
+    }
+
+    draw_line_from( line, src0, src1, fy, k );
+  }
+
+
+  static GSIMD_ATTR_sse2 void
+  draw_pixels_sse2( const float*    line,
+                    unsigned char*  dst )
+  {
+    __m128   one     = _mm_set1_ps( 1.0f );
+    __m128   sign    = _mm_set1_ps( -0.0f );
+    __m128i  lo32    = _mm_set_epi32( 0, -1, 0, -1 );
+    __m128i  lo64    = _mm_set_epi32( 0, 0, -1, -1 );
+    __m128   edge0   = _mm_set1_ps( frame.edge0 );
+    __m128   edge1   = _mm_set1_ps( frame.edge1 );
+    __m128   spread  = _mm_set1_ps( frame.spread );
+
+    int  c;
+
+
+    for ( c = 0; c + 4 <= frame.count; c += 4 )
+    {
+      const int*  ix = frame.ix + c;
+
+      __m128   fx   = _mm_loadu_ps( frame.fx + c );
+      __m128   a    = _mm_setr_ps( line[ix[0]], line[ix[1]],
+                                   line[ix[2]], line[ix[3]] );
+      __m128   b    = _mm_setr_ps( line[ix[0] + 1], line[ix[1] + 1],
+                                   line[ix[2] + 1], line[ix[3] + 1] );
+      __m128   dist = _mm_add_ps( _mm_mul_ps( _mm_sub_ps( one, fx ), a ),
+                                  _mm_mul_ps( fx, b ) );
+      __m128   value;
+      __m128i  g;
+      int      last;
+
+
+      if ( frame.reconstruct )
+      {
+        __m128  x;
+
+
+        /* smoothstep */
+        x = _mm_div_ps( _mm_sub_ps( _mm_xor_ps( dist, sign ), edge0 ),
+                        _mm_sub_ps( edge1, edge0 ) );
+        x = _mm_min_ps( _mm_max_ps( x, _mm_setzero_ps() ), one );
+        x = _mm_mul_ps( _mm_mul_ps( x, x ),
+                        _mm_sub_ps( _mm_set1_ps( 3.0f ),
+                                    _mm_mul_ps( _mm_set1_ps( 2.0f ),
+                                                x ) ) );
+
+        value = _mm_sub_ps( one, x );
+      }
+      else
+        value = _mm_sub_ps( one, _mm_div_ps( _mm_andnot_ps( sign, dist ),
+                                             spread ) );
+
+      value = _mm_mul_ps( value, _mm_set1_ps( 255.0f ) );
+
+      /* replicate the gray value of each pixel to 0x00gggggg, */
+      /* then squeeze out the fourth bytes: 12 bytes in all    */
+      g = _mm_cvttps_epi32( value );
+      g = _mm_or_si128( g, _mm_or_si128( _mm_slli_epi32( g, 8 ),
+                                         _mm_slli_epi32( g, 16 ) ) );
+      g = _mm_or_si128( _mm_and_si128( g, lo32 ),
+                        _mm_slli_epi64( _mm_srli_epi64( g, 32 ), 24 ) );
+      g = _mm_or_si128( _mm_and_si128( g, lo64 ),
+                        _mm_srli_si128( _mm_andnot_si128( lo64, g ), 2 ) );
+
+      _mm_storel_epi64( (__m128i*)( dst + 3 * c ), g );
+      last = _mm_cvtsi128_si32( _mm_srli_si128( g, 8 ) );
+      memcpy( dst + 3 * c + 8, &last, 4 );
+    }
+
+    draw_pixels_from( line, dst, c );
+  }
+
+#endif /* GBLENDER_HAVE_SSE2 */
+
+
+#ifdef GBLENDER_HAVE_AVX2
+
+  static GSIMD_ATTR_avx2 __m256
+  draw_map_avx2( __m256  v )
+  {
+    return _mm256_mul_ps( _mm256_div_ps( _mm256_sub_ps(
+                                           v, _mm256_set1_ps( 128.0f ) ),
+                                         _mm256_set1_ps( 128.0f ) ),
+                          _mm256_set1_ps( frame.spread ) );
+  }
+
+
+  static GSIMD_ATTR_avx2 void
+  draw_line_avx2( float*          line,
+                  const FT_Byte*  src0,
+                  const FT_Byte*  src1,
+                  float           fy )
+  {
+    __m256  f1 = _mm256_set1_ps( fy );
+    __m256  f0 = _mm256_set1_ps( 1.0f - fy );
+    __m256  d0 = _mm256_set1_ps( -frame.spread );
+    __m256  d1 = d0;
+
+    int  limit = frame.width - frame.first_col;
+    int  k;
+
+
+    if ( limit > frame.num_cols )
+      limit = frame.num_cols;
+
+    for ( k = 0; k + 8 <= limit; k += 8 )
+    {
+      int  col = frame.first_col + k;
+
+
+      if ( src0 )
+        d0 = draw_map_avx2( _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32(
+               _mm_loadl_epi64( (const __m128i*)( src0 + col ) ) ) ) );
+      if ( src1 )
+        d1 = draw_map_avx2( _mm256_cvtepi32_ps( _mm256_cvtepu8_epi32(
+               _mm_loadl_epi64( (const __m128i*)( src1 + col ) ) ) ) );
+
+      _mm256_storeu_ps( line + k, _mm256_add_ps( _mm256_mul_ps( d0, f0 ),
+                                                 _mm256_mul_ps( d1, f1 ) ) );
+    }
+
+    draw_line_from( line, src0, src1, fy, k );
+  }
+
+
+  static GSIMD_ATTR_avx2 void
+  draw_pixels_avx2( const float*    line,
+                    unsigned char*  dst )
+  {
+    __m256   one    = _mm256_set1_ps( 1.0f );
+    __m256   sign   = _mm256_set1_ps( -0.0f );
+    __m256   edge0  = _mm256_set1_ps( frame.edge0 );
+    __m256   edge1  = _mm256_set1_ps( frame.edge1 );
+    __m256   spread = _mm256_set1_ps( frame.spread );
+    __m128i  rgb0   = _mm_setr_epi8( 0, 0, 0, 1, 1, 1, 2, 2,
+                                     2, 3, 3, 3, 4, 4, 4, 5 );
+    __m128i  rgb1   = _mm_setr_epi8( 5, 5, 6, 6, 6, 7, 7, 7,
+                                     -1, -1, -1, -1, -1, -1, -1, -1 );
+
+    int  c;
+
+
+    for ( c = 0; c + 8 <= frame.count; c += 8 )
+    {
+      const int*  ix = frame.ix + c;
+
+      __m256   fx   = _mm256_loadu_ps( frame.fx + c );
+      __m256   a    = _mm256_setr_ps( line[ix[0]], line[ix[1]],
+                                      line[ix[2]], line[ix[3]],
+                                      line[ix[4]], line[ix[5]],
+                                      line[ix[6]], line[ix[7]] );
+      __m256   b    = _mm256_setr_ps( line[ix[0] + 1], line[ix[1] + 1],
+                                      line[ix[2] + 1], line[ix[3] + 1],
+                                      line[ix[4] + 1], line[ix[5] + 1],
+                                      line[ix[6] + 1], line[ix[7] + 1] );
+      __m256   dist = _mm256_add_ps( _mm256_mul_ps( _mm256_sub_ps( one, fx ),
+                                                    a ),
+                                     _mm256_mul_ps( fx, b ) );
+      __m256   value;
+      __m256i  g;
+      __m128i  gray;
+
+
+      if ( frame.reconstruct )
+      {
+        __m256  x;
+
+
+        /* smoothstep */
+        x = _mm256_div_ps( _mm256_sub_ps( _mm256_xor_ps( dist, sign ),
+                                          edge0 ),
+                           _mm256_sub_ps( edge1, edge0 ) );
+        x = _mm256_min_ps( _mm256_max_ps( x, _mm256_setzero_ps() ), one );
+        x = _mm256_mul_ps( _mm256_mul_ps( x, x ),
+                           _mm256_sub_ps( _mm256_set1_ps( 3.0f ),
+                                          _mm256_mul_ps(
+                                            _mm256_set1_ps( 2.0f ), x ) ) );
+
+        value = _mm256_sub_ps( one, x );
+      }
+      else
+        value = _mm256_sub_ps( one,
+                               _mm256_div_ps( _mm256_andnot_ps( sign, dist ),
+                                              spread ) );
+
+      value = _mm256_mul_ps( value, _mm256_set1_ps( 255.0f ) );
+
+      /* pack the eight gray values into bytes, then triple them */
+      g    = _mm256_cvttps_epi32( value );
+      gray = _mm_packs_epi32( _mm256_castsi256_si128( g ),
+                              _mm256_extracti128_si256( g, 1 ) );
+      gray = _mm_packus_epi16( gray, gray );
+
+      _mm_storeu_si128( (__m128i*)( dst + 3 * c ),
+                        _mm_shuffle_epi8( gray, rgb0 ) );
+      _mm_storel_epi64( (__m128i*)( dst + 3 * c + 16 ),
+                        _mm_shuffle_epi8( gray, rgb1 ) );
+    }
+
+    draw_pixels_from( line, dst, c );
+  }
+
+#endif /* GBLENDER_HAVE_AVX2 */
+
+
+  static tthread_ret_t TTHREAD_CALL
+  draw_worker_run( void*  arg )
+  {
+    DrawWorker*  worker = (DrawWorker*)arg;
+    int          r;
+
+
+    for ( r = worker->first; r < worker->last; r++ )
+    {
+      int  y = frame.first_row + r;
+      int  j = frame.top - r;
+      int  iy;
+
+      float  fy;
+
+      const FT_Byte*  src0 = NULL;
+      const FT_Byte*  src1 = NULL;
+
+
+      if ( frame.nearest )
+      {
+        /* If nearest filtering then simply take the value of the */
+        /* nearest sampling pixel.                                */
+        iy = y / frame.scale;
+        fy = 0.0f;
+      }
+      else
+      {
+        /* If bilinear filtering then compute the bilinear      */
+        /* interpolation of the current draw pixel using        */
+        /* the nearby sampling pixel values.                    */
+        /*                                                      */
+        /* Again the concept is taken from Wikipedia.           */
+        /*                                                      */
+        /* https://en.wikipedia.org/wiki/Bilinear_interpolation */
+        float  bi_y = (float)y / (float)frame.scale;
+
+
+        iy = (int)bi_y;
+        fy = bi_y - (float)iy;
+      }
+
+      if ( iy < frame.rows )
+        src0 = frame.buffer + iy * frame.width;
+      if ( iy + 1 < frame.rows )
+        src1 = frame.buffer + ( iy + 1 ) * frame.width;
+
+      frame.line_func( worker->line, src0, src1, fy );
+      frame.pixels_func( worker->line,
+                         display->bitmap->buffer +
+                           j * display->bitmap->pitch + frame.x_min * 3 );
+    }
+
+    return 0;
+  }
+
+
+  /* Set up `frame' for the columns, starting at sample column `x', */
+  /* and for the variant; the workers get their lines and an even    */
+  /* share of the rows.                                              */
+  static FT_Error
+  draw_setup( int  x,
+              int  num_workers )
+  {
+    int  c, i;
+
+
+    frame.ix = (int*)realloc( frame.ix,
+                              (size_t)frame.count * sizeof ( int ) );
+    frame.fx = (float*)realloc( frame.fx,
+                                (size_t)frame.count * sizeof ( float ) );
+    if ( !frame.ix || !frame.fx )
+      return FT_Err_Out_Of_Memory;
+
+    for ( c = 0; c < frame.count; c++, x++ )
+    {
+      if ( frame.nearest )
+      {
+        frame.ix[c] = x / frame.scale;
+        frame.fx[c] = 0.0f;
+      }
+      else
+      {
+        float  bi_x = (float)x / (float)frame.scale;
+
+
+        frame.ix[c] = (int)bi_x;
+        frame.fx[c] = bi_x - (float)frame.ix[c];
+      }
+    }
+
+    /* make the positions relative to the first entry of the line */
+    frame.first_col = frame.ix[0];
+    frame.num_cols  = frame.ix[frame.count - 1] - frame.first_col + 2;
+
+    for ( c = 0; c < frame.count; c++ )
+      frame.ix[c] -= frame.first_col;
+
+    if ( !draw_workers )
+    {
+      draw_workers = (DrawWorker*)calloc( (size_t)num_workers,
+                                          sizeof ( DrawWorker ) );
+      if ( !draw_workers )
+        return FT_Err_Out_Of_Memory;
+    }
+
+    for ( i = 0; i < num_workers; i++ )
+    {
+      if ( frame.num_cols > draw_max_cols )
+      {
+        draw_workers[i].line = (float*)realloc(
+                                 draw_workers[i].line,
+                                 (size_t)frame.num_cols * sizeof ( float ) );
+        if ( !draw_workers[i].line )
+          return FT_Err_Out_Of_Memory;
+      }
+
+      draw_workers[i].first = frame.num_rows * i / num_workers;
+      draw_workers[i].last  = frame.num_rows * ( i + 1 ) / num_workers;
+    }
+
+    if ( frame.num_cols > draw_max_cols )
+      draw_max_cols = frame.num_cols;
+
+    switch ( status.simd )
+    {
+#ifdef GBLENDER_HAVE_AVX2
+    case GBLENDER_SIMD_AVX2:
+      frame.line_func   = draw_line_avx2;
+      frame.pixels_func = draw_pixels_avx2;
+      break;
+#endif
+#ifdef GBLENDER_HAVE_SSE2
+    case GBLENDER_SIMD_SSE2:
+      frame.line_func   = draw_line_sse2;
+      frame.pixels_func = draw_pixels_sse2;
+      break;
+#endif
+    default:
+      status.simd       = GBLENDER_SIMD_NONE;
+      frame.line_func   = draw_line_c;
+      frame.pixels_func = draw_pixels_c;
+    }
+
+    return FT_Err_Ok;
+  }
+
+
   /* Draw an SDF image to the display. */
   static FT_Error
   draw( void )
@@ -459,13 +1094,22 @@
     Box  draw_region;
     Box  sample_region;
 
-    Vec2       center;
-    FT_Byte*   buffer;
+    Vec2  center;
+
+    FT_Error  err;
+    int       num_workers = num_threads;
+    double    t0;
+
+#ifdef FTDEMO_THREADS
+    int       i, num_started;
+#endif
 
 
     if ( !bitmap || !bitmap->buffer )
       return FT_Err_Invalid_Argument;
 
+    t0 = get_wall_time();
+
     /* compute center of display */
     center.x = display->bitmap->width / 2;
     center.y = display->bitmap->rows  / 2;
@@ -520,143 +1164,695 @@
       draw_region.xMax    = display->bitmap->width;
     }
 
-    buffer = (FT_Byte*)bitmap->buffer;
+    if ( draw_region.xMax <= draw_region.xMin ||
+         draw_region.yMax <= draw_region.yMin )
+      return FT_Err_Ok;
+
+    /* Finally copy the pixels from the sample region to the draw */
+    /* region; sample row `first_row' goes to display row `top'.  */
+    frame.buffer      = (const FT_Byte*)bitmap->buffer;
+    frame.width       = (int)bitmap->width;
+    frame.rows        = (int)bitmap->rows;
+    frame.scale       = (int)status.scale;
+    frame.nearest     = status.nearest_filtering;
+    frame.reconstruct = status.reconstruct;
+    frame.spread      = (float)status.spread;
+    frame.edge0       = status.width;
+    frame.edge1       = status.width + status.edge;
+
+    frame.x_min     = (int)draw_region.xMin;
+    frame.count     = (int)( draw_region.xMax - draw_region.xMin );
+    frame.top       = (int)draw_region.yMax - 1;
+    frame.first_row = (int)sample_region.yMin;
+    frame.num_rows  = (int)( draw_region.yMax - draw_region.yMin );
+
+#ifndef FTDEMO_THREADS
+    num_workers = 1;
+#endif
+
+    err = draw_setup( (int)sample_region.xMin, num_workers );
+    if ( err )
+      return err;
+
+#ifdef FTDEMO_THREADS
+    /* the main thread draws the first band */
+    for ( i = 1; i < num_workers; i++ )
+      if ( start_thread( &draw_workers[i].thread,
+                         draw_worker_run,
+                         &draw_workers[i] ) )
+        break;
+    num_started = i;
+#endif
+
+    draw_worker_run( &draw_workers[0] );
+
+#ifdef FTDEMO_THREADS
+    for ( i = 1; i < num_started; i++ )
+      join_thread( draw_workers[i].thread );
+
+    /* bands of threads that did not start */
+    for ( ; i < num_workers; i++ )
+      draw_worker_run( &draw_workers[i] );
+#endif
+
+    status.draw_time = (float)( ( get_wall_time() - t0 ) / 1000.0 );
+
+    return FT_Err_Ok;
+  }
+
+
+  static void
+  draw_done( void )
+  {
+    int  i;
+
+
+    if ( draw_workers )
+      for ( i = 0; i < num_threads; i++ )
+        free( draw_workers[i].line );
+
+    free( draw_workers );
+    free( frame.ix );
+    free( frame.fx );
+  }
+
+
+  /*************************************************************************/
+  /*************************************************************************/
+  /*****                                                               *****/
+  /*****                          ATLAS MODE                           *****/
+  /*****                                                               *****/
+  /*************************************************************************/
+  /*************************************************************************/
+
+  /* With option `-a', no window is opened.  Instead, the SDFs of a whole */
+  /* charset are generated, optionally by several threads, each with its  */
+  /* own library and face.  They are packed into an atlas image with a    */
+  /* bottom-left skyline packer, and a table of glyph positions and       */
+  /* metrics is written along with it.  The packing only starts after     */
+  /* all glyphs are generated, so the atlas does not depend on the number */
+  /* of threads.                                                          */
+
+#define ATLAS_PADDING  1     /* gap between glyphs, in pixels */
+#define ATLAS_CHUNK    16    /* glyphs taken by a thread at once */
 
-    /* Finally loop over all pixels inside the draw region        */
-    /* and copy pixels from the sample region to the draw region. */
-    for ( FT_Int  j = draw_region.yMax - 1,
-                  y = sample_region.yMin;
-          j >= draw_region.yMin;
-          j--, y++ )
+
+  typedef struct  AtlasGlyph_
+  {
+    FT_UInt   gindex;
+    FT_Error  error;
+    int       width;        /* SDF size                 */
+    int       rows;
+    int       left;         /* SDF offset to the origin */
+    int       top;
+    FT_Pos    advance;      /* 26.6                     */
+    FT_Byte*  buffer;       /* `width' x `rows' bytes   */
+    int       x;            /* position in the atlas    */
+    int       y;
+
+  } AtlasGlyph;
+
+
+  typedef struct  AtlasChar_
+  {
+    FT_ULong  charcode;
+    int       glyph;        /* index into `atlas.glyphs' */
+
+  } AtlasChar;
+
+
+  static struct
+  {
+    const char*  prefix;         /* option `-a'                      */
+    FT_ULong     first_char;     /* option `-c'                      */
+    FT_ULong     last_char;
+    int          width;          /* option `-w'                      */
+    const char*  font_name;
+
+    AtlasChar*   chars;
+    int          num_chars;
+    AtlasGlyph*  glyphs;
+    int          num_glyphs;
+
+    int          height;
+    int          next;           /* next glyph to generate           */
+
+  } atlas = { NULL, 0, ~0UL, 1024, NULL, NULL, 0, NULL, 0, 0, 0 };
+
+
+  typedef struct  AtlasWorker_
+  {
+    FT_Library  library;
+    FT_Face     face;
+    FT_Bool     use_bitmap;
+    FT_Bool     keep;         /* store the SDFs in `atlas.glyphs' */
+    int         failures;
+
+#ifdef FTDEMO_THREADS
+    thandle_t   thread;
+#endif
+
+  } AtlasWorker;
+
+
+  static FT_Error
+  atlas_worker_init( AtlasWorker*  worker )
+  {
+    FT_Error  err;
+
+
+    FT_CALL( FT_Init_FreeType( &worker->library ) );
+    FT_CALL( FT_Property_Set( worker->library, "bsdf", "spread",
+                              &status.spread ) );
+    FT_CALL( FT_Property_Set( worker->library, "sdf", "spread",
+                              &status.spread ) );
+    FT_CALL( FT_Property_Set( worker->library, "sdf", "overlaps",
+                              &status.overlaps ) );
+
+    FT_CALL( FT_New_Face( worker->library, atlas.font_name, 0,
+                          &worker->face ) );
+    FT_CALL( FT_Set_Pixel_Sizes( worker->face, 0, (FT_UInt)status.ptsize ) );
+
+  Exit:
+    return err;
+  }
+
+
+  static void
+  atlas_worker_done( AtlasWorker*  worker )
+  {
+    /* this also discards the face */
+    if ( worker->library )
+      FT_Done_FreeType( worker->library );
+
+    worker->library = NULL;
+    worker->face    = NULL;
+  }
+
+
+  static FT_Error
+  atlas_generate( AtlasWorker*  worker,
+                  AtlasGlyph*   glyph )
+  {
+    FT_Error      err;
+    FT_GlyphSlot  slot = worker->face->glyph;
+    FT_Bitmap*    bitmap;
+    int           y;
+
+
+    err = FT_Load_Glyph( worker->face, glyph->gindex, FT_LOAD_DEFAULT );
+
+    /* see `event_font_update' */
+    if ( !err && worker->use_bitmap )
+      err = FT_Render_Glyph( slot, FT_RENDER_MODE_NORMAL );
+    if ( !err )
+      err = FT_Render_Glyph( slot, FT_RENDER_MODE_SDF );
+
+    if ( err || !worker->keep )
+      return err;
+
+    bitmap = &slot->bitmap;
+
+    glyph->width   = (int)bitmap->width;
+    glyph->rows    = (int)bitmap->rows;
+    glyph->left    = slot->bitmap_left;
+    glyph->top     = slot->bitmap_top;
+    glyph->advance = slot->advance.x;
+
+    if ( !glyph->width || !glyph->rows )
+      return FT_Err_Ok;
+
+    glyph->buffer = (FT_Byte*)malloc( (size_t)glyph->width *
+                                      (size_t)glyph->rows );
+    if ( !glyph->buffer )
+      return FT_Err_Out_Of_Memory;
+
+    for ( y = 0; y < glyph->rows; y++ )
+      memcpy( glyph->buffer + y * glyph->width,
+              bitmap->pitch > 0
+                ? bitmap->buffer + y * bitmap->pitch
+                : bitmap->buffer + ( y - glyph->rows + 1 ) * bitmap->pitch,
+              (size_t)glyph->width );
+
+    return FT_Err_Ok;
+  }
+
+
+  static tthread_ret_t TTHREAD_CALL
+  atlas_worker_run( void*  arg )
+  {
+    AtlasWorker*  worker = (AtlasWorker*)arg;
+
+
+    while ( 1 )
     {
-      for ( FT_Int  i = draw_region.xMin,
-                    x = sample_region.xMin;
-            i < draw_region.xMax;
-            i++, x++ )
+      int  first, last;
+
+
+      LOCK( lock );
+      first       = atlas.next;
+      atlas.next += ATLAS_CHUNK;
+      UNLOCK( lock );
+
+      if ( first >= atlas.num_glyphs )
+        break;
+
+      last = first + ATLAS_CHUNK;
+      if ( last > atlas.num_glyphs )
+        last = atlas.num_glyphs;
+
+      for ( ; first < last; first++ )
       {
-        FT_Int  display_index = j * display->bitmap->width + i;
-        float   min_dist;
+        AtlasGlyph*  glyph = atlas.glyphs + first;
+        FT_Error     err   = atlas_generate( worker, glyph );
 
 
-        if ( status.nearest_filtering )
-        {
-          FT_Int   bitmap_index =
-                     ( y / (FT_Int)status.scale ) * (FT_Int)bitmap->width +
-                     x / (FT_Int)status.scale;
-          FT_Byte  pixel_value  = buffer[bitmap_index];
+        if ( worker->keep )
+          glyph->error = err;
+        if ( err )
+          worker->failures++;
+      }
+    }
 
+    return 0;
+  }
 
-          /* If nearest filtering then simply take the value of the */
-          /* nearest sampling pixel.                                */
-          min_dist = map_sdf_to_float( pixel_value );
-        }
-        else
-        {
-          /* for simplicity use floats */
-          float  bi_x;
-          float  bi_y;
 
-          float  nbi_x;
-          float  nbi_y;
+  /* Generate the SDFs of all glyphs with the given renderer; */
+  /* return the throughput in glyphs per second.              */
+  static double
+  atlas_run( FT_Bool  use_bitmap,
+             FT_Bool  keep,
+             int*     failures )
+  {
+    AtlasWorker*  workers;
+    int           num_workers = num_threads;
+    int           i;
+    double        t0, wall;
+
+#ifdef FTDEMO_THREADS
+    int           num_started;
+#endif
+
 
-          int    indc[4]; /* [0,0] [0,1] [1,0] [1,1] */
-          float  dist[4];
+#ifndef FTDEMO_THREADS
+    num_workers = 1;
+#endif
 
-          float  m1, m2;
+    workers = (AtlasWorker*)calloc( (size_t)num_workers,
+                                    sizeof ( AtlasWorker ) );
+    if ( !workers )
+      Panic( "could not allocate threads\n" );
 
-          int width = (int)bitmap->width;
-          int rows  = (int)bitmap->rows;
+    for ( i = 0; i < num_workers; i++ )
+    {
+      workers[i].use_bitmap = use_bitmap;
+      workers[i].keep       = keep;
+
+      if ( atlas_worker_init( &workers[i] ) )
+        Panic( "could not open font\n" );
+    }
 
+    atlas.next = 0;
+    t0         = get_wall_time();
 
-          /* If bilinear filtering then compute the bilinear      */
-          /* interpolation of the current draw pixel using        */
-          /* the nearby sampling pixel values.                    */
-          /*                                                      */
-          /* Again the concept is taken from Wikipedia.           */
-          /*                                                      */
-          /* https://en.wikipedia.org/wiki/Bilinear_interpolation */
+#ifdef FTDEMO_THREADS
+    /* the main thread is worker 0 */
+    for ( i = 1; i < num_workers; i++ )
+      if ( start_thread( &workers[i].thread,
+                         atlas_worker_run,
+                         &workers[i] ) )
+        break;
+    num_started = i;
+#endif
 
-          bi_x = (float)x / (float)status.scale;
-          bi_y = (float)y / (float)status.scale;
+    atlas_worker_run( &workers[0] );
 
-          nbi_x = bi_x - (int)bi_x;
-          nbi_y = bi_y - (int)bi_y;
+#ifdef FTDEMO_THREADS
+    for ( i = 1; i < num_started; i++ )
+      join_thread( workers[i].thread );
+#endif
 
-          indc[0] = (int)bi_y * width + (int)bi_x;
-          indc[1] = ( (int)bi_y + 1 ) * width + (int)bi_x;
-          indc[2] = (int)bi_y * width + (int)bi_x + 1;
-          indc[3] = ( (int)bi_y + 1 ) * width + (int)bi_x + 1;
+    wall = get_wall_time() - t0;
 
-          dist[0] = map_sdf_to_float( buffer[indc[0]] );
+    *failures = 0;
+    for ( i = 0; i < num_workers; i++ )
+    {
+      *failures += workers[i].failures;
+      atlas_worker_done( &workers[i] );
+    }
 
-          if ( indc[1] >= width * rows )
-            dist[1] = -status.spread;
-          else
-            dist[1] = map_sdf_to_float( buffer[indc[1]] );
+    free( workers );
 
-          if ( indc[2] >= width * rows )
-            dist[2] = -status.spread;
-          else
-            dist[2] = map_sdf_to_float( buffer[indc[2]] );
+    return wall > 0 ? 1E6 * atlas.num_glyphs / wall : 0.0;
+  }
 
-          if ( indc[3] >= width * rows )
-            dist[3] = -status.spread;
-          else
-            dist[3] = map_sdf_to_float( buffer[indc[3]] );
 
-          m1 = dist[0] * ( 1.0f - nbi_y ) + dist[1] * nbi_y;
-          m2 = dist[2] * ( 1.0f - nbi_y ) + dist[3] * nbi_y;
+  /* Collect the characters of the charmap within the requested range; */
+  /* characters that share a glyph share its SDF.                      */
+  static void
+  atlas_collect( FT_Face  face )
+  {
+    int*      slots;
+    FT_ULong  charcode;
+    FT_UInt   gindex;
 
-          /* This is our final display after bilinear interpolation. */
-          min_dist = ( 1.0f - nbi_x ) * m1 + nbi_x * m2;
-        }
 
-        if ( status.reconstruct )
+    slots = (int*)malloc( (size_t)face->num_glyphs * sizeof ( int ) );
+    if ( !slots )
+      Panic( "could not allocate glyphs\n" );
+    memset( slots, 0xFF, (size_t)face->num_glyphs * sizeof ( int ) );
+
+    for ( charcode = FT_Get_First_Char( face, &gindex );
+          gindex != 0;
+          charcode = FT_Get_Next_Char( face, charcode, &gindex ) )
+    {
+      AtlasChar*  ch;
+
+
+      if ( charcode < atlas.first_char || charcode > atlas.last_char )
+        continue;
+
+      if ( slots[gindex] < 0 )
+      {
+        if ( !( atlas.num_glyphs & 255 ) )
         {
-          float  alpha;
+          atlas.glyphs = (AtlasGlyph*)realloc(
+                           atlas.glyphs,
+                           (size_t)( atlas.num_glyphs + 256 ) *
+                             sizeof ( AtlasGlyph ) );
+          if ( !atlas.glyphs )
+            Panic( "could not allocate glyphs\n" );
+        }
+
+        memset( atlas.glyphs + atlas.num_glyphs, 0, sizeof ( AtlasGlyph ) );
+        atlas.glyphs[atlas.num_glyphs].gindex = gindex;
+
+        slots[gindex] = atlas.num_glyphs++;
+      }
+
+      if ( !( atlas.num_chars & 255 ) )
+      {
+        atlas.chars = (AtlasChar*)realloc(
+                        atlas.chars,
+                        (size_t)( atlas.num_chars + 256 ) *
+                          sizeof ( AtlasChar ) );
+        if ( !atlas.chars )
+          Panic( "could not allocate characters\n" );
+      }
+
+      ch           = atlas.chars + atlas.num_chars++;
+      ch->charcode = charcode;
+      ch->glyph    = slots[gindex];
+    }
+
+    free( slots );
+  }
+
+
+  /* larger glyphs first, in a reproducible order */
+  static int
+  atlas_compare( const void*  a,
+                 const void*  b )
+  {
+    const AtlasGlyph*  ga = atlas.glyphs + *(const int*)a;
+    const AtlasGlyph*  gb = atlas.glyphs + *(const int*)b;
+
+
+    if ( ga->rows != gb->rows )
+      return gb->rows - ga->rows;
+    if ( ga->width != gb->width )
+      return gb->width - ga->width;
+
+    return ga->gindex < gb->gindex ? -1 : ga->gindex > gb->gindex;
+  }
+
+
+  /* a horizontal segment of the skyline */
+  typedef struct  SkyNode_
+  {
+    int  x;
+    int  y;
+    int  width;
 
+  } SkyNode;
 
-          /* If we are reconstructing then discard all values outside of  */
-          /* the range defined by `status.width` and use `status.edge' to */
-          /* make smooth anti-aliased edges.                              */
 
-          /* This is similar to an OpenGL implementation to draw SDF. */
-          alpha  = 1.0f - smoothstep( status.width,
-                                      status.width + status.edge,
-                                      -min_dist );
-          alpha *= 255;
+  /* Place all glyphs with the bottom-left skyline heuristic: each */
+  /* glyph goes where its top is lowest, leftmost on a tie.        */
+  static void
+  atlas_pack( void )
+  {
+    SkyNode*  nodes;
+    int*      order;
+    int       num_nodes = 1;
+    int       i, j, n;
+
+
+    nodes = (SkyNode*)malloc( (size_t)( atlas.num_glyphs + 2 ) *
+                              sizeof ( SkyNode ) );
+    order = (int*)malloc( (size_t)( atlas.num_glyphs + 1 ) *
+                          sizeof ( int ) );
+    if ( !nodes || !order )
+      Panic( "could not allocate atlas\n" );
+
+    nodes[0].x     = 0;
+    nodes[0].y     = 0;
+    nodes[0].width = atlas.width;
+
+    for ( i = 0; i < atlas.num_glyphs; i++ )
+      order[i] = i;
+    qsort( order, (size_t)atlas.num_glyphs, sizeof ( int ), atlas_compare );
+
+    atlas.height = 0;
+
+    for ( n = 0; n < atlas.num_glyphs; n++ )
+    {
+      AtlasGlyph*  glyph = atlas.glyphs + order[n];
+
+      int  w = glyph->width + ATLAS_PADDING;
+      int  h = glyph->rows  + ATLAS_PADDING;
+      int  best     = -1;
+      int  best_x   = 0;
+      int  best_y   = 0;
+      int  best_top = 0;
+
+
+      if ( glyph->error || !glyph->buffer )
+        continue;
+
+      if ( glyph->width > atlas.width )
+        Panic( "glyph %u is wider than the atlas\n", glyph->gindex );
+
+      for ( i = 0; i < num_nodes; i++ )
+      {
+        int  left = w;
+        int  y    = 0;
+
 
-          /* finally copy the target value to the display buffer */
-          display_index *= 3;
-          display->bitmap->buffer[display_index + 0] = (unsigned char)alpha;
-          display->bitmap->buffer[display_index + 1] = (unsigned char)alpha;
-          display->bitmap->buffer[display_index + 2] = (unsigned char)alpha;
+        if ( nodes[i].x + glyph->width > atlas.width )
+          break;
+
+        /* the glyph rests on the highest segment it spans */
+        for ( j = i; left > 0 && j < num_nodes; j++ )
+        {
+          if ( nodes[j].y > y )
+            y = nodes[j].y;
+          left -= nodes[j].width;
         }
-        else
+
+        if ( best < 0 || y + h < best_top )
         {
-          float final_dist = min_dist;
+          best     = i;
+          best_x   = nodes[i].x;
+          best_y   = y;
+          best_top = y + h;
+        }
+      }
 
+      glyph->x = best_x;
+      glyph->y = best_y;
 
-          /* If not reconstructing then normalize the values between */
-          /* [0, 255] and copy to the display buffer.                */
+      if ( best_y + glyph->rows > atlas.height )
+        atlas.height = best_y + glyph->rows;
 
-          /* get absolute distance */
-          final_dist  = final_dist < 0 ? -final_dist : final_dist;
+      /* insert the new segment and cut the ones it covers */
+      memmove( nodes + best + 1, nodes + best,
+               (size_t)( num_nodes - best ) * sizeof ( SkyNode ) );
+      nodes[best].x     = best_x;
+      nodes[best].y     = best_top;
+      nodes[best].width = w;
+      num_nodes++;
 
-          /* invert the values */
-          final_dist  = 1.0f - final_dist / status.spread;
-          final_dist *= 255;
+      for ( i = best + 1; i < num_nodes; i++ )
+      {
+        int  shrink = nodes[i - 1].x + nodes[i - 1].width - nodes[i].x;
 
-          /* finally copy the target value to the display buffer */
-          display_index *= 3;
-          display->bitmap->buffer[display_index + 0] = (unsigned char)final_dist;
-          display->bitmap->buffer[display_index + 1] = (unsigned char)final_dist;
-          display->bitmap->buffer[display_index + 2] = (unsigned char)final_dist;
-        }
+
+        if ( shrink <= 0 )
+          break;
+
+        nodes[i].x     += shrink;
+        nodes[i].width -= shrink;
+
+        if ( nodes[i].width > 0 )
+          break;
+
+        memmove( nodes + i, nodes + i + 1,
+                 (size_t)( num_nodes - i - 1 ) * sizeof ( SkyNode ) );
+        num_nodes--;
+        i--;
       }
+
+      /* the last segment may stick out by the padding */
+      if ( nodes[num_nodes - 1].x + nodes[num_nodes - 1].width >
+             atlas.width                                          )
+        nodes[num_nodes - 1].width = atlas.width - nodes[num_nodes - 1].x;
+
+      /* merge segments of equal height */
+      for ( i = 0; i < num_nodes - 1; i++ )
+        if ( nodes[i].y == nodes[i + 1].y )
+        {
+          nodes[i].width += nodes[i + 1].width;
+          memmove( nodes + i + 1, nodes + i + 2,
+                   (size_t)( num_nodes - i - 2 ) * sizeof ( SkyNode ) );
+          num_nodes--;
+          i--;
+        }
     }
 
-    return FT_Err_Ok;
+    free( order );
+    free( nodes );
+  }
+
+
+  static void
+  atlas_write( FTDemo_Handle*  demo )
+  {
+    FTDemo_Display*  atlas_display;
+    FILE*            file;
+    char             name[1024];
+    char             dims[64];
+    FT_String        ver_str[64] = "ftsdf (FreeType) ";
+    int              i, y;
+
+
+    if ( !atlas.height )
+      Panic( "no glyphs to pack\n" );
+
+    sprintf( dims, "%dx%dx8", atlas.width, atlas.height );
+
+    atlas_display = FTDemo_Display_New( "batch", dims, NULL );
+    if ( !atlas_display )
+      Panic( "could not allocate atlas image\n" );
+
+    for ( y = 0; y < atlas.height; y++ )
+      memset( atlas_display->bitmap->buffer +
+                y * atlas_display->bitmap->pitch,
+              0, (size_t)atlas.width );
+
+    for ( i = 0; i < atlas.num_glyphs; i++ )
+    {
+      AtlasGlyph*  glyph = atlas.glyphs + i;
+
+
+      if ( glyph->error || !glyph->buffer )
+        continue;
+
+      for ( y = 0; y < glyph->rows; y++ )
+        memcpy( atlas_display->bitmap->buffer +
+                  ( glyph->y + y ) * atlas_display->bitmap->pitch +
+                  glyph->x,
+                glyph->buffer + y * glyph->width,
+                (size_t)glyph->width );
+    }
+
+    FTDemo_Version( demo, ver_str );
+
+    snprintf( name, sizeof ( name ), "%s.png", atlas.prefix );
+    if ( FTDemo_Display_Print( atlas_display, name, ver_str ) )
+      Panic( "could not write `%s'\n", name );
+
+    FTDemo_Display_Done( atlas_display );
+
+    snprintf( name, sizeof ( name ), "%s.txt", atlas.prefix );
+    file = fopen( name, "w" );
+    if ( !file )
+      Panic( "could not write `%s'\n", name );
+
+    fprintf( file, "# %s, %d ppem, spread %d, %s, atlas %dx%d\n",
+                   ft_basename( atlas.font_name ), status.ptsize,
+                   status.spread, status.use_bitmap ? "bsdf" : "sdf",
+                   atlas.width, atlas.height );
+    fprintf( file, "# char    glyph     x     y  width rows  left   top"
+                   "  advance\n" );
+
+    for ( i = 0; i < atlas.num_chars; i++ )
+    {
+      AtlasGlyph*  glyph = atlas.glyphs + atlas.chars[i].glyph;
+
+
+      if ( glyph->error )
+        continue;
+
+      fprintf( file, "U+%04lX %6u %5d %5d %5d %4d %5d %5d %8.2f\n",
+                     atlas.chars[i].charcode, glyph->gindex,
+                     glyph->x, glyph->y, glyph->width, glyph->rows,
+                     glyph->left, glyph->top, glyph->advance / 64.0 );
+    }
+
+    fclose( file );
+  }
+
+
+  static void
+  atlas_main( FTDemo_Handle*  demo )
+  {
+    FT_Library  library;
+    FT_Face     face;
+    double      rate[2];
+    int         failures[2];
+    int         i;
+    long        used = 0;
+
+
+    /* only the charmap is needed here */
+    if ( FT_Init_FreeType( &library )                              ||
+         FT_New_Face( library, atlas.font_name, 0, &face )         )
+      Panic( "could not open font\n" );
+
+    atlas_collect( face );
+
+    FT_Done_FreeType( library );
+
+    if ( !atlas.num_glyphs )
+      Panic( "no characters in range\n" );
+
+    /* the selected renderer goes first and fills the atlas; */
+    /* the other one is only timed                           */
+    rate[status.use_bitmap]  = atlas_run( status.use_bitmap, 1,
+                                          &failures[status.use_bitmap] );
+    rate[!status.use_bitmap] = atlas_run( !status.use_bitmap, 0,
+                                          &failures[!status.use_bitmap] );
+
+    atlas_pack();
+    atlas_write( demo );
+
+    for ( i = 0; i < atlas.num_glyphs; i++ )
+    {
+      used += (long)atlas.glyphs[i].width * atlas.glyphs[i].rows;
+      free( atlas.glyphs[i].buffer );
+    }
+
+    printf( "Atlas: %dx%d pixels, %d%% used, %d glyphs for %d characters\n",
+            atlas.width, atlas.height,
+            (int)( 100 * used / ( (long)atlas.width * atlas.height ) ),
+            atlas.num_glyphs, atlas.num_chars );
+    printf( "sdf:  %.0f glyphs/s, %d failed\n", rate[0], failures[0] );
+    printf( "bsdf: %.0f glyphs/s, %d failed\n", rate[1], failures[1] );
+
+    free( atlas.glyphs );
+    free( atlas.chars );
   }
 
 
@@ -669,13 +1865,24 @@
       "-------------------------------------------------------------------\n"
       "\n" );
     fprintf( stderr,
-      "Usage: %s pt font\n"
+      "Usage: %s [options] pt font\n"
       "\n",
              exec_name );
     fprintf( stderr,
       "  pt    The point size for the given resolution.\n" );
     fprintf( stderr,
       "  font  The font file to use for generating SDF.\n" );
+    fprintf( stderr,
+      "\n"
+      "  -a prefix  Write an atlas of all characters to `prefix.png' and\n"
+      "             their metrics to `prefix.txt' instead of opening a\n"
+      "             window, and show the generation speed.\n"
+      "  -b         Generate SDF from bitmaps instead of outlines.\n"
+      "  -c I-J     Range of character codes in the atlas (default: all).\n"
+      "  -d WxH     Set the window size (default: 800x600).\n"
+      "  -j N       Draw or generate the atlas with N threads (default: 1).\n"
+      "  -s spread  Set the spread, between 2 and 32 (default: 4).\n"
+      "  -w width   Set the atlas width (default: 1024).\n" );
 
     exit( 1 );
   }
@@ -689,12 +1896,85 @@
     const char*  exec_name = ft_basename( argv[0] );
 
     int  flip_y = 1;
+    int  option;
+
+    char  dims[32] = "800x600x24";
+
+
+    while ( ( option = getopt( argc, argv, "a:bc:d:j:s:w:" ) ) != -1 )
+    {
+      switch ( option )
+      {
+      case 'a':
+        atlas.prefix = optarg;
+        break;
+
+      case 'b':
+        status.use_bitmap = 1;
+        break;
+
+      case 'c':
+        {
+          long  first, last;
+
+
+          switch ( sscanf( optarg, "%li%*[,:-]%li", &first, &last ) )
+          {
+          case 1:
+            last = first;
+            /* fall through */
+          case 2:
+            if ( first < 0 || last < first )
+              usage( exec_name );
+            atlas.first_char = (FT_ULong)first;
+            atlas.last_char  = (FT_ULong)last;
+            break;
+          default:
+            usage( exec_name );
+          }
+        }
+        break;
+
+      case 'd':
+        {
+          int  width, height;
+
+
+          /* `draw' needs RGB24 */
+          if ( sscanf( optarg, "%dx%d", &width, &height ) != 2 ||
+               width < 1 || height < 1                          )
+            usage( exec_name );
+          sprintf( dims, "%dx%dx24", width, height );
+        }
+        break;
+
+      case 'j':
+        num_threads = atoi( optarg );
+        if ( num_threads < 1 )
+          usage( exec_name );
+        break;
+
+      case 's':
+        status.spread = atoi( optarg );
+        if ( status.spread < 2 || status.spread > 32 )
+          usage( exec_name );
+        break;
 
+      case 'w':
+        atlas.width = atoi( optarg );
+        if ( atlas.width < 1 )
+          usage( exec_name );
+        break;
+
+      default:
+        usage( exec_name );
+      }
+    }
 
-    if ( argc != 3 )
+    if ( argc - optind != 2 )
       usage( exec_name );
 
-    status.ptsize = atoi( argv[1] );
+    status.ptsize = atoi( argv[optind] );
 
     handle = FTDemo_New();
     if ( !handle )
@@ -703,7 +1983,17 @@
       goto Exit;
     }
 
-    display = FTDemo_Display_New( NULL, "800x600x24",
+    if ( atlas.prefix )
+    {
+      if ( status.ptsize < 1 )
+        usage( exec_name );
+
+      atlas.font_name = argv[optind + 1];
+      atlas_main( handle );
+      goto Exit;
+    }
+
+    display = FTDemo_Display_New( NULL, dims,
                                   "Signed Distance Field Viewer" );
     if ( !display )
     {
@@ -716,7 +2006,11 @@
 
     event_color_change();
 
-    FT_CALL( FT_New_Face( handle->library, argv[2], 0, &status.face ) );
+    /* the vector code is used as soon as the CPU supports it */
+    status.simd = gblender_simd_select( GBLENDER_SIMD_AUTO );
+
+    FT_CALL( FT_New_Face( handle->library, argv[optind + 1], 0,
+                          &status.face ) );
     FT_CALL( event_font_update() );
 
     do
@@ -729,6 +2023,8 @@
     } while ( !Process_Event() );
 
   Exit:
+    draw_done();
+
     if ( status.face )
       FT_Done_Face( status.face );
     if ( display )
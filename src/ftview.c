@@ -18,16 +18,25 @@
 
 #include "ftcommon.h"
 #include "common.h"
+#include "thread.h"
 #include "mlgetopt.h"
+#include "gblblit.h"
 #include <stdio.h>
 
 #include <freetype/ftbitmap.h>
 #include <freetype/ftcolor.h>
 #include <freetype/ftdriver.h>
 #include <freetype/ftlcdfil.h>
+#include <freetype/ftmodapi.h>
 #include <freetype/ftstroke.h>
 #include <freetype/ftsynth.h>
 
+#ifdef FTDEMO_THREADS
+  static tlock_t  lock = TLOCK_INITIALIZER;
+  static tcond_t  wake = TCOND_INITIALIZER;   /* new work is available  */
+  static tcond_t  idle = TCOND_INITIALIZER;   /* all helpers have ended */
+#endif
+
 
 #define MAXPTSIZE  500                 /* dtp */
 
@@ -111,10 +120,15 @@
     unsigned char  filter_weights[5];
     int            fw_idx;
 
+    int            num_threads;
+    int            have_geometry;
+    FT_Vector      geometry[3];       /* as set with option `-L' */
+
   } status = { "", DIM, NULL, RENDER_MODE_ALL,
                72, 48, 1, 0.04, 0.04, 0.02, 0.22,
                0, 0, 0, 0, 0, 0,
-               FT_LCD_FILTER_DEFAULT, { 0x08, 0x4D, 0x56, 0x4D, 0x08 }, 2 };
+               FT_LCD_FILTER_DEFAULT, { 0x08, 0x4D, 0x56, 0x4D, 0x08 }, 2,
+               1, 0, { { 0, 0 }, { 0, 0 }, { 0, 0 } } };
 
 
   static FTDemo_Display*  display;
@@ -176,7 +190,8 @@
     FT_Face       face;
     FT_GlyphSlot  slot;
 
-    FT_Fixed  radius;
+    FT_Fixed        radius;
+    FTDemo_Variant  variant;
 
 
     error = FTDemo_Get_Size( handle, &size );
@@ -194,37 +209,56 @@
                     FT_STROKER_LINEJOIN_ROUND,
                     0 );
 
+    memset( &variant, 0, sizeof ( FTDemo_Variant ) );
+    variant.kind          = RENDER_MODE_STROKE;
+    variant.palette_index = handle->current_font->palette_index;
+    variant.radius        = radius;
+
     have_topleft = 0;
 
     for ( i = offset; i < num_indices; i++ )
     {
-      FT_UInt   glyph_idx;
-      FT_Glyph  glyph;
+      FT_UInt    glyph_idx;
+      FT_Glyph   glyph, bitmap_glyph = NULL;
+      grBitmap   bit3;
+      int        left, top;
+      FT_Vector  advance;
 
 
       glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)i );
 
-      error = FT_Load_Glyph( face, glyph_idx,
-                             handle->load_flags | FT_LOAD_NO_BITMAP );
-      if ( error )
-        goto Next;
-
-      error = FT_Get_Glyph( slot, &glyph );
-      if ( error )
-        goto Next;
-
-      if ( slot->format == FT_GLYPH_FORMAT_OUTLINE )
+      if ( !FTDemo_Bitmap_Cache_Lookup( handle, &variant, glyph_idx,
+                                        &bit3, &left, &top, &advance ) )
       {
-        error = FT_Glyph_Stroke( &glyph, handle->stroker, 1 );
+        error = FT_Load_Glyph( face, glyph_idx,
+                               handle->load_flags | FT_LOAD_NO_BITMAP );
+        if ( error )
+          goto Next;
+
+        error = FT_Get_Glyph( slot, &glyph );
         if ( error )
-        {
-          FT_Done_Glyph( glyph );
           goto Next;
+
+        if ( slot->format == FT_GLYPH_FORMAT_OUTLINE )
+        {
+          error = FT_Glyph_Stroke( &glyph, handle->stroker, 1 );
+          if ( error )
+          {
+            FT_Done_Glyph( glyph );
+            goto Next;
+          }
         }
+
+        error = FTDemo_Bitmap_Cache_Render( handle, &variant, glyph_idx,
+                                            glyph, &bit3, &left, &top,
+                                            &advance, &bitmap_glyph );
+        FT_Done_Glyph( glyph );
+        if ( error )
+          goto Next;
       }
 
-      width = slot->advance.x ? slot->advance.x >> 6
-                              : size->metrics.y_ppem / 2;
+      width = advance.x ? (int)( advance.x >> 16 )
+                        : size->metrics.y_ppem / 2;
 
       if ( X_TOO_LONG( x + width, display ) )
       {
@@ -233,26 +267,27 @@
 
         if ( Y_TOO_LONG( y, display ) )
         {
-          FT_Done_Glyph( glyph );
+          if ( bitmap_glyph )
+            FT_Done_Glyph( bitmap_glyph );
           break;
         }
       }
 
       /* extra space between glyphs */
       x++;
-      if ( slot->advance.x == 0 )
+      if ( advance.x == 0 )
       {
         grFillRect( display->bitmap, x, y - width, width, width,
                     display->warn_color );
         x += width;
       }
 
-      error = FTDemo_Draw_Glyph( handle, display, glyph, &x, &y );
+      grBlitGlyphToSurface( display->surface, &bit3, x + left, y - top,
+                            display->fore_color );
+      x += (int)( ( advance.x + 0x8000 ) >> 16 );
 
-      if ( error )
-        goto Next;
-      else
-        FT_Done_Glyph( glyph );
+      if ( bitmap_glyph )
+        FT_Done_Glyph( bitmap_glyph );
 
       if ( !have_topleft )
       {
@@ -270,6 +305,107 @@
   }
 
 
+  /* the slanting and emboldening parameters of `Render_Fancy' */
+  typedef struct  FancyRec_
+  {
+    FT_Matrix  shear;
+    FT_Pos     xstr;
+    FT_Pos     ystr;
+
+  } FancyRec;
+
+
+  static void
+  Fancy_Init( FancyRec*  fancy,
+              FT_Size    size )
+  {
+    /***************************************************************/
+    /*                                                             */
+    /*  2*2 affine transformation matrix, 16.16 fixed float format */
+    /*                                                             */
+    /*  Shear matrix:                                              */
+    /*                                                             */
+    /*         | x' |     | 1  k |   | x |          x' = x + ky    */
+    /*         |    |  =  |      | * |   |   <==>                  */
+    /*         | y' |     | 0  1 |   | y |          y' = y         */
+    /*                                                             */
+    /*        outline'     shear    outline                        */
+    /*                                                             */
+    /***************************************************************/
+
+    fancy->shear.xx = 1 << 16;
+    fancy->shear.xy = (FT_Fixed)( status.slant * ( 1 << 16 ) );
+    fancy->shear.yx = 0;
+    fancy->shear.yy = 1 << 16;
+
+    fancy->xstr = (FT_Pos)( size->metrics.y_ppem * 64 * status.xbold_factor );
+    fancy->ystr = (FT_Pos)( size->metrics.y_ppem * 64 * status.ybold_factor );
+  }
+
+
+  /* load a glyph into the glyph slot of `face', slanted and emboldened */
+  static FT_Error
+  Load_Fancy_Glyph( FT_Face          face,
+                    FT_UInt          glyph_idx,
+                    FT_Int32         load_flags,
+                    const FancyRec*  fancy )
+  {
+    FT_GlyphSlot  slot = face->glyph;
+    FT_Pos        xstr = fancy->xstr;
+    FT_Pos        ystr = fancy->ystr;
+    FT_Error      err;
+
+
+    err = FT_Load_Glyph( face, glyph_idx, load_flags );
+    if ( err )
+      return err;
+
+    /* this is essentially the code of function */
+    /* `FT_GlyphSlot_Embolden'                  */
+
+    if ( slot->format == FT_GLYPH_FORMAT_OUTLINE )
+    {
+      FT_Outline_Transform( &slot->outline, &fancy->shear );
+
+      (void)FT_Outline_EmboldenXY( &slot->outline, xstr, ystr );
+      /* ignore error */
+    }
+    else if ( slot->format == FT_GLYPH_FORMAT_BITMAP )
+    {
+      /* round to full pixels */
+      xstr &= ~63;
+      ystr &= ~63;
+
+      err = FT_GlyphSlot_Own_Bitmap( slot );
+      if ( err )
+        return err;
+
+      err = FT_Bitmap_Embolden( slot->library, &slot->bitmap,
+                                xstr, ystr );
+      if ( err )
+        return err;
+    }
+    else
+      return FT_Err_Invalid_Glyph_Format;
+
+    if ( slot->advance.x )
+      slot->advance.x += xstr;
+
+    if ( slot->advance.y )
+      slot->advance.y += ystr;
+
+    slot->metrics.width        += xstr;
+    slot->metrics.height       += ystr;
+    slot->metrics.horiAdvance  += xstr;
+    slot->metrics.vertAdvance  += ystr;
+
+    if ( slot->format == FT_GLYPH_FORMAT_BITMAP )
+      slot->bitmap_top += ystr >> 6;
+
+    return FT_Err_Ok;
+  }
+
+
   static int
   Render_Fancy( int  num_indices,
                 int  offset )
@@ -280,8 +416,8 @@
     FT_Face       face;
     FT_GlyphSlot  slot;
 
-    FT_Matrix  shear;
-    FT_Pos     xstr, ystr;
+    FancyRec        fancy;
+    FTDemo_Variant  variant;
 
 
     error = FTDemo_Get_Size( handle, &size );
@@ -292,85 +428,50 @@
     face = size->face;
     slot = face->glyph;
 
-    /***************************************************************/
-    /*                                                             */
-    /*  2*2 affine transformation matrix, 16.16 fixed float format */
-    /*                                                             */
-    /*  Shear matrix:                                              */
-    /*                                                             */
-    /*         | x' |     | 1  k |   | x |          x' = x + ky    */
-    /*         |    |  =  |      | * |   |   <==>                  */
-    /*         | y' |     | 0  1 |   | y |          y' = y         */
-    /*                                                             */
-    /*        outline'     shear    outline                        */
-    /*                                                             */
-    /***************************************************************/
-
-    shear.xx = 1 << 16;
-    shear.xy = (FT_Fixed)( status.slant * ( 1 << 16 ) );
-    shear.yx = 0;
-    shear.yy = 1 << 16;
+    Fancy_Init( &fancy, size );
 
-    xstr = (FT_Pos)( size->metrics.y_ppem * 64 * status.xbold_factor );
-    ystr = (FT_Pos)( size->metrics.y_ppem * 64 * status.ybold_factor );
+    memset( &variant, 0, sizeof ( FTDemo_Variant ) );
+    variant.kind          = RENDER_MODE_FANCY;
+    variant.palette_index = handle->current_font->palette_index;
+    variant.matrix        = fancy.shear;
+    variant.xstr          = fancy.xstr;
+    variant.ystr          = fancy.ystr;
 
     have_topleft = 0;
 
     for ( i = offset; i < num_indices; i++ )
     {
-      FT_UInt  glyph_idx;
+      FT_UInt    glyph_idx;
+      FT_Glyph   glyph, bitmap_glyph = NULL;
+      grBitmap   bit3;
+      int        left, top;
+      FT_Vector  advance;
 
 
       glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)i );
 
-      error = FT_Load_Glyph( face, glyph_idx, handle->load_flags );
-      if ( error )
-        goto Next;
-
-      /* this is essentially the code of function */
-      /* `FT_GlyphSlot_Embolden'                  */
-
-      if ( slot->format == FT_GLYPH_FORMAT_OUTLINE )
-      {
-        FT_Outline_Transform( &slot->outline, &shear );
-
-        error = FT_Outline_EmboldenXY( &slot->outline, xstr, ystr );
-        /* ignore error */
-      }
-      else if ( slot->format == FT_GLYPH_FORMAT_BITMAP )
+      if ( !FTDemo_Bitmap_Cache_Lookup( handle, &variant, glyph_idx,
+                                        &bit3, &left, &top, &advance ) )
       {
-        /* round to full pixels */
-        xstr &= ~63;
-        ystr &= ~63;
+        error = Load_Fancy_Glyph( face, glyph_idx, handle->load_flags,
+                                  &fancy );
+        if ( error )
+          goto Next;
 
-        error = FT_GlyphSlot_Own_Bitmap( slot );
+        error = FT_Get_Glyph( slot, &glyph );
         if ( error )
           goto Next;
 
-        error = FT_Bitmap_Embolden( slot->library, &slot->bitmap,
-                                    xstr, ystr );
+        error = FTDemo_Bitmap_Cache_Render( handle, &variant, glyph_idx,
+                                            glyph, &bit3, &left, &top,
+                                            &advance, &bitmap_glyph );
+        FT_Done_Glyph( glyph );
         if ( error )
           goto Next;
       }
-      else
-        goto Next;
-
-      if ( slot->advance.x )
-        slot->advance.x += xstr;
-
-      if ( slot->advance.y )
-        slot->advance.y += ystr;
 
-      slot->metrics.width        += xstr;
-      slot->metrics.height       += ystr;
-      slot->metrics.horiAdvance  += xstr;
-      slot->metrics.vertAdvance  += ystr;
-
-      if ( slot->format == FT_GLYPH_FORMAT_BITMAP )
-        slot->bitmap_top += ystr >> 6;
-
-      width = slot->advance.x ? slot->advance.x >> 6
-                              : size->metrics.y_ppem / 2;
+      width = advance.x ? (int)( advance.x >> 16 )
+                        : size->metrics.y_ppem / 2;
 
       if ( X_TOO_LONG( x + width, display ) )
       {
@@ -378,22 +479,28 @@
         y += step_y;
 
         if ( Y_TOO_LONG( y, display ) )
+        {
+          if ( bitmap_glyph )
+            FT_Done_Glyph( bitmap_glyph );
           break;
+        }
       }
 
       /* extra space between glyphs */
       x++;
-      if ( slot->advance.x == 0 )
+      if ( advance.x == 0 )
       {
         grFillRect( display->bitmap, x, y - width, width, width,
                     display->warn_color );
         x += width;
       }
 
-      error = FTDemo_Draw_Slot( handle, display, slot, &x, &y );
+      grBlitGlyphToSurface( display->surface, &bit3, x + left, y - top,
+                            display->fore_color );
+      x += (int)( ( advance.x + 0x8000 ) >> 16 );
 
-      if ( error )
-        goto Next;
+      if ( bitmap_glyph )
+        FT_Done_Glyph( bitmap_glyph );
 
       if ( !have_topleft )
       {
@@ -411,6 +518,124 @@
   }
 
 
+  /* load a glyph into the glyph slot of `face', blending its color */
+  /* layers with `palette' if there are any                          */
+  static FT_Error
+  Load_Layered_Glyph( FTDemo_Handle*    h,
+                      FT_Face           face,
+                      FT_UInt           glyph_idx,
+                      FT_Color*         palette,
+                      FT_Palette_Data*  palette_data,
+                      FT_UShort         palette_index )
+  {
+    FT_GlyphSlot      slot = face->glyph;
+    FT_LayerIterator  iterator;
+    FT_Error          err  = FT_Err_Ok;
+
+    FT_Bool  have_layers;
+    FT_UInt  layer_glyph_idx;
+    FT_UInt  layer_color_idx;
+
+
+    /* check whether we have glyph color layers */
+    iterator.p  = NULL;
+    have_layers = FT_Get_Color_Glyph_Layer( face,
+                                            glyph_idx,
+                                            &layer_glyph_idx,
+                                            &layer_color_idx,
+                                            &iterator );
+
+    if ( palette && have_layers && h->use_layers )
+    {
+      FT_Int32  load_flags = h->load_flags;
+
+      FT_Bitmap  bitmap;
+      FT_Vector  bitmap_offset = { 0, 0 };
+
+
+      /*
+       * We want to handle glyph layers manually, thus switching off
+       * `FT_LOAD_COLOR' and ensuring normal AA render mode.
+       */
+      load_flags &= ~FT_LOAD_COLOR;
+      load_flags |=  FT_LOAD_RENDER;
+
+      load_flags &= ~FT_LOAD_TARGET_( 0xF );
+      load_flags |=  FT_LOAD_TARGET_NORMAL;
+
+      FT_Bitmap_Init( &bitmap );
+
+      do
+      {
+        FT_Vector  slot_offset;
+        FT_Color   color;
+
+
+        err = FT_Load_Glyph( face, layer_glyph_idx, load_flags );
+        if ( err )
+          break;
+
+        slot_offset.x = slot->bitmap_left * 64;
+        slot_offset.y = slot->bitmap_top * 64;
+
+        if ( layer_color_idx == 0xFFFF )
+        {
+          // TODO: FT_Palette_Get_Foreground_Color
+          if ( palette_data->palette_flags                  &&
+             ( palette_data->palette_flags[palette_index] &
+                 FT_PALETTE_FOR_DARK_BACKGROUND           ) )
+          {
+            /* white opaque */
+            color.blue  = 0xFF;
+            color.green = 0xFF;
+            color.red   = 0xFF;
+            color.alpha = 0xFF;
+          }
+          else
+          {
+            /* black opaque */
+            color.blue  = 0x00;
+            color.green = 0x00;
+            color.red   = 0x00;
+            color.alpha = 0xFF;
+          }
+        }
+        else if ( layer_color_idx < palette_data->num_palette_entries )
+          color = palette[layer_color_idx];
+        else
+          continue;
+
+        err = FT_Bitmap_Blend( h->library,
+                               &slot->bitmap,
+                               slot_offset,
+                               &bitmap,
+                               &bitmap_offset,
+                               color );
+
+      } while ( FT_Get_Color_Glyph_Layer( face,
+                                          glyph_idx,
+                                          &layer_glyph_idx,
+                                          &layer_color_idx,
+                                          &iterator ) );
+
+      if ( err )
+        FT_Bitmap_Done( h->library, &bitmap );
+      else
+      {
+        FT_Bitmap_Done( h->library, &slot->bitmap );
+
+        slot->bitmap      = bitmap;
+        slot->bitmap_left = bitmap_offset.x / 64;
+        slot->bitmap_top  = bitmap_offset.y / 64;
+      }
+    }
+    else
+      err = FT_Load_Glyph( face, glyph_idx, h->load_flags );
+
+    return err;
+  }
+
+
   static int
   Render_All( int  num_indices,
               int  offset )
@@ -445,170 +670,804 @@
 
     for ( i = offset; i < num_indices; i++ )
     {
-      FT_LayerIterator  iterator;
-      FT_UInt           glyph_idx;
-
-      FT_Bool  have_layers;
-      FT_UInt  layer_glyph_idx;
-      FT_UInt  layer_color_idx;
+      FT_UInt  glyph_idx;
 
 
       glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)i );
 
-      /* check whether we have glyph color layers */
-      iterator.p  = NULL;
-      have_layers = FT_Get_Color_Glyph_Layer( face,
-                                              glyph_idx,
-                                              &layer_glyph_idx,
-                                              &layer_color_idx,
-                                              &iterator );
+      error = Load_Layered_Glyph( handle, face, glyph_idx,
+                                  palette, &palette_data, palette_index );
+      if ( error )
+        goto Next;
+
+      width = slot->advance.x ? slot->advance.x >> 6
+                              : size->metrics.y_ppem / 2;
 
-      if ( palette && have_layers && handle->use_layers )
+      if ( X_TOO_LONG( x + width, display ) )
       {
-        FT_Int32  load_flags = handle->load_flags;
+        x  = start_x;
+        y += step_y;
 
-        FT_Bitmap  bitmap;
-        FT_Vector  bitmap_offset = { 0, 0 };
+        if ( Y_TOO_LONG( y, display ) )
+          break;
+      }
 
+      /* extra space between glyphs */
+      x++;
+      if ( slot->advance.x == 0 )
+      {
+        grFillRect( display->bitmap, x, y - width, width, width,
+                    display->warn_color );
+        x += width;
+      }
 
-        /*
-         * We want to handle glyph layers manually, thus switching off
-         * `FT_LOAD_COLOR' and ensuring normal AA render mode.
-         */
-        load_flags &= ~FT_LOAD_COLOR;
-        load_flags |=  FT_LOAD_RENDER;
+      error = FTDemo_Draw_Slot( handle, display, slot, &x, &y );
 
-        load_flags &= ~FT_LOAD_TARGET_( 0xF );
-        load_flags |=  FT_LOAD_TARGET_NORMAL;
+      if ( error )
+        goto Next;
 
-        FT_Bitmap_Init( &bitmap );
+      if ( !have_topleft )
+      {
+        have_topleft   = 1;
+        status.topleft = i;
+      }
 
-        do
-        {
-          FT_Vector  slot_offset;
-          FT_Color   color;
+      continue;
 
+    Next:
+      Process_Error();
+    }
 
-          error = FT_Load_Glyph( face, layer_glyph_idx, load_flags );
-          if ( error )
-            break;
+    return i - 1;
+  }
 
-          slot_offset.x = slot->bitmap_left * 64;
-          slot_offset.y = slot->bitmap_top * 64;
 
-          if ( layer_color_idx == 0xFFFF )
-          {
-            // TODO: FT_Palette_Get_Foreground_Color
-            if ( palette_data.palette_flags                  &&
-               ( palette_data.palette_flags[palette_index] &
-                   FT_PALETTE_FOR_DARK_BACKGROUND          ) )
-            {
-              /* white opaque */
-              color.blue  = 0xFF;
-              color.green = 0xFF;
-              color.red   = 0xFF;
-              color.alpha = 0xFF;
-            }
-            else
-            {
-              /* black opaque */
-              color.blue  = 0x00;
-              color.green = 0x00;
-              color.red   = 0x00;
-              color.alpha = 0xFF;
-            }
-          }
-          else if ( layer_color_idx < palette_data.num_palette_entries )
-            color = palette[layer_color_idx];
-          else
-            continue;
+  static int
+  Render_Text( int  num_indices,
+               int  offset )
+  {
+    int      start_x, start_y, step_y, x, y;
+    FT_Size  size;
+    int      have_topleft;
+
+    const char*  p;
+    const char*  pEnd;
+    int          ch;
 
-          error = FT_Bitmap_Blend( handle->library,
-                                   &slot->bitmap,
-                                   slot_offset,
-                                   &bitmap,
-                                   &bitmap_offset,
-                                   color );
 
-        } while ( FT_Get_Color_Glyph_Layer( face,
-                                            glyph_idx,
-                                            &layer_glyph_idx,
-                                            &layer_color_idx,
-                                            &iterator ) );
+    error = FTDemo_Get_Size( handle, &size );
+    if ( error )
+      return -1;
 
-        if ( error )
-        {
-          FT_Bitmap_Done( handle->library, &bitmap );
-          goto Next;
-        }
-        else
-        {
-          FT_Bitmap_Done( handle->library, &slot->bitmap );
+    INIT_SIZE( size, start_x, start_y, step_y, x, y );
 
-          slot->bitmap      = bitmap;
-          slot->bitmap_left = bitmap_offset.x / 64;
-          slot->bitmap_top  = bitmap_offset.y / 64;
-        }
+    p    = Text;
+    pEnd = p + strlen( Text );
+
+    while ( offset-- )
+    {
+      ch = utf8_next( &p, pEnd );
+      if ( ch < 0 )
+      {
+        p  = Text;
+        ch = utf8_next( &p, pEnd );
       }
-      else
+    }
+
+    have_topleft = 0;
+
+    while ( num_indices-- )
+    {
+      FT_UInt  glyph_idx;
+
+
+      ch = utf8_next( &p, pEnd );
+      if ( ch < 0 )
       {
-        error = FT_Load_Glyph( face, glyph_idx, handle->load_flags );
-        if ( error )
-          goto Next;
+        p  = Text;
+        ch = utf8_next( &p, pEnd );
+
+        /* not a single character of the text string could be displayed */
+        if ( !have_topleft )
+          return error;
       }
 
-      width = slot->advance.x ? slot->advance.x >> 6
-                              : size->metrics.y_ppem / 2;
+      glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)ch );
+
+      error = FTDemo_Draw_Index( handle, display, glyph_idx, &x, &y );
+
+      if ( error )
+        goto Next;
+
+      if ( !have_topleft )
+      {
+        have_topleft   = 1;
+        status.topleft = ch;
+      }
+
+      if ( X_TOO_LONG( x + ( size->metrics.max_advance >> 6 ), display ) )
+      {
+        x  = start_x;
+        y += step_y;
+
+        if ( Y_TOO_LONG( y, display ) )
+          break;
+      }
+
+      continue;
+
+    Next:
+      Process_Error();
+    }
+
+    return -1;
+  }
+
+
+  static int
+  Render_Waterfall( int  mid_size,
+                    int  offset )
+  {
+    int      start_x, start_y, step_y, x, y;
+    int      pt_size, step, pt_height;
+    FT_Size  size;
+    int      have_topleft, start;
+
+    char         text[256];
+    const char*  p;
+    const char*  pEnd;
+
+
+    start_x = START_X;
+    start_y = START_Y;
+
+    have_topleft = 0;
+
+    pt_height = 64 * 72 * display->bitmap->rows / status.res;
+    step      = ( mid_size * mid_size / pt_height + 64 ) & ~63;
+    pt_size   = mid_size - step * ( mid_size / step );  /* remainder */
+
+    while ( 1 )
+    {
+      int first = offset;
+      int ch;
+
+
+      pt_size += step;
+
+      FTDemo_Set_Current_Charsize( handle, pt_size, status.res );
+
+      error = FTDemo_Get_Size( handle, &size );
+      if ( error )
+        break;
+
+      step_y = ( size->metrics.height >> 6 ) + 1;
+
+      x = start_x;
+      y = start_y + ( size->metrics.ascender >> 6 );
+
+      start_y += step_y;
+
+      if ( y >= display->bitmap->rows )
+        break;
+
+      p    = Text;
+      pEnd = p + strlen( Text );
+
+      while ( first-- )
+      {
+        ch = utf8_next( &p, pEnd );
+        if ( ch < 0 )
+        {
+          p  = Text;
+          ch = utf8_next( &p, pEnd );
+        }
+      }
+
+      start = snprintf( text, 256, "%g: ", pt_size / 64.0 );
+      snprintf( text + start, (unsigned int)( 256 - start ), "%s", p );
+
+      p    = text;
+      pEnd = p + strlen( text );
+
+      while ( 1 )
+      {
+        FT_UInt      glyph_idx;
+        const char*  oldp;
+
+
+        oldp = p;
+        ch   = utf8_next( &p, pEnd );
+        if ( ch < 0 )
+        {
+          /* end of the text (or invalid UTF-8); continue to next size */
+          break;
+        }
+
+        glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)ch );
+
+        error = FTDemo_Draw_Index( handle, display, glyph_idx, &x, &y );
+
+        if ( error )
+          goto Next;
+
+        /* `topleft' should be the first character after the size string */
+        if ( oldp - text == start && !have_topleft )
+        {
+          have_topleft   = 1;
+          status.topleft = ch;
+        }
+
+        if ( X_TOO_LONG( x, display ) )
+          break;
+
+        continue;
+
+      Next:
+        Process_Error();
+      }
+    }
+
+    FTDemo_Set_Current_Charsize( handle, mid_size, status.res );
+    FTDemo_Get_Size( handle, &size );
+
+    return -1;
+  }
+
+
+  /*************************************************************************/
+  /*************************************************************************/
+  /*****                                                               *****/
+  /*****                      PARALLEL RENDERING                       *****/
+  /*****                                                               *****/
+  /*************************************************************************/
+  /*************************************************************************/
+
+  /*
+   * With option `-j', render modes 1, 2, and 4 draw the glyphs in
+   * batches, each of them in three steps.
+   *
+   *   1. All threads rasterize the glyphs of the batch, each thread using
+   *      its own library and cache manager.
+   *
+   *   2. The main thread lays out the glyphs exactly like the serial code,
+   *      using the advances found in step 1.  The glyphs that no longer fit
+   *      on the page are dropped.
+   *
+   *   3. All threads blit the glyphs into horizontal bands of the display,
+   *      one band at a time, in the order of the serial code.  The bands
+   *      do not overlap, and the blenders share a key table, so no lock is
+   *      needed here.
+   */
+
+  typedef struct  Worker_
+  {
+    FTDemo_Handle*   handle;       /* private library and cache manager */
+    grSurface*       tile;         /* the band being drawn, and blender */
+
+    /* set up by `Worker_Prepare' at the first job of a frame */
+    int              frame;
+    FT_Error         error;
+    FT_Size          size;
+    FT_Color*        palette;
+    FT_Palette_Data  palette_data;
+
+#ifdef FTDEMO_THREADS
+    thandle_t        thread;
+#endif
+
+  } Worker;
+
+
+  typedef struct  Job_
+  {
+    int        charcode;     /* glyph index in modes 1 and 2 */
+    FT_UInt    glyph_idx;
+    int        wrapped;      /* mode 4: the text string restarted */
+
+    /* rasterization */
+    FT_Error   load_error;
+    FT_Error   error;
+    FT_Pos     advance;      /* 26.6 format */
+    FT_Glyph   glyph;        /* owns the bitmap */
+    FT_Bitmap  gray;         /* owns the bitmap if converted to 8-bit */
+    grBitmap   bitmap;
+    int        left;
+    int        top;
+    int        x_advance;
+
+    /* layout */
+    int        drawn;
+    int        x;            /* top-left corner of `bitmap' */
+    int        y;
+    int        warn_x;       /* marker of a zero-width glyph */
+    int        warn_y;
+    int        warn_size;
+
+  } Job;
+
+
+  typedef void
+  (*Work_Func)( Worker*  worker,
+                int      item );
+
+
+  static struct  tiles_
+  {
+    int             num_workers;   /* including the main thread */
+    Worker*         workers;
+
+    /* work being distributed */
+    Work_Func       func;
+    int             num_items;
+    int             next_item;
+    int             busy;          /* helper threads not done yet */
+    int             generation;
+    int             quit;
+
+    /* current frame */
+    int             frame;
+    int             render_mode;
+    FancyRec        fancy;
+    Job*            jobs;
+    int             max_jobs;
+    int             num_drawn;     /* jobs passed to step 3 */
+    int             band_height;
+
+    GBlenderShared  shared;
+    double          gamma;
+
+  } tiles;
+
+
+  /* process items until none is left */
+  static void
+  Tiles_Work( Worker*  worker )
+  {
+    while ( 1 )
+    {
+      int  item;
+
+
+      LOCK( lock );
+      item = tiles.next_item < tiles.num_items ? tiles.next_item++ : -1;
+      UNLOCK( lock );
+
+      if ( item < 0 )
+        break;
+
+      tiles.func( worker, item );
+    }
+  }
+
+
+#ifdef FTDEMO_THREADS
+
+  static tthread_ret_t TTHREAD_CALL
+  Tiles_Thread( void*  arg )
+  {
+    Worker*  worker     = (Worker*)arg;
+    int      generation = 0;
+
+
+    LOCK( lock );
+
+    while ( 1 )
+    {
+      while ( tiles.generation == generation && !tiles.quit )
+        WAIT( wake, lock );
+
+      if ( tiles.quit )
+        break;
+
+      generation = tiles.generation;
+      UNLOCK( lock );
+
+      Tiles_Work( worker );
+
+      LOCK( lock );
+      if ( --tiles.busy == 0 )
+        BROADCAST( idle );
+    }
+
+    UNLOCK( lock );
+
+    return 0;
+  }
+
+#endif /* FTDEMO_THREADS */
+
+
+  /* call `func' for items 0 to `num_items'-1 on all threads */
+  static void
+  Tiles_Run( Work_Func  func,
+             int        num_items )
+  {
+    LOCK( lock );
+
+    tiles.func       = func;
+    tiles.num_items  = num_items;
+    tiles.next_item  = 0;
+    tiles.busy       = tiles.num_workers - 1;
+    tiles.generation++;
+
+#ifdef FTDEMO_THREADS
+    BROADCAST( wake );
+#endif
+
+    UNLOCK( lock );
+
+    Tiles_Work( &tiles.workers[0] );
+
+#ifdef FTDEMO_THREADS
+    LOCK( lock );
+    while ( tiles.busy )
+      WAIT( idle, lock );
+    UNLOCK( lock );
+#endif
+  }
+
+
+  static void
+  Tiles_Init( int  num_workers )
+  {
+    int  i;
+
+
+#ifndef FTDEMO_THREADS
+    num_workers = 1;
+#endif
+
+    tiles.workers = (Worker*)calloc( (size_t)num_workers, sizeof ( Worker ) );
+    if ( !tiles.workers )
+      Fatal( "could not allocate render threads" );
+
+    /* the threads must not race for the detection of SIMD support */
+    gblender_simd_select( GBLENDER_SIMD_AUTO );
+
+    /* the main thread is worker 0 */
+    for ( i = 0; i < num_workers; i++ )
+    {
+      Worker*  worker = &tiles.workers[i];
+
+
+      worker->handle = FTDemo_New();
+      worker->tile   = (grSurface*)calloc( 1, sizeof ( grSurface ) );
+      worker->frame  = -1;
+
+      if ( !worker->tile )
+        Fatal( "could not allocate render threads" );
+
+      if ( status.have_geometry )
+        FT_Library_SetLcdGeometry( worker->handle->library,
+                                   status.geometry );
+
+#ifdef FTDEMO_THREADS
+      if ( i > 0 && start_thread( &worker->thread, Tiles_Thread, worker ) )
+      {
+        FTDemo_Done( worker->handle );
+        free( worker->tile );
+        break;
+      }
+#endif
+
+      tiles.num_workers++;
+    }
+  }
+
+
+  static void
+  Tiles_Done( void )
+  {
+    int  i;
+
+
+    if ( !tiles.workers )
+      return;
+
+#ifdef FTDEMO_THREADS
+    LOCK( lock );
+    tiles.quit = 1;
+    BROADCAST( wake );
+    UNLOCK( lock );
+
+    for ( i = 1; i < tiles.num_workers; i++ )
+      join_thread( tiles.workers[i].thread );
+#endif
+
+    for ( i = 0; i < tiles.num_workers; i++ )
+    {
+      FTDemo_Done( tiles.workers[i].handle );
+      free( tiles.workers[i].tile );
+    }
+
+    free( tiles.workers );
+    free( tiles.jobs );
+    gblender_shared_done( tiles.shared );
+
+    tiles.workers = NULL;
+  }
+
+
+  /* copy a driver property of the main library; return 1 if changed */
+  static int
+  Tiles_Sync_Property( FT_Library   library,
+                       const char*  module_name,
+                       const char*  property_name )
+  {
+    FT_UInt  value, old_value;
+
+
+    if ( FT_Property_Get( handle->library, module_name,
+                          property_name, &value ) )
+      return 0;
+
+    if ( !FT_Property_Get( library, module_name,
+                           property_name, &old_value ) &&
+         old_value == value                            )
+      return 0;
+
+    return !FT_Property_Set( library, module_name, property_name, &value );
+  }
+
+
+  /* pass the current settings to the workers */
+  static void
+  Tiles_Sync( void )
+  {
+    grBitmap*  bit = display->bitmap;
+    int        num_bands, i;
+
+
+    tiles.frame++;
+
+    /* the shared keys are only valid for a given gamma */
+    if ( !tiles.shared || tiles.gamma != display->gamma )
+    {
+      gblender_shared_done( tiles.shared );
+
+      tiles.shared = gblender_shared_new( display->gamma );
+      tiles.gamma  = display->gamma;
+
+      for ( i = 0; i < tiles.num_workers; i++ )
+      {
+        grSurface*  tile = tiles.workers[i].tile;
+
+
+        grSetTargetGamma( tile, display->gamma );
+        gblender_attach( tile->gblender, tiles.shared );
+      }
+    }
+
+    /* a few bands per thread balance the load */
+    num_bands         = 4 * tiles.num_workers;
+    tiles.band_height = ( bit->rows + num_bands - 1 ) / num_bands;
+    if ( tiles.band_height < 16 )
+      tiles.band_height = 16;
+
+    for ( i = 0; i < tiles.num_workers; i++ )
+    {
+      Worker*         worker = &tiles.workers[i];
+      FTDemo_Handle*  h      = worker->handle;
+      int             reset  = 0;
+
+
+      h->current_font = handle->current_font;
+      h->scaler       = handle->scaler;
+      h->load_flags   = handle->load_flags;
+      h->lcd_mode     = handle->lcd_mode;
+      h->use_layers   = handle->use_layers;
+
+      worker->tile->gblender->backend = display->surface->gblender->backend;
+
+      if ( status.lcd_filter < 0 )
+        FT_Library_SetLcdFilterWeights( h->library, status.filter_weights );
+      else
+        FT_Library_SetLcdFilter( h->library,
+                                 (FT_LcdFilter)status.lcd_filter );
+
+      /* see `FTDemo_Hinting_Engine_Change' */
+      reset |= Tiles_Sync_Property( h->library,
+                                    "truetype", "interpreter-version" );
+      reset |= Tiles_Sync_Property( h->library,
+                                    "cff", "hinting-engine" );
+      reset |= Tiles_Sync_Property( h->library,
+                                    "type1", "hinting-engine" );
+      reset |= Tiles_Sync_Property( h->library,
+                                    "t1cid", "hinting-engine" );
+      if ( reset )
+        FTC_Manager_Reset( h->cache_manager );
+    }
+  }
+
+
+  static void
+  Worker_Prepare( Worker*  worker )
+  {
+    FTDemo_Handle*  h = worker->handle;
+    FT_Face         face;
+
+
+    worker->frame = tiles.frame;
+    worker->error = FTC_Manager_LookupSize( h->cache_manager,
+                                            &h->scaler,
+                                            &worker->size );
+    if ( worker->error )
+      return;
+
+    face = worker->size->face;
+
+    if ( FT_Palette_Select( face,
+                            (FT_UShort)h->current_font->palette_index,
+                            &worker->palette )                          ||
+         FT_Palette_Data_Get( face, &worker->palette_data )             )
+      worker->palette = NULL;
+  }
+
+
+  /* step 1 */
+  static void
+  Rasterize_Job( Worker*  worker,
+                 int      item )
+  {
+    Job*            job = &tiles.jobs[item];
+    FTDemo_Handle*  h   = worker->handle;
+    FT_Face         face;
+    FT_Glyph        glyph, bitmap_glyph;
+    FT_Error        err;
+    int             y_advance;
+
+
+    if ( worker->frame != tiles.frame )
+      Worker_Prepare( worker );
+
+    if ( worker->error )
+    {
+      job->load_error = worker->error;
+      return;
+    }
+
+    face = worker->size->face;
+
+    switch ( tiles.render_mode )
+    {
+    case RENDER_MODE_ALL:
+      err = Load_Layered_Glyph( h, face, job->glyph_idx,
+                                worker->palette, &worker->palette_data,
+                                (FT_UShort)h->current_font->palette_index );
+      break;
+
+    case RENDER_MODE_FANCY:
+      err = Load_Fancy_Glyph( face, job->glyph_idx, h->load_flags,
+                              &tiles.fancy );
+      break;
+
+    default:
+      err = FT_Load_Glyph( face, job->glyph_idx, h->load_flags );
+    }
+
+    if ( err )
+    {
+      job->load_error = err;
+      return;
+    }
+
+    job->advance = face->glyph->advance.x;
+
+    err = FT_Get_Glyph( face->glyph, &glyph );
+    if ( err )
+      goto Exit;
+
+    err = FTDemo_Glyph_To_Bitmap_R( h, glyph, &job->bitmap,
+                                    &job->left, &job->top,
+                                    &job->x_advance, &y_advance,
+                                    &bitmap_glyph );
+    if ( err )
+    {
+      FT_Done_Glyph( glyph );
+      goto Exit;
+    }
+
+    /* keep the glyph owning the bitmap */
+    if ( bitmap_glyph )
+    {
+      FT_Done_Glyph( glyph );
+      glyph = bitmap_glyph;
+    }
+    job->glyph = glyph;
+
+    /* the conversion buffer gets reused by the next job */
+    if ( job->bitmap.buffer == h->bitmap.buffer )
+    {
+      err = FT_Bitmap_Copy( h->library, &h->bitmap, &job->gray );
+      if ( err )
+        goto Exit;
+
+      job->bitmap.buffer = job->gray.buffer;
+    }
+
+    /* the band threads must not let the blitter convert it concurrently */
+    FTDemo_Bitmap_Upgray( &job->bitmap );
+
+  Exit:
+    job->error = err;
+  }
+
+
+  /* step 3 */
+  static void
+  Composite_Band( Worker*  worker,
+                  int      item )
+  {
+    grBitmap*   bit  = display->bitmap;
+    grSurface*  tile = worker->tile;
+    int         top  = item * tiles.band_height;
+    int         rows = bit->rows - top;
+    int         i;
+
+
+    if ( rows > tiles.band_height )
+      rows = tiles.band_height;
 
-      if ( X_TOO_LONG( x + width, display ) )
-      {
-        x  = start_x;
-        y += step_y;
+    /* a view of rows `top' to `top+rows-1' */
+    tile->bitmap      = *bit;
+    tile->bitmap.rows = rows;
+    if ( bit->pitch > 0 )
+      tile->bitmap.buffer += top * bit->pitch;
+    else
+      tile->bitmap.buffer -= ( bit->rows - top - rows ) * bit->pitch;
 
-        if ( Y_TOO_LONG( y, display ) )
-          break;
-      }
+    for ( i = 0; i < tiles.num_drawn; i++ )
+    {
+      Job*  job = &tiles.jobs[i];
 
-      /* extra space between glyphs */
-      x++;
-      if ( slot->advance.x == 0 )
-      {
-        grFillRect( display->bitmap, x, y - width, width, width,
+
+      if ( job->warn_size                        &&
+           job->warn_y < top + rows              &&
+           job->warn_y + job->warn_size > top    )
+        grFillRect( &tile->bitmap, job->warn_x, job->warn_y - top,
+                    job->warn_size, job->warn_size,
                     display->warn_color );
-        x += width;
-      }
 
-      error = FTDemo_Draw_Slot( handle, display, slot, &x, &y );
+      if ( job->drawn                            &&
+           job->y < top + rows                   &&
+           job->y + job->bitmap.rows > top       )
+        grBlitGlyphToSurface( tile, &job->bitmap,
+                              job->x, job->y - top,
+                              display->fore_color );
+    }
+  }
 
-      if ( error )
-        goto Next;
 
-      if ( !have_topleft )
-      {
-        have_topleft   = 1;
-        status.topleft = i;
-      }
+  static void
+  Tiles_Free_Jobs( int  num_jobs )
+  {
+    int  i;
 
-      continue;
 
-    Next:
-      Process_Error();
+    /* all libraries use the same memory allocator */
+    for ( i = 0; i < num_jobs; i++ )
+    {
+      if ( tiles.jobs[i].glyph )
+        FT_Done_Glyph( tiles.jobs[i].glyph );
+      FT_Bitmap_Done( handle->library, &tiles.jobs[i].gray );
     }
-
-    return i - 1;
   }
 
 
+  /* the parallel version of `Render_All', `Render_Fancy', and */
+  /* `Render_Text'; `num_indices' is the same as for these     */
   static int
-  Render_Text( int  num_indices,
-               int  offset )
+  Render_Tiled( int  render_mode,
+                int  num_indices,
+                int  offset )
   {
-    int      start_x, start_y, step_y, x, y;
+    int      start_x, start_y, step_y, x, y, width;
+    int      i, n, have_topleft, done, batch;
     FT_Size  size;
-    int      have_topleft;
 
-    const char*  p;
-    const char*  pEnd;
+    const char*  p    = Text;
+    const char*  pEnd = p + strlen( Text );
     int          ch;
 
 
@@ -616,179 +1475,252 @@
     if ( error )
       return -1;
 
-    INIT_SIZE( size, start_x, start_y, step_y, x, y );
-
-    p    = Text;
-    pEnd = p + strlen( Text );
-
-    while ( offset-- )
+    switch ( render_mode )
     {
-      ch = utf8_next( &p, pEnd );
-      if ( ch < 0 )
+    case RENDER_MODE_ALL:
       {
-        p  = Text;
-        ch = utf8_next( &p, pEnd );
+        FT_Palette_Data  palette_data;
+
+
+        if ( FT_Palette_Data_Get( size->face, &palette_data ) )
+          return -1;
       }
-    }
+      break;
 
-    have_topleft = 0;
+    case RENDER_MODE_FANCY:
+      Fancy_Init( &tiles.fancy, size );
+      break;
 
-    while ( num_indices-- )
-    {
-      FT_UInt  glyph_idx;
+    case RENDER_MODE_TEXT:
+      {
+        /* small glyphs come from the sbits cache of the main handle; */
+        /* see `FTDemo_Index_To_Bitmap'                               */
+        unsigned int  w = handle->scaler.width;
+        unsigned int  h = handle->scaler.height;
 
 
-      ch = utf8_next( &p, pEnd );
-      if ( ch < 0 )
+        if ( !handle->scaler.pixel )
+        {
+          w = ( ( w * handle->scaler.x_res + 36 ) / 72 ) >> 6;
+          h = ( ( h * handle->scaler.y_res + 36 ) / 72 ) >> 6;
+        }
+
+        if ( handle->use_sbits_cache && w < 48 && h < 48 )
+          return Render_Text( num_indices, offset );
+      }
+
+      while ( offset-- )
       {
-        p  = Text;
         ch = utf8_next( &p, pEnd );
-
-        /* not a single character of the text string could be displayed */
-        if ( !have_topleft )
-          return error;
+        if ( ch < 0 )
+        {
+          p  = Text;
+          ch = utf8_next( &p, pEnd );
+        }
       }
+      break;
+    }
 
-      glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)ch );
+    INIT_SIZE( size, start_x, start_y, step_y, x, y );
 
-      error = FTDemo_Draw_Index( handle, display, glyph_idx, &x, &y );
+    tiles.render_mode = render_mode;
+    Tiles_Sync();
 
-      if ( error )
-        goto Next;
+    /* start with a page of glyphs half an em wide */
+    width = size->metrics.y_ppem / 2 + 1;
+    batch = ( ( display->bitmap->width - start_x ) / width + 1 ) *
+            ( ( display->bitmap->rows - start_y ) / step_y + 1 );
 
-      if ( !have_topleft )
-      {
-        have_topleft   = 1;
-        status.topleft = ch;
-      }
+    i            = offset;
+    have_topleft = 0;
+    done         = 0;
 
-      if ( X_TOO_LONG( x + ( size->metrics.max_advance >> 6 ), display ) )
+    while ( !done )
+    {
+      int  j;
+
+
+      /* at least a few glyphs per thread */
+      if ( batch < 4 * tiles.num_workers )
+        batch = 4 * tiles.num_workers;
+      if ( render_mode != RENDER_MODE_TEXT && batch > num_indices - i )
+        batch = num_indices - i;
+      if ( batch <= 0 )
+        break;
+
+      if ( batch > tiles.max_jobs )
       {
-        x  = start_x;
-        y += step_y;
+        Job*  jobs = (Job*)realloc( tiles.jobs,
+                                    (size_t)batch * sizeof ( Job ) );
 
-        if ( Y_TOO_LONG( y, display ) )
-          break;
-      }
 
-      continue;
+        if ( !jobs )
+          Fatal( "could not allocate glyph jobs" );
 
-    Next:
-      Process_Error();
-    }
+        tiles.jobs     = jobs;
+        tiles.max_jobs = batch;
+      }
 
-    return -1;
-  }
+      memset( tiles.jobs, 0, (size_t)batch * sizeof ( Job ) );
 
+      for ( n = 0; n < batch; n++ )
+      {
+        Job*  job = &tiles.jobs[n];
 
-  static int
-  Render_Waterfall( int  mid_size,
-                    int  offset )
-  {
-    int      start_x, start_y, step_y, x, y;
-    int      pt_size, step, pt_height;
-    FT_Size  size;
-    int      have_topleft, start;
 
-    char         text[256];
-    const char*  p;
-    const char*  pEnd;
+        if ( render_mode == RENDER_MODE_TEXT )
+        {
+          ch = utf8_next( &p, pEnd );
+          if ( ch < 0 )
+          {
+            p  = Text;
+            ch = utf8_next( &p, pEnd );
 
+            job->wrapped = 1;
+          }
 
-    start_x = START_X;
-    start_y = START_Y;
+          job->charcode = ch;
+        }
+        else
+          job->charcode = i + n;
 
-    have_topleft = 0;
+        job->glyph_idx = FTDemo_Get_Index( handle,
+                                           (FT_UInt32)job->charcode );
+      }
 
-    pt_height = 64 * 72 * display->bitmap->rows / status.res;
-    step      = ( mid_size * mid_size / pt_height + 64 ) & ~63;
-    pt_size   = mid_size - step * ( mid_size / step );  /* remainder */
+      Tiles_Run( Rasterize_Job, n );
 
-    while ( 1 )
-    {
-      int first = offset;
-      int ch;
+      /* step 2, mirroring the loops of the serial functions */
+      for ( j = 0; j < n; j++ )
+      {
+        Job*  job = &tiles.jobs[j];
 
 
-      pt_size += step;
+        if ( render_mode == RENDER_MODE_TEXT )
+        {
+          /* not a single character of the text string could be displayed */
+          if ( job->wrapped && !have_topleft )
+          {
+            Tiles_Free_Jobs( n );
+            return error;
+          }
 
-      FTDemo_Set_Current_Charsize( handle, pt_size, status.res );
+          error = job->load_error ? job->load_error : job->error;
+          if ( error )
+          {
+            Process_Error();
+            continue;
+          }
 
-      error = FTDemo_Get_Size( handle, &size );
-      if ( error )
-        break;
+          /* don't accept a `missing' character with zero or negative width */
+          if ( job->glyph_idx == 0 && job->x_advance <= 0 )
+            job->x_advance = 1;
 
-      step_y = ( size->metrics.height >> 6 ) + 1;
+          job->drawn = 1;
+          job->x     = x + job->left;
+          job->y     = y - job->top;
 
-      x = start_x;
-      y = start_y + ( size->metrics.ascender >> 6 );
+          x += job->x_advance;
 
-      start_y += step_y;
+          if ( !have_topleft )
+          {
+            have_topleft   = 1;
+            status.topleft = job->charcode;
+          }
 
-      if ( y >= display->bitmap->rows )
-        break;
+          if ( X_TOO_LONG( x + ( size->metrics.max_advance >> 6 ), display ) )
+          {
+            x  = start_x;
+            y += step_y;
 
-      p    = Text;
-      pEnd = p + strlen( Text );
+            if ( Y_TOO_LONG( y, display ) )
+            {
+              j++;
+              done = 1;
+              break;
+            }
+          }
 
-      while ( first-- )
-      {
-        ch = utf8_next( &p, pEnd );
-        if ( ch < 0 )
-        {
-          p  = Text;
-          ch = utf8_next( &p, pEnd );
+          continue;
         }
-      }
 
-      start = snprintf( text, 256, "%g: ", pt_size / 64.0 );
-      snprintf( text + start, (unsigned int)( 256 - start ), "%s", p );
+        error = job->load_error;
+        if ( error )
+        {
+          Process_Error();
+          continue;
+        }
 
-      p    = text;
-      pEnd = p + strlen( text );
+        width = job->advance ? job->advance >> 6
+                             : size->metrics.y_ppem / 2;
 
-      while ( 1 )
-      {
-        FT_UInt      glyph_idx;
-        const char*  oldp;
+        if ( X_TOO_LONG( x + width, display ) )
+        {
+          x  = start_x;
+          y += step_y;
 
+          if ( Y_TOO_LONG( y, display ) )
+          {
+            done = 1;
+            break;
+          }
+        }
 
-        oldp = p;
-        ch   = utf8_next( &p, pEnd );
-        if ( ch < 0 )
+        /* extra space between glyphs */
+        x++;
+        if ( job->advance == 0 )
         {
-          /* end of the text (or invalid UTF-8); continue to next size */
-          break;
+          job->warn_x    = x;
+          job->warn_y    = y - width;
+          job->warn_size = width;
+
+          x += width;
         }
 
-        glyph_idx = FTDemo_Get_Index( handle, (FT_UInt32)ch );
+        error = job->error;
+        if ( error )
+        {
+          Process_Error();
+          continue;
+        }
 
-        error = FTDemo_Draw_Index( handle, display, glyph_idx, &x, &y );
+        job->drawn = 1;
+        job->x     = x + job->left;
+        job->y     = y - job->top;
 
-        if ( error )
-          goto Next;
+        x += job->x_advance;
 
-        /* `topleft' should be the first character after the size string */
-        if ( oldp - text == start && !have_topleft )
+        if ( !have_topleft )
         {
           have_topleft   = 1;
-          status.topleft = ch;
+          status.topleft = job->charcode;
         }
+      }
 
-        if ( X_TOO_LONG( x, display ) )
-          break;
+      tiles.num_drawn = j;
 
-        continue;
+      Tiles_Run( Composite_Band,
+                 ( display->bitmap->rows + tiles.band_height - 1 ) /
+                   tiles.band_height );
 
-      Next:
-        Process_Error();
+      Tiles_Free_Jobs( n );
+
+      i += j;
+
+      /* estimate the rest of the page from the space used so far */
+      if ( !done )
+      {
+        long  line = display->bitmap->width - start_x;
+        long  used = ( y - start_y ) / step_y * line + x - start_x;
+        long  left = ( ( display->bitmap->rows - start_y ) / step_y + 1 ) *
+                       line - used;
+
+
+        batch = used > 0 ? (int)( ( i - offset ) * left / used ) : n;
       }
     }
 
-    FTDemo_Set_Current_Charsize( handle, mid_size, status.res );
-    FTDemo_Get_Size( handle, &size );
-
-    return -1;
+    return render_mode == RENDER_MODE_TEXT ? -1 : i - 1;
   }
 
 
@@ -882,6 +1814,7 @@
 
     FTC_Manager_RemoveFaceID( handle->cache_manager,
                               handle->scaler.face_id );
+    FTDemo_Bitmap_Cache_Reset( handle );
 
     /* keep it normalized and balanced */
     status.filter_weights[    i] += delta;
@@ -1327,6 +2260,7 @@
       case grKEY( 'L' ):
         FTC_Manager_RemoveFaceID( handle->cache_manager,
                                   handle->scaler.face_id );
+        FTDemo_Bitmap_Cache_Reset( handle );
 
         status.lcd_filter++;
         switch ( status.lcd_filter )
@@ -1655,10 +2589,22 @@
              N_LCD_IDXS - 1 );
     fprintf( stderr,
       "  -L N,...  Set LCD filter or geometry by comma-separated values.\n"
-      "  -p        Preload file in memory to simulate memory-mapping.\n"
+      "  -p        Preload font files by memory-mapping them.\n"
+      "  -P how    Preload font files as given by `how': `map' (as with -p),\n"
+      "            `willneed' (map and read ahead), `random' (map without\n"
+      "            read-ahead), or `read' (read into allocated memory).\n"
+      "  -j N      Render modes 1, 2, and 4 with N threads (default: 1).\n"
+      "  -c size   Cache up to `size' kB of glyph bitmaps (default: %d);\n"
+      "            zero disables the cache.\n"
+      "  -S opts   Set OT-SVG rendering options by a comma-separated list:\n"
+      "            `direct' (draw documents straight into the glyph bitmap),\n"
+      "            `cache=size' (cache up to `size' kB of parsed documents;\n"
+      "            zero disables the cache), `entries=N' (cache up to N\n"
+      "            documents).  The cache hit rate is printed at exit.\n"
       "\n"
       "  -v        Show version.\n"
-      "\n" );
+      "\n",
+             MAX_BITMAP_BYTES / 1000 );
 
     exit( 1 );
   }
@@ -1674,13 +2620,24 @@
 
     while ( 1 )
     {
-      option = getopt( *argc, *argv, "d:e:f:k:L:l:m:pr:v" );
+      option = getopt( *argc, *argv, "c:d:e:f:j:k:L:l:m:pP:r:S:v" );
 
       if ( option == -1 )
         break;
 
       switch ( option )
       {
+      case 'c':
+        {
+          long  kbytes = atol( optarg );
+
+
+          if ( kbytes < 0 )
+            usage( execname );
+          FTDemo_Bitmap_Cache_Set_Budget( handle, (size_t)kbytes * 1000 );
+        }
+        break;
+
       case 'd':
         status.dims = optarg;
         break;
@@ -1693,6 +2650,12 @@
         sscanf( optarg, "%i", &status.offset );
         break;
 
+      case 'j':
+        status.num_threads = atoi( optarg );
+        if ( status.num_threads < 1 )
+          usage( execname );
+        break;
+
       case 'k':
         status.keys = optarg;
         while ( *optarg && *optarg != 'q' )
@@ -1744,6 +2707,10 @@
 
 
             FT_Library_SetLcdGeometry( handle->library, sub );
+
+            /* for the libraries of option `-j' */
+            memcpy( status.geometry, sub, sizeof ( sub ) );
+            status.have_geometry = 1;
           }
         }
         break;
@@ -1754,7 +2721,20 @@
         break;
 
       case 'p':
-        status.preload = 1;
+        status.preload = PRELOAD_MAP;
+        break;
+
+      case 'P':
+        if ( !strcmp( optarg, "read" ) )
+          status.preload = PRELOAD_READ;
+        else if ( !strcmp( optarg, "map" ) )
+          status.preload = PRELOAD_MAP;
+        else if ( !strcmp( optarg, "willneed" ) )
+          status.preload = PRELOAD_MAP_WILLNEED;
+        else if ( !strcmp( optarg, "random" ) )
+          status.preload = PRELOAD_MAP_RANDOM;
+        else
+          usage( execname );
         break;
 
       case 'r':
@@ -1763,6 +2743,11 @@
           usage( execname );
         break;
 
+      case 'S':
+        if ( FTDemo_SVG_Options( optarg ) )
+          usage( execname );
+        break;
+
       case 'v':
         {
           FT_String  str[64] = "ftview (FreeType) ";
@@ -1814,7 +2799,7 @@
                                (FT_LcdFilter)status.lcd_filter );
 
     if ( status.preload )
-      FTDemo_Set_Preload( handle, 1 );
+      FTDemo_Set_Preload( handle, status.preload );
 
     for ( ; argc > 0; argc--, argv++ )
       FTDemo_Install_Font( handle, argv[0], 0, 0 );
@@ -1829,6 +2814,9 @@
 
     FTDemo_Icon( handle, display );
 
+    if ( status.num_threads > 1 )
+      Tiles_Init( status.num_threads );
+
     status.num_fails = 0;
 
     event_font_change( 0 );
@@ -1840,13 +2828,23 @@
       switch ( status.render_mode )
       {
       case RENDER_MODE_ALL:
-        last = Render_All( handle->current_font->num_indices,
-                           status.offset );
+        if ( tiles.workers )
+          last = Render_Tiled( RENDER_MODE_ALL,
+                               handle->current_font->num_indices,
+                               status.offset );
+        else
+          last = Render_All( handle->current_font->num_indices,
+                             status.offset );
         break;
 
       case RENDER_MODE_FANCY:
-        last = Render_Fancy( handle->current_font->num_indices,
-                             status.offset );
+        if ( tiles.workers )
+          last = Render_Tiled( RENDER_MODE_FANCY,
+                               handle->current_font->num_indices,
+                               status.offset );
+        else
+          last = Render_Fancy( handle->current_font->num_indices,
+                               status.offset );
         break;
 
       case RENDER_MODE_STROKE:
@@ -1855,7 +2853,10 @@
         break;
 
       case RENDER_MODE_TEXT:
-        last = Render_Text( -1, status.offset );
+        if ( tiles.workers )
+          last = Render_Tiled( RENDER_MODE_TEXT, -1, status.offset );
+        else
+          last = Render_Text( -1, status.offset );
         break;
 
       case RENDER_MODE_WATERFALL:
@@ -1876,8 +2877,32 @@
               status.err_fails, FTDemo_Error_String( status.err_fails ) );
     }
 
+    if ( handle->bitmap_cache.hits || handle->bitmap_cache.misses )
+      printf( "Bitmap cache: %lu hits, %lu misses, %lu evictions,"
+              " %lu kB in use\n",
+              handle->bitmap_cache.hits,
+              handle->bitmap_cache.misses,
+              handle->bitmap_cache.evictions,
+              (unsigned long)( handle->bitmap_cache.cur_bytes / 1000 ) );
+
+    if ( status.preload )
+    {
+      size_t  total, resident;
+
+
+      FTDemo_Preload_Stats( handle, &total, &resident );
+      printf( "Preloaded fonts: %lu kB, %lu kB of it resident\n",
+              (unsigned long)( total / 1000 ),
+              (unsigned long)( resident / 1000 ) );
+    }
+
+    Tiles_Done();
     FTDemo_Display_Done( display );
     FTDemo_Done( handle );
+
+    /* the libraries add their counts when they are done */
+    FTDemo_SVG_Stats();
+
     exit( 0 );      /* for safety reasons */
 
     /* return 0; */ /* never reached */
@@ -37,6 +37,13 @@
 #endif
 #include "gbench.h"
 
+  /* for the comparison of the graph library's backends (option `-B') */
+  /* and of its SIMD variants (option `-C')                            */
+#include "grobjs.h"
+#include "gblblit.h"
+#include "grconvert.h"
+#include "grswizzle.h"
+
 #define  xxCACHE
 
   static  int             use_gamma = 0;
@@ -646,6 +653,525 @@ dump_cache_stats( void )
 }
 
 
+/* comparison of the blending backends of the graph library
+ */
+
+static grSurface*  bsurface;
+
+
+static int
+do_backend_glyph( int  arg )
+{
+  grBitmap  bit;
+  grColor   color;
+
+
+  bit.rows   = glyph.height;
+  bit.width  = glyph.width;
+  bit.pitch  = glyph.pitch;
+  bit.mode   = gr_pixel_mode_gray;
+  bit.grays  = 256;
+  bit.buffer = glyph.buffer;
+
+  /* draw white or in colors */
+  color.chroma[0] = (unsigned char)( arg ? RAND(256) : 255 );
+  color.chroma[1] = (unsigned char)( arg ? RAND(256) : 255 );
+  color.chroma[2] = (unsigned char)( arg ? RAND(256) : 255 );
+
+  grBlitGlyphToSurface( bsurface, &bit,
+                        (grPos)RAND(SIZE_X), (grPos)RAND(SIZE_Y), color );
+
+  return 0;
+}
+
+
+static double
+ref_to_linear( double  gamma,
+               double  x )
+{
+  if ( gamma > 0 )
+    return pow( x, gamma );
+
+  return x <= 0.04045 ? x / 12.92 : pow( ( x + 0.055 ) / 1.055, 2.4 );
+}
+
+
+static double
+ref_from_linear( double  gamma,
+                 double  x )
+{
+  if ( gamma > 0 )
+    return pow( x, 1 / gamma );
+
+  return x <= 0.0031308 ? x * 12.92 : 1.055 * pow( x, 1 / 2.4 ) - 0.055;
+}
+
+
+/* blend the test glyph over random pixels in random colors and compare */
+/* with the exact result, computed in double precision                  */
+static void
+backend_error( double  gamma )
+{
+  grSurface*  surface = bsurface;
+  grBitmap    bit;
+  int         trial, x, y, c;
+  int         max_err  = 0;
+  double      sum_err  = 0;
+  long        num_err  = 0;
+
+  unsigned char  back[18 * 14 * 3];
+
+
+  bit.rows   = glyph.height;
+  bit.width  = glyph.width;
+  bit.pitch  = glyph.pitch;
+  bit.mode   = gr_pixel_mode_gray;
+  bit.grays  = 256;
+  bit.buffer = glyph.buffer;
+
+  for ( trial = 0; trial < 1000; trial++ )
+  {
+    grColor  color;
+
+
+    for ( c = 0; c < 3; c++ )
+      color.chroma[c] = (unsigned char)RAND(256);
+
+    for ( y = 0; y < glyph.height; y++ )
+      for ( x = 0; x < glyph.width * 3; x++ )
+        surface->bitmap.buffer[y * surface->bitmap.pitch + x] =
+          back[y * glyph.width * 3 + x] = (unsigned char)RAND(256);
+
+    grBlitGlyphToSurface( surface, &bit, 0, 0, color );
+
+    for ( y = 0; y < glyph.height; y++ )
+      for ( x = 0; x < glyph.width; x++ )
+      {
+        double  a = glyph.buffer[y * glyph.pitch + x] / 255.;
+
+
+        if ( a == 0 || a == 1 )
+          continue;
+
+        for ( c = 0; c < 3; c++ )
+        {
+          int  b   = back[( y * glyph.width + x ) * 3 + c];
+          int  out = surface->bitmap.buffer[y * surface->bitmap.pitch +
+                                            x * 3 + c];
+          int  ref = (int)( 255 * ref_from_linear( gamma,
+                                 ( 1 - a ) * ref_to_linear( gamma, b / 255. ) +
+                                 a * ref_to_linear( gamma,
+                                                    color.chroma[c] / 255. ) ) +
+                            0.5 );
+          int  err = out > ref ? out - ref : ref - out;
+
+
+          if ( err > max_err )
+            max_err = err;
+          sum_err += err;
+          num_err++;
+        }
+      }
+  }
+
+  printf( "%-30s : %d max, %.3f mean\n",
+          "  error (8-bit levels)", max_err, sum_err / num_err );
+}
+
+
+static void
+bench_backends( double  gamma )
+{
+  int  backend;
+
+
+  bsurface = (grSurface*)grAlloc( sizeof ( grSurface ) );
+  if ( !bsurface                                             ||
+       grNewBitmap( gr_pixel_mode_rgb24, 0, SIZE_X, SIZE_Y,
+                    &bsurface->bitmap )                       )
+  {
+    fprintf( stderr, "could not allocate the target surface\n" );
+    exit( 1 );
+  }
+
+  grSetTargetGamma( bsurface, gamma );
+
+  for ( backend = 0; backend < GBLENDER_BACKEND_MAX; backend++ )
+  {
+    printf( "backend `%s'\n",
+            gblender_backend_name( (GBlenderBackend)backend ) );
+    gblender_set_backend( bsurface->gblender, (GBlenderBackend)backend );
+
+    memset( bsurface->bitmap.buffer, 0, (size_t)SIZE_X * 3 * SIZE_Y );
+    bench( do_backend_glyph, 0, "  white glyph", 0 );
+
+    memset( bsurface->bitmap.buffer, 0, (size_t)SIZE_X * 3 * SIZE_Y );
+    bench( do_backend_glyph, 1, "  color glyph", 0 );
+
+    backend_error( gamma );
+  }
+}
+
+
+/* comparison of the SIMD variants of the graph library's pixel format
+ * converters, swizzle filters, glyph blitters, and span fillers, on
+ * whole frames of random pixels
+ */
+
+static unsigned char  csrc[SIZE_X * 4 * SIZE_Y];
+static unsigned char  cframe[SIZE_X * 4 * SIZE_Y];
+
+static grConvertFunc  cfunc;
+
+
+static int
+do_convert( int  gray )
+{
+  const unsigned char*  src = csrc;
+  unsigned char*        dst = cframe;
+  int                   y;
+
+
+  for ( y = 0; y < SIZE_Y; y++ )
+  {
+    cfunc( src, dst, SIZE_X );
+
+    src += gray ? SIZE_X : SIZE_X * 3;
+    dst += SIZE_X * 4;
+  }
+
+  return 0;
+}
+
+
+static const struct
+{
+  const char*  name;
+  int          pix_bytes;
+  void       (*func)( unsigned char*  read_buff,
+                      int             read_pitch,
+                      unsigned char*  write_buff,
+                      int             write_pitch,
+                      int             buff_width,
+                      int             buff_height,
+                      int             x,
+                      int             y,
+                      int             width,
+                      int             height );
+
+} swizzles[] =
+{
+  { "swizzle rgb24",  3, gr_swizzle_rect_rgb24 },
+  { "swizzle rgb565", 2, gr_swizzle_rect_rgb565 },
+  { "swizzle xrgb32", 4, gr_swizzle_rect_xrgb32 }
+};
+
+
+static int
+do_swizzle( int  idx )
+{
+  int  pitch = SIZE_X * swizzles[idx].pix_bytes;
+
+
+  swizzles[idx].func( csrc, pitch, cframe, pitch,
+                      SIZE_X, SIZE_Y, 0, 0, SIZE_X, SIZE_Y );
+
+  return 0;
+}
+
+
+/* the glyph blitters and span fillers draw into `cframe' as a */
+/* surface in the target format                                */
+static const struct
+{
+  const char*  name;
+  grPixelMode  mode;
+  int          pix_bytes;
+
+} ctargets[] =
+{
+  { "rgb32", gr_pixel_mode_rgb32, 4 },
+  { "rgb24", gr_pixel_mode_rgb24, 3 }
+};
+
+
+/* an antialiased disc with blocks of full, partial, and zero coverage */
+/* for the vector units; the LCD modes have 3 subpixels per pixel      */
+#define DISC_SIZE  128
+
+static const struct
+{
+  const char*  name;
+  grPixelMode  mode;
+  int          x_sub;
+  int          y_sub;
+
+} csources[] =
+{
+  { "gray", gr_pixel_mode_gray, 1, 1 },
+  { "lcd",  gr_pixel_mode_lcd,  3, 1 },
+  { "lcd2", gr_pixel_mode_lcd2, 3, 1 },
+  { "lcdv", gr_pixel_mode_lcdv, 1, 3 }
+};
+
+
+#define NUM_SWIZZLES  (int)( sizeof ( swizzles ) / sizeof ( *swizzles ) )
+#define NUM_TARGETS   (int)( sizeof ( ctargets ) / sizeof ( *ctargets ) )
+#define NUM_SOURCES   (int)( sizeof ( csources ) / sizeof ( *csources ) )
+
+/* converters, swizzles, and per target all sources plus the spans */
+static unsigned long  chash[2 * gr_convert_max + NUM_SWIZZLES +
+                            NUM_TARGETS * ( NUM_SOURCES + 1 )];
+
+static grSurface      csurface;
+static grBitmap       cglyphs[NUM_SOURCES];
+static unsigned char  cglyph_buffers[NUM_SOURCES][DISC_SIZE * DISC_SIZE * 3];
+
+
+/* number of blits or span calls before a frame is compared */
+#define CHECK_COUNT  2000
+
+
+/* the portable variant comes first and provides the reference hashes */
+static void
+check_frame( int          level,
+             int          test,
+             const char*  title )
+{
+  unsigned long  hash = 2166136261UL;
+  size_t         nn;
+
+
+  for ( nn = 0; nn < sizeof ( cframe ); nn++ )
+    hash = ( ( hash ^ cframe[nn] ) * 16777619UL ) & 0xFFFFFFFFUL;
+
+  if ( level == GBLENDER_SIMD_NONE )
+    chash[test] = hash;
+  else if ( hash != chash[test] )
+    printf( "%-30s : differs from the portable code!\n", title );
+}
+
+
+/* coverage at (x,y) in pixels, with an edge 3 pixels wide */
+static unsigned char
+disc_coverage( double  x,
+               double  y )
+{
+  double  r = DISC_SIZE / 2 - 2;
+  double  c = ( r - sqrt( ( x - DISC_SIZE / 2 ) * ( x - DISC_SIZE / 2 ) +
+                          ( y - DISC_SIZE / 2 ) * ( y - DISC_SIZE / 2 ) ) ) / 3;
+
+
+  return c <= 0 ? 0 : c >= 1 ? 255 : (unsigned char)( c * 255 );
+}
+
+
+static void
+init_glyph( int  idx )
+{
+  grBitmap*  bit = &cglyphs[idx];
+  int        x, y;
+
+
+  bit->mode   = csources[idx].mode;
+  bit->grays  = 256;
+  bit->width  = DISC_SIZE * csources[idx].x_sub;
+  bit->rows   = DISC_SIZE * csources[idx].y_sub;
+  bit->pitch  = bit->width;
+  bit->buffer = cglyph_buffers[idx];
+
+  for ( y = 0; y < bit->rows; y++ )
+    for ( x = 0; x < bit->width; x++ )
+      bit->buffer[y * bit->pitch + x] =
+        disc_coverage( ( x + 0.5 ) / csources[idx].x_sub,
+                       ( y + 0.5 ) / csources[idx].y_sub );
+}
+
+
+static void
+init_target( int  idx )
+{
+  csurface.bitmap.mode   = ctargets[idx].mode;
+  csurface.bitmap.grays  = 256;
+  csurface.bitmap.width  = SIZE_X;
+  csurface.bitmap.rows   = SIZE_Y;
+  csurface.bitmap.pitch  = SIZE_X * ctargets[idx].pix_bytes;
+  csurface.bitmap.buffer = cframe;
+}
+
+
+/* white for timing, random colors for the checks */
+static int  cvary;
+
+
+static grColor
+draw_color( void )
+{
+  int  r = cvary ? RAND(256) : 255;
+  int  g = cvary ? RAND(256) : 255;
+  int  b = cvary ? RAND(256) : 255;
+
+
+  return grFindColor( &csurface.bitmap, r, g, b, 255 );
+}
+
+
+static int
+do_simd_blit( int  idx )
+{
+  int  x = RAND(SIZE_X);
+  int  y = RAND(SIZE_Y);
+
+
+  grBlitGlyphToSurface( &csurface, &cglyphs[idx], x, y, draw_color() );
+
+  return 0;
+}
+
+
+#define NUM_SPANS  8
+
+/* spans on a random row, half of them with full coverage */
+static int
+do_simd_spans( int  count )
+{
+  grSpan  spans[NUM_SPANS];
+  int     y = RAND(SIZE_Y);
+  int     n;
+
+
+  grSetTargetPenBrush( &csurface, 0, SIZE_Y, draw_color() );
+
+  for ( n = 0; n < count; n++ )
+  {
+    spans[n].x        = (short)RAND(SIZE_X - 64);
+    spans[n].len      = (unsigned short)( 1 + RAND(64) );
+    spans[n].coverage = (unsigned char)( RAND(2) ? 255 : RAND(256) );
+  }
+
+  csurface.gray_spans( y, count, spans, &csurface );
+
+  return 0;
+}
+
+
+/* draw the same sequence in random colors on the same random */
+/* background for every variant                               */
+static void
+check_drawing( int          level,
+               int          test,
+               const char*  title,
+               bench_t      func,
+               int          arg,
+               double       gamma )
+{
+  int  n;
+
+
+  memcpy( cframe, csrc, sizeof ( cframe ) );
+  grSetTargetGamma( &csurface, gamma );
+
+  seed  = 1;
+  cvary = 1;
+  for ( n = 0; n < CHECK_COUNT; n++ )
+    func( arg );
+  cvary = 0;
+
+  check_frame( level, test, title );
+}
+
+
+static void
+bench_simd( double  gamma )
+{
+  static const char*  levels[] = { "none", "sse2", "avx2", "neon" };
+
+  int  level, format, gray, idx, target;
+
+
+  for ( idx = 0; idx < (int)sizeof ( csrc ); idx++ )
+    csrc[idx] = (unsigned char)RAND(256);
+
+  for ( idx = 0; idx < NUM_SOURCES; idx++ )
+    init_glyph( idx );
+
+  for ( level = GBLENDER_SIMD_NONE; level <= GBLENDER_SIMD_NEON; level++ )
+  {
+    /* skip variants not supported here */
+    if ( gblender_simd_select( (GBlenderSimd)level ) != level )
+      continue;
+
+    printf( "SIMD variant `%s' (%dx%d frame)\n", levels[level],
+            SIZE_X, SIZE_Y );
+
+    for ( gray = 0; gray < 2; gray++ )
+      for ( format = 0; format < gr_convert_max; format++ )
+      {
+        char  title[64];
+
+
+        sprintf( title, "  %s to %s", gray ? "gray" : "rgb24",
+                 gr_convert_format_name( (grConvertFormat)format ) );
+
+        cfunc = gr_convert_get_func( gray ? gr_pixel_mode_gray
+                                          : gr_pixel_mode_rgb24,
+                                     (grConvertFormat)format );
+
+        memset( cframe, 0, sizeof ( cframe ) );
+        bench( do_convert, gray, title, 0 );
+        check_frame( level, gray * gr_convert_max + format, title );
+      }
+
+    for ( idx = 0; idx < NUM_SWIZZLES; idx++ )
+    {
+      char  title[64];
+
+
+      sprintf( title, "  %s", swizzles[idx].name );
+
+      memset( cframe, 0, sizeof ( cframe ) );
+      bench( do_swizzle, idx, title, 0 );
+      check_frame( level, 2 * gr_convert_max + idx, title );
+    }
+
+    for ( target = 0; target < NUM_TARGETS; target++ )
+    {
+      int  test = 2 * gr_convert_max + NUM_SWIZZLES +
+                  target * ( NUM_SOURCES + 1 );
+
+
+      init_target( target );
+
+      for ( idx = 0; idx <= NUM_SOURCES; idx++ )
+      {
+        bench_t  func = do_simd_blit;
+        int      arg  = idx;
+        char     title[64];
+
+
+        if ( idx < NUM_SOURCES )
+          sprintf( title, "  %s glyph to %s",
+                   csources[idx].name, ctargets[target].name );
+        else
+        {
+          func = do_simd_spans;
+          arg  = NUM_SPANS;
+          sprintf( title, "  spans to %s", ctargets[target].name );
+        }
+
+        /* white on black, like typical text */
+        memset( cframe, 0, sizeof ( cframe ) );
+        grSetTargetGamma( &csurface, gamma );
+        bench( func, arg, title, 0 );
+        check_drawing( level, test + idx, title, func, arg, gamma );
+      }
+    }
+  }
+
+  gblender_simd_select( GBLENDER_SIMD_AUTO );
+}
+
+
 void usage(void)
 {
   fprintf( stderr,
@@ -659,6 +1185,12 @@ void usage(void)
   "   -s seed  : specify random seed\n" );
   fprintf( stderr,
   "   -g gamma : specify gamma\n" );
+  fprintf( stderr,
+  "   -B       : compare the blending backends of the graph library\n" );
+  fprintf( stderr,
+  "   -C       : compare the SIMD variants of the pixel format converters,\n"
+  "              swizzle filters, glyph blitters, and span fillers of the\n"
+  "              graph library\n" );
   exit( 1 );
 }
 
@@ -671,6 +1203,8 @@ main(int argc,
   char* tests = NULL;
   int size;
   double gamma = 1.0;
+  int backends = 0;
+  int simd = 0;
 
   while (argc > 1 && argv[1][0] == '-')
   {
@@ -702,6 +1236,14 @@ main(int argc,
       argv += 2;
       break;
 
+    case 'B':
+      backends = 1;
+      break;
+
+    case 'C':
+      simd = 1;
+      break;
+
 #if 0
     case 'b':
       argc--;
@@ -725,6 +1267,18 @@ main(int argc,
   if ( argc != 1 )
     usage();
 
+  if ( backends )
+  {
+    bench_backends( gamma );
+    return 0;
+  }
+
+  if ( simd )
+  {
+    bench_simd( gamma );
+    return 0;
+  }
+
   ggamma_set( gamma );
 
   memset( buffer, 0, sizeof ( buffer ) );
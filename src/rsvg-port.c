@@ -19,18 +19,30 @@
 #include <ft2build.h>
 #include <freetype/otsvg.h>
 
+#include "rsvg-port.h"
+
+
+  Rsvg_Port_OptionsRec  rsvg_port_options =
+  {
+    32 * 1024 * 1024,  /* cache_limit   */
+    64,                /* cache_entries */
+    0                  /* direct        */
+  };
+
+  Rsvg_Port_StatsRec  rsvg_port_stats;
+
+
 #ifdef HAVE_LIBRSVG
 
 #include <cairo.h>
 #include <librsvg/rsvg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include <freetype/freetype.h>
 #include <freetype/ftbbox.h>
 
-#include "rsvg-port.h"
-
 
   /*
    * The init hook is called when the first OT-SVG glyph is rendered.  All
@@ -40,22 +52,221 @@
    * the other one might use.
    */
   FT_Error
-  rsvg_port_init( FT_Pointer  *state )
+  rsvg_port_init( FT_Pointer  *_state )
   {
-    /* allocate the memory upon initialization */
-    *state = malloc( sizeof( Rsvg_Port_StateRec ) ); /* XXX error handling */
+    Rsvg_Port_State  state;
+
+
+    /* allocate the memory upon initialization; note that FreeType */
+    /* ignores errors, so the other hooks must handle a NULL state */
+    state = (Rsvg_Port_State)calloc( 1, sizeof ( Rsvg_Port_StateRec ) );
+
+    *_state = state;
+    if ( !state )
+      return FT_Err_Out_Of_Memory;
+
+    state->options = rsvg_port_options;
 
     return FT_Err_Ok;
   }
 
 
   /*
-   * Deallocate the state structure.
+   * A cheap guard against a document of a face that is gone and the
+   * document of a new face at the same address: a hash of up to 64 bytes
+   * at either end of the document.
+   */
+  static unsigned long
+  rsvg_port_hash( const FT_Byte*  data,
+                  FT_ULong        length )
+  {
+    unsigned long  hash = 2166136261UL;
+    FT_ULong       n;
+
+
+    for ( n = 0; n < length && n < 64; n++ )
+      hash = ( ( hash ^ data[n] ) * 16777619UL ) & 0xFFFFFFFFUL;
+
+    for ( n = length > 128 ? length - 64 : 64; n < length; n++ )
+      hash = ( ( hash ^ data[n] ) * 16777619UL ) & 0xFFFFFFFFUL;
+
+    return hash;
+  }
+
+
+  static void
+  rsvg_port_cache_unlink( Rsvg_Port_State  state,
+                          Rsvg_Port_Entry  entry )
+  {
+    if ( entry->prev )
+      entry->prev->next = entry->next;
+    else
+      state->first = entry->next;
+
+    if ( entry->next )
+      entry->next->prev = entry->prev;
+    else
+      state->last = entry->prev;
+  }
+
+
+  static void
+  rsvg_port_cache_push( Rsvg_Port_State  state,
+                        Rsvg_Port_Entry  entry )
+  {
+    entry->prev = NULL;
+    entry->next = state->first;
+
+    if ( state->first )
+      state->first->prev = entry;
+    else
+      state->last = entry;
+
+    state->first = entry;
+  }
+
+
+  static void
+  rsvg_port_cache_remove( Rsvg_Port_State  state,
+                          Rsvg_Port_Entry  entry )
+  {
+    rsvg_port_cache_unlink( state, entry );
+
+    state->num_entries--;
+    state->cache_size -= entry->svg_document_length;
+
+    g_object_unref( entry->handle );
+    free( entry );
+  }
+
+
+  /*
+   * Look up the parsed document; a hit becomes the most recently used
+   * entry.
+   */
+  static Rsvg_Port_Entry
+  rsvg_port_cache_lookup( Rsvg_Port_State  state,
+                          FT_SVG_Document  document,
+                          unsigned long    hash )
+  {
+    Rsvg_Port_Entry  entry;
+
+
+    state->stats.lookups++;
+
+    for ( entry = state->first; entry; entry = entry->next )
+      if ( entry->svg_document        == document->svg_document        &&
+           entry->svg_document_length == document->svg_document_length &&
+           entry->start_glyph_id      == document->start_glyph_id      &&
+           entry->end_glyph_id        == document->end_glyph_id        &&
+           entry->hash                == hash                          )
+      {
+        if ( entry != state->first )
+        {
+          rsvg_port_cache_unlink( state, entry );
+          rsvg_port_cache_push( state, entry );
+        }
+
+        state->stats.hits++;
+        return entry;
+      }
+
+    return NULL;
+  }
+
+
+  /*
+   * Add a parsed document, dropping the least recently used ones as
+   * needed.  On success, the cache takes over the reference to `handle`;
+   * otherwise, NULL is returned and the caller keeps it.
+   */
+  static Rsvg_Port_Entry
+  rsvg_port_cache_insert( Rsvg_Port_State  state,
+                          FT_SVG_Document  document,
+                          unsigned long    hash,
+                          RsvgHandle      *handle,
+                          int              width,
+                          int              height )
+  {
+    Rsvg_Port_Entry  entry;
+
+
+    if ( state->options.cache_entries < 1                           ||
+         document->svg_document_length > state->options.cache_limit )
+      return NULL;
+
+    entry = (Rsvg_Port_Entry)malloc( sizeof ( Rsvg_Port_EntryRec ) );
+    if ( !entry )
+      return NULL;
+
+    while ( state->last                                            &&
+            ( state->num_entries >= state->options.cache_entries ||
+              state->cache_size + document->svg_document_length >
+                state->options.cache_limit                       ) )
+    {
+      rsvg_port_cache_remove( state, state->last );
+      state->stats.evictions++;
+    }
+
+    entry->svg_document        = document->svg_document;
+    entry->svg_document_length = document->svg_document_length;
+    entry->start_glyph_id      = document->start_glyph_id;
+    entry->end_glyph_id        = document->end_glyph_id;
+    entry->hash                = hash;
+    entry->handle              = handle;
+    entry->width               = width;
+    entry->height              = height;
+
+    rsvg_port_cache_push( state, entry );
+
+    state->num_entries++;
+    state->cache_size += entry->svg_document_length;
+
+    return entry;
+  }
+
+
+  /*
+   * Deallocate the state structure and the cache.
    */
   void
-  rsvg_port_free( FT_Pointer  *state )
+  rsvg_port_free( FT_Pointer  *_state )
   {
-    free( *state );
+    Rsvg_Port_State  state = *(Rsvg_Port_State*)_state;
+
+
+    if ( !state )
+      return;
+
+    while ( state->first )
+      rsvg_port_cache_remove( state, state->first );
+
+    if ( state->rec_surface )
+      cairo_surface_destroy( state->rec_surface );
+    if ( state->handle )
+      g_object_unref( state->handle );
+
+    rsvg_port_stats.lookups   += state->stats.lookups;
+    rsvg_port_stats.hits      += state->stats.hits;
+    rsvg_port_stats.evictions += state->stats.evictions;
+
+    free( state );
+  }
+
+
+  /*
+   * Draw the whole document or only the element with ID `id`, if not
+   * empty.
+   */
+  static gboolean
+  rsvg_port_draw( RsvgHandle   *handle,
+                  cairo_t      *cr,
+                  const char   *id )
+  {
+    if ( id[0] )
+      return rsvg_handle_render_cairo_sub( handle, cr, id );
+    else
+      return rsvg_handle_render_cairo( handle, cr );
   }
 
 
@@ -63,7 +274,7 @@
    * The render hook.  The job of this hook is to simply render the glyph in
    * the buffer that has been allocated on the FreeType side.  Here we
    * simply use the recording surface by playing it back against the
-   * surface.
+   * surface, or draw the document again if `direct` is set.
    */
   FT_Error
   rsvg_port_render( FT_GlyphSlot  slot,
@@ -78,6 +289,8 @@
 
 
     state = *(Rsvg_Port_State*)_state;
+    if ( !state )
+      return FT_Err_Out_Of_Memory;
 
     /* Create an image surface to store the rendered image.  However,   */
     /* don't allocate memory; instead use the space already provided in */
@@ -112,11 +325,27 @@
     /* that we get a tight rendering with least redundant white spac.     */
     cairo_translate( cr, -state->x, -state->y );
 
-    /* Replay from the recorded surface.  This saves us from parsing the */
-    /* document again and redoing what was already done in the preset    */
-    /* hook.                                                             */
-    cairo_set_source_surface( cr, state->rec_surface, 0.0, 0.0 );
-    cairo_paint( cr );
+    if ( state->handle )
+    {
+      /* Draw the document, parsed by the preset hook, with the same */
+      /* transformation as the recorded drawing.                     */
+      cairo_scale( cr, state->x_scale, state->y_scale );
+      cairo_transform( cr, &state->transform );
+
+      if ( rsvg_port_draw( state->handle, cr, state->id ) == FALSE )
+        error = FT_Err_Invalid_SVG_Document;
+
+      g_object_unref( state->handle );
+      state->handle = NULL;
+    }
+    else
+    {
+      /* Replay from the recorded surface.  This saves us from parsing */
+      /* the document again and redoing what was already done in the  */
+      /* preset hook.                                                  */
+      cairo_set_source_surface( cr, state->rec_surface, 0.0, 0.0 );
+      cairo_paint( cr );
+    }
 
     cairo_surface_flush( surface );
 
@@ -127,7 +356,9 @@
     /* Clean up everything. */
     cairo_surface_destroy( surface );
     cairo_destroy( cr );
-    cairo_surface_destroy( state->rec_surface );
+    if ( state->rec_surface )
+      cairo_surface_destroy( state->rec_surface );
+    state->rec_surface = NULL;
 
     return error;
   }
@@ -177,9 +408,13 @@
     cairo_t        *rec_cr;
     cairo_matrix_t  transform_matrix;
 
-    /* Rendering port's state. */
+    /* Rendering port's state; `port` also holds the cache. */
+    Rsvg_Port_State     port;
     Rsvg_Port_State     state;
     Rsvg_Port_StateRec  state_dummy;
+    Rsvg_Port_Entry     entry = NULL;
+    unsigned long       hash;
+    FT_Bool             direct;
 
     /* General variables. */
     double  x, y;
@@ -189,6 +424,8 @@
     double  x_svg_to_out, y_svg_to_out;
     double  tmpd;
 
+    char  id[32] = "";
+
     float metrics_width, metrics_height;
     float horiBearingX, horiBearingY;
     float vertBearingX, vertBearingY;
@@ -198,57 +435,93 @@
     /* If `cache` is `TRUE` we store calculations in the actual port */
     /* state variable, otherwise we just create a dummy variable and */
     /* store there.  This saves us from too many 'if' statements.    */
+    port = *(Rsvg_Port_State*)_state;
     if ( cache )
-      state = *(Rsvg_Port_State*)_state;
-    else
-      state = &state_dummy;
-
-    /* Form an `RsvgHandle` by loading the SVG document. */
-    handle = rsvg_handle_new_from_data( document->svg_document,
-                                        document->svg_document_length,
-                                        &gerror );
-    if ( handle == NULL )
     {
-      error = FT_Err_Invalid_SVG_Document;
-      goto CleanLibrsvg;
-    }
+      if ( !port )
+        return FT_Err_Out_Of_Memory;
 
-    /* Get attributes like `viewBox` and `width`/`height`. */
-    rsvg_handle_get_intrinsic_dimensions( handle,
-                                          &out_has_width,
-                                          &out_width,
-                                          &out_has_height,
-                                          &out_height,
-                                          &out_has_viewbox,
-                                          &out_viewbox );
+      state = port;
 
-    /*
-     * Figure out the units in the EM square in the SVG document.  This is
-     * specified by the `ViewBox` or the `width`/`height` attributes, if
-     * present, otherwise it should be assumed that the units in the EM
-     * square are the same as in the TTF/CFF outlines.
-     *
-     * TODO: I'm not sure what the standard says about the situation if
-     * `ViewBox` as well as `width`/`height` are present; however, I've
-     * never seen that situation in real fonts.
-     */
-    if ( out_has_viewbox == TRUE )
-    {
-      dimension_svg.width  = (int)out_viewbox.width; /* XXX rounding? */
-      dimension_svg.height = (int)out_viewbox.height;
+      /* in case the last glyph was never rendered */
+      if ( state->rec_surface )
+        cairo_surface_destroy( state->rec_surface );
+      if ( state->handle )
+        g_object_unref( state->handle );
+      state->rec_surface = NULL;
+      state->handle      = NULL;
     }
-    else if ( out_has_width == TRUE && out_has_height == TRUE )
+    else
+      state = &state_dummy;
+
+    /* Documents with several glyphs are usually used again right away. */
+    hash = rsvg_port_hash( document->svg_document,
+                           document->svg_document_length );
+    if ( port )
+      entry = rsvg_port_cache_lookup( port, document, hash );
+
+    if ( entry )
     {
-      dimension_svg.width  = (int)out_width.length; /* XXX rounding? */
-      dimension_svg.height = (int)out_height.length;
+      handle               = entry->handle;
+      dimension_svg.width  = entry->width;
+      dimension_svg.height = entry->height;
     }
     else
     {
-      /* If neither `ViewBox` nor `width`/`height` are present, the */
-      /* `units_per_EM` in SVG coordinates must be the same as      */
-      /* `units_per_EM` of the TTF/CFF outlines.                    */
-      dimension_svg.width  = units_per_EM;
-      dimension_svg.height = units_per_EM;
+      /* Form an `RsvgHandle` by loading the SVG document. */
+      handle = rsvg_handle_new_from_data( document->svg_document,
+                                          document->svg_document_length,
+                                          &gerror );
+      if ( handle == NULL )
+      {
+        if ( gerror )
+          g_error_free( gerror );
+        return FT_Err_Invalid_SVG_Document;
+      }
+
+      /* Get attributes like `viewBox` and `width`/`height`. */
+      rsvg_handle_get_intrinsic_dimensions( handle,
+                                            &out_has_width,
+                                            &out_width,
+                                            &out_has_height,
+                                            &out_height,
+                                            &out_has_viewbox,
+                                            &out_viewbox );
+
+      /*
+       * Figure out the units in the EM square in the SVG document.  This
+       * is specified by the `ViewBox` or the `width`/`height` attributes,
+       * if present, otherwise it should be assumed that the units in the
+       * EM square are the same as in the TTF/CFF outlines.
+       *
+       * TODO: I'm not sure what the standard says about the situation if
+       * `ViewBox` as well as `width`/`height` are present; however, I've
+       * never seen that situation in real fonts.
+       */
+      if ( out_has_viewbox == TRUE )
+      {
+        dimension_svg.width  = (int)out_viewbox.width; /* XXX rounding? */
+        dimension_svg.height = (int)out_viewbox.height;
+      }
+      else if ( out_has_width == TRUE && out_has_height == TRUE )
+      {
+        dimension_svg.width  = (int)out_width.length; /* XXX rounding? */
+        dimension_svg.height = (int)out_height.length;
+      }
+      else
+      {
+        /* If neither `ViewBox` nor `width`/`height` are present, the */
+        /* `units_per_EM` in SVG coordinates must be the same as      */
+        /* `units_per_EM` of the TTF/CFF outlines.                    */
+        dimension_svg.width  = units_per_EM;
+        dimension_svg.height = units_per_EM;
+      }
+
+      /* From now on, the handle is the cache's if this succeeds. */
+      if ( port )
+        entry = rsvg_port_cache_insert( port, document, hash, handle,
+                                        dimension_svg.width,
+                                        dimension_svg.height );
     }
 
     /* Scale factors from SVG coordinates to the needed output size. */
@@ -301,26 +574,16 @@
     cairo_transform( rec_cr, &transform_matrix );
 
     /* If the document contains only one glyph, `start_glyph_id` and */
-    /* `end_glyph_id` have the same value.  Otherwise `end_glyph_id` */
-    /* is larger.                                                    */
-    if ( start_glyph_id == end_glyph_id )
-    {
-      /* Render the whole document to the recording surface. */
-      ret = rsvg_handle_render_cairo ( handle, rec_cr );
-      if ( ret == FALSE )
-      {
-        error = FT_Err_Invalid_SVG_Document;
-        goto CleanCairo;
-      }
-    }
-    else if ( start_glyph_id < end_glyph_id )
+    /* `end_glyph_id` have the same value, and we render the whole    */
+    /* document to the recording surface.  Otherwise `end_glyph_id`   */
+    /* is larger, and we render only the element with its ID equal to */
+    /* `glyph<ID>`.                                                   */
+    if ( start_glyph_id < end_glyph_id )
+      sprintf( id, "#glyph%u", slot->glyph_index );
+
+    if ( start_glyph_id <= end_glyph_id )
     {
-      char  str[32] = "#glyph";
-
-
-      /* Render only the element with its ID equal to `glyph<ID>`. */
-      sprintf( str + 6, "%u", slot->glyph_index );
-      ret = rsvg_handle_render_cairo_sub( handle, rec_cr, str );
+      ret = rsvg_port_draw( handle, rec_cr, id );
       if ( ret == FALSE )
       {
         error = FT_Err_Invalid_SVG_Document;
@@ -380,21 +643,37 @@
 
     /* If a render call is to follow, just destroy the context for the */
     /* recording surface since no more drawing will be done on it.     */
-    /* However, keep the surface itself for use by the render hook.    */
-    if ( cache == TRUE )
+    /* However, keep the surface itself for use by the render hook,    */
+    /* or hand over the document for direct rendering.                 */
+    direct = cache == TRUE                 &&
+             port->options.direct          &&
+             start_glyph_id <= end_glyph_id;
+
+    if ( cache == TRUE && !direct )
     {
       cairo_destroy( rec_cr );
       goto CleanLibrsvg;
     }
 
+    if ( direct )
+    {
+      state->handle    = g_object_ref( handle );
+      state->x_scale   = x_svg_to_out;
+      state->y_scale   = y_svg_to_out;
+      state->transform = transform_matrix;
+      strcpy( state->id, id );
+    }
+
     /* Destroy the recording surface as well as the context. */
   CleanCairo:
     cairo_surface_destroy( state->rec_surface );
+    state->rec_surface = NULL;
     cairo_destroy( rec_cr );
 
   CleanLibrsvg:
-    /* Destroy the handle. */
-    g_object_unref( handle );
+    /* Destroy the handle unless it is cached. */
+    if ( !entry )
+      g_object_unref( handle );
 
     return error;
   }
@@ -22,6 +22,50 @@
 #include <ft2build.h>
 #include <freetype/otsvg.h>
 
+#include <stddef.h>
+
+
+  /*
+   * Parsed SVG documents are kept in a cache of each library, so that
+   * glyphs from the same document, as in most OT-SVG emoji fonts, and the
+   * two presetting calls for a glyph do not parse it again.  The least
+   * recently used documents are dropped if there are more than
+   * `cache_entries` of them or their size exceeds `cache_limit` bytes in
+   * total; larger documents are not cached at all.
+   *
+   * If `direct` is set, the render hook draws the document straight into
+   * the bitmap of the glyph slot instead of replaying the drawing that the
+   * preset hook recorded to get its extents.  This needs less memory for
+   * complex glyphs but draws them twice.
+   *
+   * The options are read when a library loads its first OT-SVG glyph; set
+   * them before.
+   */
+  typedef struct  Rsvg_Port_OptionsRec_
+  {
+    size_t   cache_limit;    /* 0 disables the cache */
+    int      cache_entries;
+    FT_Bool  direct;
+
+  } Rsvg_Port_OptionsRec;
+
+
+  /*
+   * Cache statistics, summed over the libraries done so far.
+   */
+  typedef struct  Rsvg_Port_StatsRec_
+  {
+    unsigned long  lookups;
+    unsigned long  hits;
+    unsigned long  evictions;  /* documents dropped to make room */
+
+  } Rsvg_Port_StatsRec;
+
+
+  extern Rsvg_Port_OptionsRec  rsvg_port_options;
+  extern Rsvg_Port_StatsRec    rsvg_port_stats;
+
+
 #ifdef HAVE_LIBRSVG
 
 #include <cairo.h>
@@ -34,6 +78,29 @@
    * structure and putting its address in `library->svg_renderer_state`.
    * Functions can then store and retrieve data from this structure.
    */
+  typedef struct  Rsvg_Port_EntryRec_
+  {
+    struct Rsvg_Port_EntryRec_  *prev;   /* more recently used */
+    struct Rsvg_Port_EntryRec_  *next;
+
+    /* the key */
+    FT_Byte        *svg_document;
+    FT_ULong        svg_document_length;
+    FT_UShort       start_glyph_id;
+    FT_UShort       end_glyph_id;
+    unsigned long   hash;
+
+    RsvgHandle  *handle;
+
+    /* units of the EM square in the document */
+    int  width;
+    int  height;
+
+  } Rsvg_Port_EntryRec;
+
+  typedef struct Rsvg_Port_EntryRec_*  Rsvg_Port_Entry;
+
+
   typedef struct  Rsvg_Port_StateRec_
   {
     cairo_surface_t  *rec_surface;
@@ -41,6 +108,22 @@
     double  x;
     double  y;
 
+    /* For direct rendering, the preset hook passes the document and */
+    /* the transformation to the render hook instead of a drawing.   */
+    RsvgHandle      *handle;
+    double           x_scale;
+    double           y_scale;
+    cairo_matrix_t   transform;
+    char             id[32];
+
+    Rsvg_Port_OptionsRec  options;
+    Rsvg_Port_StatsRec    stats;
+
+    Rsvg_Port_Entry  first;   /* most recently used */
+    Rsvg_Port_Entry  last;
+    int              num_entries;
+    size_t           cache_size;
+
   } Rsvg_Port_StateRec;
 
   typedef struct Rsvg_Port_StateRec_*  Rsvg_Port_State;
@@ -0,0 +1,117 @@
+/****************************************************************************/
+/*                                                                          */
+/*  The FreeType project -- a free and portable quality TrueType renderer.  */
+/*                                                                          */
+/*  Copyright (C) 2023 by                                                   */
+/*  D. Turner, R.Wilhelm, and W. Lemberg                                    */
+/*                                                                          */
+/*                                                                          */
+/*  thread.h - minimal portability layer for the demo programs that use     */
+/*             helper threads (Win32 or POSIX threads).                     */
+/*                                                                          */
+/****************************************************************************/
+
+
+#ifndef THREAD_H_
+#define THREAD_H_
+
+#ifdef UNIX
+#include <unistd.h>   /* for `_POSIX_THREADS' */
+#endif
+
+
+  /*
+   * `FTDEMO_THREADS' is defined if threads are available.  Without them,
+   * `LOCK' and `UNLOCK' do nothing and ignore their argument, so that the
+   * lock itself only needs to exist if `FTDEMO_THREADS' is defined.
+   *
+   * A thread function is declared as
+   *
+   *   static tthread_ret_t TTHREAD_CALL
+   *   func( void*  arg );
+   *
+   * and started with `start_thread', which returns nonzero on failure.
+   * Locks and condition variables are initialized statically with
+   * `TLOCK_INITIALIZER' and `TCOND_INITIALIZER'.
+   */
+
+#if defined _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define FTDEMO_THREADS
+#elif defined _POSIX_THREADS && _POSIX_THREADS > 0
+#include <pthread.h>
+#define FTDEMO_THREADS
+#endif
+
+
+#ifdef FTDEMO_THREADS
+
+#ifdef _WIN32
+
+  typedef HANDLE              thandle_t;
+  typedef DWORD               tthread_ret_t;
+  typedef SRWLOCK             tlock_t;
+  typedef CONDITION_VARIABLE  tcond_t;
+
+#define TTHREAD_CALL  WINAPI
+
+#define TLOCK_INITIALIZER  SRWLOCK_INIT
+#define TCOND_INITIALIZER  CONDITION_VARIABLE_INIT
+
+#define LOCK( l )          AcquireSRWLockExclusive( &(l) )
+#define UNLOCK( l )        ReleaseSRWLockExclusive( &(l) )
+#define WAIT( c, l )       SleepConditionVariableSRW( &(c), &(l), \
+                                                      INFINITE, 0 )
+#define BROADCAST( c )     WakeAllConditionVariable( &(c) )
+
+#define start_thread( h, func, arg )                                   \
+          ( ( *(h) = CreateThread( NULL, 0, (func), (arg), 0, NULL ) ) \
+            == NULL )
+#define join_thread( h )                          \
+          do                                      \
+          {                                       \
+            WaitForSingleObject( (h), INFINITE ); \
+            CloseHandle( (h) );                   \
+          } while ( 0 )
+
+#else /* !_WIN32 */
+
+  typedef pthread_t        thandle_t;
+  typedef void*            tthread_ret_t;
+  typedef pthread_mutex_t  tlock_t;
+  typedef pthread_cond_t   tcond_t;
+
+#define TTHREAD_CALL  /* empty */
+
+#define TLOCK_INITIALIZER  PTHREAD_MUTEX_INITIALIZER
+#define TCOND_INITIALIZER  PTHREAD_COND_INITIALIZER
+
+#define LOCK( l )          pthread_mutex_lock( &(l) )
+#define UNLOCK( l )        pthread_mutex_unlock( &(l) )
+#define WAIT( c, l )       pthread_cond_wait( &(c), &(l) )
+#define BROADCAST( c )     pthread_cond_broadcast( &(c) )
+
+#define start_thread( h, func, arg )  pthread_create( (h), NULL, \
+                                                      (func), (arg) )
+#define join_thread( h )              pthread_join( (h), NULL )
+
+#endif /* !_WIN32 */
+
+#else /* !FTDEMO_THREADS */
+
+  typedef void*  tthread_ret_t;
+
+#define TTHREAD_CALL  /* empty */
+
+#define LOCK( l )    do { } while ( 0 )
+#define UNLOCK( l )  do { } while ( 0 )
+
+#endif /* !FTDEMO_THREADS */
+
+#endif /* THREAD_H_ */
+
+
+/* End */